@@ -28,9 +28,13 @@ class UKinectSensor : public UObject
 
  public:
   UKinectSensor(const FObjectInitializer& ObjectInitializer);
+
+  virtual void PostInitProperties() override;
+  virtual void BeginDestroy() override;
   
  private:
-  struct IKinectSensor *KinectSensor;
+  /** Keeps the plugin's shared sensor open for as long as this object lives. */
+  class FKinectHubFrameSource *FrameSource;
 };
 
 
@@ -1,10 +1,19 @@
 #include "KinectPluginPrivatePCH.h"
 #include "KinectActor.h"
+#include "KinectColorConversion.h"
+#include "KinectSensorHub.h"
+#include "KinectSyntheticFrameSource.h"
+#include "KinectReplayFrameSource.h"
 #include "Vector2D.h"
 #include "AllowWindowsPlatformTypes.h"
 #include "comdef.h"
 #include "ppl.h"
 
+DECLARE_CYCLE_STAT(TEXT("Update Vertex Data"), STAT_KinectUpdateVertexData, STATGROUP_Kinect);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Frame Packets Published"), STAT_KinectFramePacketsPublished, STATGROUP_Kinect);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Frame Packets Dropped"), STAT_KinectFramePacketsDropped, STATGROUP_Kinect);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Updates Coalesced"), STAT_KinectUpdatesCoalesced, STATGROUP_Kinect);
+
 static void LogKinectError(const FString &context, int hr) {
 	_com_error err(hr);
 	LPCTSTR errMsg = err.ErrorMessage();
@@ -18,18 +27,34 @@ AKinectActor::AKinectActor(const class FObjectInitializer& PCIP)
 	, Camera(0)
 	, DepthCamera(0)
 	, InfraredCamera(0)
-	, ColorSource(0)
-	, DepthSource(0)
-	, BodySource(0)
-	, BodyIndexSource(0)
-	, ColorReader(0)
-	, DepthReader(0)
-	, BodyReader(0)
-	, BodyIndexReader(0)
+	, FrameSource(nullptr)
+	, bCoordinateMappingChanged(false)
+	, bUseSyntheticFrameSource(false)
+	, ReplayFramesPerSecond(0.0f)
+	, bReplayAsFastAsPossible(false)
+	, bLoopReplay(true)
+	, bCompressRecordedDepth(true)
+	, FrameSyncToleranceMilliseconds(FKinectFrameSynchronizer::DefaultToleranceMilliseconds)
+	, bHalfResolutionCamera(false)
+	, bMirrorBodies(true)
+	, bQueryHandStates(true)
+	, bQueryJointOrientations(true)
+	, bQueryLean(false)
+	, bQueryActivities(false)
+	, bQueryAppearance(false)
+	, bQueryExpressions(false)
+	, BodyLatencyCompensationSeconds(0.0f)
+	, MaxBodyExtrapolationSeconds(0.1f)
+	, bEnableGestures(true)
+	, JointFilter(EJointFilter::None)
+	, JointPositionFilter(FKinectJointFilter::GetDefaultParams(FKinectJointFilter::Position))
+	, JointOrientationFilter(FKinectJointFilter::GetDefaultParams(FKinectJointFilter::Orientation))
 	, bEnableBodyIndexMask(false)
-	, CoordinateMapper(0)
 	, Resolution(2)
 	, MaxEdgeLength(8)
+	, bWeldGridVertices(false)
+	, MeshTileSize(0)
+	, MeshTileChangeThreshold(4.0f)
 	, InnerBandThreshold(2)
 	, OuterBandThreshold(5)
 	, bEnableDepthSmoothing(false)
@@ -38,8 +63,19 @@ AKinectActor::AKinectActor(const class FObjectInitializer& PCIP)
 	, MinDistanceInMeters(0)
 	, MaxDistanceInMeters(2)
 	, BilateralFilterKernelSize(4)
+	, bEnableBilateralFilter(false)
+	, BilateralSpatialSigma(2.0f)
+	, BilateralRangeSigma(20.0f)
+	, bApproximateBilateralFilter(true)
 	, bPlaying(false)
 	, Thread(nullptr)
+	, CurrentFrame(0)
+	, bColorFrameArrived(false)
+	, bDepthFrameArrived(false)
+	, bBodyFrameArrived(false)
+	, LastBodyTime(-1)
+	, bBackPacketDropped(false)
+	, bBodiesBuilt(true)
 	, HoleFillingRadius(10)
 	, SmoothingRadius(2)
 	, Tc(2)
@@ -57,140 +93,104 @@ AKinectActor::~AKinectActor()
 
 }
 
-#define SafeRelease(p) { if (p) p->Release(); p = nullptr; }
-
 void AKinectActor::BeginPlay()
 {
 	Camera = NewObject<UKinectTexture>();
-	HRESULT hResult = S_OK;
-	hResult = GetDefaultKinectSensor(&Sensor);
-	if (FAILED(hResult)){
-		return;
-	}
-
-	// Open Sensor
-	hResult = Sensor->Open();
-	if (FAILED(hResult))
+	if (bUseSyntheticFrameSource)
 	{
-		LogKinectError("Sensor Open", hResult);
-		return;
+		FrameSource = new FKinectSyntheticFrameSource();
 	}
-
-	// Retrieved Coordinate Mapper
-	hResult = Sensor->get_CoordinateMapper(&CoordinateMapper);
-	if (FAILED(hResult))
+	else if (!ReplayFilename.IsEmpty())
 	{
-		LogKinectError("Get Coordinate Mapper", hResult);
-		return;
-	}
-
-	// Retrieved Color Frame Source
-	hResult = Sensor->get_ColorFrameSource(&ColorSource);
-	if (FAILED(hResult)){
-		LogKinectError("Get Color Frame Source", hResult);
-		return;
-	}
-
-	// Retrieved Depth Frame Source
-	hResult = Sensor->get_DepthFrameSource(&DepthSource);
-	if (FAILED(hResult))
-	{
-		LogKinectError("Get Depth Frame Source", hResult);
-		return;
-	}
-
-	// Open Color Frame Reader
-	hResult = ColorSource->OpenReader(&ColorReader);
-	if (FAILED(hResult))
-	{
-		LogKinectError("Color Source Open Reader", hResult);
-		return;
+		FKinectReplaySettings Settings;
+		Settings.Pacing = bReplayAsFastAsPossible ? EKinectReplayPacing::AsFastAsPossible :
+			ReplayFramesPerSecond > 0.0f ? EKinectReplayPacing::FixedRate : EKinectReplayPacing::RealTime;
+		Settings.FramesPerSecond = ReplayFramesPerSecond;
+		Settings.bLoop = bLoopReplay;
+		FrameSource = new FKinectReplayFrameSource(ReplayFilename, Settings);
 	}
-
-	// Open Depth Frame Reader
-	hResult = DepthSource->OpenReader(&DepthReader);
-	if (FAILED(hResult))
+	else
 	{
-		LogKinectError("Depth Source Open Reader", hResult);
-		return;
+		// Shares the sensor, and each acquired frame, with every other actor in the process
+		FrameSource = new FKinectHubFrameSource(IKinectPlugin::Get().GetSensorHub());
 	}
-
-	hResult = Sensor->get_BodyFrameSource(&BodySource);
-	if (FAILED(hResult)){
-		LogKinectError("Error : IKinectSensor::get_BodyFrameSource()", hResult);
-		return;
-	}
-
-	hResult = BodySource->OpenReader(&BodyReader);
-	if (FAILED(hResult)){
-		LogKinectError("Error : IBodyFrameSource::OpenReader()", hResult);
-		return;
-	}
-	
-	// Retrieved Color Frame Size
-	IFrameDescription* pColorDescription;
-	hResult = ColorSource->get_FrameDescription(&pColorDescription);
+	const int32 Streams = EKinectFrameStream::Color | EKinectFrameStream::Depth | EKinectFrameStream::Body |
+		(bEnableBodyIndexMask ? EKinectFrameStream::BodyIndex : EKinectFrameStream::None);
+	FrameSource->SetBodyAttributes(GetBodyAttributes());
+	HRESULT hResult = FrameSource->Open(Streams);
 	if (FAILED(hResult))
 	{
-		LogKinectError("Color Source Frame Description", hResult);
+		LogKinectError("Open Frame Source", hResult);
+		delete FrameSource;
+		FrameSource = nullptr;
 		return;
 	}
-	pColorDescription->get_Width(&ColorWidth); // 1920
-	pColorDescription->get_Height(&ColorHeight); // 1080
-	pColorDescription->Release();
-	if (Camera) Camera->SetDimensions(FIntPoint(ColorWidth, ColorHeight));
-
-	// To Reserve Color Frame Buffer
-	// Retrieved Depth Frame Size
-	IFrameDescription* pDepthDescription;
-	hResult = DepthSource->get_FrameDescription(&pDepthDescription);
-	if (FAILED(hResult))
+	DepthUnprojector.Invalidate();
+	bCoordinateMappingChanged = false;
+	if (!RecordFilename.IsEmpty())
 	{
-		LogKinectError("Depth Source Frame Description", hResult);
-		return;
+		Recorder.Start(RecordFilename, *FrameSource, bCompressRecordedDepth);
 	}
-
-	pDepthDescription->get_Width(&DepthWidth); // 512
-	pDepthDescription->get_Height(&DepthHeight); // 424
-	pDepthDescription->Release();
-	ColorBuffer.Reset();
-	DepthBuffer.Reset();
+	// Bodies take their own path in Run and never hold back a mesh
+	FrameSynchronizer.Configure(Streams & ~EKinectFrameStream::Body, EKinectFrameStream::None, FrameSyncToleranceMilliseconds);
+
+	const FIntPoint ColorSize = FrameSource->GetColorSize();
+	ColorWidth = ColorSize.X;
+	ColorHeight = ColorSize.Y;
+	if (Camera) Camera->SetDimensions(bHalfResolutionCamera ? ColorSize / 2 : ColorSize);
+	const FIntPoint DepthSize = FrameSource->GetDepthSize();
+	DepthWidth = DepthSize.X;
+	DepthHeight = DepthSize.Y;
+	ColorFrame.Reset();
+	ColorImage.Reset();
+	DepthFrame.Reset();
+	BodyIndexFrame.Reset();
 	SmoothDepthBuffer.Reset();
-	ColorBuffer.AddUninitialized(ColorWidth * ColorHeight);
-	DepthBuffer.AddUninitialized(DepthWidth * DepthHeight);
 	SmoothDepthBuffer.AddUninitialized(DepthWidth * DepthHeight);
-	if (bEnableBodyIndexMask)
+	FilteredDepthBuffer.Reset();
+	FilteredDepthBuffer.AddUninitialized(DepthWidth * DepthHeight);
+	if (Thread != nullptr)
 	{
-		BodyIndexBuffer.Reset();
-		BodyIndexBuffer.AddUninitialized(DepthWidth * DepthHeight);
-		hResult = Sensor->get_BodyIndexFrameSource(&BodyIndexSource);
-		if (FAILED(hResult)){
-			LogKinectError("Error : IKinectSensor::get_BodyIndexFrameSource()", hResult);
-			return;
-		}
-
-		hResult = BodyIndexSource->OpenReader(&BodyIndexReader);
-		if (FAILED(hResult)){
-			LogKinectError("Error : IBodyIndexFrameSource::OpenReader()", hResult);
-			return;
-		}
+		delete Thread;
 	}
-	else
+	SectionWriter.Reset();
+	TileWriters.Reset();
+	MeshTiles.Reset();
+	Bodies.SetNum(BODY_COUNT);
+	for (int32 i = 0; i < Bodies.Num(); i++)
 	{
-		BodyIndexBuffer.Empty();
+		Bodies[i].bIsTracked = false;
+		Bodies[i].Joints.SetNum(JointType_Count);
 	}
-	if (Thread != nullptr)
+	BodyFramePool.Reset();
+	UpdateBodyFrame.Reset();
+	LastBodyTime = -1;
+	ConfigureJointFilter();
+	BodyFrame.Reset();
+	bBodiesBuilt = true;
+	BodyHistory.Reset();
+	GestureRecognizer.Reset();
+	RecognizedGestures.Reset();
+	if (!GestureLibraryFilename.IsEmpty())
 	{
-		delete Thread;
+		GestureRecognizer.LoadLibrary(GestureLibraryFilename);
+	}
+	if (!PredictedBodyFrame.IsValid())
+	{
+		PredictedBodyFrame = MakeShareable(new FKinectBodyFrame());
 	}
-	ConsumerFrame = 0;
-	ProducerFrame = 0;
-	Bodies.SetNum(6);
-	UpdateBodies.SetNum(6);
-	for (int i = 0; i < UpdateBodies.Num(); i++)
+	for (int32 i = 0; i < FramePackets.NumSlots; i++)
 	{
-		UpdateBodies[i].Joints.SetNum(JointType::JointType_Count);
+		FKinectFramePacket &Packet = FramePackets.GetSlot(i);
+		ResetFramePacket(Packet);
+		Packet.bMeshTiled = false;
+		Packet.Mesh.Reset();
+		Packet.Tiles.Reset();
+		Packet.TileDirty.Reset();
+		Packet.BodyFrame.Reset();
 	}
+	bBackPacketDropped = false;
+	UpdateMailbox.Take();
 	bPlaying = true;
 	if (Camera) Camera->UpdateResource();
 	Thread = FRunnableThread::Create(this, TEXT("MeshGenerator"));
@@ -201,262 +201,400 @@ void AKinectActor::BeginPlay()
 void AKinectActor::Tick(float DeltaTime)
 {
 	Super::Tick(DeltaTime);
-
-	CommandDelegate Command;
-
-	while (Commands.Dequeue(Command))
+	DoUpdates();
+	if (BodyLatencyCompensationSeconds > 0.0f && PredictedBodyFrame.IsValid() &&
+		BodyHistory.Sample(FPlatformTime::Seconds() + BodyLatencyCompensationSeconds, MaxBodyExtrapolationSeconds, *PredictedBodyFrame))
 	{
-		Command.Execute();
+		// Only the game thread reads the predicted frame, so it is filled in place
+		BodyFrame = PredictedBodyFrame;
+		bBodiesBuilt = false;
 	}
+	if (bMirrorBodies)
+	{
+		BuildBodies();
+	}
+}
 
+void AKinectActor::UpdateBody(const FKinectFramePacket &Packet)
+{
+	// Only the pointer is taken; Bodies is rebuilt when something asks for it
+	BodyFrame = Packet.BodyFrame;
+	bBodiesBuilt = false;
+	for (const FKinectGestureEvent &Gesture : Packet.Gestures)
+	{
+		OnGestureRecognized.Broadcast(Gesture.Body, Gesture.Name, Gesture.Cost);
+	}
 }
 
-void AKinectActor::UpdateBody()
+void AKinectActor::UpdateCamera(const FKinectFramePacket &Packet)
 {
-	Bodies = UpdateBodies;
+	Camera->SetCurrentFrame(Packet.CameraFrame);
 }
 
-void AKinectActor::UpdateCamera()
+void AKinectActor::UpdateMesh(const FKinectFramePacket &Packet)
 {
-	if (!CurrentCameraFrame.IsValid() || CurrentCameraFrame->Num() != ColorBuffer.Num() * 4)
+	if (Packet.bMeshTiled)
 	{
-		TArray<uint8> *Copy = new TArray<uint8>();
-		Copy->SetNumUninitialized(ColorBuffer.Num() * 4);
-		CurrentCameraFrame = TSharedPtr<TArray<uint8>, ESPMode::ThreadSafe>(Copy);
+		if (Packet.bTileLayoutChanged || TileWriters.Num() != Packet.Tiles.Num())
+		{
+			MeshComp->ClearAllMeshSections();
+			SectionWriter.Reset();
+			TileWriters.Reset();
+			TileWriters.SetNum(Packet.Tiles.Num());
+		}
+		for (int32 t = 0; t < Packet.Tiles.Num(); t++)
+		{
+			if (Packet.TileDirty[t])
+			{
+				TileWriters[t].Write(MeshComp, t, Packet.Tiles[t], Normals, EnablePhysics);
+			}
+		}
 	}
-	CurrentCameraFrame->Reset(ColorBuffer.Num() * 4);
-	for (int i = 0; i < ColorBuffer.Num(); i++) {
-		const RGBQUAD &q = ColorBuffer[i];
-		CurrentCameraFrame->Add(q.rgbBlue);
-		CurrentCameraFrame->Add(q.rgbGreen);
-		CurrentCameraFrame->Add(q.rgbRed);
-		CurrentCameraFrame->Add(1);
+	else
+	{
+		if (TileWriters.Num() > 0)
+		{
+			MeshComp->ClearAllMeshSections();
+			TileWriters.Reset();
+			SectionWriter.Reset();
+		}
+		SectionWriter.Write(MeshComp, 0, Packet.Mesh, Normals, EnablePhysics);
 	}
-	Camera->SetCurrentFrame(CurrentCameraFrame);
 }
 
-void AKinectActor::UpdateMesh()
+void AKinectActor::DoUpdates()
 {
-
-	MeshComp->ClearAllMeshSections();
-	MeshComp->CreateMeshSection(0, Vertices, Triangles, Normals, UVs, VertexColors, Tangents, EnablePhysics);
-	ConsumerFrame = ProducerFrame;
+	// Posts always follow their packet, so nothing pending means nothing new to acquire
+	if (UpdateMailbox.Take() == EKinectUpdate::None || !FramePackets.Acquire())
+	{
+		return;
+	}
+	// The packet's own flags include whatever dropped packets merged into it
+	const FKinectFramePacket &Packet = FramePackets.GetFront();
+	if (Packet.bCameraFrameChanged)
+	{
+		UpdateCamera(Packet);
+	}
+	if (Packet.bBodiesChanged)
+	{
+		UpdateBody(Packet);
+	}
+	if (Packet.bMeshChanged)
+	{
+		UpdateMesh(Packet);
+	}
 }
 
-void AKinectActor::DoUpdates(bool DoMesh)
+void AKinectActor::ResetFramePacket(FKinectFramePacket &Packet)
 {
-	Crit.Lock();
-	UpdateCamera();
-	UpdateBody();
-	if (DoMesh)
+	Packet.bCameraFrameChanged = false;
+	Packet.bMeshChanged = false;
+	Packet.bBodiesChanged = false;
+	Packet.Gestures.Reset();
+	Packet.bTileLayoutChanged = false;
+	for (int32 t = 0; t < Packet.TileDirty.Num(); t++)
 	{
-		UpdateMesh();
+		Packet.TileDirty[t] = false;
 	}
-	Crit.Unlock();
 }
 
 uint32 AKinectActor::Run()
 {
 	while (bPlaying)
 	{
-		bool DoMeshData;
-		Update();
-		Crit.Lock();
-		DoMeshData = ConsumerFrame >= ProducerFrame;
-		Crit.Unlock();
-		if (DoMeshData)
+		// Woken by the frame source as soon as a bundle arrives, or by Stop at EndPlay
+		if (!FrameSource->WaitForFrame(IncomingBundle, 100))
+		{
+			continue;
+		}
+		if (FrameSource->PollCoordinateMappingChanged())
+		{
+			bCoordinateMappingChanged = true;
+			Recorder.InvalidateCalibration();
+		}
+		// The recorder copies what it needs, the sensor frames stay with the synchronizer
+		Recorder.Write(IncomingBundle, *FrameSource);
+		// Bodies wait for no color or depth frame, so every body frame is filtered and recognized once
+		DoUpdateBody(IncomingBundle);
+		FrameSynchronizer.Push(IncomingBundle);
+		// Only the newest matched bundle is worth a mesh, older ones go back to the synchronizer
+		bool bMatched = false;
+		while (FrameSynchronizer.Pop(FrameBundle))
+		{
+			bMatched = true;
+		}
+		// Frames still waiting for a partner would keep the sensor from delivering the next ones
+		FrameSynchronizer.RetainQueuedFrames();
+		if (bMatched)
+		{
+			Update();
+		}
+		else
+		{
+			bColorFrameArrived = false;
+			bDepthFrameArrived = false;
+		}
+		if (!bColorFrameArrived && !bDepthFrameArrived && !bBodyFrameArrived)
+		{
+			continue;
+		}
+
+		// A dropped packet keeps its camera frame and dirty tiles, the new frame is merged on top
+		FKinectFramePacket &Packet = FramePackets.GetBack();
+		if (!bBackPacketDropped)
+		{
+			ResetFramePacket(Packet);
+		}
+		if (bColorFrameArrived)
+		{
+			Packet.CameraFrame = ColorFrame;
+			Packet.bCameraFrameChanged = true;
+		}
+		// Color and depth are both required by the synchronizer, so a depth frame always comes with its color
+		const bool bMeshChanged = bDepthFrameArrived;
+		if (bMeshChanged)
+		{
+			UpdateVertexData(Packet);
+			Packet.bMeshChanged = true;
+		}
+		// The mesh holds all that is needed of them, hand the sensor its buffers back
+		ColorImage.Reset();
+		DepthFrame.Reset();
+		BodyIndexFrame.Reset();
+		if (bBodyFrameArrived)
 		{
-			UpdateVertexData();
-			Crit.Lock();
-			ProducerFrame = ConsumerFrame + 1;
-			Crit.Unlock();
+			Packet.BodyFrame = UpdateBodyFrame;
+			Packet.bBodiesChanged = true;
+			UpdateBodyFrame.Reset();
+			// Appended, so the gestures of a dropped packet still reach the game thread
+			Packet.Gestures.Append(RecognizedGestures);
+			RecognizedGestures.Reset();
 		}
-		Commands.Enqueue(FSimpleDelegate::CreateUObject(this, &AKinectActor::DoUpdates, DoMeshData));
-		FPlatformProcess::Sleep(1.0f / 60);
+		Packet.Timestamp = CurrentFrame;
+		const int32 Kinds = (bMeshChanged ? EKinectUpdate::Mesh : EKinectUpdate::None) |
+			(bColorFrameArrived ? EKinectUpdate::Camera : EKinectUpdate::None) |
+			(bBodyFrameArrived ? EKinectUpdate::Bodies : EKinectUpdate::None);
+		bBackPacketDropped = FramePackets.Publish();
+		INC_DWORD_STAT(STAT_KinectFramePacketsPublished);
+		if (bBackPacketDropped)
+		{
+			INC_DWORD_STAT(STAT_KinectFramePacketsDropped);
+		}
+		INC_DWORD_STAT_BY(STAT_KinectUpdatesCoalesced, FKinectUpdateMailbox::CountKinds(UpdateMailbox.Post(Kinds)));
 	}
 	return 0;
 }
 
 
-void AKinectActor::UpdateVertexData()
+bool AKinectActor::UpdateDepthUnprojector()
+{
+	if (bCoordinateMappingChanged)
+	{
+		bCoordinateMappingChanged = false;
+		DepthUnprojector.Invalidate();
+	}
+	if (!DepthUnprojector.IsValid())
+	{
+		DepthUnprojector.Rebuild(FrameSource->GetDepthIntrinsics(), DepthWidth, DepthHeight);
+	}
+	return DepthUnprojector.IsValid();
+}
+
+void AKinectActor::UpdateVertexData(FKinectFramePacket &Packet)
 {
+	SCOPE_CYCLE_COUNTER(STAT_KinectUpdateVertexData);
+	if (DepthFrame.Num() != DepthWidth * DepthHeight)
+	{
+		Packet.Mesh.Reset();
+		Packet.bMeshTiled = false;
+		MeshTiles.Reset();
+		return;
+	}
+	const UINT16 *Depth = DepthFrame.GetData();
 	if (bEnableDepthSmoothing)
 	{
 		FillHoles();
-		//BilateralFilter();
+		Depth = SmoothDepthBuffer.GetData();
 	}
-	TArray<UINT16> &DepthBuffer = bEnableDepthSmoothing ? this->SmoothDepthBuffer : this->DepthBuffer;
-	Triangles.Reset();
-	Vertices.Reset();
-	VertexColors.Reset();
-	CurrentFrame++;
-	const int step = Resolution;
-	const int startx = FMath::RoundToInt((DepthWidth - FMath::Clamp(ViewportWidth, 0.0f, 1.0f)*DepthWidth) / 2.0f);
-	const int starty = FMath::RoundToInt((DepthHeight - FMath::Clamp(ViewportHeight, 0.0f, 1.0f)*DepthHeight) / 2.0f);
-
-	for (int y = starty; y < DepthHeight - step - starty; y += step)
+	if (bEnableBilateralFilter)
 	{
-		for (int x = startx; x < DepthWidth - step - startx; x += step)
+		BilateralFilter(Depth);
+		Depth = FilteredDepthBuffer.GetData();
+	}
+	if (!UpdateDepthUnprojector() || ColorImage.Num() != ColorWidth * ColorHeight * 2)
+	{
+		Packet.Mesh.Reset();
+		Packet.bMeshTiled = false;
+		MeshTiles.Reset();
+		return;
+	}
+	HRESULT hResult = ColorRegistration.Register(*FrameSource, Depth, DepthWidth, DepthHeight,
+		ColorImage.GetData(), ColorWidth, ColorHeight);
+	if (FAILED(hResult))
+	{
+		LogKinectError("Color Registration", hResult);
+		Packet.Mesh.Reset();
+		Packet.bMeshTiled = false;
+		MeshTiles.Reset();
+		return;
+	}
+	FKinectDepthMeshInput Input;
+	Input.Depth = Depth;
+	Input.BodyIndex = BodyIndexFrame.Num() == DepthFrame.Num() ? BodyIndexFrame.GetData() : nullptr;
+	Input.BodyIndexMask = &BodyIndexMask;
+	Input.Color = ColorRegistration.GetRegisteredColor().GetData();
+	Input.Unprojector = &DepthUnprojector;
+	Input.Width = DepthWidth;
+	Input.Height = DepthHeight;
+
+	FKinectDepthMeshSettings Settings;
+	Settings.Step = Resolution;
+	Settings.ViewportWidth = ViewportWidth;
+	Settings.ViewportHeight = ViewportHeight;
+	Settings.MinDistanceInMeters = MinDistanceInMeters;
+	Settings.MaxDistanceInMeters = MaxDistanceInMeters;
+	Settings.MaxEdgeLength = MaxEdgeLength;
+	Settings.bWeldGridVertices = bWeldGridVertices;
+	if (MeshTileSize > 0)
+	{
+		Settings.TileSize = MeshTileSize;
+		Settings.TileChangeThreshold = MeshTileChangeThreshold;
+		// Every tile is dirty after a layout change, so a recycled packet only needs resizing
+		const bool bLayoutChanged = DepthMesher.TriangulateTiles(Input, Settings, MeshTiles, DirtyTiles);
+		if (bLayoutChanged || Packet.Tiles.Num() != MeshTiles.Num())
 		{
-			FVector P[2][2];
-			FColor C[2][2];
-			const float scale = 100.0f; // meters to centimeters
-			bool skip = false;
-			for (int32 ix = 0; ix < 2 && !skip; ix++)
-			{
-				for (int32 iy = 0; iy < 2 && !skip; iy++)
-				{
-					int32 X = (x + ix*step);
-					int32 Y = (y + iy*step);				
-					UINT16 depth = DepthBuffer[Y * DepthWidth + X];
-					if (BodyIndexBuffer.Num() > 0)
-					{
-						uint8 index = BodyIndexBuffer[Y * DepthWidth + X];
-						skip = index == 255;
-						if (!skip)
-						{
-							if (index >= 0 && index < BodyIndexMask.Num())
-							{
-								skip = !BodyIndexMask[index];
-							}
-							else
-							{
-								skip = true;
-							}
-						}
-						if (skip) break;
-					}
-					DepthSpacePoint depthSpacePoint = { static_cast<float>(X), static_cast<float>(Y) };
-					// Coordinate Mapping Depth to Color Space, and Setting PointCloud RGB
-					ColorSpacePoint colorSpacePoint = { 0.0f, 0.0f };
-					CoordinateMapper->MapDepthPointToColorSpace(depthSpacePoint, depth, &colorSpacePoint);
-					int colorX = static_cast<int>(std::floor(colorSpacePoint.X + 0.5f));
-					int colorY = static_cast<int>(std::floor(colorSpacePoint.Y + 0.5f));
-					// Coordinate Mapping Depth to Camera Space, and Setting PointCloud XYZ
-					CameraSpacePoint cameraSpacePoint = { 0.0f, 0.0f, 0.0f };
-					CoordinateMapper->MapDepthPointToCameraSpace(depthSpacePoint, depth, &cameraSpacePoint);
-					float dist = FMath::Sqrt(cameraSpacePoint.X * cameraSpacePoint.X +
-						cameraSpacePoint.Y * cameraSpacePoint.Y +
-						cameraSpacePoint.Z * cameraSpacePoint.Z);
-					if (dist > MinDistanceInMeters && dist <= MaxDistanceInMeters &&
-						(0 <= colorX) && (colorX < ColorWidth) && (0 <= colorY) && (colorY < ColorHeight))
-					{
-						RGBQUAD color = ColorBuffer[colorY * ColorWidth + colorX];
-						C[ix][iy] = FColor(color.rgbRed, color.rgbGreen, color.rgbBlue);
-						float right = cameraSpacePoint.X;
-						float up = cameraSpacePoint.Y;
-						float forward = cameraSpacePoint.Z;
-						FVector P0;
-						P0.X = forward * scale;
-						P0.Y = right * scale;
-						P0.Z = up * scale;
-						P[ix][iy] = P0;
-					}
-					else
-					{
-						skip = true;
-					}
-
-				}
-			}
-			if (skip) continue;
-			const FVector P00 = P[0][0];
-			const FVector P01 = P[0][1];
-			const FVector P10 = P[1][0];
-			const FVector P11 = P[1][1];
-			const int32 max_edge_len = MaxEdgeLength;
-			if (((P00.X > 0) && (P01.X > 0) && (P10.X > 0) && (P11.X > 0) && (P01.X > 0) && (P10.X > 0) &&// check for non valid values
-				(abs(P00.X - P01.X) < max_edge_len) &&
-				(abs(P10.X - P01.X) < max_edge_len) &&
-				(abs(P11.X - P01.X) < max_edge_len) &&
-				(abs(P10.X - P01.X) < max_edge_len)))
-			{
-				const int32 Next = Vertices.Num();
-				Vertices.Add(P00);
-				Vertices.Add(P01);
-				Vertices.Add(P10);
-
-				Triangles.Add(Next);
-				Triangles.Add(Next + 1);
-				Triangles.Add(Next + 2);
-
-
-				VertexColors.Add(C[0][0]);
-				VertexColors.Add(C[0][1]);
-				VertexColors.Add(C[1][0]);
-
-				//Vertices.Add(P01);
-				Triangles.Add(Next + 1);
-				Vertices.Add(P11);
-				Triangles.Add(Next + 3);
-				//Vertices.Add(P10);
-				Triangles.Add(Next + 2);
-				//VertexColors.Add(C[0][1]);
-				VertexColors.Add(C[1][1]);
-				//VertexColors.Add(C[1][0]);
-			}
+			Packet.Tiles.SetNum(MeshTiles.Num());
+			Packet.TileDirty.Init(false, MeshTiles.Num());
+		}
+		Packet.bTileLayoutChanged |= bLayoutChanged;
+		for (int32 i = 0; i < DirtyTiles.Num(); i++)
+		{
+			const int32 t = DirtyTiles[i];
+			Packet.Tiles[t] = MeshTiles[t];
+			Packet.TileDirty[t] = true;
 		}
+		Packet.bMeshTiled = true;
+	}
+	else
+	{
+		Packet.bMeshTiled = false;
+		DepthMesher.Triangulate(Input, Settings, Packet.Mesh);
+	}
+}
+
+/** The sensor's JointType of each EJointType, in EJointType order. */
+static const JointType SdkJointTypes[] =
+{
+	JointType_AnkleLeft,
+	JointType_AnkleRight,
+	JointType_ElbowLeft,
+	JointType_ElbowRight,
+	JointType_FootLeft,
+	JointType_FootRight,
+	JointType_HandLeft,
+	JointType_HandRight,
+	JointType_HandTipLeft,
+	JointType_HandTipRight,
+	JointType_Head,
+	JointType_HipLeft,
+	JointType_HipRight,
+	JointType_KneeLeft,
+	JointType_KneeRight,
+	JointType_Neck,
+	JointType_ShoulderLeft,
+	JointType_ShoulderRight,
+	JointType_SpineBase,
+	JointType_SpineMid,
+	JointType_SpineShoulder,
+	JointType_ThumbLeft,
+	JointType_ThumbRight,
+	JointType_WristLeft,
+	JointType_WristRight,
+};
+static_assert(ARRAY_COUNT(SdkJointTypes) == JointType_Count, "Every EJointType needs a sensor joint");
+
+/** The EJointType of each of the sensor's JointType, in JointType order. */
+static const EJointType EngineJointTypes[] =
+{
+	EJointType::SpineBase,
+	EJointType::SpineMid,
+	EJointType::Neck,
+	EJointType::Head,
+	EJointType::ShoulderLeft,
+	EJointType::ElbowLeft,
+	EJointType::WristLeft,
+	EJointType::HandLeft,
+	EJointType::ShoulderRight,
+	EJointType::ElbowRight,
+	EJointType::WristRight,
+	EJointType::HandRight,
+	EJointType::HipLeft,
+	EJointType::KneeLeft,
+	EJointType::AnkleLeft,
+	EJointType::FootLeft,
+	EJointType::HipRight,
+	EJointType::KneeRight,
+	EJointType::AnkleRight,
+	EJointType::FootRight,
+	EJointType::SpineShoulder,
+	EJointType::HandTipLeft,
+	EJointType::ThumbLeft,
+	EJointType::HandTipRight,
+	EJointType::ThumbRight,
+};
+static_assert(ARRAY_COUNT(EngineJointTypes) == JointType_Count, "Every sensor joint needs an EJointType");
+
+/** Index of Type in the sensor's joint arrays, or INDEX_NONE for a value out of range. */
+static int32 mapSdkJoint(EJointType Type)
+{
+	const int32 Index = static_cast<int32>(Type);
+	return Index < static_cast<int32>(ARRAY_COUNT(SdkJointTypes)) ? SdkJointTypes[Index] : INDEX_NONE;
+}
 
+int32 AKinectActor::GetBodyAttributes() const
+{
+	return (bQueryHandStates ? EKinectBodyAttribute::HandStates : EKinectBodyAttribute::None) |
+		(bQueryJointOrientations ? EKinectBodyAttribute::JointOrientations : EKinectBodyAttribute::None) |
+		(bQueryLean ? EKinectBodyAttribute::Lean : EKinectBodyAttribute::None) |
+		(bQueryActivities ? EKinectBodyAttribute::Activities : EKinectBodyAttribute::None) |
+		(bQueryAppearance ? EKinectBodyAttribute::Appearance : EKinectBodyAttribute::None) |
+		(bQueryExpressions ? EKinectBodyAttribute::Expressions : EKinectBodyAttribute::None);
+}
+
+void AKinectActor::UpdateBodyAttributeQueries()
+{
+	// Sources take their own locks or ignore it, so this is safe while the mesh thread runs
+	if (FrameSource)
+	{
+		FrameSource->SetBodyAttributes(GetBodyAttributes());
 	}
 }
 
-static EJointType mapJointType(JointType type)
+void AKinectActor::ConfigureJointFilter()
 {
-	switch (type)
+	switch (JointFilter)
 	{
-	case JointType::JointType_AnkleLeft:
-		return EJointType::AnkleLeft;
-	case JointType::JointType_AnkleRight:
-		return EJointType::AnkleRight;
-	case JointType::JointType_ElbowLeft:
-		return EJointType::ElbowLeft;
-	case JointType::JointType_ElbowRight:
-		return EJointType::ElbowRight;
-	case JointType::JointType_FootLeft:
-		return EJointType::FootLeft;
-	case JointType::JointType_FootRight:
-		return EJointType::FootRight;
-	case JointType::JointType_HandLeft:
-		return EJointType::HandLeft;
-	case JointType::JointType_HandRight:
-		return EJointType::HandRight;
-	case JointType::JointType_HandTipLeft:
-		return EJointType::HandTipLeft;
-	case JointType::JointType_HandTipRight:
-		return EJointType::HandTipRight;
-	case JointType::JointType_Head:
-		return EJointType::Head;
-	case JointType::JointType_HipLeft:
-		return EJointType::HipLeft;
-	case JointType::JointType_HipRight:
-		return EJointType::HipRight;
-	case JointType::JointType_KneeLeft:
-		return EJointType::KneeLeft;
-	case JointType::JointType_KneeRight:
-		return EJointType::KneeRight;
-	case JointType::JointType_Neck:
-		return EJointType::Neck;
-	case JointType::JointType_ShoulderLeft:
-		return EJointType::ShoulderLeft;
-	case JointType::JointType_ShoulderRight:
-		return EJointType::ShoulderRight;
-	case JointType::JointType_SpineBase:
-		return EJointType::SpineBase;
-	case JointType::JointType_SpineMid:
-		return EJointType::SpineMid;
-	case JointType::JointType_SpineShoulder:
-		return EJointType::SpineShoulder;
-	case JointType::JointType_ThumbLeft:
-		return EJointType::ThumbLeft;
-	case JointType::JointType_ThumbRight:
-		return EJointType::ThumbRight;
-	case JointType::JointType_WristLeft:
-		return EJointType::WristLeft;
-	case JointType::JointType_WristRight:
+	case EJointFilter::OneEuro:
+		BodyFilter.SetType(EKinectJointFilter::OneEuro);
+		break;
+	case EJointFilter::DoubleExponential:
+		BodyFilter.SetType(EKinectJointFilter::DoubleExponential);
+		break;
 	default:
-		return EJointType::WristRight;
+		BodyFilter.SetType(EKinectJointFilter::None);
+		break;
+	}
+	BodyFilter.SetParams(FKinectJointFilter::Position, JointPositionFilter.ToParams());
+	BodyFilter.SetParams(FKinectJointFilter::Orientation, JointOrientationFilter.ToParams());
+	for (const FJointFilterOverride &Override : JointFilterOverrides)
+	{
+		const int32 Joint = mapSdkJoint(Override.JointType);
+		if (Joint != INDEX_NONE)
+		{
+			BodyFilter.SetParams(FKinectJointFilter::Position, Joint, Override.Position.ToParams());
+			BodyFilter.SetParams(FKinectJointFilter::Orientation, Joint, Override.Orientation.ToParams());
+		}
 	}
-
 }
 
 static ETrackingState mapTrackingState(TrackingState State)
@@ -473,331 +611,314 @@ static ETrackingState mapTrackingState(TrackingState State)
 	}
 }
 
-void AKinectActor::DoUpdateBody()
+void AKinectActor::DoUpdateBody(const FKinectFrameBundle &Bundle)
 {
-	IBodyFrame *pBodyFrame;
-	HRESULT hResult = BodyReader->AcquireLatestFrame(&pBodyFrame);
-	if (SUCCEEDED(hResult))
+	// A source may hand the same body frame out again with the next color or depth frame
+	bBodyFrameArrived = Bundle.Has(EKinectFrameStream::Body) && Bundle.BodyTime != LastBodyTime;
+	if (!bBodyFrameArrived)
 	{
-		IBody* pBody[BODY_COUNT] = { 0 };
-		hResult = pBodyFrame->GetAndRefreshBodyData(BODY_COUNT, pBody);
-		if (SUCCEEDED(hResult))
-		{
-			for (int count = 0; count < BODY_COUNT; count++)
-			{
-				BOOLEAN bTracked = false;
-				hResult = pBody[count]->get_IsTracked(&bTracked);
-				FBody &Body = UpdateBodies[count];
-				Body.bIsTracked = !!bTracked;
-				if (SUCCEEDED(hResult) && bTracked)
-				{
-					Joint joint[JointType::JointType_Count];
-					JointOrientation jointOrient[JointType::JointType_Count];
-					hResult = pBody[count]->GetJoints(JointType::JointType_Count, joint);
-					if (SUCCEEDED(hResult))
-					{
-						hResult = pBody[count]->GetJointOrientations(JointType::JointType_Count, jointOrient);
-						if (FAILED(hResult))
-						{
-							LogKinectError("GetJointOrientations", hResult);
-						}
-						for (int j = 0; j < JointType::JointType_Count; j++)
-						{
-							FJoint &J = Body.Joints[j];
-							auto P = joint[j].Position;
-							auto Forward = P.Z;
-							auto Up = P.Y;
-							auto Right = P.X;
-							const float scale = 100.0f;
-							J.Position.X = scale * Forward;
-							J.Position.Y = scale * Right;
-							J.Position.Z = scale * Up;
-							J.JointType = mapJointType(joint[j].JointType);
-							J.TrackingState = mapTrackingState(joint[j].TrackingState);
-							for (int i = 0; i < JointType::JointType_Count; i++)
-							{
-								if (joint[j].JointType == jointOrient[i].JointType)
-								{
-									Vector4 &V = jointOrient[i].Orientation;
-									J.Orientation = FRotator(FQuat(V.z, V.y, V.x, V.w));
-									break;
-								}
-							}
-							
-						}
-						// Left Hand State
-						HandState leftHandState = HandState::HandState_Unknown;
-						Body.LeftHandState = EHandState::Unknown;
-						hResult = pBody[count]->get_HandLeftState(&leftHandState);
-						if (SUCCEEDED(hResult))
-						{
-							switch (leftHandState)
-							{
-							case HandState::HandState_Open:
-								Body.LeftHandState = EHandState::Open;
-								break;
-							case HandState::HandState_Closed:
-								Body.LeftHandState = EHandState::Closed;
-								break;
-							case HandState::HandState_Lasso:
-								Body.LeftHandState = EHandState::Lasso;
-								break;
-							}
-						}
-
-						// Right Hand State
-						HandState rightHandState = HandState::HandState_Unknown;
-						Body.RightHandState = EHandState::Unknown;
-						hResult = pBody[count]->get_HandRightState(&rightHandState);
-						if (SUCCEEDED(hResult))
-						{
-							switch (rightHandState)
-							{
-							case HandState::HandState_Open:
-								Body.RightHandState = EHandState::Open;
-								break;
-							case HandState::HandState_Closed:
-								Body.RightHandState = EHandState::Closed;
-								break;
-							case HandState::HandState_Lasso:
-								Body.RightHandState = EHandState::Lasso;
-								break;
-							}
-						}
-					}
+		return;
+	}
+	LastBodyTime = Bundle.BodyTime;
+	const FKinectBodyFrameRef Frame = BodyFramePool.Acquire();
+	Frame->Set(Bundle.Bodies, Bundle.BodyTime);
+	BodyFilter.Apply(*Frame);
+	UpdateBodyFrame = Frame;
+	BodyHistory.Push(Frame, FPlatformTime::Seconds());
+	if (bEnableGestures)
+	{
+		GestureRecognizer.Update(*Frame, RecognizedGestures);
+	}
+}
 
-					// Activity
-					UINT capacity = 0;
-					DetectionResult detectionResults = DetectionResult::DetectionResult_Unknown;
-					hResult = pBody[count]->GetActivityDetectionResults(capacity, &detectionResults);
-					if (SUCCEEDED(hResult))
-					{
-						if (detectionResults == DetectionResult::DetectionResult_Yes)
-						{
-							switch (capacity)
-							{
-							case Activity::Activity_EyeLeftClosed:
-								//std::cout << "Activity_EyeLeftClosed" << std::endl;
-								break;
-							case Activity::Activity_EyeRightClosed:
-								//std::cout << "Activity_EyeRightClosed" << std::endl;
-								break;
-							case Activity::Activity_MouthOpen:
-								//std::cout << "Activity_MouthOpen" << std::endl;
-								break;
-							case Activity::Activity_MouthMoved:
-								//std::cout << "Activity_MouthMoved" << std::endl;
-								break;
-							case Activity::Activity_LookingAway:
-								//std::cout << "Activity_LookingAway" << std::endl;
-								break;
-							default:
-								break;
-							}
-						}
-					}
-					else
-					{
-						//std::cerr << "Error : IBody::GetActivityDetectionResults()" << std::endl;
-					}
+static EHandState mapHandState(HandState State)
+{
+	switch (State)
+	{
+	case HandState_Open:
+		return EHandState::Open;
+	case HandState_Closed:
+		return EHandState::Closed;
+	case HandState_Lasso:
+		return EHandState::Lasso;
+	case HandState_NotTracked:
+		return EHandState::NotTracked;
+	default:
+		return EHandState::Unknown;
+	}
+}
 
-					// Appearance
-					capacity = 0;
-					detectionResults = DetectionResult::DetectionResult_Unknown;
-					hResult = pBody[count]->GetAppearanceDetectionResults(capacity, &detectionResults);
-					if (SUCCEEDED(hResult))
-					{
-						if (detectionResults == DetectionResult::DetectionResult_Yes)
-						{
-							switch (capacity)
-							{
-							case Appearance::Appearance_WearingGlasses:
-								//std::cout << "Appearance_WearingGlasses" << std::endl;
-								break;
-							default:
-								break;
-							}
-						}
-					}
-					else
-					{
-						//std::cerr << "Error : IBody::GetAppearanceDetectionResults()" << std::endl;
-					}
+/** Fills Result with joint Joint, an index into the sensor's joint arrays, of body BodyIndex of Frame. */
+static void buildJoint(const FKinectBodyFrame &Frame, int32 BodyIndex, int32 Joint, FJoint &Result)
+{
+	Result.JointType = EngineJointTypes[Joint];
+	Result.Position = Frame.Positions[BodyIndex][Joint];
+	Result.Orientation = FRotator(Frame.Orientations[BodyIndex][Joint]);
+	Result.TrackingState = mapTrackingState(Frame.TrackingStates[BodyIndex][Joint]);
+}
 
-					// Expression
-					capacity = 0;
-					detectionResults = DetectionResult::DetectionResult_Unknown;
-					hResult = pBody[count]->GetExpressionDetectionResults(capacity, &detectionResults);
-					if (SUCCEEDED(hResult))
-					{
-						if (detectionResults == DetectionResult::DetectionResult_Yes){
-							switch (capacity)
-							{
-							case Expression::Expression_Happy:
-								//std::cout << "Expression_Happy" << std::endl;
-								break;
-							case Expression::Expression_Neutral:
-								//std::cout << "Expression_Neutral" << std::endl;
-								break;
-							default:
-								break;
-							}
-						}
-					}
-					else
-					{
-						//std::cerr << "Error : IBody::GetExpressionDetectionResults()" << std::endl;
-					}
+static EDetectionResult mapDetectionResult(DetectionResult Result)
+{
+	switch (Result)
+	{
+	case DetectionResult_No:
+		return EDetectionResult::No;
+	case DetectionResult_Maybe:
+		return EDetectionResult::Maybe;
+	case DetectionResult_Yes:
+		return EDetectionResult::Yes;
+	default:
+		return EDetectionResult::Unknown;
+	}
+}
 
-					// Lean
-					PointF amount;
-					hResult = pBody[count]->get_Lean(&amount);
-					if (SUCCEEDED(hResult))
-					{
-						//std::cout << "amount : " << amount.X << ", " << amount.Y << std::endl;
-					}
-				}
-			}
-		}
-		for (int count = 0; count < BODY_COUNT; count++)
-		{
-			SafeRelease(pBody[count]);
-		}
-		SafeRelease(pBodyFrame);
+/** Fills Result with body BodyIndex of Frame; Result.Joints is in the sensor's JointType order. */
+static void buildBody(const FKinectBodyFrame &Frame, int32 BodyIndex, FBody &Result)
+{
+	Result.bIsTracked = Frame.bTracked[BodyIndex];
+	Result.LeftHandState = mapHandState(Frame.LeftHandStates[BodyIndex]);
+	Result.RightHandState = mapHandState(Frame.RightHandStates[BodyIndex]);
+	Result.Lean = Frame.Leans[BodyIndex];
+	Result.LeanTrackingState = mapTrackingState(Frame.LeanTrackingStates[BodyIndex]);
+	const DetectionResult *Activities = Frame.Activities[BodyIndex];
+	Result.EyeLeftClosed = mapDetectionResult(Activities[Activity_EyeLeftClosed]);
+	Result.EyeRightClosed = mapDetectionResult(Activities[Activity_EyeRightClosed]);
+	Result.MouthOpen = mapDetectionResult(Activities[Activity_MouthOpen]);
+	Result.MouthMoved = mapDetectionResult(Activities[Activity_MouthMoved]);
+	Result.LookingAway = mapDetectionResult(Activities[Activity_LookingAway]);
+	Result.WearingGlasses = mapDetectionResult(Frame.Appearances[BodyIndex][Appearance_WearingGlasses]);
+	Result.Neutral = mapDetectionResult(Frame.Expressions[BodyIndex][Expression_Neutral]);
+	Result.Happy = mapDetectionResult(Frame.Expressions[BodyIndex][Expression_Happy]);
+	Result.Joints.SetNum(JointType_Count);
+	for (int32 j = 0; j < JointType_Count; j++)
+	{
+		buildJoint(Frame, BodyIndex, j, Result.Joints[j]);
 	}
 }
 
-int AKinectActor::Update()
+void AKinectActor::BuildBodies()
 {
-	if (ColorReader == nullptr) return 0;
-	IColorFrame *pColorFrame = nullptr;
-	HRESULT hResult = ColorReader->AcquireLatestFrame(&pColorFrame);
-	if (SUCCEEDED(hResult)){
-		// Retrieved Color Data
-		TIMESPAN Timestamp;
-		hResult = pColorFrame->get_RelativeTime(&Timestamp);
-		if (SUCCEEDED(hResult))
+	if (bBodiesBuilt || !BodyFrame.IsValid())
+	{
+		return;
+	}
+	Bodies.SetNum(BODY_COUNT);
+	for (int32 i = 0; i < BODY_COUNT; i++)
+	{
+		// Untracked bodies keep whatever pose they last had, as they always did
+		if (BodyFrame->bTracked[i])
 		{
-			if (Timestamp == CurrentFrame)
-			{
-				SafeRelease(pColorFrame);
-				return 0;
-			}
-
-		}
-		CurrentFrame = Timestamp;
-		hResult = pColorFrame->CopyConvertedFrameDataToArray(ColorBuffer.Num() * sizeof(RGBQUAD),
-			reinterpret_cast<BYTE*>(ColorBuffer.GetData()),
-			ColorImageFormat::ColorImageFormat_Bgra);
-		if (FAILED(hResult)){
-			LogKinectError("Error : IColorFrame::CopyConvertedFrameDataToArray()", hResult);
+			buildBody(*BodyFrame, i, Bodies[i]);
 		}
-	}
-
-	SafeRelease(pColorFrame);
-
-	IDepthFrame *pDepthFrame = nullptr;
-	// Acquire Latest Depth Frame
-	hResult = DepthReader->AcquireLatestFrame(&pDepthFrame);
-	if (SUCCEEDED(hResult)){
-		// Retrieved Depth Data
-		hResult = pDepthFrame->CopyFrameDataToArray(DepthBuffer.Num(), DepthBuffer.GetData());
-		if (FAILED(hResult)){
-			LogKinectError("Error : IDepthFrame::CopyFrameDataToArray()", hResult);
+		else
+		{
+			Bodies[i].bIsTracked = false;
 		}
 	}
+	bBodiesBuilt = true;
+}
 
-	SafeRelease(pDepthFrame);
-
-	if (BodyIndexReader != nullptr)
+void AKinectActor::GetBody(int32 BodyIndex, FBody &Result)
+{
+	if (BodyFrame.IsValid() && BodyIndex >= 0 && BodyIndex < BODY_COUNT)
 	{
-		IBodyIndexFrame *pBodyIndexFrame = nullptr;
-		// Acquire Latest Body Index Frame
-		hResult = BodyIndexReader->AcquireLatestFrame(&pBodyIndexFrame);
-		if (SUCCEEDED(hResult)){
-			// Retrieved Body Index Data
-			hResult = pBodyIndexFrame->CopyFrameDataToArray(BodyIndexBuffer.Num(), BodyIndexBuffer.GetData());
-		}
-		SafeRelease(pBodyIndexFrame);
+		buildBody(*BodyFrame, BodyIndex, Result);
 	}
-
-	DoUpdateBody();
-	return 0;
 }
 
-// Algorithm from http://stackoverflow.com/questions/5695865/bilateral-filter
-void AKinectActor::BilateralFilter()
+void AKinectActor::GetBodies(TArray<FBody> &Result)
 {
-	const int width = DepthWidth;
-	const int height = DepthHeight;
-	UINT16 *_in = SmoothDepthBuffer.GetData();
-	UINT16 *_out = SmoothDepthBuffer.GetData();
-	const int halfkernelsize = FMath::RoundToInt(BilateralFilterKernelSize / 2.0f);
-	const float id = 1.0f;
-	const float cd = 1.0f;
-	//void convolution(uchar4 *_in, uchar4 *_out, int width, int height, int ~halfkernelsize, float id, float cd)
-	{
-		int kernelDim = 2 * halfkernelsize + 1;
+	BuildBodies();
+	Result = Bodies;
+}
 
-		Concurrency::parallel_for(0, height, [&](int y)
-		{
-			for (int x = 0; x < width; x++) {
+bool AKinectActor::RecordGesture(FName Name, int32 BodyIndex, float DurationSeconds, float Threshold)
+{
+	return GestureRecognizer.CaptureTemplate(Name, BodyIndex, DurationSeconds, Threshold);
+}
 
-				float sumWeight = 0;
-				float _sum[3] = { 0, 0, 0 };
-				unsigned int ctrIdx = y*width + x;
+bool AKinectActor::RemoveGesture(FName Name)
+{
+	return GestureRecognizer.RemoveTemplate(Name);
+}
 
-				float ctrPix[3];
-				ctrPix[0] = _in[ctrIdx];
-				ctrPix[1] = _in[ctrIdx];
-				ctrPix[2] = _in[ctrIdx];
+void AKinectActor::GetGestureNames(TArray<FName> &Result)
+{
+	TArray<FKinectGestureTemplate> Templates;
+	GestureRecognizer.GetTemplates(Templates);
+	Result.Reset();
+	for (const FKinectGestureTemplate &Template : Templates)
+	{
+		Result.Add(Template.Name);
+	}
+}
 
+bool AKinectActor::SaveGestureLibrary(const FString &Filename)
+{
+	return GestureRecognizer.SaveLibrary(Filename);
+}
 
-				// neighborhood of current pixel
-				int kernelStartX, kernelEndX, kernelStartY, kernelEndY;
-				kernelStartX = x - halfkernelsize;
-				kernelEndX = x + halfkernelsize;
-				kernelStartY = y - halfkernelsize;
-				kernelEndY = y + halfkernelsize;
+bool AKinectActor::LoadGestureLibrary(const FString &Filename)
+{
+	return GestureRecognizer.LoadLibrary(Filename);
+}
 
-				for (int j = kernelStartY; j <= kernelEndY; j++)
-				{
-					for (int i = kernelStartX; i <= kernelEndX; i++)
-					{
-						unsigned int idx = FMath::Max(0, FMath::Min(j, height - 1))*width + FMath::Max(0, FMath::Min(i, width - 1));
+bool AKinectActor::SampleBodyFrame(double Seconds, FKinectBodyFrame &Out) const
+{
+	return BodyHistory.Sample(Seconds, MaxBodyExtrapolationSeconds, Out);
+}
 
-						float curPix[3];
-						curPix[0] = _in[idx];
-						curPix[1] = _in[idx];
-						curPix[2] = _in[idx];
+bool AKinectActor::SampleBodies(float SecondsFromNow, TArray<FBody> &Result)
+{
+	FKinectBodyFrame Frame;
+	if (!SampleBodyFrame(FPlatformTime::Seconds() + SecondsFromNow, Frame))
+	{
+		Result.Reset();
+		return false;
+	}
+	Result.SetNum(BODY_COUNT);
+	for (int32 i = 0; i < BODY_COUNT; i++)
+	{
+		if (Frame.bTracked[i])
+		{
+			buildBody(Frame, i, Result[i]);
+		}
+		else
+		{
+			Result[i].bIsTracked = false;
+		}
+	}
+	return true;
+}
 
+bool AKinectActor::IsBodyTracked(int32 BodyIndex)
+{
+	return BodyFrame.IsValid() && BodyIndex >= 0 && BodyIndex < BODY_COUNT && BodyFrame->bTracked[BodyIndex];
+}
 
-						float currWeight;
+EHandState AKinectActor::GetHandState(int32 BodyIndex, EHand Hand)
+{
+	if (!BodyFrame.IsValid() || BodyIndex < 0 || BodyIndex >= BODY_COUNT)
+	{
+		return EHandState::Unknown;
+	}
+	return mapHandState(Hand == EHand::LeftHand ? BodyFrame->LeftHandStates[BodyIndex] : BodyFrame->RightHandStates[BodyIndex]);
+}
 
-						// define bilateral filter kernel weights
-						float imageDist = sqrt((float)((i - x)*(i - x) + (j - y)*(j - y)));
+void AKinectActor::GetJoint(int32 BodyIndex, EJointType JointType, FJoint &Result)
+{
+	const int32 Joint = mapSdkJoint(JointType);
+	if (BodyFrame.IsValid() && BodyIndex >= 0 && BodyIndex < BODY_COUNT && Joint != INDEX_NONE)
+	{
+		buildJoint(*BodyFrame, BodyIndex, Joint, Result);
+	}
+}
 
-						float colorDist = sqrt((float)((curPix[0] - ctrPix[0])*(curPix[0] - ctrPix[0]) +
-							(curPix[1] - ctrPix[1])*(curPix[1] - ctrPix[1]) +
-							(curPix[2] - ctrPix[2])*(curPix[2] - ctrPix[2])));
+void AKinectActor::GetJoints(int32 BodyIndex, TArray<FJoint> &Result)
+{
+	if (!BodyFrame.IsValid() || BodyIndex < 0 || BodyIndex >= BODY_COUNT)
+	{
+		Result.Reset();
+		return;
+	}
+	Result.SetNum(JointType_Count);
+	for (int32 j = 0; j < JointType_Count; j++)
+	{
+		buildJoint(*BodyFrame, BodyIndex, j, Result[j]);
+	}
+}
 
-						currWeight = 1.0f / (exp((imageDist / id)*(imageDist / id)*0.5)*exp((colorDist / cd)*(colorDist / cd)*0.5));
-						sumWeight += currWeight;
+void AKinectActor::GetTrackedJoints(const TArray<EJointType> &JointTypes, TArray<int32> &BodyIndices, TArray<FJoint> &Result)
+{
+	BodyIndices.Reset();
+	if (!BodyFrame.IsValid())
+	{
+		Result.Reset();
+		return;
+	}
+	for (int32 i = 0; i < BODY_COUNT; i++)
+	{
+		if (BodyFrame->bTracked[i])
+		{
+			BodyIndices.Add(i);
+		}
+	}
+	TArray<int32, TInlineAllocator<JointType_Count>> SdkJoints;
+	SdkJoints.SetNumUninitialized(JointTypes.Num());
+	for (int32 j = 0; j < JointTypes.Num(); j++)
+	{
+		SdkJoints[j] = mapSdkJoint(JointTypes[j]);
+	}
+	// SetNum keeps the allocation of a Result passed in again, so polling every tick does not allocate
+	Result.SetNum(BodyIndices.Num() * JointTypes.Num(), false);
+	int32 Out = 0;
+	for (int32 b = 0; b < BodyIndices.Num(); b++)
+	{
+		for (int32 j = 0; j < JointTypes.Num(); j++, Out++)
+		{
+			if (SdkJoints[j] != INDEX_NONE)
+			{
+				buildJoint(*BodyFrame, BodyIndices[b], SdkJoints[j], Result[Out]);
+			}
+			else
+			{
+				// Keeps its slot so the layout stays JointTypes.Num() per body, but never stale data from a previous call
+				FJoint &Joint = Result[Out];
+				Joint.JointType = JointTypes[j];
+				Joint.Position = FVector::ZeroVector;
+				Joint.Orientation = FRotator::ZeroRotator;
+				Joint.TrackingState = ETrackingState::NotTracked;
+			}
+		}
+	}
+}
 
-						_sum[0] += currWeight*curPix[0];
-						_sum[1] += currWeight*curPix[1];
-						_sum[2] += currWeight*curPix[2];
-					}
-				}
+int AKinectActor::Update()
+{
+	// Frames are passed on by reference, depth and body index usually still live in sensor memory
+	bColorFrameArrived = FrameBundle.Has(EKinectFrameStream::Color) && FrameBundle.Color.Num() == ColorWidth * ColorHeight * 2;
+	if (bColorFrameArrived)
+	{
+		CurrentFrame = FrameBundle.ColorTime;
+		ColorImage = FrameBundle.Color;
+		// Converted once for the camera; the mesh samples the YUY2 image directly
+		if (bHalfResolutionCamera)
+		{
+			ColorFrame = ColorFramePool.Acquire(FIntPoint(ColorWidth / 2, ColorHeight / 2));
+			FKinectColorConversion::ConvertToBGRAHalf(ColorImage.GetData(), ColorWidth, ColorHeight, ColorFrame->GetData());
+		}
+		else
+		{
+			ColorFrame = ColorFramePool.Acquire(FIntPoint(ColorWidth, ColorHeight));
+			FKinectColorConversion::ConvertToBGRA(ColorImage.GetData(), ColorWidth, ColorHeight, ColorFrame->GetData());
+		}
+	}
+	FrameBundle.Color.Reset();
 
-				_sum[0] /= sumWeight;
-				_sum[1] /= sumWeight;
-				_sum[2] /= sumWeight;
+	bDepthFrameArrived = FrameBundle.Has(EKinectFrameStream::Depth) && FrameBundle.Depth.Num() == DepthWidth * DepthHeight;
+	if (bDepthFrameArrived)
+	{
+		DepthFrame = FrameBundle.Depth;
+	}
+	FrameBundle.Depth.Reset();
 
-				_out[ctrIdx] = (UINT16)(floor(_sum[0]));
-			}
-		});
+	if (bEnableBodyIndexMask && FrameBundle.Has(EKinectFrameStream::BodyIndex))
+	{
+		BodyIndexFrame = FrameBundle.BodyIndex;
 	}
+	FrameBundle.BodyIndex.Reset();
+	return 0;
+}
+
+void AKinectActor::BilateralFilter(const UINT16 *Depth)
+{
+	FKinectBilateralFilterSettings Settings;
+	Settings.Radius = BilateralFilterKernelSize / 2;
+	Settings.SpatialSigma = BilateralSpatialSigma;
+	Settings.RangeSigma = BilateralRangeSigma;
+	// The square costs (2 * Radius + 1)^2 samples per pixel, which outgrows a frame's 2 ms on one core past a radius of 1
+	Settings.bSeparable = bApproximateBilateralFilter && Settings.Radius > 1;
+	DepthFilter.Filter(Depth, DepthWidth, DepthHeight, Settings, FilteredDepthBuffer.GetData());
 }
 
 // Algorithm from http://www.codeproject.com/Articles/317974/KinectDepthSmoothing
@@ -805,11 +926,11 @@ void AKinectActor::SmoothDepthImage()
 {
 	if (true)
 	{
-		BilateralFilter();
+		BilateralFilter(SmoothDepthBuffer.GetData());
 		return;
 	}
 	TArray<UINT16> &smoothDepthArray = SmoothDepthBuffer;
-	TArray<UINT16> &depthArray = DepthBuffer;
+	const UINT16 *depthArray = DepthFrame.GetData();
 
 	// We will be using these numbers for constraints on indexes
 	int widthBound = DepthWidth - 1;
@@ -951,119 +1072,34 @@ void AKinectActor::SmoothDepthImage()
 void AKinectActor::EndPlay(const EEndPlayReason::Type EndPlayReason)
 {
 	bPlaying = false;
-	Thread->WaitForCompletion();
-	delete Thread;
-	Thread = nullptr;
-	SafeRelease(ColorSource);
-	SafeRelease(DepthSource);
-	SafeRelease(BodySource);
-	SafeRelease(BodyIndexSource);
-	SafeRelease(ColorReader);
-	SafeRelease(DepthReader);
-	SafeRelease(BodyReader);
-	SafeRelease(BodyIndexReader);
-	SafeRelease(CoordinateMapper);
-	if (Sensor){
-		Sensor->Close();
+	if (FrameSource)
+	{
+		FrameSource->Stop();
 	}
-	SafeRelease(Sensor);
-}
-
-
-static void findNeighbors(
-	const UINT16 *Source,
-	const int w,
-	const int h,
-	const int i,
-	TArray<UINT16> &Result,
-	const int radius,
-	UINT16 &min,
-	UINT16 &max,
-	int &enclosed)
-{
-	const int y0 = i / h;
-	const int x0 = i % h;
-	min = 65535;
-	max = 0;
-	enclosed = 0;
-	Result.Reset();
-	for (int y = FMath::Max(0, y0 - radius); y < FMath::Min(y0 + radius, h); y++)
+	if (Thread)
 	{
-		for (int x = FMath::Max(x0 - radius, 0); x < FMath::Min(x0 + radius, w); x++)
-		{
-			int j = y * w + x;
-			if (j != i && j >= 0 && j < w * h)
-			{
-				UINT16 d = Source[j];
-				if (d > 0)
-				{
-					min = FMath::Min(min, d);
-					max = FMath::Max(max, d);
-
-					bool onEdge = (y == y0 - radius) || (y + 1 == y0 + radius) || (x == x0 - radius) || (x + 1 == x0 + radius);
-					if (onEdge)
-					{
-						enclosed++;
-					}
-					Result.Add(d);
-				}
-			}
-		}
+		Thread->WaitForCompletion();
+		delete Thread;
+		Thread = nullptr;
+	}
+	Recorder.Stop();
+	BodyHistory.Reset();
+	if (FrameSource)
+	{
+		FrameSource->Close();
+		delete FrameSource;
+		FrameSource = nullptr;
 	}
-	if (max < min) max = min;
+	ColorFrame.Reset();
+	ColorImage.Reset();
 }
 
-// Algorithmn 1 from https://www.cs.unc.edu/~maimone/media/CG_paper_2012.pdf
 void AKinectActor::FillHoles()
 {
-	UINT16 *depth_in = DepthBuffer.GetData();
-	UINT16 *depth_out = SmoothDepthBuffer.GetData();
-	const int radiusPass[2] = { HoleFillingRadius, SmoothingRadius };
-	const int tc = Tc;
-	const int te = Te;
-	const int tr = Tr;
-	for (int pass = 1; pass <= 2; pass++)
-	{
-		const int radius = radiusPass[pass - 1];
-		Concurrency::combinable<TArray<UINT16>> combinedNeighbors;
-		Concurrency::parallel_for(0, DepthBuffer.Num(), [&](int i)
-		{
-			depth_out[i] = depth_in[i];
-			if (depth_in[i] == 0 || pass == 2)
-			{
-				int count = 0;
-				int enclosed = 0;
-				UINT16 min = 0;
-				UINT16 max = 0;
-				/*
-				findNeighbors(
-				const TArray<UINT16> &Source,
-				const int w,
-				const int h,
-				const int i,
-				TArray<UINT16> &Result,
-				const int radius,
-				UINT16 &min,
-				UINT16 &max,
-				int &enclosed
-				)*/
-				TArray<UINT16> &neighbors = combinedNeighbors.local(); // non-zero neighbors
-				findNeighbors(depth_in, DepthWidth, DepthHeight, i, neighbors, radius, min, max, enclosed);
-				if (max - min < tr && neighbors.Num() >= tc && enclosed >= te)
-				{
-					neighbors.Sort();
-					depth_out[i] = neighbors[neighbors.Num() / 2];
-				}
-				else if (pass == 2)
-				{
-					//depth_out[i] = 0; // trim
-				}
-			}
-		});
-		if (pass == 1)
-		{
-			if (true) break;
-			depth_in = depth_out;
-		}
-	}
+	FKinectHoleFillSettings Settings;
+	Settings.Radius = HoleFillingRadius;
+	Settings.MinNeighbors = Tc;
+	Settings.MinEnclosed = Te;
+	Settings.MaxRange = Tr;
+	HoleFiller.Fill(DepthFrame.GetData(), DepthWidth, DepthHeight, Settings, SmoothDepthBuffer.GetData());
 }
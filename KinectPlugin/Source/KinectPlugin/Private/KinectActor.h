@@ -6,6 +6,21 @@
 #include "ProceduralMeshComponent.h"
 #include "IKinectPlugin.h"
 #include "KinectTexture.h"
+#include "KinectDepthUnprojector.h"
+#include "KinectColorRegistration.h"
+#include "KinectFrameSource.h"
+#include "KinectFrameSynchronizer.h"
+#include "KinectBodyFrame.h"
+#include "KinectJointFilter.h"
+#include "KinectBodyHistory.h"
+#include "KinectGestureRecognizer.h"
+#include "KinectHoleFiller.h"
+#include "KinectBilateralFilter.h"
+#include "KinectRecording.h"
+#include "KinectDepthMesher.h"
+#include "KinectMeshSectionWriter.h"
+#include "KinectTripleBuffer.h"
+#include "KinectUpdateMailbox.h"
 #include "AllowWindowsPlatformTypes.h"
 #include "Kinect.h"
 #include "HideWindowsPlatformTypes.h"
@@ -30,6 +45,13 @@ enum class ETrackingState : uint8
 	Inferred, NotTracked, Tracked
 };
 
+/** How sure the sensor is of an activity, appearance or expression. */
+UENUM(BlueprintType)
+enum class EDetectionResult : uint8
+{
+	Unknown, No, Maybe, Yes
+};
+
 UENUM(BlueprintType)
 enum class EJointType: uint8
 {
@@ -86,8 +108,161 @@ struct FBody
 		EHandState LeftHandState;
 	UPROPERTY(EditAnywhere, BlueprintReadOnly)
 		EHandState RightHandState;
+	/** Lean left and right in X, forward and back in Y, from -1 to 1. Only queried with bQueryLean. */
+	UPROPERTY(EditAnywhere, BlueprintReadOnly)
+		FVector2D Lean;
+	UPROPERTY(EditAnywhere, BlueprintReadOnly)
+		ETrackingState LeanTrackingState;
+	/** Activities, only queried with bQueryActivities. */
+	UPROPERTY(EditAnywhere, BlueprintReadOnly)
+		EDetectionResult EyeLeftClosed;
+	UPROPERTY(EditAnywhere, BlueprintReadOnly)
+		EDetectionResult EyeRightClosed;
+	UPROPERTY(EditAnywhere, BlueprintReadOnly)
+		EDetectionResult MouthOpen;
+	UPROPERTY(EditAnywhere, BlueprintReadOnly)
+		EDetectionResult MouthMoved;
+	UPROPERTY(EditAnywhere, BlueprintReadOnly)
+		EDetectionResult LookingAway;
+	/** Appearance, only queried with bQueryAppearance. */
+	UPROPERTY(EditAnywhere, BlueprintReadOnly)
+		EDetectionResult WearingGlasses;
+	/** Expressions, only queried with bQueryExpressions. */
+	UPROPERTY(EditAnywhere, BlueprintReadOnly)
+		EDetectionResult Neutral;
+	UPROPERTY(EditAnywhere, BlueprintReadOnly)
+		EDetectionResult Happy;
+};
+
+UENUM(BlueprintType)
+enum class EJointFilter : uint8
+{
+	None,
+	/** Little lag on fast moves, little jitter at rest. */
+	OneEuro	UMETA(DisplayName = "1 Euro"),
+	/** Holt's double exponential smoothing with jitter removal and prediction. */
+	DoubleExponential	UMETA(DisplayName = "Double exponential")
 };
 
+/** Joint filter parameters; each filter only reads its own. Distances are in centimeters for positions and in quaternion units for orientations. */
+USTRUCT(BlueprintType)
+struct FJointFilterSettings
+{
+	GENERATED_USTRUCT_BODY();
+	/** 1 Euro: cutoff frequency at rest, in Hz. Lower is smoother. */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
+		float MinCutoff;
+	/** 1 Euro: cutoff increase per unit of speed. Higher lags less on fast moves. */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
+		float Beta;
+	/** 1 Euro: cutoff of the speed estimate, in Hz. */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
+		float DerivativeCutoff;
+	/** Double exponential: weight of the previous estimate, 0 to 1. */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
+		float Smoothing;
+	/** Double exponential: how fast the trend follows, 0 to 1. */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
+		float Correction;
+	/** Double exponential: frames the output is extrapolated ahead. */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
+		float Prediction;
+	/** Double exponential: moves smaller than this are damped as jitter. */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
+		float JitterRadius;
+	/** Double exponential: largest distance the output may stray from the raw joint. */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
+		float MaxDeviationRadius;
+
+	FJointFilterSettings()
+	{
+		Set(FKinectJointFilterParams());
+	}
+
+	explicit FJointFilterSettings(const FKinectJointFilterParams &Params)
+	{
+		Set(Params);
+	}
+
+	void Set(const FKinectJointFilterParams &Params)
+	{
+		MinCutoff = Params.MinCutoff;
+		Beta = Params.Beta;
+		DerivativeCutoff = Params.DerivativeCutoff;
+		Smoothing = Params.Smoothing;
+		Correction = Params.Correction;
+		Prediction = Params.Prediction;
+		JitterRadius = Params.JitterRadius;
+		MaxDeviationRadius = Params.MaxDeviationRadius;
+	}
+
+	FKinectJointFilterParams ToParams() const
+	{
+		FKinectJointFilterParams Params;
+		Params.MinCutoff = MinCutoff;
+		Params.Beta = Beta;
+		Params.DerivativeCutoff = DerivativeCutoff;
+		Params.Smoothing = Smoothing;
+		Params.Correction = Correction;
+		Params.Prediction = Prediction;
+		Params.JitterRadius = JitterRadius;
+		Params.MaxDeviationRadius = MaxDeviationRadius;
+		return Params;
+	}
+};
+
+/** Filter parameters of a single joint, replacing the actor wide ones. */
+USTRUCT(BlueprintType)
+struct FJointFilterOverride
+{
+	GENERATED_USTRUCT_BODY();
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
+		EJointType JointType;
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
+		FJointFilterSettings Position;
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
+		FJointFilterSettings Orientation;
+
+	FJointFilterOverride()
+		: JointType(EJointType::HandLeft)
+		, Position(FKinectJointFilter::GetDefaultParams(FKinectJointFilter::Position))
+		, Orientation(FKinectJointFilter::GetDefaultParams(FKinectJointFilter::Orientation))
+	{
+	}
+};
+
+/** Everything the mesh generator thread hands to the game thread in one update. */
+struct FKinectFramePacket
+{
+	/** RelativeTime of the newest color frame the packet was built from. */
+	TIMESPAN Timestamp;
+	/** Set when the packet holds a mesh built from a newer depth frame. */
+	bool bMeshChanged;
+	bool bMeshTiled;
+	FKinectMeshBuffers Mesh;
+	/** Tiled mesh: only the tiles flagged in TileDirty hold new geometry. */
+	bool bTileLayoutChanged;
+	TArray<FKinectMeshBuffers> Tiles;
+	TArray<bool> TileDirty;
+	bool bCameraFrameChanged;
+	FKinectFrameBufferPtr CameraFrame;
+	bool bBodiesChanged;
+	FKinectBodyFramePtr BodyFrame;
+	/** Gestures completed since the last packet the game thread received. */
+	TArray<FKinectGestureEvent> Gestures;
+
+	FKinectFramePacket()
+		: Timestamp(0)
+		, bMeshChanged(false)
+		, bMeshTiled(false)
+		, bTileLayoutChanged(false)
+		, bCameraFrameChanged(false)
+		, bBodiesChanged(false)
+	{
+	}
+};
+
+DECLARE_DYNAMIC_MULTICAST_DELEGATE_ThreeParams(FGestureRecognizedSignature, int32, BodyIndex, FName, Gesture, float, Cost);
 
 UCLASS()
 class KINECTPLUGIN_API AKinectActor : public AActor, public FRunnable
@@ -96,45 +271,150 @@ class KINECTPLUGIN_API AKinectActor : public AActor, public FRunnable
 public:
 
 	UFUNCTION(Category = "Kinect", BlueprintCallable)
-		EHandState GetHandState(int32 BodyIndex, EHand Hand)
-	{
-		FBody &Body = Bodies[BodyIndex];
-		if (Hand == EHand::LeftHand)
-		{
-			return Body.LeftHandState;
-		}
-		return Body.RightHandState;
-	}
+		EHandState GetHandState(int32 BodyIndex, EHand Hand);
 
 	UFUNCTION(Category = "Kinect", BlueprintCallable)
-		void GetJoint(int32 BodyIndex, EJointType JointType, FJoint &Result)
-	{
-		FBody &Body = Bodies[BodyIndex];
-		for (int j = 0; j < Body.Joints.Num(); j++)
-		{
-			if (Body.Joints[j].JointType == JointType)
-			{
-				Result = Body.Joints[j];
-			}
-		}
-	}
+		void GetJoint(int32 BodyIndex, EJointType JointType, FJoint &Result);
 
+	/** All joints of body BodyIndex in one call, in the sensor's joint order; Result is empty for an unknown body. */
 	UFUNCTION(Category = "Kinect", BlueprintCallable)
-		bool IsBodyTracked(int32 BodyIndex)
-	{
-		return Bodies[BodyIndex].bIsTracked;
-	}
+		void GetJoints(int32 BodyIndex, TArray<FJoint> &Result);
+
+	/**
+	 * The joints in JointTypes of every tracked body in one call. BodyIndices
+	 * lists the tracked bodies; Result holds JointTypes.Num() joints per body,
+	 * in that order. A JointTypes value out of range comes back at the origin,
+	 * NotTracked.
+	 */
+	UFUNCTION(Category = "Kinect", BlueprintCallable)
+		void GetTrackedJoints(const TArray<EJointType> &JointTypes, TArray<int32> &BodyIndices, TArray<FJoint> &Result);
+
+	UFUNCTION(Category = "Kinect", BlueprintCallable)
+		bool IsBodyTracked(int32 BodyIndex);
+
+	/** Builds one body of the newest body frame. */
+	UFUNCTION(Category = "Kinect", BlueprintCallable)
+		void GetBody(int32 BodyIndex, FBody &Result);
+
+	/** All bodies of the newest body frame, built on the first call after it arrived. */
+	UFUNCTION(Category = "Kinect", BlueprintCallable)
+		void GetBodies(TArray<FBody> &Result);
+
+	/**
+	 * All bodies as they are predicted to be SecondsFromNow from now, such as
+	 * when the frame being rendered reaches the display; negative values look
+	 * into the past. Returns false until the first body frame arrived.
+	 */
+	UFUNCTION(Category = "Kinect", BlueprintCallable)
+		bool SampleBodies(float SecondsFromNow, TArray<FBody> &Result);
+
+	/** Applies changes of the bQuery properties made while playing. */
+	UFUNCTION(Category = "Kinect", BlueprintCallable)
+		void UpdateBodyAttributeQueries();
+
+	/** Bodies at FPlatformTime::Seconds() Seconds, interpolated between body frames or extrapolated past the newest. */
+	bool SampleBodyFrame(double Seconds, FKinectBodyFrame &Out) const;
+
+	/**
+	 * Adds the last DurationSeconds of body BodyIndex's motion to the gesture
+	 * library as Name, replacing a gesture of that name. Threshold is the
+	 * largest mean distance to it, in torso lengths, that still recognizes it.
+	 */
+	UFUNCTION(Category = "Kinect", BlueprintCallable)
+		bool RecordGesture(FName Name, int32 BodyIndex, float DurationSeconds, float Threshold = 0.3f);
+
+	UFUNCTION(Category = "Kinect", BlueprintCallable)
+		bool RemoveGesture(FName Name);
+
+	UFUNCTION(Category = "Kinect", BlueprintCallable)
+		void GetGestureNames(TArray<FName> &Result);
+
+	UFUNCTION(Category = "Kinect", BlueprintCallable)
+		bool SaveGestureLibrary(const FString &Filename);
+
+	/** Replaces the gesture library with the one in Filename. */
+	UFUNCTION(Category = "Kinect", BlueprintCallable)
+		bool LoadGestureLibrary(const FString &Filename);
+
+	/** Fired on the game thread for every gesture a body completed. */
+	UPROPERTY(Category = "Kinect", BlueprintAssignable)
+		FGestureRecognizedSignature OnGestureRecognized;
 	
 	UPROPERTY(Category = "Kinect", EditAnywhere, BlueprintReadOnly)
 		bool EnablePhysics;
 	UPROPERTY(Category = "Kinect", EditAnywhere, BlueprintReadOnly)
 		UKinectTexture *Camera;
+	/** The newest bodies, rebuilt on every body frame only if bMirrorBodies is set; GetBody and GetBodies build them on demand. */
 	UPROPERTY(Category = "Kinect", EditAnywhere, BlueprintReadOnly)
 		TArray<FBody> Bodies;
+	/** Keep Bodies up to date for graphs that read it directly. */
+	UPROPERTY(Category = "Kinect", EditAnywhere)
+		bool bMirrorBodies;
+	/** Body attributes the sensor is queried for; each one left off saves runtime calls per body and frame. */
+	UPROPERTY(Category = "Kinect", EditAnywhere, BlueprintReadWrite)
+		bool bQueryHandStates;
+	UPROPERTY(Category = "Kinect", EditAnywhere, BlueprintReadWrite)
+		bool bQueryJointOrientations;
+	UPROPERTY(Category = "Kinect", EditAnywhere, BlueprintReadWrite)
+		bool bQueryLean;
+	UPROPERTY(Category = "Kinect", EditAnywhere, BlueprintReadWrite)
+		bool bQueryActivities;
+	UPROPERTY(Category = "Kinect", EditAnywhere, BlueprintReadWrite)
+		bool bQueryAppearance;
+	UPROPERTY(Category = "Kinect", EditAnywhere, BlueprintReadWrite)
+		bool bQueryExpressions;
+	/** Every tick, Bodies and the joint queries show the bodies predicted this far ahead instead of the newest body frame. 0 turns prediction off. */
+	UPROPERTY(Category = "Kinect", EditAnywhere)
+		float BodyLatencyCompensationSeconds;
+	/** Largest time past the newest body frame joints are extrapolated to. */
+	UPROPERTY(Category = "Kinect", EditAnywhere)
+		float MaxBodyExtrapolationSeconds;
+	/** Match the bodies' motion against the gesture library. */
+	UPROPERTY(Category = "Kinect", EditAnywhere)
+		bool bEnableGestures;
+	/** Gesture library loaded at BeginPlay, as written by SaveGestureLibrary. */
+	UPROPERTY(Category = "Kinect", EditAnywhere)
+		FString GestureLibraryFilename;
+	/** Smoothing applied to every body frame before it reaches the game thread. */
+	UPROPERTY(Category = "Kinect", EditAnywhere)
+		EJointFilter JointFilter;
+	UPROPERTY(Category = "Kinect", EditAnywhere)
+		FJointFilterSettings JointPositionFilter;
+	UPROPERTY(Category = "Kinect", EditAnywhere)
+		FJointFilterSettings JointOrientationFilter;
+	/** Joints filtered with parameters of their own, such as lighter smoothing on the hands. */
+	UPROPERTY(Category = "Kinect", EditAnywhere)
+		TArray<FJointFilterOverride> JointFilterOverrides;
 	UPROPERTY()
 		UTexture *DepthCamera;
 	UPROPERTY()
 		UTexture *InfraredCamera;
+	/** Drive the actor from a generated scene instead of the sensor, so it can be profiled without a Kinect attached. */
+	UPROPERTY(Category = "Kinect", EditAnywhere)
+		bool bUseSyntheticFrameSource;
+	/** Recording to replay instead of reading the sensor, as written with RecordFilename. */
+	UPROPERTY(Category = "Kinect", EditAnywhere)
+		FString ReplayFilename;
+	/** Replays at this fixed rate; 0 keeps the recorded timing. */
+	UPROPERTY(Category = "Kinect", EditAnywhere)
+		float ReplayFramesPerSecond;
+	/** Replays each frame as soon as the previous one is processed, for throughput measurements. */
+	UPROPERTY(Category = "Kinect", EditAnywhere)
+		bool bReplayAsFastAsPossible;
+	UPROPERTY(Category = "Kinect", EditAnywhere)
+		bool bLoopReplay;
+	/** Records every frame the actor receives to this file while playing. */
+	UPROPERTY(Category = "Kinect", EditAnywhere)
+		FString RecordFilename;
+	/** Stores recorded depth losslessly compressed, at about a quarter of the size. */
+	UPROPERTY(Category = "Kinect", EditAnywhere)
+		bool bCompressRecordedDepth;
+	/** Largest RelativeTime difference of the depth, color and body index frames a mesh is built from. */
+	UPROPERTY(Category = "Kinect", EditAnywhere)
+		int32 FrameSyncToleranceMilliseconds;
+	/** Fill the Camera texture at half the color resolution, converting and uploading a quarter of the pixels. The mesh colors are unaffected. */
+	UPROPERTY(Category = "Kinect", EditAnywhere)
+		bool bHalfResolutionCamera;
 	UPROPERTY(Category = "Kinect", EditAnywhere, BlueprintReadOnly)
 		bool bEnableBodyIndexMask;
 	UPROPERTY(Category = "Kinect", EditAnywhere, BlueprintReadOnly)
@@ -153,10 +433,32 @@ public:
 		int32 Resolution;
 	UPROPERTY(Category = "Kinect", EditAnywhere)
 		int32 MaxEdgeLength;
+	/** One vertex per sampled depth pixel with a fixed index buffer, so most frames only update positions and colors. */
+	UPROPERTY(Category = "Kinect", EditAnywhere)
+		bool bWeldGridVertices;
+	/** Edge length in depth pixels of the mesh tiles, each uploaded as its own mesh section. 0 keeps a single section. */
+	UPROPERTY(Category = "Kinect", EditAnywhere)
+		int32 MeshTileSize;
+	/** Mean depth change in millimeters since a tile's last upload that gets it re-triangulated and uploaded again. */
+	UPROPERTY(Category = "Kinect", EditAnywhere)
+		float MeshTileChangeThreshold;
 	UPROPERTY(Category = "Kinect", EditAnywhere)
 		bool bEnableDepthSmoothing;
+	/** Edge length in pixels of the bilateral filter's kernel; an even size grows to the next odd one. */
 	UPROPERTY(Category = "Kinect", EditAnywhere)
 		int32 BilateralFilterKernelSize;
+	/** Smooths the depth, after the holes are filled if bEnableDepthSmoothing, without blurring across depth edges. */
+	UPROPERTY(Category = "Kinect", EditAnywhere)
+		bool bEnableBilateralFilter;
+	/** Standard deviation of the bilateral filter's weights over distance in pixels. */
+	UPROPERTY(Category = "Kinect", EditAnywhere)
+		float BilateralSpatialSigma;
+	/** Standard deviation of the bilateral filter's weights over depth difference in millimeters. */
+	UPROPERTY(Category = "Kinect", EditAnywhere)
+		float BilateralRangeSigma;
+	/** Filters rows and then columns for kernels larger than 3, much faster and close to the full kernel. */
+	UPROPERTY(Category = "Kinect", EditAnywhere)
+		bool bApproximateBilateralFilter;
 	UPROPERTY(Category = "Kinect", EditAnywhere)
 		int32 InnerBandThreshold;
 	UPROPERTY(Category = "Kinect", EditAnywhere)
@@ -183,57 +485,98 @@ public:
 	virtual ~AKinectActor();
 	virtual uint32 Run() override;
 
-	/** Events have to occur on the main thread, so we have this queue to feed the ticker */
-	DECLARE_DELEGATE(CommandDelegate)
-	/** Holds the router command queue. */
-	TQueue<CommandDelegate, EQueueMode::Mpsc> Commands;
+	/** Events have to occur on the main thread, so the ticker applies whatever was posted here since the last tick */
+	FKinectUpdateMailbox UpdateMailbox;
 
-	void UpdateMesh();
-	void UpdateCamera();
-	void UpdateBody();
-	void DoUpdates(bool DoMesh);
+	void UpdateMesh(const FKinectFramePacket &Packet);
+	void UpdateCamera(const FKinectFramePacket &Packet);
+	void UpdateBody(const FKinectFramePacket &Packet);
+	void DoUpdates();
 
-	void UpdateVertexData();
-	void DoUpdateBody();
+	void UpdateVertexData(FKinectFramePacket &Packet);
+	/** Filters, records and recognizes the body frame of Bundle, unless it has none or it was seen already. */
+	void DoUpdateBody(const FKinectFrameBundle &Bundle);
 private:
+	/** Brings Bodies up to the newest body frame if it is not already. */
+	void BuildBodies();
+	/** Hands the JointFilter properties to BodyFilter. */
+	void ConfigureJointFilter();
+	/** EKinectBodyAttribute bits of the bQuery properties. */
+	int32 GetBodyAttributes() const;
+	bool UpdateDepthUnprojector();
 	void SmoothDepthImage();
-	void BilateralFilter();
+	/** Filters Depth into FilteredDepthBuffer. */
+	void BilateralFilter(const UINT16 *Depth);
 	void FillHoles();
+	void ResetFramePacket(FKinectFramePacket &Packet);
 	bool bPlaying;
 	FRunnableThread *Thread;	
-	FCriticalSection Crit;
-	TIMESPAN ConsumerFrame;
-	TIMESPAN ProducerFrame;
 	TIMESPAN CurrentFrame;
+	bool bColorFrameArrived;
+	bool bDepthFrameArrived;
+	bool bBodyFrameArrived;
+	/** RelativeTime of the last body frame DoUpdateBody took, -1 before the first. */
+	TIMESPAN LastBodyTime;
 	int Update();
-	TArray<int32> Triangles;
-	TArray<FVector> Vertices;
+	/** Frame packets from the mesh generator thread, newest wins. */
+	TKinectTripleBuffer<FKinectFramePacket> FramePackets;
+	/** Set when the current back packet was dropped and still holds updates the game thread has not seen. */
+	bool bBackPacketDropped;
+	FKinectDepthMesher DepthMesher;
+	/** Tiled mesh as triangulated by the mesh generator thread; dirty tiles are copied into the packets. */
+	TArray<FKinectMeshBuffers> MeshTiles;
+	TArray<int32> DirtyTiles;
+	FKinectMeshSectionWriter SectionWriter;
+	TArray<FKinectMeshSectionWriter> TileWriters;
 	TArray<FVector> Normals;
-	TArray<FVector2D> UVs;
-	TArray<FColor> VertexColors;
-	TArray<FProcMeshTangent> Tangents;
-
-	IKinectSensor *Sensor;
-	ICoordinateMapper *CoordinateMapper;
-	IColorFrameSource *ColorSource;
-	IDepthFrameSource *DepthSource;
-	IBodyFrameSource *BodySource;
-	IBodyIndexFrameSource *BodyIndexSource;
-	IColorFrameReader *ColorReader;
-	IDepthFrameReader *DepthReader;
-	IBodyFrameReader *BodyReader;
-	IBodyIndexFrameReader *BodyIndexReader;
+
+	/** Sensor, replayed or synthetic frames; only the mesh generator thread reads from it while playing. */
+	IKinectFrameSource *FrameSource;
+	/** Set when the frame source reported a new calibration the unprojector has not picked up yet. */
+	bool bCoordinateMappingChanged;
+	FKinectFrameRecorder Recorder;
+	/** Bundle as delivered by the frame source, before its streams are matched up. */
+	FKinectFrameBundle IncomingBundle;
+	FKinectFrameSynchronizer FrameSynchronizer;
+	/** Newest matched bundle; its frames are handed on to the ones below. */
+	FKinectFrameBundle FrameBundle;
+	FKinectDepthUnprojector DepthUnprojector;
+	FKinectColorRegistration ColorRegistration;
 	int32 ColorWidth;
 	int32 ColorHeight;
 	int32 DepthWidth;
 	int32 DepthHeight;
-	TArray<UINT16> DepthBuffer;
+	/** Depth frame being meshed, a view of sensor memory released once the mesh is built. */
+	TKinectFramePlane<uint16> DepthFrame;
 	TArray<UINT16> SmoothDepthBuffer;
-	TArray<RGBQUAD> ColorBuffer;
-	TArray<uint8> BodyIndexBuffer;
-	TSharedPtr<TArray<uint8>, ESPMode::ThreadSafe> CurrentCameraFrame;
+	/** Fills the holes of DepthFrame into SmoothDepthBuffer. */
+	FKinectHoleFiller HoleFiller;
+	TArray<UINT16> FilteredDepthBuffer;
+	FKinectBilateralFilter DepthFilter;
+	/** YUY2 color frame registered to the mesh, released with DepthFrame. */
+	TKinectFramePlane<uint8> ColorImage;
+	/** Newest color frame converted to BGRA at the camera resolution; shared with the packets and the camera texture. */
+	FKinectFrameBufferPtr ColorFrame;
+	FKinectFrameBufferPool ColorFramePool;
+	TKinectFramePlane<uint8> BodyIndexFrame;
 
-	TArray<FBody> UpdateBodies; 
+	/** Body frames from the mesh generator thread, shared with the packets. */
+	FKinectBodyFramePool BodyFramePool;
+	/** Body frame built by DoUpdateBody for the next packet. */
+	FKinectBodyFramePtr UpdateBodyFrame;
+	/** Smooths the body frames on the mesh generator thread. */
+	FKinectJointFilter BodyFilter;
+	/** Recent body frames, pushed by the mesh generator thread and sampled by the game thread. */
+	FKinectBodyHistory BodyHistory;
+	/** Body frame the game thread predicts into each tick when BodyLatencyCompensationSeconds is set. */
+	FKinectBodyFrameRef PredictedBodyFrame;
+	/** Runs on the mesh generator thread; the library is changed from the game thread. */
+	FKinectGestureRecognizer GestureRecognizer;
+	/** Gestures recognized since the last packet was published. */
+	TArray<FKinectGestureEvent> RecognizedGestures;
+	/** Newest body frame the game thread received, and whether Bodies was built from it. */
+	FKinectBodyFramePtr BodyFrame;
+	bool bBodiesBuilt;
 
 };
 
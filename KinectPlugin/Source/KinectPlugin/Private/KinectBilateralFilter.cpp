@@ -0,0 +1,226 @@
+#include "KinectPluginPrivatePCH.h"
+#include "KinectBilateralFilter.h"
+#include "KinectSimd.h"
+#include "AllowWindowsPlatformTypes.h"
+#include "ppl.h"
+#include "HideWindowsPlatformTypes.h"
+
+DECLARE_CYCLE_STAT(TEXT("Bilateral Filter"), STAT_KinectBilateralFilter, STATGROUP_Kinect);
+
+/** Holes are far below every depth, so their range weight to any depth is zero. */
+static const float HoleDepth = -static_cast<float>(MAX_uint16);
+
+/**
+ * The range weight of a difference d is (1 - x / N)^N for x = d^2 / (2 sigma^2)
+ * and N = 2^RangeSquarings, which is exp(-x) in the limit and within a few
+ * percent of it at N = 16. It takes RangeSquarings multiplies in registers
+ * where exp would take a call or a table lookup per lane, and it reaches
+ * zero by itself at d = sqrt(2 N) sigma, so holes weigh nothing.
+ */
+static const int32 RangeSquarings = 4;
+static const float RangePower = static_cast<float>(1 << RangeSquarings);
+
+/**
+ * Filters Width pixels of a padded row, TLanes::Width at a time, with the
+ * taps at Offsets from each of them besides the center, whose weight is
+ * always one. A tap's weight is the RangePower-th power of its root minus
+ * its scale times the squared difference, so the spatial weight rides along
+ * in the root; Roots and Scales hold each tap's TLanes::Width times over, so
+ * they load without a broadcast. Out gets the filtered depth of the pixels
+ * and HoleDepth at holes; it is written in whole lanes, so it must have
+ * room up to Width rounded up to them.
+ */
+template<typename TLanes>
+static void FilterRow(const float *Center, int32 Width, const int32 *Offsets, const float *Roots, const float *Scales, int32 NumTaps, float *Out)
+{
+	const TLanes Hole(HoleDepth);
+	const TLanes Zero(0.0f);
+	for (int32 x = 0; x < Width; x += TLanes::Width)
+	{
+		// The center weighs one against itself, holes included, so Weight is never zero
+		const TLanes Depth = TLanes::Load(Center + x);
+		TLanes Sum = Depth;
+		TLanes Weight(1.0f);
+		for (int32 Tap = 0; Tap < NumTaps; Tap++)
+		{
+			const TLanes Neighbor = TLanes::Load(Center + x + Offsets[Tap]);
+			const TLanes Difference = Neighbor - Depth;
+			TLanes TapWeight = TLanes::Max(TLanes::Load(Roots + Tap * TLanes::Width) - Difference * Difference * TLanes::Load(Scales + Tap * TLanes::Width), Zero);
+			for (int32 i = 0; i < RangeSquarings; i++)
+			{
+				TapWeight = TapWeight * TapWeight;
+			}
+			Sum = Sum + TapWeight * Neighbor;
+			Weight = Weight + TapWeight;
+		}
+		TLanes::Select(Depth < Zero, Hole, Sum / Weight).Store(Out + x);
+	}
+}
+
+/** Depth in millimeters to floats, with HoleDepth at holes. */
+static void PadRow(const uint16 *Depth, int32 Width, float *Out)
+{
+	int32 x = 0;
+#if KINECT_SIMD_SSE
+	const __m128i Zero = _mm_setzero_si128();
+	const __m128 Hole = _mm_set1_ps(HoleDepth);
+	for (; x + 8 <= Width; x += 8)
+	{
+		const __m128i Raw = _mm_loadu_si128(reinterpret_cast<const __m128i*>(Depth + x));
+		const __m128i Holes = _mm_cmpeq_epi16(Raw, Zero);
+		const __m128 Lo = _mm_cvtepi32_ps(_mm_unpacklo_epi16(Raw, Zero));
+		const __m128 Hi = _mm_cvtepi32_ps(_mm_unpackhi_epi16(Raw, Zero));
+		// The hole mask widens to 32 bits along with the depth
+		const __m128 HolesLo = _mm_castsi128_ps(_mm_unpacklo_epi16(Holes, Holes));
+		const __m128 HolesHi = _mm_castsi128_ps(_mm_unpackhi_epi16(Holes, Holes));
+		_mm_storeu_ps(Out + x, _mm_or_ps(_mm_and_ps(HolesLo, Hole), _mm_andnot_ps(HolesLo, Lo)));
+		_mm_storeu_ps(Out + x + 4, _mm_or_ps(_mm_and_ps(HolesHi, Hole), _mm_andnot_ps(HolesHi, Hi)));
+	}
+#endif
+	for (; x < Width; x++)
+	{
+		Out[x] = Depth[x] ? Depth[x] : HoleDepth;
+	}
+}
+
+/** Filtered depth back to the nearest millimeter, with holes at zero. */
+static void FinishRow(const float *Filtered, int32 Width, uint16 *Out)
+{
+	int32 x = 0;
+#if KINECT_SIMD_SSE
+	const __m128 Zero = _mm_setzero_ps();
+	const __m128 Half = _mm_set1_ps(0.5f);
+	// SSE2 packs to signed words only, so the depth is packed 32768 down and moved back up
+	const __m128i Bias32 = _mm_set1_epi32(32768);
+	const __m128i Bias16 = _mm_set1_epi16(-32768);
+	for (; x + 8 <= Width; x += 8)
+	{
+		const __m128 Lo = _mm_loadu_ps(Filtered + x);
+		const __m128 Hi = _mm_loadu_ps(Filtered + x + 4);
+		const __m128i RoundedLo = _mm_cvttps_epi32(_mm_and_ps(_mm_cmpgt_ps(Lo, Zero), _mm_add_ps(Lo, Half)));
+		const __m128i RoundedHi = _mm_cvttps_epi32(_mm_and_ps(_mm_cmpgt_ps(Hi, Zero), _mm_add_ps(Hi, Half)));
+		const __m128i Packed = _mm_packs_epi32(_mm_sub_epi32(RoundedLo, Bias32), _mm_sub_epi32(RoundedHi, Bias32));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(Out + x), _mm_xor_si128(Packed, Bias16));
+	}
+#endif
+	for (; x < Width; x++)
+	{
+		Out[x] = Filtered[x] > 0.0f ? static_cast<uint16>(Filtered[x] + 0.5f) : 0;
+	}
+}
+
+FKinectBilateralFilter::FKinectBilateralFilter()
+	: Pitch(0)
+{
+	KernelSettings.Radius = -1;
+}
+
+void FKinectBilateralFilter::UpdateKernel(const FKinectBilateralFilterSettings &Settings, int32 InPitch)
+{
+	if (Settings.Radius == KernelSettings.Radius && Settings.SpatialSigma == KernelSettings.SpatialSigma &&
+		Settings.RangeSigma == KernelSettings.RangeSigma && InPitch == Pitch)
+	{
+		return;
+	}
+	KernelSettings = Settings;
+	Pitch = InPitch;
+	const int32 Radius = Settings.Radius;
+	// Roots are the spatial weights' RangePower-th roots, so their power is the spatial weight again
+	const float SpatialScale = -0.5f / (FMath::Square(FMath::Max(Settings.SpatialSigma, KINDA_SMALL_NUMBER)) * RangePower);
+	const float RangeScale = 0.5f / (FMath::Square(FMath::Max(Settings.RangeSigma, KINDA_SMALL_NUMBER)) * RangePower);
+	SquareOffsets.Reset();
+	SquareRoots.Reset();
+	SquareScales.Reset();
+	RowOffsets.Reset();
+	ColumnOffsets.Reset();
+	LineRoots.Reset();
+	LineScales.Reset();
+	for (int32 dy = -Radius; dy <= Radius; dy++)
+	{
+		for (int32 dx = -Radius; dx <= Radius; dx++)
+		{
+			if (dx == 0 && dy == 0)
+			{
+				continue;
+			}
+			const float Root = FMath::Exp((dx * dx + dy * dy) * SpatialScale);
+			SquareOffsets.Add(dy * Pitch + dx);
+			for (int32 Lane = 0; Lane < FKinectLanes::Width; Lane++)
+			{
+				SquareRoots.Add(Root);
+				SquareScales.Add(Root * RangeScale);
+			}
+		}
+		if (dy == 0)
+		{
+			continue;
+		}
+		const float Root = FMath::Exp(dy * dy * SpatialScale);
+		RowOffsets.Add(dy);
+		ColumnOffsets.Add(dy * Pitch);
+		for (int32 Lane = 0; Lane < FKinectLanes::Width; Lane++)
+		{
+			LineRoots.Add(Root);
+			LineScales.Add(Root * RangeScale);
+		}
+	}
+}
+
+void FKinectBilateralFilter::Filter(const uint16 *Depth, int32 Width, int32 Height, const FKinectBilateralFilterSettings &Settings, uint16 *Out)
+{
+	SCOPE_CYCLE_COUNTER(STAT_KinectBilateralFilter);
+	const int32 Radius = FMath::Max(Settings.Radius, 0);
+	const int32 Lanes = FKinectLanes::Width;
+	// Rows are padded to whole lanes as well, so the last lanes of a row read holes
+	const int32 PaddedWidth = (Width + Lanes - 1) / Lanes * Lanes + 2 * Radius;
+	const int32 PaddedHeight = Height + 2 * Radius;
+	const bool bResized = PaddedWidth != Pitch || Padded.Num() != PaddedWidth * PaddedHeight;
+	FKinectBilateralFilterSettings Clamped = Settings;
+	Clamped.Radius = Radius;
+	UpdateKernel(Clamped, PaddedWidth);
+	if (bResized)
+	{
+		Padded.SetNumUninitialized(PaddedWidth * PaddedHeight);
+		for (int32 i = 0; i < Padded.Num(); i++)
+		{
+			Padded[i] = HoleDepth;
+		}
+		Filtered = Padded;
+	}
+	const int32 Origin = Radius * PaddedWidth + Radius;
+	Concurrency::parallel_for(0, Height, [&](int y)
+	{
+		PadRow(Depth + y * Width, Width, Padded.GetData() + Origin + y * PaddedWidth);
+	});
+
+	Concurrency::combinable<TArray<float>> Scratches;
+	if (Settings.bSeparable)
+	{
+		// The rows keep their padding, which is all holes, so the columns pass reads the same layout
+		Concurrency::parallel_for(0, Height, [&](int y)
+		{
+			const int32 Row = Origin + y * PaddedWidth;
+			FilterRow<FKinectLanes>(Padded.GetData() + Row, Width, RowOffsets.GetData(), LineRoots.GetData(), LineScales.GetData(), RowOffsets.Num(),
+				Filtered.GetData() + Row);
+		});
+		Concurrency::parallel_for(0, Height, [&](int y)
+		{
+			TArray<float> &Scratch = Scratches.local();
+			Scratch.SetNumUninitialized(PaddedWidth);
+			FilterRow<FKinectLanes>(Filtered.GetData() + Origin + y * PaddedWidth, Width, ColumnOffsets.GetData(), LineRoots.GetData(), LineScales.GetData(), RowOffsets.Num(),
+				Scratch.GetData());
+			FinishRow(Scratch.GetData(), Width, Out + y * Width);
+		});
+	}
+	else
+	{
+		Concurrency::parallel_for(0, Height, [&](int y)
+		{
+			TArray<float> &Scratch = Scratches.local();
+			Scratch.SetNumUninitialized(PaddedWidth);
+			FilterRow<FKinectLanes>(Padded.GetData() + Origin + y * PaddedWidth, Width, SquareOffsets.GetData(), SquareRoots.GetData(), SquareScales.GetData(), SquareOffsets.Num(),
+				Scratch.GetData());
+			FinishRow(Scratch.GetData(), Width, Out + y * Width);
+		});
+	}
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+#include "Engine.h"
+
+/** Kernel of FKinectBilateralFilter. */
+struct FKinectBilateralFilterSettings
+{
+	/** Half the edge length of the square kernel, in pixels; the kernel spans 2 * Radius + 1. */
+	int32 Radius;
+	/** Standard deviation of the spatial weights, in pixels. */
+	float SpatialSigma;
+	/** Standard deviation of the range weights, in millimeters; depths more than 5.7 times it apart do not weigh each other. */
+	float RangeSigma;
+	/** Filters the rows and then the columns, 2 * (2 * Radius + 1) samples per pixel rather than the whole square. */
+	bool bSeparable;
+
+	FKinectBilateralFilterSettings()
+		: Radius(2)
+		, SpatialSigma(1.5f)
+		, RangeSigma(20.0f)
+		, bSeparable(false)
+	{
+	}
+};
+
+/**
+ * Edge-preserving smoothing of a depth image: every pixel becomes the
+ * average of its neighbours weighted by their distance in the image and
+ * their difference in depth, so surfaces are smoothed but not blurred into
+ * each other at depth edges. Holes neither take part nor get filled.
+ *
+ * The spatial weights are Gaussian, from a kernel built when the settings
+ * change. The range weights are (1 - x / 16)^16, a close stand-in for the
+ * Gaussian exp(-x) that is computed in registers with four multiplies and
+ * is zero beyond about 5.7 RangeSigma. The kernel runs over FKinectLanes
+ * adjacent pixels at a time. Large kernels can be approximated separably,
+ * after Pham and van Vliet, "Separable bilateral filtering for fast video
+ * preprocessing" (2005).
+ */
+class FKinectBilateralFilter
+{
+public:
+	FKinectBilateralFilter();
+
+	/** Filters Depth into Out, which must not overlap it. */
+	void Filter(const uint16 *Depth, int32 Width, int32 Height, const FKinectBilateralFilterSettings &Settings, uint16 *Out);
+
+private:
+	/** Rebuilds the tap offsets and weights for Settings and a row pitch. */
+	void UpdateKernel(const FKinectBilateralFilterSettings &Settings, int32 InPitch);
+
+	/** Settings and pitch the tables were built for. */
+	FKinectBilateralFilterSettings KernelSettings;
+	int32 Pitch;
+	/**
+	 * Offsets from the center in the padded images, the square's and then a
+	 * row's and a column's, the center itself left out. Each tap has the
+	 * 16th root of its spatial weight and that root scaled by the range
+	 * weights' falloff, repeated for every one of FKinectLanes.
+	 */
+	TArray<int32> SquareOffsets;
+	TArray<float> SquareRoots;
+	TArray<float> SquareScales;
+	TArray<int32> RowOffsets;
+	TArray<int32> ColumnOffsets;
+	TArray<float> LineRoots;
+	TArray<float> LineScales;
+	/** Depth as floats, bordered by Radius pixels of holes so the kernel never leaves it. */
+	TArray<float> Padded;
+	/** Rows filtered by the first separable pass, laid out as Padded. */
+	TArray<float> Filtered;
+};
@@ -0,0 +1,121 @@
+#include "KinectPluginPrivatePCH.h"
+#include "KinectBodyFrame.h"
+
+/** Sensor meters to engine centimeters. */
+static const float BodyScale = 100.0f;
+
+FKinectBodyFrame::FKinectBodyFrame()
+	: Time(0)
+{
+	for (int32 Body = 0; Body < BODY_COUNT; Body++)
+	{
+		bTracked[Body] = false;
+		Attributes[Body] = EKinectBodyAttribute::None;
+		LeftHandStates[Body] = HandState_Unknown;
+		RightHandStates[Body] = HandState_Unknown;
+		Leans[Body] = FVector2D::ZeroVector;
+		LeanTrackingStates[Body] = TrackingState_NotTracked;
+		for (int32 i = 0; i < Activity_Count; i++)
+		{
+			Activities[Body][i] = DetectionResult_Unknown;
+		}
+		for (int32 i = 0; i < Appearance_Count; i++)
+		{
+			Appearances[Body][i] = DetectionResult_Unknown;
+		}
+		for (int32 i = 0; i < Expression_Count; i++)
+		{
+			Expressions[Body][i] = DetectionResult_Unknown;
+		}
+		for (int32 j = 0; j < JointType_Count; j++)
+		{
+			Positions[Body][j] = FVector::ZeroVector;
+			Orientations[Body][j] = FQuat::Identity;
+			TrackingStates[Body][j] = TrackingState_NotTracked;
+		}
+	}
+}
+
+void FKinectBodyFrame::Set(const FKinectBodyData (&Bodies)[BODY_COUNT], TIMESPAN InTime)
+{
+	Time = InTime;
+	for (int32 Body = 0; Body < BODY_COUNT; Body++)
+	{
+		const FKinectBodyData &Data = Bodies[Body];
+		bTracked[Body] = Data.bTracked;
+		if (!Data.bTracked)
+		{
+			continue;
+		}
+		const int32 BodyAttributes = Data.Attributes;
+		Attributes[Body] = BodyAttributes;
+		const bool bOrientations = (BodyAttributes & EKinectBodyAttribute::JointOrientations) != 0;
+		// The sensor fills both arrays in JointType order, so joint and orientation j belong together
+		for (int32 j = 0; j < JointType_Count; j++)
+		{
+			const CameraSpacePoint &P = Data.Joints[j].Position;
+			// Sensor X right, Y up, Z forward to engine X forward, Y right, Z up
+			Positions[Body][j] = FVector(P.Z, P.X, P.Y) * BodyScale;
+			if (bOrientations)
+			{
+				const Vector4 &V = Data.JointOrientations[j].Orientation;
+				Orientations[Body][j] = FQuat(V.z, V.y, V.x, V.w);
+			}
+			else
+			{
+				Orientations[Body][j] = FQuat::Identity;
+			}
+			TrackingStates[Body][j] = Data.Joints[j].TrackingState;
+		}
+		const bool bHandStates = (BodyAttributes & EKinectBodyAttribute::HandStates) != 0;
+		LeftHandStates[Body] = bHandStates ? Data.LeftHandState : HandState_Unknown;
+		RightHandStates[Body] = bHandStates ? Data.RightHandState : HandState_Unknown;
+		if (BodyAttributes & EKinectBodyAttribute::Lean)
+		{
+			Leans[Body] = FVector2D(Data.Lean.X, Data.Lean.Y);
+			LeanTrackingStates[Body] = Data.LeanTrackingState;
+		}
+		else
+		{
+			Leans[Body] = FVector2D::ZeroVector;
+			LeanTrackingStates[Body] = TrackingState_NotTracked;
+		}
+		for (int32 i = 0; i < Activity_Count; i++)
+		{
+			Activities[Body][i] = (BodyAttributes & EKinectBodyAttribute::Activities) ? Data.Activities[i] : DetectionResult_Unknown;
+		}
+		for (int32 i = 0; i < Appearance_Count; i++)
+		{
+			Appearances[Body][i] = (BodyAttributes & EKinectBodyAttribute::Appearance) ? Data.Appearance[i] : DetectionResult_Unknown;
+		}
+		for (int32 i = 0; i < Expression_Count; i++)
+		{
+			Expressions[Body][i] = (BodyAttributes & EKinectBodyAttribute::Expressions) ? Data.Expressions[i] : DetectionResult_Unknown;
+		}
+	}
+}
+
+void FKinectBodyFrame::CopyBodyAttributes(const FKinectBodyFrame &Source, int32 Body)
+{
+	Attributes[Body] = Source.Attributes[Body];
+	LeftHandStates[Body] = Source.LeftHandStates[Body];
+	RightHandStates[Body] = Source.RightHandStates[Body];
+	Leans[Body] = Source.Leans[Body];
+	LeanTrackingStates[Body] = Source.LeanTrackingStates[Body];
+	FMemory::Memcpy(Activities[Body], Source.Activities[Body], sizeof(Activities[Body]));
+	FMemory::Memcpy(Appearances[Body], Source.Appearances[Body], sizeof(Appearances[Body]));
+	FMemory::Memcpy(Expressions[Body], Source.Expressions[Body], sizeof(Expressions[Body]));
+}
+
+FKinectBodyFrameRef FKinectBodyFramePool::Acquire()
+{
+	// Only the producer hands frames out, so a frame only the pool references stays unshared
+	for (int32 i = 0; i < Frames.Num(); i++)
+	{
+		if (Frames[i].IsUnique())
+		{
+			return Frames[i];
+		}
+	}
+	return Frames[Frames.Add(MakeShareable(new FKinectBodyFrame()))];
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+#include "Engine.h"
+#include "KinectFrameSource.h"
+
+/**
+ * Every body of one body frame in engine space, stored per attribute and
+ * indexed by body and by the sensor's JointType, so reading a joint is plain
+ * array indexing and the whole frame is one flat block without allocations.
+ * Positions are in centimeters.
+ */
+struct FKinectBodyFrame
+{
+	/** RelativeTime of the body frame, in 100 ns units. */
+	TIMESPAN Time;
+	bool bTracked[BODY_COUNT];
+	/** EKinectBodyAttribute bits of what the sensor was queried for; the rest holds defaults. */
+	int32 Attributes[BODY_COUNT];
+	HandState LeftHandStates[BODY_COUNT];
+	HandState RightHandStates[BODY_COUNT];
+	FVector2D Leans[BODY_COUNT];
+	TrackingState LeanTrackingStates[BODY_COUNT];
+	DetectionResult Activities[BODY_COUNT][Activity_Count];
+	DetectionResult Appearances[BODY_COUNT][Appearance_Count];
+	DetectionResult Expressions[BODY_COUNT][Expression_Count];
+	FVector Positions[BODY_COUNT][JointType_Count];
+	FQuat Orientations[BODY_COUNT][JointType_Count];
+	TrackingState TrackingStates[BODY_COUNT][JointType_Count];
+
+	FKinectBodyFrame();
+
+	/** Converts the bodies of a frame bundle. Joints of untracked bodies are left as they were and mean nothing. */
+	void Set(const FKinectBodyData (&Bodies)[BODY_COUNT], TIMESPAN InTime);
+
+	/** Copies what body Body has besides its joints from Source. */
+	void CopyBodyAttributes(const FKinectBodyFrame &Source, int32 Body);
+};
+
+typedef TSharedPtr<FKinectBodyFrame, ESPMode::ThreadSafe> FKinectBodyFrameRef;
+/** Published body frames are read only; readers share them until the last one lets go. */
+typedef TSharedPtr<const FKinectBodyFrame, ESPMode::ThreadSafe> FKinectBodyFramePtr;
+
+/**
+ * Recycles body frames for a single producer. A frame is handed out again
+ * once the pool holds the only reference to it, so publishing a frame is a
+ * pointer copy and steady state updates do not allocate.
+ */
+class FKinectBodyFramePool
+{
+public:
+	/** Returns a frame nobody else references, holding the contents it was last published with. */
+	FKinectBodyFrameRef Acquire();
+
+	void Reset()
+	{
+		Frames.Reset();
+	}
+
+private:
+	TArray<FKinectBodyFrameRef> Frames;
+};
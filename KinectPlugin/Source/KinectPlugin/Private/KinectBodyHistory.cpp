@@ -0,0 +1,129 @@
+#include "KinectPluginPrivatePCH.h"
+#include "KinectBodyHistory.h"
+
+DECLARE_CYCLE_STAT(TEXT("Body Sample"), STAT_KinectBodySample, STATGROUP_Kinect);
+
+FKinectBodyHistory::FKinectBodyHistory(int32 InCapacity)
+	: Head(0)
+	, Num(0)
+	, ClockOffset(0.0)
+{
+	Entries.SetNum(FMath::Max(InCapacity, 2));
+}
+
+void FKinectBodyHistory::Push(const FKinectBodyFramePtr &Frame, double ArrivalSeconds)
+{
+	FScopeLock ScopeLock(&Lock);
+	if (Num > 0)
+	{
+		const FEntry &Newest = Entries[(Head + Num - 1) % Entries.Num()];
+		if (Frame->Time <= Newest.Frame->Time)
+		{
+			for (int32 i = 0; i < Entries.Num(); i++)
+			{
+				Entries[i].Frame.Reset();
+			}
+			Head = 0;
+			Num = 0;
+		}
+	}
+	if (Num == Entries.Num())
+	{
+		// Drop the oldest, which lets its frame go back to the producer's pool
+		Entries[Head].Frame.Reset();
+		Head = (Head + 1) % Entries.Num();
+		Num--;
+	}
+	FEntry &Entry = Entries[(Head + Num) % Entries.Num()];
+	Entry.Frame = Frame;
+	Entry.ArrivalSeconds = ArrivalSeconds;
+	Num++;
+	// Taken over the frames held only, so the estimate follows the clocks drifting apart
+	ClockOffset = MAX_dbl;
+	for (int32 i = 0; i < Num; i++)
+	{
+		const FEntry &Held = Entries[(Head + i) % Entries.Num()];
+		ClockOffset = FMath::Min(ClockOffset, Held.ArrivalSeconds - Held.Frame->Time / KinectTicksPerSecond);
+	}
+}
+
+void FKinectBodyHistory::Reset()
+{
+	FScopeLock ScopeLock(&Lock);
+	for (int32 i = 0; i < Entries.Num(); i++)
+	{
+		Entries[i].Frame.Reset();
+	}
+	Head = 0;
+	Num = 0;
+	ClockOffset = 0.0;
+}
+
+FKinectBodyFramePtr FKinectBodyHistory::GetNewest() const
+{
+	FScopeLock ScopeLock(&Lock);
+	return Num > 0 ? Entries[(Head + Num - 1) % Entries.Num()].Frame : FKinectBodyFramePtr();
+}
+
+TIMESPAN FKinectBodyHistory::ToSensorTime(double Seconds) const
+{
+	return static_cast<TIMESPAN>((Seconds - ClockOffset) * KinectTicksPerSecond);
+}
+
+bool FKinectBodyHistory::Sample(double Seconds, float MaxExtrapolationSeconds, FKinectBodyFrame &Out) const
+{
+	SCOPE_CYCLE_COUNTER(STAT_KinectBodySample);
+	FKinectBodyFramePtr Older;
+	FKinectBodyFramePtr Newer;
+	TIMESPAN Time;
+	{
+		FScopeLock ScopeLock(&Lock);
+		if (Num == 0)
+		{
+			return false;
+		}
+		Time = ToSensorTime(Seconds);
+		// The first frame not older than Time, or the newest
+		int32 i = 0;
+		while (i < Num - 1 && Entries[(Head + i) % Entries.Num()].Frame->Time < Time)
+		{
+			i++;
+		}
+		Newer = Entries[(Head + i) % Entries.Num()].Frame;
+		Older = i > 0 ? Entries[(Head + i - 1) % Entries.Num()].Frame : Newer;
+	}
+	const TIMESPAN MaxTime = Newer->Time + static_cast<TIMESPAN>(MaxExtrapolationSeconds * KinectTicksPerSecond);
+	Time = FMath::Clamp(Time, Older->Time, FMath::Max(MaxTime, Newer->Time));
+	if (Older == Newer)
+	{
+		Out = *Newer;
+		Out.Time = Time;
+		return true;
+	}
+	// Above 1 past the newest frame, which carries the last frame's motion on
+	const float Alpha = static_cast<float>(static_cast<double>(Time - Older->Time) / (Newer->Time - Older->Time));
+	// Tracking states and the other attributes do not blend, they come from the nearer frame
+	const FKinectBodyFrame &Nearer = Alpha < 0.5f ? *Older : *Newer;
+	Out.Time = Time;
+	for (int32 Body = 0; Body < BODY_COUNT; Body++)
+	{
+		// A body found or lost between the two frames is as the nearer frame has it; past the newest frame that is the newest
+		Out.bTracked[Body] = Nearer.bTracked[Body];
+		if (!Older->bTracked[Body] || !Newer->bTracked[Body])
+		{
+			Out.CopyBodyAttributes(Nearer, Body);
+			FMemory::Memcpy(Out.Positions[Body], Nearer.Positions[Body], sizeof(Out.Positions[Body]));
+			FMemory::Memcpy(Out.Orientations[Body], Nearer.Orientations[Body], sizeof(Out.Orientations[Body]));
+			FMemory::Memcpy(Out.TrackingStates[Body], Nearer.TrackingStates[Body], sizeof(Out.TrackingStates[Body]));
+			continue;
+		}
+		Out.CopyBodyAttributes(Nearer, Body);
+		for (int32 j = 0; j < JointType_Count; j++)
+		{
+			Out.Positions[Body][j] = FMath::Lerp(Older->Positions[Body][j], Newer->Positions[Body][j], Alpha);
+			Out.Orientations[Body][j] = FQuat::Slerp(Older->Orientations[Body][j], Newer->Orientations[Body][j], Alpha);
+			Out.TrackingStates[Body][j] = Nearer.TrackingStates[Body][j];
+		}
+	}
+	return true;
+}
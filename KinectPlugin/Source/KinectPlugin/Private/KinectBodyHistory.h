@@ -0,0 +1,62 @@
+#pragma once
+
+#include "Engine.h"
+#include "KinectBodyFrame.h"
+
+/**
+ * The most recent body frames with the host time they arrived at, so bodies
+ * can be sampled at any host time: between two frames the joints are
+ * interpolated, past the newest frame they are extrapolated from the last two.
+ * Sampling at the time a frame will be displayed hides part of the sensor's
+ * latency.
+ *
+ * One thread pushes, any thread samples. The lock only covers copying the two
+ * frame pointers a sample needs; the frames themselves are read only.
+ */
+class FKinectBodyHistory
+{
+public:
+	static const int32 DefaultCapacity = 8;
+
+	explicit FKinectBodyHistory(int32 InCapacity = DefaultCapacity);
+
+	/**
+	 * Adds the newest frame, which arrived at ArrivalSeconds of FPlatformTime.
+	 * A frame that is not newer than the last one, as when a replay loops,
+	 * starts the history over.
+	 */
+	void Push(const FKinectBodyFramePtr &Frame, double ArrivalSeconds);
+
+	void Reset();
+
+	/**
+	 * Fills Out with the bodies at host time Seconds. Extrapolation stops
+	 * MaxExtrapolationSeconds past the newest frame. A body tracked in only one
+	 * of the two frames is taken as it is from the nearer one, so past the
+	 * newest frame a body it lost is not tracked.
+	 *
+	 * @return false if the history is empty.
+	 */
+	bool Sample(double Seconds, float MaxExtrapolationSeconds, FKinectBodyFrame &Out) const;
+
+	/** Newest frame, or null. */
+	FKinectBodyFramePtr GetNewest() const;
+
+private:
+	struct FEntry
+	{
+		FKinectBodyFramePtr Frame;
+		double ArrivalSeconds;
+	};
+
+	/** Sensor time, in 100 ns units, of host time Seconds. Called with the lock held. */
+	TIMESPAN ToSensorTime(double Seconds) const;
+
+	mutable FCriticalSection Lock;
+	/** Ring of frames, oldest at Head once the ring is full. */
+	TArray<FEntry> Entries;
+	int32 Head;
+	int32 Num;
+	/** Host minus sensor time in seconds, the smallest seen in the history: the frame that waited least tells the clocks apart best. */
+	double ClockOffset;
+};
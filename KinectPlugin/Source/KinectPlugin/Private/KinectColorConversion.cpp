@@ -0,0 +1,169 @@
+#include "KinectPluginPrivatePCH.h"
+#include "KinectColorConversion.h"
+#include "KinectSimd.h"
+#include "AllowWindowsPlatformTypes.h"
+#include "ppl.h"
+#include "HideWindowsPlatformTypes.h"
+
+DECLARE_CYCLE_STAT(TEXT("Color Conversion"), STAT_KinectColorConversion, STATGROUP_Kinect);
+
+static FORCEINLINE uint8 Average(uint8 A, uint8 B)
+{
+	// Rounds like _mm_avg_epu8, so the scalar and SSE downsample agree
+	return static_cast<uint8>((A + B + 1) >> 1);
+}
+
+#if KINECT_SIMD_SSE
+/**
+ * Converts four pixels given as int16 pairs: P holds (C, E) and Q (C, D) per
+ * pixel, DE the chroma (D, E). Results are int32 lanes, not yet clamped.
+ */
+static FORCEINLINE void ConvertPixels4(__m128i P, __m128i Q, __m128i DE, __m128i &OutB, __m128i &OutG, __m128i &OutR)
+{
+	const __m128i Round = _mm_set1_epi32(128);
+	// _mm_madd_epi16 sums each product pair into int32, so 100 * D + 208 * E is a single multiply
+	const __m128i ChromaG = _mm_madd_epi16(DE, _mm_setr_epi16(100, 208, 100, 208, 100, 208, 100, 208));
+	const __m128i Luma = _mm_add_epi32(_mm_madd_epi16(P, _mm_setr_epi16(298, 0, 298, 0, 298, 0, 298, 0)), Round);
+	OutR = _mm_srai_epi32(_mm_add_epi32(_mm_madd_epi16(P, _mm_setr_epi16(298, 409, 298, 409, 298, 409, 298, 409)), Round), 8);
+	OutB = _mm_srai_epi32(_mm_add_epi32(_mm_madd_epi16(Q, _mm_setr_epi16(298, 516, 298, 516, 298, 516, 298, 516)), Round), 8);
+	OutG = _mm_srai_epi32(_mm_sub_epi32(Luma, ChromaG), 8);
+}
+
+/** Four YUY2 pixels, unpacked to int16 Y0 U Y1 V Y2 U Y3 V, to int32 B, G and R. */
+static FORCEINLINE void ConvertUnpacked4(__m128i Yuyv, __m128i &OutB, __m128i &OutG, __m128i &OutR)
+{
+	const __m128i Centered = _mm_sub_epi16(Yuyv, _mm_setr_epi16(16, 128, 16, 128, 16, 128, 16, 128));
+	// Lanes are C0 D C1 E per pixel pair
+	__m128i P = _mm_shufflelo_epi16(Centered, _MM_SHUFFLE(3, 2, 3, 0));
+	P = _mm_shufflehi_epi16(P, _MM_SHUFFLE(3, 2, 3, 0));
+	__m128i Q = _mm_shufflelo_epi16(Centered, _MM_SHUFFLE(1, 2, 1, 0));
+	Q = _mm_shufflehi_epi16(Q, _MM_SHUFFLE(1, 2, 1, 0));
+	__m128i DE = _mm_shufflelo_epi16(Centered, _MM_SHUFFLE(3, 1, 3, 1));
+	DE = _mm_shufflehi_epi16(DE, _MM_SHUFFLE(3, 1, 3, 1));
+	ConvertPixels4(P, Q, DE, OutB, OutG, OutR);
+}
+
+/** Clamps two groups of four int32 pixels and stores them as eight BGRA pixels. */
+static FORCEINLINE void StoreBGRA8(uint8 *Out, __m128i B0, __m128i G0, __m128i R0, __m128i B1, __m128i G1, __m128i R1)
+{
+	const __m128i BR = _mm_packus_epi16(_mm_packs_epi32(B0, B1), _mm_packs_epi32(R0, R1));
+	const __m128i GA = _mm_packus_epi16(_mm_packs_epi32(G0, G1), _mm_set1_epi16(255));
+	const __m128i BG = _mm_unpacklo_epi8(BR, GA);
+	const __m128i RA = _mm_unpackhi_epi8(BR, GA);
+	_mm_storeu_si128(reinterpret_cast<__m128i*>(Out), _mm_unpacklo_epi16(BG, RA));
+	_mm_storeu_si128(reinterpret_cast<__m128i*>(Out + 16), _mm_unpackhi_epi16(BG, RA));
+}
+
+/**
+ * Four macro pixels, vertically averaged and unpacked to int16 Y0 U Y1 V,
+ * reduced to one pixel each: Lo holds macro pixels 0 and 1, Hi 2 and 3.
+ */
+static FORCEINLINE void ConvertMacroPixels4(__m128i Lo, __m128i Hi, __m128i &OutB, __m128i &OutG, __m128i &OutR)
+{
+	const __m128i LumaLanes = _mm_setr_epi16(-1, 0, -1, 0, -1, 0, -1, 0);
+	const __m128i Bias = _mm_setr_epi16(16, 128, 16, 128, 16, 128, 16, 128);
+	// Y0 and Y1 swap places so an average of the two lands on both luma lanes
+	__m128i SwappedLo = _mm_shufflelo_epi16(Lo, _MM_SHUFFLE(1, 0, 3, 2));
+	SwappedLo = _mm_shufflehi_epi16(SwappedLo, _MM_SHUFFLE(1, 0, 3, 2));
+	__m128i SwappedHi = _mm_shufflelo_epi16(Hi, _MM_SHUFFLE(1, 0, 3, 2));
+	SwappedHi = _mm_shufflehi_epi16(SwappedHi, _MM_SHUFFLE(1, 0, 3, 2));
+	// Now C D C E per macro pixel, i.e. int32 lanes (C, D) (C, E)
+	const __m128i CenteredLo = _mm_sub_epi16(_mm_or_si128(_mm_and_si128(_mm_avg_epu16(Lo, SwappedLo), LumaLanes), _mm_andnot_si128(LumaLanes, Lo)), Bias);
+	const __m128i CenteredHi = _mm_sub_epi16(_mm_or_si128(_mm_and_si128(_mm_avg_epu16(Hi, SwappedHi), LumaLanes), _mm_andnot_si128(LumaLanes, Hi)), Bias);
+	const __m128i Even = _mm_unpacklo_epi32(CenteredLo, CenteredHi);
+	const __m128i Odd = _mm_unpackhi_epi32(CenteredLo, CenteredHi);
+	const __m128i Q = _mm_unpacklo_epi32(Even, Odd);
+	const __m128i P = _mm_unpackhi_epi32(Even, Odd);
+	// D E of each macro pixel
+	__m128i DELo = _mm_shufflelo_epi16(CenteredLo, _MM_SHUFFLE(3, 1, 3, 1));
+	DELo = _mm_shuffle_epi32(_mm_shufflehi_epi16(DELo, _MM_SHUFFLE(3, 1, 3, 1)), _MM_SHUFFLE(3, 1, 2, 0));
+	__m128i DEHi = _mm_shufflelo_epi16(CenteredHi, _MM_SHUFFLE(3, 1, 3, 1));
+	DEHi = _mm_shuffle_epi32(_mm_shufflehi_epi16(DEHi, _MM_SHUFFLE(3, 1, 3, 1)), _MM_SHUFFLE(3, 1, 2, 0));
+	ConvertPixels4(P, Q, _mm_unpacklo_epi64(DELo, DEHi), OutB, OutG, OutR);
+}
+#endif
+
+void FKinectColorConversion::ConvertRow(const uint8 *Yuy2, int32 Width, uint8 *OutBgra)
+{
+	int32 x = 0;
+#if KINECT_SIMD_SSE
+	const __m128i Zero = _mm_setzero_si128();
+	for (; x + 8 <= Width; x += 8)
+	{
+		const __m128i Raw = _mm_loadu_si128(reinterpret_cast<const __m128i*>(Yuy2 + x * 2));
+		__m128i B0, G0, R0, B1, G1, R1;
+		ConvertUnpacked4(_mm_unpacklo_epi8(Raw, Zero), B0, G0, R0);
+		ConvertUnpacked4(_mm_unpackhi_epi8(Raw, Zero), B1, G1, R1);
+		StoreBGRA8(OutBgra + x * 4, B0, G0, R0, B1, G1, R1);
+	}
+#endif
+	FColor *Out = reinterpret_cast<FColor*>(OutBgra);
+	for (; x + 2 <= Width; x += 2)
+	{
+		const uint8 *Pair = Yuy2 + x * 2;
+		Out[x] = ToColor(Pair[0], Pair[1], Pair[3]);
+		Out[x + 1] = ToColor(Pair[2], Pair[1], Pair[3]);
+	}
+}
+
+void FKinectColorConversion::ConvertRowHalf(const uint8 *Yuy2Top, const uint8 *Yuy2Bottom, int32 Width, uint8 *OutBgra)
+{
+	// x counts output pixels, each one macro pixel of both rows
+	const int32 OutWidth = Width / 2;
+	int32 x = 0;
+#if KINECT_SIMD_SSE
+	const __m128i Zero = _mm_setzero_si128();
+	for (; x + 8 <= OutWidth; x += 8)
+	{
+		const __m128i *Top = reinterpret_cast<const __m128i*>(Yuy2Top + x * 4);
+		const __m128i *Bottom = reinterpret_cast<const __m128i*>(Yuy2Bottom + x * 4);
+		const __m128i Raw0 = _mm_avg_epu8(_mm_loadu_si128(Top), _mm_loadu_si128(Bottom));
+		const __m128i Raw1 = _mm_avg_epu8(_mm_loadu_si128(Top + 1), _mm_loadu_si128(Bottom + 1));
+		__m128i B0, G0, R0, B1, G1, R1;
+		ConvertMacroPixels4(_mm_unpacklo_epi8(Raw0, Zero), _mm_unpackhi_epi8(Raw0, Zero), B0, G0, R0);
+		ConvertMacroPixels4(_mm_unpacklo_epi8(Raw1, Zero), _mm_unpackhi_epi8(Raw1, Zero), B1, G1, R1);
+		StoreBGRA8(OutBgra + x * 4, B0, G0, R0, B1, G1, R1);
+	}
+#endif
+	FColor *Out = reinterpret_cast<FColor*>(OutBgra);
+	for (; x < OutWidth; x++)
+	{
+		const uint8 *Top = Yuy2Top + x * 4;
+		const uint8 *Bottom = Yuy2Bottom + x * 4;
+		const uint8 Y = Average(Average(Top[0], Bottom[0]), Average(Top[2], Bottom[2]));
+		Out[x] = ToColor(Y, Average(Top[1], Bottom[1]), Average(Top[3], Bottom[3]));
+	}
+}
+
+void FKinectColorConversion::ConvertToBGRA(const uint8 *Yuy2, int32 Width, int32 Height, uint8 *OutBgra)
+{
+	SCOPE_CYCLE_COUNTER(STAT_KinectColorConversion);
+	// A few bands per core, rows are cheap enough that finer scheduling only adds overhead
+	const int32 NumBands = FMath::Clamp(FPlatformMisc::NumberOfCoresIncludingHyperthreads() * 2, 1, FMath::Max(Height, 1));
+	Concurrency::parallel_for(0, NumBands, [&](int b)
+	{
+		const int32 FirstRow = Height * b / NumBands;
+		const int32 LastRow = Height * (b + 1) / NumBands;
+		for (int32 y = FirstRow; y < LastRow; y++)
+		{
+			ConvertRow(Yuy2 + y * Width * 2, Width, OutBgra + y * Width * 4);
+		}
+	});
+}
+
+void FKinectColorConversion::ConvertToBGRAHalf(const uint8 *Yuy2, int32 Width, int32 Height, uint8 *OutBgra)
+{
+	SCOPE_CYCLE_COUNTER(STAT_KinectColorConversion);
+	const int32 OutHeight = Height / 2;
+	const int32 NumBands = FMath::Clamp(FPlatformMisc::NumberOfCoresIncludingHyperthreads() * 2, 1, FMath::Max(OutHeight, 1));
+	Concurrency::parallel_for(0, NumBands, [&](int b)
+	{
+		const int32 FirstRow = OutHeight * b / NumBands;
+		const int32 LastRow = OutHeight * (b + 1) / NumBands;
+		for (int32 y = FirstRow; y < LastRow; y++)
+		{
+			const uint8 *Top = Yuy2 + 2 * y * Width * 2;
+			ConvertRowHalf(Top, Top + Width * 2, Width, OutBgra + y * (Width / 2) * 4);
+		}
+	});
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include "Engine.h"
+
+/**
+ * Converts the color camera's native YUY2 frames to BGRA.
+ *
+ * YUY2 packs two pixels into four bytes, Y0 U Y1 V, sharing the chroma. The
+ * conversion is the BT.601 video range integer formula, evaluated exactly
+ * alike by the SSE kernels and the scalar path, so both produce identical
+ * images. Whole frames are converted in parallel row bands.
+ */
+class FKinectColorConversion
+{
+public:
+	/** Converts a Width x Height frame to BGRA at full resolution. Width must be even. */
+	static void ConvertToBGRA(const uint8 *Yuy2, int32 Width, int32 Height, uint8 *OutBgra);
+
+	/**
+	 * Converts a Width x Height frame to a Width/2 x Height/2 BGRA image, each
+	 * pixel the 2x2 box average of the input. The average is taken in YUV
+	 * before converting, so the downsample costs no extra pass.
+	 */
+	static void ConvertToBGRAHalf(const uint8 *Yuy2, int32 Width, int32 Height, uint8 *OutBgra);
+
+	/** Converts the single pixel (X, Y), for sampling only the pixels something maps to. */
+	static FORCEINLINE FColor Sample(const uint8 *Yuy2, int32 Width, int32 X, int32 Y)
+	{
+		const uint8 *Pair = Yuy2 + (Y * Width + (X & ~1)) * 2;
+		return ToColor(Pair[X & 1 ? 2 : 0], Pair[1], Pair[3]);
+	}
+
+	static FORCEINLINE FColor ToColor(int32 Y, int32 U, int32 V)
+	{
+		const int32 C = 298 * (Y - 16) + 128;
+		const int32 D = U - 128;
+		const int32 E = V - 128;
+		return FColor(
+			Clamp8((C + 409 * E) >> 8),
+			Clamp8((C - 100 * D - 208 * E) >> 8),
+			Clamp8((C + 516 * D) >> 8),
+			255);
+	}
+
+private:
+	static FORCEINLINE uint8 Clamp8(int32 Value)
+	{
+		return static_cast<uint8>(FMath::Clamp(Value, 0, 255));
+	}
+
+	static void ConvertRow(const uint8 *Yuy2, int32 Width, uint8 *OutBgra);
+	static void ConvertRowHalf(const uint8 *Yuy2Top, const uint8 *Yuy2Bottom, int32 Width, uint8 *OutBgra);
+};
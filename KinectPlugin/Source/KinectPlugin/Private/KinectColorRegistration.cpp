@@ -0,0 +1,50 @@
+#include "KinectPluginPrivatePCH.h"
+#include "KinectColorRegistration.h"
+#include "KinectColorConversion.h"
+#include "AllowWindowsPlatformTypes.h"
+#include "ppl.h"
+
+DECLARE_CYCLE_STAT(TEXT("Color Registration"), STAT_KinectColorRegistration, STATGROUP_Kinect);
+
+HRESULT FKinectColorRegistration::Register(IKinectFrameSource &Source,
+	const UINT16 *Depth, int32 DepthWidth, int32 DepthHeight,
+	const uint8 *ColorYuy2, int32 ColorWidth, int32 ColorHeight)
+{
+	SCOPE_CYCLE_COUNTER(STAT_KinectColorRegistration);
+	if (Depth == nullptr || ColorYuy2 == nullptr)
+	{
+		return E_INVALIDARG;
+	}
+	const int32 DepthPixels = DepthWidth * DepthHeight;
+	ColorCoordinates.SetNumUninitialized(DepthPixels);
+	Registered.SetNumUninitialized(DepthPixels);
+
+	HRESULT hResult = Source.MapDepthFrameToColorSpace(Depth, DepthPixels, ColorCoordinates.GetData());
+	if (FAILED(hResult))
+	{
+		FMemory::Memzero(Registered.GetData(), DepthPixels * sizeof(FColor));
+		return hResult;
+	}
+
+	const ColorSpacePoint *Coordinates = ColorCoordinates.GetData();
+	FColor *Out = Registered.GetData();
+	Concurrency::parallel_for(0, DepthHeight, [&](int y)
+	{
+		const int32 RowStart = y * DepthWidth;
+		for (int32 i = RowStart; i < RowStart + DepthWidth; i++)
+		{
+			// Rounded coordinates; unmapped pixels come back as -infinity and fail the range test
+			const float colorX = Coordinates[i].X + 0.5f;
+			const float colorY = Coordinates[i].Y + 0.5f;
+			if (colorX >= 0.0f && colorX < ColorWidth && colorY >= 0.0f && colorY < ColorHeight)
+			{
+				Out[i] = FKinectColorConversion::Sample(ColorYuy2, ColorWidth, static_cast<int32>(colorX), static_cast<int32>(colorY));
+			}
+			else
+			{
+				Out[i] = FColor(0, 0, 0, 0);
+			}
+		}
+	});
+	return S_OK;
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include "Engine.h"
+#include "KinectFrameSource.h"
+#include "AllowWindowsPlatformTypes.h"
+#include "Kinect.h"
+#include "HideWindowsPlatformTypes.h"
+
+/**
+ * Registers the color camera to the depth camera. Each depth frame is mapped
+ * to color space in a single MapDepthFrameToColorSpace batch and the color
+ * frame is gathered into a depth aligned BGRA image, so consumers index one
+ * pixel instead of calling the coordinate mapper per point. Only the gathered
+ * pixels are converted from YUY2, a tenth of the color frame.
+ */
+class FKinectColorRegistration
+{
+public:
+	/**
+	 * Maps Depth to color space with the frame source's calibration and gathers
+	 * the matching pixels of the YUY2 color frame. Depth pixels that land
+	 * outside the color frame get a zero alpha.
+	 */
+	HRESULT Register(IKinectFrameSource &Source,
+		const UINT16 *Depth, int32 DepthWidth, int32 DepthHeight,
+		const uint8 *ColorYuy2, int32 ColorWidth, int32 ColorHeight);
+
+	/** Depth aligned color image, one FColor (BGRA) per depth pixel. */
+	const TArray<FColor> &GetRegisteredColor() const
+	{
+		return Registered;
+	}
+
+	/** Color space coordinates of every depth pixel from the last Register call. */
+	const TArray<ColorSpacePoint> &GetColorCoordinates() const
+	{
+		return ColorCoordinates;
+	}
+
+	static bool IsRegistered(const FColor &Pixel)
+	{
+		return Pixel.A != 0;
+	}
+
+private:
+	TArray<ColorSpacePoint> ColorCoordinates;
+	TArray<FColor> Registered;
+};
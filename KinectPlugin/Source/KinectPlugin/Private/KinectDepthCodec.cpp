@@ -0,0 +1,188 @@
+#include "KinectPluginPrivatePCH.h"
+#include "KinectDepthCodec.h"
+
+DECLARE_CYCLE_STAT(TEXT("Depth Encode"), STAT_KinectDepthEncode, STATGROUP_Kinect);
+DECLARE_CYCLE_STAT(TEXT("Depth Decode"), STAT_KinectDepthDecode, STATGROUP_Kinect);
+
+/** Packs nibbles into 32 bit words, first nibble in the top bits. */
+class FNibbleWriter
+{
+public:
+	explicit FNibbleWriter(uint32 *InOut)
+		: Out(InOut)
+		, Word(0)
+		, NumNibbles(0)
+	{
+	}
+
+	FORCEINLINE void WriteVarInt(uint32 Value)
+	{
+		do
+		{
+			uint32 Nibble = Value & 0x7;
+			Value >>= 3;
+			if (Value)
+			{
+				Nibble |= 0x8;
+			}
+			Word = (Word << 4) | Nibble;
+			if (++NumNibbles == 8)
+			{
+				*Out++ = Word;
+				Word = 0;
+				NumNibbles = 0;
+			}
+		} while (Value);
+	}
+
+	/** Writes the partial last word; returns the end of the output. */
+	uint32 *Flush()
+	{
+		if (NumNibbles)
+		{
+			*Out++ = Word << (4 * (8 - NumNibbles));
+			Word = 0;
+			NumNibbles = 0;
+		}
+		return Out;
+	}
+
+private:
+	uint32 *Out;
+	uint32 Word;
+	int32 NumNibbles;
+};
+
+class FNibbleReader
+{
+public:
+	FNibbleReader(const uint32 *InData, const uint32 *InEnd)
+		: Data(InData)
+		, End(InEnd)
+		, Word(0)
+		, NumNibbles(0)
+		, bOverrun(false)
+	{
+	}
+
+	FORCEINLINE uint32 ReadVarInt()
+	{
+		uint32 Value = 0;
+		int32 Shift = 0;
+		uint32 Nibble;
+		do
+		{
+			if (!NumNibbles)
+			{
+				if (Data == End)
+				{
+					bOverrun = true;
+					return 0;
+				}
+				Word = *Data++;
+				NumNibbles = 8;
+			}
+			Nibble = Word >> 28;
+			Word <<= 4;
+			NumNibbles--;
+			Value |= (Nibble & 0x7) << Shift;
+			Shift += 3;
+		} while ((Nibble & 0x8) && Shift < 32);
+		return Value;
+	}
+
+	bool IsOverrun() const
+	{
+		return bOverrun;
+	}
+
+	/** True once only the zero padding of the last word is left. */
+	bool IsExhausted() const
+	{
+		return Data == End && Word == 0;
+	}
+
+private:
+	const uint32 *Data;
+	const uint32 *End;
+	uint32 Word;
+	int32 NumNibbles;
+	bool bOverrun;
+};
+
+int32 FKinectDepthCodec::GetMaxCompressedSize(int32 NumPixels)
+{
+	// A 17 bit zigzagged difference takes 6 nibbles, and a pair of run lengths never costs
+	// more than the zero pixels it follows, but for the first pair and the last partial word
+	return NumPixels * 3 + 16;
+}
+
+int32 FKinectDepthCodec::Compress(const uint16 *Depth, int32 NumPixels, TArray<uint8> &OutData)
+{
+	SCOPE_CYCLE_COUNTER(STAT_KinectDepthEncode);
+	OutData.SetNumUninitialized(GetMaxCompressedSize(NumPixels));
+	uint32 *Begin = reinterpret_cast<uint32*>(OutData.GetData());
+	FNibbleWriter Writer(Begin);
+	const uint16 *Pixel = Depth;
+	const uint16 *End = Depth + NumPixels;
+	int32 Previous = 0;
+	while (Pixel != End)
+	{
+		const uint16 *RunStart = Pixel;
+		while (Pixel != End && *Pixel == 0)
+		{
+			Pixel++;
+		}
+		Writer.WriteVarInt(static_cast<uint32>(Pixel - RunStart));
+		RunStart = Pixel;
+		while (Pixel != End && *Pixel != 0)
+		{
+			Pixel++;
+		}
+		Writer.WriteVarInt(static_cast<uint32>(Pixel - RunStart));
+		for (const uint16 *Valid = RunStart; Valid != Pixel; Valid++)
+		{
+			const int32 Delta = *Valid - Previous;
+			Writer.WriteVarInt(static_cast<uint32>((Delta << 1) ^ (Delta >> 31)));
+			Previous = *Valid;
+		}
+	}
+	const int32 Size = static_cast<int32>(reinterpret_cast<uint8*>(Writer.Flush()) - OutData.GetData());
+	OutData.SetNum(Size, false);
+	return Size;
+}
+
+bool FKinectDepthCodec::Decompress(const uint8 *Data, int32 Size, uint16 *OutDepth, int32 NumPixels)
+{
+	SCOPE_CYCLE_COUNTER(STAT_KinectDepthDecode);
+	if (Size % sizeof(uint32) != 0)
+	{
+		return false;
+	}
+	const uint32 *Words = reinterpret_cast<const uint32*>(Data);
+	FNibbleReader Reader(Words, Words + Size / sizeof(uint32));
+	uint16 *Pixel = OutDepth;
+	uint16 *End = OutDepth + NumPixels;
+	int32 Previous = 0;
+	while (Pixel != End)
+	{
+		const uint32 Zeros = Reader.ReadVarInt();
+		const uint32 Valid = Reader.ReadVarInt();
+		// Each run is checked on its own, their sum could wrap around
+		const uint32 Remaining = static_cast<uint32>(End - Pixel);
+		if (Reader.IsOverrun() || (Zeros == 0 && Valid == 0) || Zeros > Remaining || Valid > Remaining - Zeros)
+		{
+			return false;
+		}
+		FMemory::Memzero(Pixel, Zeros * sizeof(uint16));
+		Pixel += Zeros;
+		for (uint32 i = 0; i < Valid; i++)
+		{
+			const uint32 Zigzag = Reader.ReadVarInt();
+			Previous += static_cast<int32>(Zigzag >> 1) ^ -static_cast<int32>(Zigzag & 1);
+			*Pixel++ = static_cast<uint16>(Previous);
+		}
+	}
+	// Runs left over mean the data was compressed from a larger image
+	return !Reader.IsOverrun() && Reader.IsExhausted();
+}
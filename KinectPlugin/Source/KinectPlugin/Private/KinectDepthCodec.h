@@ -0,0 +1,29 @@
+#pragma once
+
+#include "Engine.h"
+
+/**
+ * Lossless depth image compression after Wilson's RVL: the image is coded as
+ * alternating runs of invalid (zero) and valid pixels, and each valid pixel as
+ * the zigzagged difference to the previous valid one. Run lengths and
+ * differences are written as variable length integers of 3 bit groups, one
+ * nibble each, packed into 32 bit words. Kinect depth is mostly smooth surfaces
+ * with holes, so most pixels take a nibble or two; a frame compresses to
+ * about a quarter of its size in roughly a millisecond on one core.
+ */
+class FKinectDepthCodec
+{
+public:
+	/** Upper bound of the compressed size of NumPixels pixels, in bytes. */
+	static int32 GetMaxCompressedSize(int32 NumPixels);
+
+	/** Replaces OutData with the compressed Depth; returns its size in bytes. */
+	static int32 Compress(const uint16 *Depth, int32 NumPixels, TArray<uint8> &OutData);
+
+	/**
+	 * Decompresses Size bytes at Data into NumPixels pixels at OutDepth.
+	 *
+	 * @return false if the data is cut short or does not hold exactly NumPixels pixels.
+	 */
+	static bool Decompress(const uint8 *Data, int32 Size, uint16 *OutDepth, int32 NumPixels);
+};
@@ -0,0 +1,380 @@
+#include "KinectPluginPrivatePCH.h"
+#include "KinectDepthMesher.h"
+#include "AllowWindowsPlatformTypes.h"
+#include "ppl.h"
+#include "HideWindowsPlatformTypes.h"
+
+FKinectDepthMesher::FKinectDepthMesher()
+	: TopologySerial(0)
+	, TiledTileQuads(0)
+{
+}
+
+FKinectDepthMesher::FGrid FKinectDepthMesher::MakeGrid(const FKinectDepthMeshInput &Input, const FKinectDepthMeshSettings &Settings)
+{
+	FGrid Grid;
+	Grid.Step = FMath::Max(1, Settings.Step);
+	Grid.StartX = FMath::RoundToInt((Input.Width - FMath::Clamp(Settings.ViewportWidth, 0.0f, 1.0f) * Input.Width) / 2.0f);
+	Grid.StartY = FMath::RoundToInt((Input.Height - FMath::Clamp(Settings.ViewportHeight, 0.0f, 1.0f) * Input.Height) / 2.0f);
+	const int32 EndX = Input.Width - Grid.Step - Grid.StartX;
+	const int32 EndY = Input.Height - Grid.Step - Grid.StartY;
+	Grid.QuadsX = EndX > Grid.StartX ? (EndX - Grid.StartX + Grid.Step - 1) / Grid.Step : 0;
+	Grid.QuadsY = EndY > Grid.StartY ? (EndY - Grid.StartY + Grid.Step - 1) / Grid.Step : 0;
+	return Grid;
+}
+
+void FKinectDepthMesher::SampleRow(const FKinectDepthMeshInput &Input, const FKinectDepthMeshSettings &Settings,
+	int32 Y, int32 X0, int32 Count, FVector *Positions, FColor *Colors, bool *Valid, float *Distances)
+{
+	const int32 Step = FMath::Max(1, Settings.Step);
+	const int32 RowStart = Y * Input.Width;
+	Input.Unprojector->UnprojectRow(Input.Depth + RowStart, Y, X0, Step, Count, Positions, Distances);
+	for (int32 i = 0; i < Count; i++)
+	{
+		const int32 Index = RowStart + X0 + i * Step;
+		bool skip = false;
+		if (Input.BodyIndex != nullptr)
+		{
+			const uint8 index = Input.BodyIndex[Index];
+			const TArray<bool> &Mask = *Input.BodyIndexMask;
+			skip = index == 255 || index >= Mask.Num() || !Mask[index];
+		}
+		const float dist = Distances[i];
+		Valid[i] = !skip && dist > Settings.MinDistanceInMeters && dist <= Settings.MaxDistanceInMeters &&
+			Input.Color[Index].A != 0;
+		Colors[i] = Input.Color[Index];
+	}
+}
+
+bool FKinectDepthMesher::IsQuadValid(const FKinectDepthMeshSettings &Settings,
+	const FVector &P00, const FVector &P01, const FVector &P10, const FVector &P11)
+{
+	const float max_edge_len = Settings.MaxEdgeLength;
+	return (P00.X > 0) && (P01.X > 0) && (P10.X > 0) && (P11.X > 0) && // check for non valid values
+		(FMath::Abs(P00.X - P01.X) < max_edge_len) &&
+		(FMath::Abs(P10.X - P01.X) < max_edge_len) &&
+		(FMath::Abs(P11.X - P01.X) < max_edge_len);
+}
+
+void FKinectDepthMesher::Triangulate(const FKinectDepthMeshInput &Input, const FKinectDepthMeshSettings &Settings, FKinectMeshBuffers &Out)
+{
+	check(Input.Depth && Input.Color && Input.Unprojector && Input.Unprojector->IsValid());
+	check(Input.BodyIndex == nullptr || Input.BodyIndexMask != nullptr);
+	const FGrid Grid = MakeGrid(Input, Settings);
+	TiledGrid = FGrid();
+	if (Grid.QuadsX == 0 || Grid.QuadsY == 0)
+	{
+		Out.Reset();
+		Out.TopologySerial = ++TopologySerial;
+		return;
+	}
+	if (Settings.bWeldGridVertices)
+	{
+		TriangulateWeldedGrid(Input, Settings, Grid, Out);
+	}
+	else
+	{
+		TriangulateQuads(Input, Settings, Grid, Out);
+	}
+}
+
+void FKinectDepthMesher::TriangulateRect(const FKinectDepthMeshInput &Input, const FKinectDepthMeshSettings &Settings, const FGrid &Grid,
+	int32 FirstQuadX, int32 EndQuadX, int32 FirstQuadY, int32 EndQuadY, FRowScratch &Scratch,
+	TArray<FVector> &Vertices, TArray<FColor> &Colors, TArray<int32> &Triangles)
+{
+	Vertices.Reset();
+	Colors.Reset();
+	Triangles.Reset();
+
+	// Each sampled row is unprojected once and shared by the quads above and below it
+	const int32 QuadsX = EndQuadX - FirstQuadX;
+	const int32 Columns = QuadsX + 1;
+	const int32 X0 = Grid.StartX + FirstQuadX * Grid.Step;
+	for (int32 Row = 0; Row < 2; Row++)
+	{
+		Scratch.RowPositions[Row].SetNumUninitialized(Columns);
+		Scratch.RowColors[Row].SetNumUninitialized(Columns);
+		Scratch.RowValid[Row].SetNumUninitialized(Columns);
+	}
+	Scratch.RowDistances.SetNumUninitialized(Columns);
+	int32 Top = 0;
+	SampleRow(Input, Settings, Grid.StartY + FirstQuadY * Grid.Step, X0, Columns,
+		Scratch.RowPositions[Top].GetData(), Scratch.RowColors[Top].GetData(), Scratch.RowValid[Top].GetData(), Scratch.RowDistances.GetData());
+
+	for (int32 qy = FirstQuadY; qy < EndQuadY; qy++)
+	{
+		const int32 Bottom = 1 - Top;
+		const int32 y = Grid.StartY + qy * Grid.Step;
+		SampleRow(Input, Settings, y + Grid.Step, X0, Columns,
+			Scratch.RowPositions[Bottom].GetData(), Scratch.RowColors[Bottom].GetData(), Scratch.RowValid[Bottom].GetData(), Scratch.RowDistances.GetData());
+		const FVector *PTop = Scratch.RowPositions[Top].GetData();
+		const FVector *PBottom = Scratch.RowPositions[Bottom].GetData();
+		const FColor *CTop = Scratch.RowColors[Top].GetData();
+		const FColor *CBottom = Scratch.RowColors[Bottom].GetData();
+		const bool *VTop = Scratch.RowValid[Top].GetData();
+		const bool *VBottom = Scratch.RowValid[Bottom].GetData();
+
+		for (int32 qx = 0; qx < QuadsX; qx++)
+		{
+			// P[ix][iy] is the corner at (x + ix * step, y + iy * step)
+			if (!(VTop[qx] && VTop[qx + 1] && VBottom[qx] && VBottom[qx + 1]) ||
+				!IsQuadValid(Settings, PTop[qx], PBottom[qx], PTop[qx + 1], PBottom[qx + 1]))
+			{
+				continue;
+			}
+			const int32 Next = Vertices.Num();
+			Vertices.Add(PTop[qx]);
+			Vertices.Add(PBottom[qx]);
+			Vertices.Add(PTop[qx + 1]);
+			Vertices.Add(PBottom[qx + 1]);
+
+			Triangles.Add(Next);
+			Triangles.Add(Next + 1);
+			Triangles.Add(Next + 2);
+			Triangles.Add(Next + 1);
+			Triangles.Add(Next + 3);
+			Triangles.Add(Next + 2);
+
+			Colors.Add(CTop[qx]);
+			Colors.Add(CBottom[qx]);
+			Colors.Add(CTop[qx + 1]);
+			Colors.Add(CBottom[qx + 1]);
+		}
+		Top = Bottom;
+	}
+}
+
+void FKinectDepthMesher::TriangulateQuads(const FKinectDepthMeshInput &Input, const FKinectDepthMeshSettings &Settings, const FGrid &Grid, FKinectMeshBuffers &Out)
+{
+	WeldedGrid = FGrid();
+
+	// A few bands per core keeps the workers busy when some bands are mostly empty
+	const int32 NumBands = FMath::Clamp(FPlatformMisc::NumberOfCoresIncludingHyperthreads() * 2, 1, Grid.QuadsY);
+	if (Bands.Num() < NumBands)
+	{
+		Bands.SetNum(NumBands);
+	}
+	Concurrency::parallel_for(0, NumBands, [&](int b)
+	{
+		const int32 FirstQuadRow = Grid.QuadsY * b / NumBands;
+		const int32 EndQuadRow = Grid.QuadsY * (b + 1) / NumBands;
+		FBand &Band = Bands[b];
+		TriangulateRect(Input, Settings, Grid, 0, Grid.QuadsX, FirstQuadRow, EndQuadRow, Band.Scratch, Band.Vertices, Band.Colors, Band.Triangles);
+	});
+
+	// Prefix sums place every band's output right after the previous band's
+	BandFirstVertex.SetNumUninitialized(NumBands);
+	BandFirstIndex.SetNumUninitialized(NumBands);
+	int32 NumVertices = 0;
+	int32 NumIndices = 0;
+	for (int32 b = 0; b < NumBands; b++)
+	{
+		BandFirstVertex[b] = NumVertices;
+		BandFirstIndex[b] = NumIndices;
+		NumVertices += Bands[b].Vertices.Num();
+		NumIndices += Bands[b].Triangles.Num();
+	}
+	Out.Vertices.SetNumUninitialized(NumVertices);
+	Out.Colors.SetNumUninitialized(NumVertices);
+	Out.Triangles.SetNumUninitialized(NumIndices);
+	Concurrency::parallel_for(0, NumBands, [&](int b)
+	{
+		const FBand &Band = Bands[b];
+		const int32 FirstVertex = BandFirstVertex[b];
+		FMemory::Memcpy(Out.Vertices.GetData() + FirstVertex, Band.Vertices.GetData(), Band.Vertices.Num() * sizeof(FVector));
+		FMemory::Memcpy(Out.Colors.GetData() + FirstVertex, Band.Colors.GetData(), Band.Colors.Num() * sizeof(FColor));
+		int32 *Indices = Out.Triangles.GetData() + BandFirstIndex[b];
+		for (int32 i = 0; i < Band.Triangles.Num(); i++)
+		{
+			Indices[i] = Band.Triangles[i] + FirstVertex;
+		}
+	});
+	Out.TopologySerial = ++TopologySerial;
+	Out.IndexPattern = EKinectMeshIndexPattern::Quads;
+}
+
+void FKinectDepthMesher::TriangulateWeldedGrid(const FKinectDepthMeshInput &Input, const FKinectDepthMeshSettings &Settings, const FGrid &Grid, FKinectMeshBuffers &Out)
+{
+	const int32 Columns = Grid.QuadsX + 1;
+	const int32 Rows = Grid.QuadsY + 1;
+	const int32 NumQuads = Grid.QuadsX * Grid.QuadsY;
+	if (!(WeldedGrid == Grid))
+	{
+		// Built once per grid; every quad starts out collapsed
+		WeldedGrid = Grid;
+		GridTriangles.SetNumZeroed(NumQuads * 6);
+		GridQuadValid.Init(false, NumQuads);
+		for (int32 q = 0; q < NumQuads; q++)
+		{
+			const int32 Corner = (q / Grid.QuadsX) * Columns + q % Grid.QuadsX;
+			for (int32 k = 0; k < 6; k++)
+			{
+				GridTriangles[q * 6 + k] = Corner;
+			}
+		}
+		TopologySerial++;
+	}
+	Out.Vertices.SetNumUninitialized(Columns * Rows);
+	Out.Colors.SetNumUninitialized(Columns * Rows);
+	GridVertexValid.SetNumUninitialized(Columns * Rows);
+
+	FVector *Positions = Out.Vertices.GetData();
+	FColor *Colors = Out.Colors.GetData();
+	bool *VertexValid = GridVertexValid.GetData();
+	Concurrency::combinable<TArray<float>> Distances;
+	Concurrency::parallel_for(0, Rows, [&](int Row)
+	{
+		TArray<float> &RowDistance = Distances.local();
+		RowDistance.SetNumUninitialized(Columns);
+		const int32 First = Row * Columns;
+		SampleRow(Input, Settings, Grid.StartY + Row * Grid.Step, Grid.StartX, Columns,
+			Positions + First, Colors + First, VertexValid + First, RowDistance.GetData());
+		for (int32 i = First; i < First + Columns; i++)
+		{
+			if (!VertexValid[i])
+			{
+				Positions[i] = FVector::ZeroVector;
+			}
+		}
+	});
+
+	int32 *Indices = GridTriangles.GetData();
+	bool *QuadValid = GridQuadValid.GetData();
+	FThreadSafeCounter ChangedQuads;
+	Concurrency::parallel_for(0, Grid.QuadsY, [&](int qy)
+	{
+		for (int32 qx = 0; qx < Grid.QuadsX; qx++)
+		{
+			const int32 i00 = qy * Columns + qx;
+			const int32 i01 = i00 + Columns;
+			const int32 i10 = i00 + 1;
+			const int32 i11 = i01 + 1;
+			const bool bValid = VertexValid[i00] && VertexValid[i01] && VertexValid[i10] && VertexValid[i11] &&
+				IsQuadValid(Settings, Positions[i00], Positions[i01], Positions[i10], Positions[i11]);
+			const int32 q = qy * Grid.QuadsX + qx;
+			if (bValid == QuadValid[q])
+			{
+				continue;
+			}
+			QuadValid[q] = bValid;
+			int32 *Quad = Indices + q * 6;
+			if (bValid)
+			{
+				Quad[0] = i00;
+				Quad[1] = i01;
+				Quad[2] = i10;
+				Quad[3] = i01;
+				Quad[4] = i11;
+				Quad[5] = i10;
+			}
+			else
+			{
+				for (int32 k = 0; k < 6; k++)
+				{
+					Quad[k] = i00;
+				}
+			}
+			ChangedQuads.Increment();
+		}
+	});
+	if (ChangedQuads.GetValue() > 0)
+	{
+		TopologySerial++;
+	}
+	Out.IndexPattern = EKinectMeshIndexPattern::Explicit;
+	if (Out.TopologySerial != TopologySerial)
+	{
+		Out.Triangles = GridTriangles;
+		Out.TopologySerial = TopologySerial;
+	}
+}
+
+float FKinectDepthMesher::MeasureTileChange(const FKinectDepthMeshInput &Input, const FGrid &Grid, const FTile &Tile, TArray<uint16> &SampledDepth)
+{
+	const int32 Columns = Tile.EndQuadX - Tile.FirstQuadX + 1;
+	const int32 Rows = Tile.EndQuadY - Tile.FirstQuadY + 1;
+	SampledDepth.SetNumUninitialized(Columns * Rows);
+	const bool bCompare = Tile.TriangulatedDepth.Num() == SampledDepth.Num();
+	uint32 Change = 0;
+	int32 Sample = 0;
+	for (int32 Row = 0; Row < Rows; Row++)
+	{
+		const int32 Y = Grid.StartY + (Tile.FirstQuadY + Row) * Grid.Step;
+		for (int32 Column = 0; Column < Columns; Column++, Sample++)
+		{
+			const int32 Index = Y * Input.Width + Grid.StartX + (Tile.FirstQuadX + Column) * Grid.Step;
+			uint16 Depth = Input.Depth[Index];
+			if (Input.BodyIndex != nullptr)
+			{
+				const uint8 index = Input.BodyIndex[Index];
+				const TArray<bool> &Mask = *Input.BodyIndexMask;
+				if (index == 255 || index >= Mask.Num() || !Mask[index])
+				{
+					Depth = 0;
+				}
+			}
+			SampledDepth[Sample] = Depth;
+			if (bCompare)
+			{
+				Change += FMath::Abs(static_cast<int32>(Depth) - static_cast<int32>(Tile.TriangulatedDepth[Sample]));
+			}
+		}
+	}
+	return bCompare ? static_cast<float>(Change) / SampledDepth.Num() : MAX_FLT;
+}
+
+bool FKinectDepthMesher::TriangulateTiles(const FKinectDepthMeshInput &Input, const FKinectDepthMeshSettings &Settings, TArray<FKinectMeshBuffers> &OutTiles, TArray<int32> &OutDirtyTiles)
+{
+	check(Input.Depth && Input.Color && Input.Unprojector && Input.Unprojector->IsValid());
+	check(Input.BodyIndex == nullptr || Input.BodyIndexMask != nullptr);
+	OutDirtyTiles.Reset();
+	WeldedGrid = FGrid();
+	const FGrid Grid = MakeGrid(Input, Settings);
+	const int32 TileQuads = FMath::Max(1, Settings.TileSize / Grid.Step);
+	const bool bLayoutChanged = !(TiledGrid == Grid) || TiledTileQuads != TileQuads || OutTiles.Num() != Tiles.Num();
+	if (bLayoutChanged)
+	{
+		TiledGrid = Grid;
+		TiledTileQuads = TileQuads;
+		Tiles.Reset();
+		for (int32 FirstQuadY = 0; FirstQuadY < Grid.QuadsY; FirstQuadY += TileQuads)
+		{
+			for (int32 FirstQuadX = 0; FirstQuadX < Grid.QuadsX; FirstQuadX += TileQuads)
+			{
+				FTile &Tile = Tiles[Tiles.AddDefaulted()];
+				Tile.FirstQuadX = FirstQuadX;
+				Tile.EndQuadX = FMath::Min(FirstQuadX + TileQuads, Grid.QuadsX);
+				Tile.FirstQuadY = FirstQuadY;
+				Tile.EndQuadY = FMath::Min(FirstQuadY + TileQuads, Grid.QuadsY);
+			}
+		}
+		OutTiles.SetNum(Tiles.Num());
+	}
+	TileDirty.SetNumUninitialized(Tiles.Num());
+
+	Concurrency::combinable<FRowScratch> Scratch;
+	Concurrency::combinable<TArray<uint16>> SampledDepth;
+	Concurrency::parallel_for(0, Tiles.Num(), [&](int t)
+	{
+		FTile &Tile = Tiles[t];
+		TArray<uint16> &Sampled = SampledDepth.local();
+		TileDirty[t] = MeasureTileChange(Input, Grid, Tile, Sampled) > Settings.TileChangeThreshold;
+		if (TileDirty[t])
+		{
+			FKinectMeshBuffers &Out = OutTiles[t];
+			TriangulateRect(Input, Settings, Grid, Tile.FirstQuadX, Tile.EndQuadX, Tile.FirstQuadY, Tile.EndQuadY, Scratch.local(),
+				Out.Vertices, Out.Colors, Out.Triangles);
+			Exchange(Tile.TriangulatedDepth, Sampled);
+		}
+	});
+	for (int32 t = 0; t < Tiles.Num(); t++)
+	{
+		if (TileDirty[t])
+		{
+			OutTiles[t].TopologySerial = ++TopologySerial;
+			OutTiles[t].IndexPattern = EKinectMeshIndexPattern::Quads;
+			OutDirtyTiles.Add(t);
+		}
+	}
+	return bLayoutChanged;
+}
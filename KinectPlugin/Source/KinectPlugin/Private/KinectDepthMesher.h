@@ -0,0 +1,186 @@
+#pragma once
+
+#include "Engine.h"
+#include "KinectDepthUnprojector.h"
+#include "KinectMeshBuffers.h"
+
+/** Per frame inputs of FKinectDepthMesher. All images are depth aligned. */
+struct FKinectDepthMeshInput
+{
+	const uint16 *Depth;
+	/** Optional body index image. Pixels of bodies not enabled in BodyIndexMask are dropped. */
+	const uint8 *BodyIndex;
+	const TArray<bool> *BodyIndexMask;
+	/** Registered color, alpha 0 where the depth pixel has no color. */
+	const FColor *Color;
+	const FKinectDepthUnprojector *Unprojector;
+	int32 Width;
+	int32 Height;
+
+	FKinectDepthMeshInput()
+		: Depth(nullptr)
+		, BodyIndex(nullptr)
+		, BodyIndexMask(nullptr)
+		, Color(nullptr)
+		, Unprojector(nullptr)
+		, Width(0)
+		, Height(0)
+	{
+	}
+};
+
+struct FKinectDepthMeshSettings
+{
+	/** Distance in depth pixels between sampled points. */
+	int32 Step;
+	/** Fraction of the depth image, centered, that is triangulated. */
+	float ViewportWidth;
+	float ViewportHeight;
+	float MinDistanceInMeters;
+	float MaxDistanceInMeters;
+	/** Quads whose corners differ by this much in depth (centimeters) are cut. */
+	int32 MaxEdgeLength;
+	/** One vertex per sampled pixel and a persistent index buffer, instead of four vertices per quad. */
+	bool bWeldGridVertices;
+	/** Edge length in depth pixels of the tiles used by TriangulateTiles. */
+	int32 TileSize;
+	/** Mean change in millimeters of a tile's sampled depth that makes it dirty. */
+	float TileChangeThreshold;
+
+	FKinectDepthMeshSettings()
+		: Step(2)
+		, ViewportWidth(1.0f)
+		, ViewportHeight(1.0f)
+		, MinDistanceInMeters(0.0f)
+		, MaxDistanceInMeters(2.0f)
+		, MaxEdgeLength(8)
+		, bWeldGridVertices(false)
+		, TileSize(64)
+		, TileChangeThreshold(4.0f)
+	{
+	}
+};
+
+/**
+ * Triangulates depth images into a colored height field mesh.
+ *
+ * The default layout emits four vertices per accepted quad. Rows of quads are
+ * split into bands that are triangulated in parallel and concatenated in band
+ * order, so the output does not depend on scheduling. The welded grid
+ * layout keeps one vertex per sampled pixel at a fixed slot and an index buffer
+ * that is only built when the grid size changes; quads that are rejected are
+ * collapsed to degenerate triangles in place, so while no quad changes state
+ * a frame only rewrites positions and colors.
+ *
+ * The tiled layout cuts the viewport into fixed tiles with one mesh buffer
+ * each, and only triangulates the tiles whose depth moved since they were last
+ * triangulated.
+ */
+class FKinectDepthMesher
+{
+public:
+	FKinectDepthMesher();
+
+	void Triangulate(const FKinectDepthMeshInput &Input, const FKinectDepthMeshSettings &Settings, FKinectMeshBuffers &Out);
+
+	/**
+	 * Triangulates the tiles whose sampled depth changed by more than
+	 * Settings.TileChangeThreshold on average since their last triangulation,
+	 * into OutTiles[Tile], and lists them in OutDirtyTiles. Pixels dropped by the
+	 * body index mask count as no depth, so bodies moving in or out dirty a tile.
+	 *
+	 * @return true if the tile layout changed, in which case every tile is dirty and OutTiles was resized.
+	 */
+	bool TriangulateTiles(const FKinectDepthMeshInput &Input, const FKinectDepthMeshSettings &Settings, TArray<FKinectMeshBuffers> &OutTiles, TArray<int32> &OutDirtyTiles);
+
+private:
+	/** Sampled grid covered by the viewport. */
+	struct FGrid
+	{
+		int32 StartX;
+		int32 StartY;
+		int32 Step;
+		int32 QuadsX;
+		int32 QuadsY;
+
+		FGrid()
+			: StartX(0)
+			, StartY(0)
+			, Step(0)
+			, QuadsX(0)
+			, QuadsY(0)
+		{
+		}
+
+		bool operator==(const FGrid &Other) const
+		{
+			return StartX == Other.StartX && StartY == Other.StartY && Step == Other.Step && QuadsX == Other.QuadsX && QuadsY == Other.QuadsY;
+		}
+	};
+
+	static FGrid MakeGrid(const FKinectDepthMeshInput &Input, const FKinectDepthMeshSettings &Settings);
+
+	/** Unprojects and colors Count points of row Y. Rejected points are flagged in Valid. */
+	static void SampleRow(const FKinectDepthMeshInput &Input, const FKinectDepthMeshSettings &Settings,
+		int32 Y, int32 X0, int32 Count, FVector *Positions, FColor *Colors, bool *Valid, float *Distances);
+
+	static bool IsQuadValid(const FKinectDepthMeshSettings &Settings,
+		const FVector &P00, const FVector &P01, const FVector &P10, const FVector &P11);
+
+	/** Two sampled rows, the top and bottom edge of the quads being triangulated. */
+	struct FRowScratch
+	{
+		TArray<FVector> RowPositions[2];
+		TArray<FColor> RowColors[2];
+		TArray<bool> RowValid[2];
+		TArray<float> RowDistances;
+	};
+
+	/** Output and scratch of one band of quad rows, triangulated by a single worker. */
+	struct FBand
+	{
+		TArray<FVector> Vertices;
+		TArray<FColor> Colors;
+		/** Indices relative to the band's first vertex. */
+		TArray<int32> Triangles;
+		FRowScratch Scratch;
+	};
+
+	/** A tile of the tiled layout and the depth it was last triangulated from. */
+	struct FTile
+	{
+		int32 FirstQuadX;
+		int32 EndQuadX;
+		int32 FirstQuadY;
+		int32 EndQuadY;
+		TArray<uint16> TriangulatedDepth;
+	};
+
+	/** Triangulates quads [FirstQuadX, EndQuadX) x [FirstQuadY, EndQuadY) in the four vertices per quad layout. */
+	static void TriangulateRect(const FKinectDepthMeshInput &Input, const FKinectDepthMeshSettings &Settings, const FGrid &Grid,
+		int32 FirstQuadX, int32 EndQuadX, int32 FirstQuadY, int32 EndQuadY, FRowScratch &Scratch,
+		TArray<FVector> &Vertices, TArray<FColor> &Colors, TArray<int32> &Triangles);
+
+	/** Samples the tile's depth grid, masked by body index, and returns the mean change against the last triangulation. */
+	static float MeasureTileChange(const FKinectDepthMeshInput &Input, const FGrid &Grid, const FTile &Tile, TArray<uint16> &SampledDepth);
+
+	void TriangulateQuads(const FKinectDepthMeshInput &Input, const FKinectDepthMeshSettings &Settings, const FGrid &Grid, FKinectMeshBuffers &Out);
+	void TriangulateWeldedGrid(const FKinectDepthMeshInput &Input, const FKinectDepthMeshSettings &Settings, const FGrid &Grid, FKinectMeshBuffers &Out);
+
+	uint32 TopologySerial;
+
+	TArray<FBand> Bands;
+	/** Tiled layout state: the grid and tile size the tiles were cut for. */
+	FGrid TiledGrid;
+	int32 TiledTileQuads;
+	TArray<FTile> Tiles;
+	TArray<bool> TileDirty;
+	TArray<int32> BandFirstVertex;
+	TArray<int32> BandFirstIndex;
+
+	/** Welded grid state: the grid the index buffer was built for, the index buffer and which quads it currently draws. */
+	FGrid WeldedGrid;
+	TArray<int32> GridTriangles;
+	TArray<bool> GridQuadValid;
+	TArray<bool> GridVertexValid;
+};
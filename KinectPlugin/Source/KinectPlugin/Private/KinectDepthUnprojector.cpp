@@ -0,0 +1,161 @@
+#include "KinectPluginPrivatePCH.h"
+#include "KinectDepthUnprojector.h"
+#include "KinectSimd.h"
+#if PLATFORM_WINDOWS
+#include "AllowWindowsPlatformTypes.h"
+#include "Kinect.h"
+#include "HideWindowsPlatformTypes.h"
+#endif
+
+FKinectSyntheticDepthIntrinsics::FKinectSyntheticDepthIntrinsics(float InFocalLengthX, float InFocalLengthY, float InPrincipalPointX, float InPrincipalPointY)
+	: FocalLengthX(InFocalLengthX)
+	, FocalLengthY(InFocalLengthY)
+	, PrincipalPointX(InPrincipalPointX)
+	, PrincipalPointY(InPrincipalPointY)
+{
+}
+
+bool FKinectSyntheticDepthIntrinsics::GetDepthRays(int32 Width, int32 Height, TArray<FVector2D> &OutRays)
+{
+	if (FocalLengthX <= 0.0f || FocalLengthY <= 0.0f)
+	{
+		return false;
+	}
+	OutRays.SetNumUninitialized(Width * Height);
+	for (int32 y = 0; y < Height; y++)
+	{
+		for (int32 x = 0; x < Width; x++)
+		{
+			// Image rows go down, camera space Y goes up
+			OutRays[y * Width + x] = FVector2D((x - PrincipalPointX) / FocalLengthX, (PrincipalPointY - y) / FocalLengthY);
+		}
+	}
+	return true;
+}
+
+#if PLATFORM_WINDOWS
+bool FKinectCoordinateMapperIntrinsics::GetDepthRays(int32 Width, int32 Height, TArray<FVector2D> &OutRays)
+{
+	if (Mapper == nullptr)
+	{
+		return false;
+	}
+	UINT32 Count = 0;
+	PointF *Table = nullptr;
+	HRESULT hResult = Mapper->GetDepthFrameToCameraSpaceTable(&Count, &Table);
+	if (FAILED(hResult) || Table == nullptr || Count != static_cast<UINT32>(Width * Height))
+	{
+		if (Table != nullptr)
+		{
+			CoTaskMemFree(Table);
+		}
+		return false;
+	}
+	// The table stays zeroed until the sensor has reported its calibration
+	bool bCalibrated = false;
+	OutRays.SetNumUninitialized(Count);
+	for (UINT32 i = 0; i < Count; i++)
+	{
+		OutRays[i] = FVector2D(Table[i].X, Table[i].Y);
+		bCalibrated |= Table[i].X != 0.0f;
+	}
+	CoTaskMemFree(Table);
+	return bCalibrated;
+}
+#endif
+
+FKinectDepthUnprojector::FKinectDepthUnprojector()
+	: Width(0)
+	, Height(0)
+{
+}
+
+bool FKinectDepthUnprojector::Rebuild(IKinectDepthIntrinsics &Intrinsics, int32 InWidth, int32 InHeight)
+{
+	Invalidate();
+	TArray<FVector2D> Rays;
+	if (InWidth <= 0 || InHeight <= 0 || !Intrinsics.GetDepthRays(InWidth, InHeight, Rays))
+	{
+		return false;
+	}
+	const int32 Num = InWidth * InHeight;
+	RayX.SetNumUninitialized(Num);
+	RayY.SetNumUninitialized(Num);
+	RayLength.SetNumUninitialized(Num);
+	for (int32 i = 0; i < Num; i++)
+	{
+		const FVector2D &Ray = Rays[i];
+		RayX[i] = Ray.X;
+		RayY[i] = Ray.Y;
+		RayLength[i] = FMath::Sqrt(1.0f + Ray.X * Ray.X + Ray.Y * Ray.Y);
+	}
+	Width = InWidth;
+	Height = InHeight;
+	return true;
+}
+
+void FKinectDepthUnprojector::UnprojectRow(const uint16 *DepthRow, int32 Y, int32 X0, int32 Step, int32 Count, FVector *OutPositions, float *OutDistances) const
+{
+	check(IsValid() && Y >= 0 && Y < Height);
+	check(Count <= 0 || (X0 >= 0 && X0 + (Count - 1) * Step < Width));
+	const float *RowX = RayX.GetData() + Y * Width;
+	const float *RowY = RayY.GetData() + Y * Width;
+	const float *RowLength = RayLength.GetData() + Y * Width;
+	// millimeters to centimeters, and to meters for the distance
+	const float ToCentimeters = 0.1f;
+	const float ToMeters = 0.001f;
+
+	int32 i = 0;
+	int32 x = X0;
+#if KINECT_SIMD_SSE
+	const __m128 Centimeters = _mm_set1_ps(ToCentimeters);
+	const __m128 Meters = _mm_set1_ps(ToMeters);
+	for (; i + 4 <= Count; i += 4, x += 4 * Step)
+	{
+		const int32 x1 = x + Step;
+		const int32 x2 = x1 + Step;
+		const int32 x3 = x2 + Step;
+		__m128 Depth;
+		__m128 Rx;
+		__m128 Ry;
+		__m128 Length;
+		if (Step == 1)
+		{
+			const __m128i Raw = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(DepthRow + x));
+			Depth = _mm_cvtepi32_ps(_mm_unpacklo_epi16(Raw, _mm_setzero_si128()));
+			Rx = _mm_loadu_ps(RowX + x);
+			Ry = _mm_loadu_ps(RowY + x);
+			Length = _mm_loadu_ps(RowLength + x);
+		}
+		else
+		{
+			Depth = _mm_setr_ps(DepthRow[x], DepthRow[x1], DepthRow[x2], DepthRow[x3]);
+			Rx = _mm_setr_ps(RowX[x], RowX[x1], RowX[x2], RowX[x3]);
+			Ry = _mm_setr_ps(RowY[x], RowY[x1], RowY[x2], RowY[x3]);
+			Length = _mm_setr_ps(RowLength[x], RowLength[x1], RowLength[x2], RowLength[x3]);
+		}
+		const __m128 Forward = _mm_mul_ps(Depth, Centimeters);
+		const __m128 Right = _mm_mul_ps(Forward, Rx);
+		const __m128 Up = _mm_mul_ps(Forward, Ry);
+		_mm_storeu_ps(OutDistances + i, _mm_mul_ps(_mm_mul_ps(Depth, Meters), Length));
+
+		float F[4];
+		float R[4];
+		float U[4];
+		_mm_storeu_ps(F, Forward);
+		_mm_storeu_ps(R, Right);
+		_mm_storeu_ps(U, Up);
+		for (int32 Lane = 0; Lane < 4; Lane++)
+		{
+			OutPositions[i + Lane] = FVector(F[Lane], R[Lane], U[Lane]);
+		}
+	}
+#endif
+	for (; i < Count; i++, x += Step)
+	{
+		const float Depth = DepthRow[x];
+		const float Forward = Depth * ToCentimeters;
+		OutPositions[i] = FVector(Forward, Forward * RowX[x], Forward * RowY[x]);
+		OutDistances[i] = Depth * ToMeters * RowLength[x];
+	}
+}
@@ -0,0 +1,110 @@
+#pragma once
+
+#include "Core.h"
+
+/**
+ * Source of the depth camera rays used to unproject depth images. The live
+ * implementation reads them from the sensor's coordinate mapper; the synthetic
+ * one lets the unprojection run without a sensor.
+ */
+class IKinectDepthIntrinsics
+{
+public:
+	virtual ~IKinectDepthIntrinsics() {}
+
+	/**
+	 * Fills OutRays with one entry per depth pixel, row major, holding the X/Y
+	 * camera space coordinates of the pixel's ray at a depth of one meter.
+	 *
+	 * @return false if the intrinsics are not available (yet).
+	 */
+	virtual bool GetDepthRays(int32 Width, int32 Height, TArray<FVector2D> &OutRays) = 0;
+};
+
+/**
+ * Pinhole intrinsics given in pixels. Defaults are the nominal Kinect v2 depth
+ * camera values.
+ */
+class FKinectSyntheticDepthIntrinsics : public IKinectDepthIntrinsics
+{
+public:
+	FKinectSyntheticDepthIntrinsics(float InFocalLengthX = 365.26f, float InFocalLengthY = 365.12f, float InPrincipalPointX = 256.0f, float InPrincipalPointY = 212.0f);
+
+	virtual bool GetDepthRays(int32 Width, int32 Height, TArray<FVector2D> &OutRays) override;
+
+private:
+	float FocalLengthX;
+	float FocalLengthY;
+	float PrincipalPointX;
+	float PrincipalPointY;
+};
+
+#if PLATFORM_WINDOWS
+/** Reads the depth rays from the sensor calibration via ICoordinateMapper::GetDepthFrameToCameraSpaceTable. */
+class FKinectCoordinateMapperIntrinsics : public IKinectDepthIntrinsics
+{
+public:
+	explicit FKinectCoordinateMapperIntrinsics(struct ICoordinateMapper *InMapper)
+		: Mapper(InMapper)
+	{
+	}
+
+	virtual bool GetDepthRays(int32 Width, int32 Height, TArray<FVector2D> &OutRays) override;
+
+private:
+	struct ICoordinateMapper *Mapper;
+};
+#endif
+
+/**
+ * Cached unprojection table for the depth camera. Turns whole rows of raw depth
+ * (millimeters) into camera space points without a coordinate mapper call per
+ * pixel. Rebuild it once the intrinsics are known and whenever the coordinate
+ * mapping changes.
+ */
+class FKinectDepthUnprojector
+{
+public:
+	FKinectDepthUnprojector();
+
+	bool Rebuild(IKinectDepthIntrinsics &Intrinsics, int32 InWidth, int32 InHeight);
+
+	void Invalidate()
+	{
+		Width = 0;
+		Height = 0;
+	}
+
+	bool IsValid() const
+	{
+		return Width > 0 && Height > 0;
+	}
+
+	int32 GetWidth() const
+	{
+		return Width;
+	}
+
+	int32 GetHeight() const
+	{
+		return Height;
+	}
+
+	/**
+	 * Unprojects Count pixels of row Y, starting at column X0 and advancing Step
+	 * columns each time. Positions are in Unreal units and axes (centimeters,
+	 * X forward, Y right, Z up), distances are to the sensor in meters.
+	 *
+	 * @param DepthRow Start of row Y of the depth image.
+	 */
+	void UnprojectRow(const uint16 *DepthRow, int32 Y, int32 X0, int32 Step, int32 Count, FVector *OutPositions, float *OutDistances) const;
+
+private:
+	int32 Width;
+	int32 Height;
+
+	/** Per pixel ray at one meter, and its length, stored as separate planes. */
+	TArray<float> RayX;
+	TArray<float> RayY;
+	TArray<float> RayLength;
+};
@@ -0,0 +1,55 @@
+#include "KinectPluginPrivatePCH.h"
+#include "KinectFrameBuffer.h"
+
+static volatile int64 GKinectFrameBufferSequence = 0;
+
+FKinectFrameBufferPool::FFreeList::FFreeList(int32 InMaxBuffers)
+	: MaxBuffers(InMaxBuffers)
+{
+}
+
+FKinectFrameBufferPool::FFreeList::~FFreeList()
+{
+	for (int32 i = 0; i < Buffers.Num(); i++)
+	{
+		delete Buffers[i];
+	}
+}
+
+FKinectFrameBuffer *FKinectFrameBufferPool::FFreeList::Pop()
+{
+	FScopeLock Lock(&Crit);
+	return Buffers.Num() > 0 ? Buffers.Pop() : nullptr;
+}
+
+void FKinectFrameBufferPool::FFreeList::Push(FKinectFrameBuffer *Buffer)
+{
+	{
+		FScopeLock Lock(&Crit);
+		if (Buffers.Num() < MaxBuffers)
+		{
+			Buffers.Add(Buffer);
+			return;
+		}
+	}
+	delete Buffer;
+}
+
+FKinectFrameBufferPool::FKinectFrameBufferPool(int32 MaxFreeBuffers)
+	: FreeList(MakeShareable(new FFreeList(MaxFreeBuffers)))
+{
+}
+
+FKinectFrameBufferPtr FKinectFrameBufferPool::Acquire(const FIntPoint &Dimensions)
+{
+	FKinectFrameBuffer *Buffer = FreeList->Pop();
+	if (Buffer == nullptr)
+	{
+		Buffer = new FKinectFrameBuffer();
+	}
+	Buffer->Dimensions = Dimensions;
+	Buffer->Sequence = FPlatformAtomics::InterlockedIncrement(&GKinectFrameBufferSequence);
+	Buffer->Data.SetNumUninitialized(Dimensions.X * Dimensions.Y * 4);
+	FRelease Release = { FreeList };
+	return MakeShareable(Buffer, Release);
+}
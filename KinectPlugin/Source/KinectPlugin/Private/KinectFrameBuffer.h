@@ -0,0 +1,94 @@
+#pragma once
+
+#include "Engine.h"
+
+/** A BGRA8 image shared between the sensor thread, the game thread and the render thread. */
+class FKinectFrameBuffer
+{
+public:
+	FKinectFrameBuffer()
+		: Dimensions(0, 0)
+		, Sequence(0)
+	{
+	}
+
+	/** Distinct for every buffer handed out by any pool, including recycled ones; consumers compare it to skip frames they have seen. */
+	uint64 GetSequence() const
+	{
+		return Sequence;
+	}
+
+	const FIntPoint &GetDimensions() const
+	{
+		return Dimensions;
+	}
+
+	uint8 *GetData()
+	{
+		return Data.GetData();
+	}
+
+	const uint8 *GetData() const
+	{
+		return Data.GetData();
+	}
+
+	/** Size in bytes, four per pixel. */
+	int32 Num() const
+	{
+		return Data.Num();
+	}
+
+private:
+	friend class FKinectFrameBufferPool;
+
+	FIntPoint Dimensions;
+	uint64 Sequence;
+	TArray<uint8> Data;
+};
+
+typedef TSharedPtr<FKinectFrameBuffer, ESPMode::ThreadSafe> FKinectFrameBufferPtr;
+
+/**
+ * Recycles frame buffers. Buffers handed out are reference counted and
+ * return to the pool when the last reference, usually the render thread's,
+ * is released, so steady state streaming does not allocate. Buffers may
+ * outlive the pool; they are then simply freed.
+ */
+class FKinectFrameBufferPool
+{
+public:
+	/** @param MaxFreeBuffers Number of idle buffers kept for reuse. */
+	explicit FKinectFrameBufferPool(int32 MaxFreeBuffers = 4);
+
+	/** Returns a buffer of the given size whose contents are undefined. */
+	FKinectFrameBufferPtr Acquire(const FIntPoint &Dimensions);
+
+private:
+	/** Idle buffers, shared with the deleters of the buffers in flight. */
+	class FFreeList
+	{
+	public:
+		explicit FFreeList(int32 InMaxBuffers);
+		~FFreeList();
+		FKinectFrameBuffer *Pop();
+		void Push(FKinectFrameBuffer *Buffer);
+
+	private:
+		FCriticalSection Crit;
+		TArray<FKinectFrameBuffer*> Buffers;
+		int32 MaxBuffers;
+	};
+
+	struct FRelease
+	{
+		TSharedRef<FFreeList, ESPMode::ThreadSafe> FreeList;
+
+		void operator()(FKinectFrameBuffer *Buffer) const
+		{
+			FreeList->Push(Buffer);
+		}
+	};
+
+	TSharedRef<FFreeList, ESPMode::ThreadSafe> FreeList;
+};
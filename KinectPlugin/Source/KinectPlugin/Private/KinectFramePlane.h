@@ -0,0 +1,104 @@
+#pragma once
+
+#include "Engine.h"
+
+/** Keeps the memory behind frame planes alive, e.g. a sensor frame that must be released when done. */
+class FKinectFrameHold
+{
+public:
+	virtual ~FKinectFrameHold() {}
+};
+
+typedef TSharedPtr<FKinectFrameHold, ESPMode::ThreadSafe> FKinectFrameHoldPtr;
+
+/**
+ * Read only image plane of a frame bundle. It either points straight into a
+ * sensor owned buffer, kept alive by its hold, or into storage of its own.
+ * Copies share the memory, so passing a plane between stages never copies
+ * pixels. A plane viewing sensor memory keeps that frame acquired, and the
+ * sensor cannot deliver the next frame of the stream until it is released:
+ * Reset planes as soon as the frame is processed, or Retain them if the data
+ * has to outlive it.
+ */
+template<typename T>
+class TKinectFramePlane
+{
+public:
+	TKinectFramePlane()
+		: Data(nullptr)
+		, Count(0)
+		, bOwned(false)
+	{
+	}
+
+	const T *GetData() const
+	{
+		return Data;
+	}
+
+	int32 Num() const
+	{
+		return Count;
+	}
+
+	/** Views InNum elements at InData, valid while InHold is alive. */
+	void SetView(const T *InData, int32 InNum, const FKinectFrameHoldPtr &InHold)
+	{
+		Data = InData;
+		Count = InNum;
+		Hold = InHold;
+		bOwned = false;
+	}
+
+	/**
+	 * Returns InNum writable elements owned by the plane. The previous storage
+	 * is reused when no other plane shares it, otherwise a new one is made.
+	 */
+	T *Allocate(int32 InNum)
+	{
+		FStorage *Storage = bOwned && Hold.IsUnique() ? static_cast<FStorage*>(Hold.Get()) : nullptr;
+		if (Storage == nullptr)
+		{
+			Storage = new FStorage();
+			Hold = MakeShareable(Storage);
+			bOwned = true;
+		}
+		Storage->Elements.SetNumUninitialized(InNum);
+		Data = Storage->Elements.GetData();
+		Count = InNum;
+		return Storage->Elements.GetData();
+	}
+
+	/** Copies a view of sensor memory into storage of the plane's own, releasing the sensor frame. */
+	void Retain()
+	{
+		if (bOwned || Data == nullptr)
+		{
+			return;
+		}
+		const T *Source = Data;
+		const FKinectFrameHoldPtr SourceHold = Hold;
+		Hold.Reset();
+		FMemory::Memcpy(Allocate(Count), Source, Count * sizeof(T));
+	}
+
+	void Reset()
+	{
+		Data = nullptr;
+		Count = 0;
+		Hold.Reset();
+		bOwned = false;
+	}
+
+private:
+	struct FStorage : public FKinectFrameHold
+	{
+		TArray<T> Elements;
+	};
+
+	const T *Data;
+	int32 Count;
+	FKinectFrameHoldPtr Hold;
+	/** Hold is an FStorage rather than someone else's memory. */
+	bool bOwned;
+};
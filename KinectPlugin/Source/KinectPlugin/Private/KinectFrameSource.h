@@ -0,0 +1,148 @@
+#pragma once
+
+#include "Engine.h"
+#include "KinectFramePlane.h"
+#include "KinectDepthUnprojector.h"
+#include "AllowWindowsPlatformTypes.h"
+#include "Kinect.h"
+#include "HideWindowsPlatformTypes.h"
+
+/** TIMESPAN units per second; the sensor's RelativeTime counts 100 ns ticks. */
+static const double KinectTicksPerSecond = 10000000.0;
+
+/** Streams a frame source can deliver, as bits of a mask. */
+namespace EKinectFrameStream
+{
+	enum Type
+	{
+		None = 0,
+		Color = 1 << 0,
+		Depth = 1 << 1,
+		BodyIndex = 1 << 2,
+		Body = 1 << 3,
+	};
+}
+
+/**
+ * What a frame source queries of each tracked body besides its joint
+ * positions, as bits of a mask. Each is a call into the sensor runtime per
+ * body and frame, so only what some consumer asked for is queried.
+ */
+namespace EKinectBodyAttribute
+{
+	enum Type
+	{
+		None = 0,
+		HandStates = 1 << 0,
+		JointOrientations = 1 << 1,
+		Lean = 1 << 2,
+		Activities = 1 << 3,
+		Appearance = 1 << 4,
+		Expressions = 1 << 5,
+		/** What every consumer got before attributes could be chosen. */
+		Default = HandStates | JointOrientations,
+		All = HandStates | JointOrientations | Lean | Activities | Appearance | Expressions,
+	};
+}
+
+/** One tracked (or untracked) body of a body frame, in sensor terms. */
+struct FKinectBodyData
+{
+	bool bTracked;
+	Joint Joints[JointType_Count];
+	JointOrientation JointOrientations[JointType_Count];
+	HandState LeftHandState;
+	HandState RightHandState;
+	/** EKinectBodyAttribute bits of what was queried; the members of the others mean nothing. */
+	int32 Attributes;
+	/** Lean left and right in X, forward and back in Y, from -1 to 1. */
+	PointF Lean;
+	TrackingState LeanTrackingState;
+	DetectionResult Activities[Activity_Count];
+	DetectionResult Appearance[Appearance_Count];
+	DetectionResult Expressions[Expression_Count];
+};
+
+/** Frames of every stream that arrived with one sensor tick. */
+struct FKinectFrameBundle
+{
+	/** EKinectFrameStream bits of the streams present in this bundle. */
+	int32 Streams;
+	/** RelativeTime of each stream's frame, in 100 ns units. */
+	TIMESPAN ColorTime;
+	TIMESPAN DepthTime;
+	TIMESPAN BodyIndexTime;
+	TIMESPAN BodyTime;
+	/**
+	 * Usually views of the sensor's own buffers; see TKinectFramePlane for how
+	 * long they may be held. Color is the camera's native YUY2, two bytes per
+	 * pixel; FKinectColorConversion turns it into BGRA at the size a consumer needs.
+	 */
+	TKinectFramePlane<uint8> Color;
+	TKinectFramePlane<uint16> Depth;
+	TKinectFramePlane<uint8> BodyIndex;
+	FKinectBodyData Bodies[BODY_COUNT];
+
+	FKinectFrameBundle()
+		: Streams(EKinectFrameStream::None)
+		, ColorTime(0)
+		, DepthTime(0)
+		, BodyIndexTime(0)
+		, BodyTime(0)
+	{
+	}
+
+	bool Has(EKinectFrameStream::Type Stream) const
+	{
+		return (Streams & Stream) != 0;
+	}
+};
+
+/**
+ * Where frames come from. The live implementation waits on the sensor's
+ * frame arrival event; others replay or synthesize frames, so the whole
+ * pipeline downstream of the source can run without a sensor.
+ */
+class IKinectFrameSource
+{
+public:
+	virtual ~IKinectFrameSource() {}
+
+	/** Starts delivering the streams in Streams, a mask of EKinectFrameStream bits. */
+	virtual HRESULT Open(int32 Streams) = 0;
+	virtual void Close() = 0;
+
+	/**
+	 * Blocks until the next bundle arrives and fills OutBundle with it.
+	 *
+	 * @return false on timeout, on error or once Stop was called.
+	 */
+	virtual bool WaitForFrame(FKinectFrameBundle &OutBundle, uint32 TimeoutMilliseconds) = 0;
+
+	/** Wakes a thread blocked in WaitForFrame; safe to call from any thread. */
+	virtual void Stop() = 0;
+
+	virtual FIntPoint GetColorSize() const = 0;
+	virtual FIntPoint GetDepthSize() const = 0;
+
+	/** Intrinsics the depth unprojector is built from. */
+	virtual IKinectDepthIntrinsics &GetDepthIntrinsics() = 0;
+
+	/** Returns true once after each change of the depth camera calibration. */
+	virtual bool PollCoordinateMappingChanged() = 0;
+
+	/** Maps every pixel of a depth frame to color frame coordinates; unmapped pixels get -infinity. */
+	virtual HRESULT MapDepthFrameToColorSpace(const uint16 *Depth, int32 NumPixels, ColorSpacePoint *OutColorPoints) = 0;
+
+	/** Coordinate mapper for consumers needing more than the source offers, nullptr if it has none. Not AddRef'ed. */
+	virtual ICoordinateMapper *GetCoordinateMapper() const = 0;
+
+	/**
+	 * Queries the body attributes in Attributes, a mask of EKinectBodyAttribute
+	 * bits, from the next body frame on; the default is EKinectBodyAttribute::Default.
+	 * Sources that do not query a sensor deliver what they have and ignore it.
+	 */
+	virtual void SetBodyAttributes(int32 Attributes)
+	{
+	}
+};
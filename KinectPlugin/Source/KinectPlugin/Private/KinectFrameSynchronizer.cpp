@@ -0,0 +1,266 @@
+#include "KinectPluginPrivatePCH.h"
+#include "KinectFrameSynchronizer.h"
+
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Sync Frames Dropped"), STAT_KinectSyncFramesDropped, STATGROUP_Kinect);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Sync Frames Unmatched"), STAT_KinectSyncFramesUnmatched, STATGROUP_Kinect);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Sync Bundles Matched"), STAT_KinectSyncBundlesMatched, STATGROUP_Kinect);
+
+FKinectFrameSynchronizer::FKinectFrameSynchronizer()
+	: RequiredStreams(EKinectFrameStream::None)
+	, OptionalStreams(EKinectFrameStream::None)
+	, AnchorStream(INDEX_NONE)
+	, Tolerance(0)
+	, RingSize(0)
+	, DroppedFrames(0)
+	, UnmatchedFrames(0)
+{
+	for (int32 s = 0; s < NumStreams; s++)
+	{
+		Rings[s].First = 0;
+		Rings[s].Count = 0;
+	}
+}
+
+void FKinectFrameSynchronizer::Configure(int32 InRequiredStreams, int32 InOptionalStreams, int32 ToleranceMilliseconds, int32 InRingSize)
+{
+	RequiredStreams = InRequiredStreams;
+	OptionalStreams = InOptionalStreams & ~InRequiredStreams;
+	// RelativeTime ticks are 100 ns
+	Tolerance = static_cast<TIMESPAN>(ToleranceMilliseconds) * 10000;
+	RingSize = FMath::Max(InRingSize, 1);
+	// Depth drives the mesh, so bundles follow its cadence whenever it is required
+	AnchorStream = INDEX_NONE;
+	for (int32 s = 0; s < NumStreams; s++)
+	{
+		if ((RequiredStreams & (1 << s)) && (AnchorStream == INDEX_NONE || (1 << s) == EKinectFrameStream::Depth))
+		{
+			AnchorStream = s;
+		}
+	}
+	DroppedFrames = 0;
+	UnmatchedFrames = 0;
+	Reset();
+}
+
+void FKinectFrameSynchronizer::Reset()
+{
+	for (int32 s = 0; s < NumStreams; s++)
+	{
+		Rings[s].Slots.SetNum(RingSize);
+		Rings[s].First = 0;
+		Rings[s].Count = 0;
+	}
+}
+
+FKinectFrameBundle &FKinectFrameSynchronizer::GetSlot(int32 Stream, int32 Index)
+{
+	FRing &Ring = Rings[Stream];
+	return Ring.Slots[(Ring.First + Index) % RingSize];
+}
+
+void FKinectFrameSynchronizer::PopFront(int32 Stream)
+{
+	FRing &Ring = Rings[Stream];
+	check(Ring.Count > 0);
+	// An emptied slot must not keep a sensor frame acquired
+	FKinectFrameBundle &Slot = Ring.Slots[Ring.First];
+	Slot.Color.Reset();
+	Slot.Depth.Reset();
+	Slot.BodyIndex.Reset();
+	Ring.First = (Ring.First + 1) % RingSize;
+	Ring.Count--;
+}
+
+void FKinectFrameSynchronizer::DropFront(int32 Stream, int32 Num)
+{
+	for (int32 i = 0; i < Num; i++)
+	{
+		PopFront(Stream);
+	}
+	DroppedFrames += Num;
+	INC_DWORD_STAT_BY(STAT_KinectSyncFramesDropped, Num);
+}
+
+void FKinectFrameSynchronizer::Push(FKinectFrameBundle &Bundle)
+{
+	for (int32 s = 0; s < NumStreams; s++)
+	{
+		const int32 Bit = 1 << s;
+		if (!(Bundle.Streams & Bit) || !((RequiredStreams | OptionalStreams) & Bit))
+		{
+			continue;
+		}
+		FRing &Ring = Rings[s];
+		const TIMESPAN Time = GetTime(Bundle, s);
+		if (Ring.Count > 0)
+		{
+			const TIMESPAN Newest = GetTime(GetSlot(s, Ring.Count - 1), s);
+			if (Time == Newest)
+			{
+				continue;
+			}
+			if (Time < Newest)
+			{
+				// The timeline restarted, e.g. a looping recording; nothing queued can match what follows
+				for (int32 t = 0; t < NumStreams; t++)
+				{
+					DropFront(t, Rings[t].Count);
+				}
+			}
+		}
+		if (Ring.Count == RingSize)
+		{
+			DropFront(s, 1);
+		}
+		ExchangeStream(Bundle, GetSlot(s, Ring.Count), s);
+		Ring.Count++;
+		Bundle.Streams &= ~Bit;
+	}
+}
+
+void FKinectFrameSynchronizer::RetainQueuedFrames()
+{
+	for (int32 s = 0; s < NumStreams; s++)
+	{
+		for (int32 i = 0; i < Rings[s].Count; i++)
+		{
+			// Slots only fill the fields of their own stream, the other planes are empty
+			FKinectFrameBundle &Slot = GetSlot(s, i);
+			Slot.Color.Retain();
+			Slot.Depth.Retain();
+			Slot.BodyIndex.Retain();
+		}
+	}
+}
+
+int32 FKinectFrameSynchronizer::FindMatch(int32 Stream, TIMESPAN Time)
+{
+	int32 Match = INDEX_NONE;
+	TIMESPAN MatchDifference = Tolerance;
+	for (int32 i = 0; i < Rings[Stream].Count; i++)
+	{
+		const TIMESPAN Difference = FMath::Abs(GetTime(GetSlot(Stream, i), Stream) - Time);
+		if (Difference < MatchDifference)
+		{
+			Match = i;
+			MatchDifference = Difference;
+		}
+	}
+	return Match;
+}
+
+bool FKinectFrameSynchronizer::Pop(FKinectFrameBundle &OutBundle)
+{
+	if (AnchorStream == INDEX_NONE)
+	{
+		return false;
+	}
+	while (Rings[AnchorStream].Count > 0)
+	{
+		const TIMESPAN AnchorTime = GetTime(GetSlot(AnchorStream, 0), AnchorStream);
+		int32 Matches[NumStreams];
+		bool bWait = false;
+		bool bGiveUp = false;
+		for (int32 s = 0; s < NumStreams; s++)
+		{
+			const int32 Bit = 1 << s;
+			Matches[s] = INDEX_NONE;
+			if (s == AnchorStream)
+			{
+				Matches[s] = 0;
+			}
+			else if (RequiredStreams & Bit)
+			{
+				Matches[s] = FindMatch(s, AnchorTime);
+				if (Matches[s] == INDEX_NONE)
+				{
+					// Frames arrive in order, once the stream is past the window no match can come
+					const FRing &Ring = Rings[s];
+					if (Ring.Count > 0 && GetTime(GetSlot(s, Ring.Count - 1), s) >= AnchorTime + Tolerance)
+					{
+						bGiveUp = true;
+					}
+					else
+					{
+						bWait = true;
+					}
+				}
+			}
+			else if (OptionalStreams & Bit)
+			{
+				Matches[s] = FindMatch(s, AnchorTime);
+			}
+		}
+		if (bGiveUp)
+		{
+			PopFront(AnchorStream);
+			UnmatchedFrames++;
+			INC_DWORD_STAT(STAT_KinectSyncFramesUnmatched);
+			continue;
+		}
+		if (bWait)
+		{
+			return false;
+		}
+		OutBundle.Streams = EKinectFrameStream::None;
+		for (int32 s = 0; s < NumStreams; s++)
+		{
+			if (Matches[s] != INDEX_NONE)
+			{
+				// Older frames of the stream would only ever pair with older anchors
+				if (Matches[s] > 0)
+				{
+					DropFront(s, Matches[s]);
+				}
+				ExchangeStream(GetSlot(s, 0), OutBundle, s);
+				PopFront(s);
+				OutBundle.Streams |= 1 << s;
+			}
+		}
+		INC_DWORD_STAT(STAT_KinectSyncBundlesMatched);
+		return true;
+	}
+	return false;
+}
+
+TIMESPAN FKinectFrameSynchronizer::GetTime(const FKinectFrameBundle &Bundle, int32 Stream)
+{
+	switch (1 << Stream)
+	{
+	case EKinectFrameStream::Color:
+		return Bundle.ColorTime;
+	case EKinectFrameStream::Depth:
+		return Bundle.DepthTime;
+	case EKinectFrameStream::BodyIndex:
+		return Bundle.BodyIndexTime;
+	case EKinectFrameStream::Body:
+	default:
+		return Bundle.BodyTime;
+	}
+}
+
+void FKinectFrameSynchronizer::ExchangeStream(FKinectFrameBundle &A, FKinectFrameBundle &B, int32 Stream)
+{
+	switch (1 << Stream)
+	{
+	case EKinectFrameStream::Color:
+		Exchange(A.ColorTime, B.ColorTime);
+		Exchange(A.Color, B.Color);
+		break;
+	case EKinectFrameStream::Depth:
+		Exchange(A.DepthTime, B.DepthTime);
+		Exchange(A.Depth, B.Depth);
+		break;
+	case EKinectFrameStream::BodyIndex:
+		Exchange(A.BodyIndexTime, B.BodyIndexTime);
+		Exchange(A.BodyIndex, B.BodyIndex);
+		break;
+	case EKinectFrameStream::Body:
+		Exchange(A.BodyTime, B.BodyTime);
+		for (int32 i = 0; i < BODY_COUNT; i++)
+		{
+			Exchange(A.Bodies[i], B.Bodies[i]);
+		}
+		break;
+	}
+}
@@ -0,0 +1,93 @@
+#pragma once
+
+#include "KinectFrameSource.h"
+
+/**
+ * Pairs frames of different streams by RelativeTime. Incoming bundles are
+ * split into a short ring per stream, and a bundle is only handed out once
+ * every required stream has a frame within the tolerance of the anchor
+ * stream's frame (depth, when it is required). Optional streams are attached
+ * when they have a close enough frame but are never waited for. Frames that
+ * can no longer be matched are dropped and counted.
+ */
+class FKinectFrameSynchronizer
+{
+public:
+	/** Largest color/depth timestamp difference, in milliseconds, Kinect Fusion still treats as synchronized. */
+	static const int32 DefaultToleranceMilliseconds = 30;
+
+	FKinectFrameSynchronizer();
+
+	/**
+	 * Sets the streams to match and empties the rings.
+	 *
+	 * @param InRequiredStreams EKinectFrameStream bits every bundle handed out contains.
+	 * @param InOptionalStreams EKinectFrameStream bits attached when a matching frame is at hand.
+	 * @param ToleranceMilliseconds Largest timestamp difference of frames in one bundle.
+	 * @param InRingSize Frames kept per stream while waiting for a match.
+	 */
+	void Configure(int32 InRequiredStreams, int32 InOptionalStreams, int32 ToleranceMilliseconds = DefaultToleranceMilliseconds, int32 InRingSize = 4);
+
+	void Reset();
+
+	/** Takes over the streams of Bundle; their buffers are swapped out, not copied. */
+	void Push(FKinectFrameBundle &Bundle);
+
+	/** Fills OutBundle with the oldest matched set of frames, if there is one. */
+	bool Pop(FKinectFrameBundle &OutBundle);
+
+	/**
+	 * Copies the color, depth and body index frames still queued out of
+	 * sensor memory, so the sensor can deliver the next ones while they wait
+	 * for a match. Cheap in the common case, where every frame is matched right away.
+	 */
+	void RetainQueuedFrames();
+
+	/** True if two timestamps in the same unit lie within Tolerance of each other. */
+	static bool IsSynchronized(int64 TimeA, int64 TimeB, int64 Tolerance)
+	{
+		return FMath::Abs(TimeA - TimeB) < Tolerance;
+	}
+
+	/** Frames evicted from a full ring or skipped over by a later match. */
+	uint32 GetDroppedFrames() const
+	{
+		return DroppedFrames;
+	}
+
+	/** Anchor frames given up on because a required stream had no frame close enough. */
+	uint32 GetUnmatchedFrames() const
+	{
+		return UnmatchedFrames;
+	}
+
+private:
+	enum { NumStreams = 4 };
+
+	/** Frames of one stream, oldest first; only that stream's fields of each slot are used. */
+	struct FRing
+	{
+		TArray<FKinectFrameBundle> Slots;
+		int32 First;
+		int32 Count;
+	};
+
+	FKinectFrameBundle &GetSlot(int32 Stream, int32 Index);
+	void PopFront(int32 Stream);
+	void DropFront(int32 Stream, int32 Num);
+	/** Index of the frame of Stream closest to Time within the tolerance, or INDEX_NONE. */
+	int32 FindMatch(int32 Stream, TIMESPAN Time);
+
+	static TIMESPAN GetTime(const FKinectFrameBundle &Bundle, int32 Stream);
+	static void ExchangeStream(FKinectFrameBundle &A, FKinectFrameBundle &B, int32 Stream);
+
+	int32 RequiredStreams;
+	int32 OptionalStreams;
+	int32 AnchorStream;
+	/** In 100 ns units, like RelativeTime. */
+	TIMESPAN Tolerance;
+	int32 RingSize;
+	FRing Rings[NumStreams];
+	uint32 DroppedFrames;
+	uint32 UnmatchedFrames;
+};
@@ -110,6 +110,7 @@ void AKinectFusionActor::BeginPlay()
 	
 	Processor->SetParams(Params);
 	Processor->StartProcessing();
+	SectionWriter.Reset();
 	if (Thread != nullptr)
 	{
 		delete Thread;
@@ -150,8 +151,7 @@ int AKinectFusionActor::Update()
 	while (MeshGeneration.Dequeue(Mesh)) 
 	{
 		Mesh->Release();
-		this->MeshComp->ClearAllMeshSections();
-		this->MeshComp->CreateMeshSection(0, Vertices, Triangles, Normals, UVs, VertexColors, Tangents, EnablePhysics);
+		SectionWriter.Write(this->MeshComp, 0, MeshBuffers, Normals, EnablePhysics);
 	}
 	return 0;
 }
@@ -173,11 +173,11 @@ int AKinectFusionActor::UpdateVertexData(INuiFusionColorMesh *mesh)
 	{
 		return hr;
 	}
-	Vertices.Empty();
+	MeshBuffers.Vertices.SetNumUninitialized(numVertices);
 	for (unsigned int i = 0; i < numVertices; i++)
 	{
 		const Vector3 &v = vertices[i];
-		Vertices.Add(FVector(v.z, -v.x, -v.y) * 100.0f);
+		MeshBuffers.Vertices[i] = FVector(v.z, -v.x, -v.y) * 100.0f;
 	}
 
 	const Vector3 *normals = NULL;
@@ -186,11 +186,11 @@ int AKinectFusionActor::UpdateVertexData(INuiFusionColorMesh *mesh)
 	{
 		return hr;
 	}
-	Normals.Empty();
+	Normals.SetNumUninitialized(numVertices);
 	for (unsigned int i = 0; i < numVertices; i++)
 	{
 		const Vector3 &v = normals[i];
-		Normals.Add(FVector(v.z, -v.x, -v.y).GetSafeNormal());
+		Normals[i] = FVector(v.z, -v.x, -v.y).GetSafeNormal();
 	}
 	const int *triangleIndices = NULL;
 	hr = mesh->GetTriangleIndices(&triangleIndices);
@@ -198,23 +198,28 @@ int AKinectFusionActor::UpdateVertexData(INuiFusionColorMesh *mesh)
 	{
 		return hr;
 	}
-	Triangles.Empty();
+	// Fusion meshes are normally unshared triangles indexed in order, which lets the section be padded and updated in place
+	MeshBuffers.Triangles.SetNumUninitialized(numTriangleIndices);
+	bool bInOrder = true;
 	for (unsigned int i = 0; i < numTriangleIndices; i++)
 	{
 		const int index = triangleIndices[i];
-		Triangles.Add(index);
+		MeshBuffers.Triangles[i] = index;
+		bInOrder &= index == static_cast<int>(i);
 	}
+	MeshBuffers.IndexPattern = bInOrder ? EKinectMeshIndexPattern::TriangleList : EKinectMeshIndexPattern::Explicit;
+	MeshBuffers.TopologySerial++;
 	int const *colors;
 	hr = mesh->GetColors(&colors);
 	if (FAILED(hr))
 	{
 		return hr;
 	}
-	VertexColors.Empty();
+	MeshBuffers.Colors.SetNumUninitialized(numVertices);
 	for (unsigned int i = 0; i < numVertices; i++)
 	{
 		int color = colors[i];
-		VertexColors.Add(FColor(color));
+		MeshBuffers.Colors[i] = FColor(color);
 	}
 	return S_OK;
 }
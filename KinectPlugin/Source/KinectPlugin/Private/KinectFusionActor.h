@@ -5,6 +5,7 @@
 #include "Engine/Texture.h"
 #include "ProceduralMeshComponent.h"
 #include "IKinectPlugin.h"
+#include "KinectMeshSectionWriter.h"
 #include "KinectFusionActor.generated.h"
 
 UCLASS()
@@ -35,12 +36,9 @@ class KINECTPLUGIN_API AKinectFusionActor : public AActor, public FRunnable
   int UpdateVertexData(struct INuiFusionColorMesh *mesh);
 
   class KinectFusionProcessor *Processor;
-  TArray<int32> Triangles;
-  TArray<FVector> Vertices;
+  FKinectMeshBuffers MeshBuffers;
   TArray<FVector> Normals;
-  TArray<FVector2D> UVs;
-  TArray<FColor> VertexColors;
-  TArray<FProcMeshTangent> Tangents;
+  FKinectMeshSectionWriter SectionWriter;
   float LastReconstruction;
   FRunnableThread *Thread;
   TQueue<struct INuiFusionColorMesh *, EQueueMode::Mpsc> MeshGeneration;
@@ -18,6 +18,7 @@
 // Project includes
 #include "KinectFusionProcessor.h"
 #include "KinectFusionHelper.h"
+#include "KinectColorConversion.h"
 #define min(a, b) (a<b)?a:b
 #define max(a, b) (a>b)?a:b
 //#include "resource.h"
@@ -29,26 +30,20 @@
     _ASSERT_EXPR(GetCurrentThreadId() != m_threadId, __FUNCTIONW__ L" called on wrong thread!");
 
 HRESULT KinectFusionProcessor::CopyDepth(
-    IDepthFrame* pDepthFrame
+    const TKinectFramePlane<uint16>& depthFrame
     )
 {
-        // Check the frame pointer
-        if (NULL == pDepthFrame)
-        {
-            return E_INVALIDARG;
-        }
-
-        UINT nBufferSize = 0;
-        UINT16 *pBuffer = NULL;
+        const UINT bufferLength =  NUI_DEPTH_RAW_HEIGHT * NUI_DEPTH_RAW_WIDTH;
 
-        HRESULT hr = pDepthFrame->AccessUnderlyingBuffer(&nBufferSize, &pBuffer);
-        if (FAILED(hr))
+        // Check the frame; one of another size, e.g. from a recording, would be read past its end
+        const UINT16* pBuffer = depthFrame.GetData();
+        if (NULL == pBuffer || static_cast<UINT>(depthFrame.Num()) != bufferLength)
         {
-            return hr;
+            SetStatusMessage(L"Error copying depth frame pixels.");
+            return E_INVALIDARG;
         }
 
         //copy and remap depth
-        const UINT bufferLength =  NUI_DEPTH_RAW_HEIGHT * NUI_DEPTH_RAW_WIDTH;
         UINT16 * pDepth = m_pDepthUndistortedPixelBuffer;
         UINT16 * pRawDepth = m_pDepthRawPixelBuffer;
         for(UINT i = 0; i < bufferLength; i++, pDepth++, pRawDepth++)
@@ -72,7 +67,8 @@ m_hThread(nullptr),
 m_threadId(0),
 m_pVolume(nullptr),
 m_hrRecreateVolume(S_OK),
-m_pNuiSensor(nullptr),
+m_sensorHub(IKinectPlugin::Get().GetSensorHub()),
+m_pFrameSource(nullptr),
 m_cLostFrameCounter(0),
 m_bTrackingFailed(false),
 m_cFrameCounter(0),
@@ -114,9 +110,7 @@ m_pDownsampledShadedDeltaFromReference(nullptr),
 m_pDownsampledRaycastPointCloud(nullptr),
 m_bCalculateDeltaFrame(false),
 m_coordinateMappingChangedEvent(NULL),
-m_bHaveValidCameraParameters(false),
-m_pColorFrameReader(nullptr),
-m_pDepthFrameReader(nullptr)
+m_bHaveValidCameraParameters(false)
 
 {
     // Initialize synchronization objects
@@ -198,10 +192,6 @@ KinectFusionProcessor::~KinectFusionProcessor()
         CloseHandle(m_hStopProcessingEvent);
     }
 
-    // done with depth frame reader
-    SafeRelease(m_pDepthFrameReader);
-    SafeRelease(m_pColorFrameReader);
-
 
     DeleteCriticalSection(&m_lockParams);
     DeleteCriticalSection(&m_lockFrame);
@@ -215,11 +205,11 @@ void KinectFusionProcessor::ShutdownSensor()
 {
     AssertOwnThread();
 
-    // Clean up Kinect
-    if (m_pNuiSensor != nullptr)
+    // Unsubscribe from the shared sensor, the hub closes it once nobody else uses it
+    if (m_pFrameSource != nullptr)
     {
-        m_pNuiSensor->Close();
-        SafeRelease(m_pNuiSensor);
+        m_pFrameSource->Close();
+        SAFE_DELETE(m_pFrameSource);
     }
 }
 
@@ -385,7 +375,7 @@ DWORD KinectFusionProcessor::MainLoop()
             }
         }
 
-        if (m_pNuiSensor == nullptr)
+        if (m_pFrameSource == nullptr)
         {
             // We have no sensor: Set frame rate to zero and notify the UI
             NotifyEmptyFrame();
@@ -405,60 +395,33 @@ HRESULT KinectFusionProcessor::InitializeDefaultSensor()
 {
     HRESULT hr;
 
-    hr = GetDefaultKinectSensor(&m_pNuiSensor);
+    // Depth and color come from the plugin's sensor hub, which may already be streaming for other actors
+    m_pFrameSource = new FKinectHubFrameSource(m_sensorHub);
+    hr = m_pFrameSource->Open(EKinectFrameStream::Depth | EKinectFrameStream::Color);
     if (FAILED(hr))
     {
+        SAFE_DELETE(m_pFrameSource);
         return hr;
     }
 
-    if (m_pNuiSensor)
+    // The mapper belongs to the hub's sensor, or its replay, keep our own reference
+    m_pMapper = m_pFrameSource->GetCoordinateMapper();
+    if (nullptr != m_pMapper)
     {
-        // Initialize the Kinect and get the depth reader
-        IDepthFrameSource* pDepthFrameSource = NULL;
-        IColorFrameSource* pColorFrameSource = NULL;
-
-        hr = m_pNuiSensor->Open();
-
-        if (SUCCEEDED(hr))
-        {
-            hr = m_pNuiSensor->get_DepthFrameSource(&pDepthFrameSource);
-        }
-
-        if (SUCCEEDED(hr))
-        {
-            hr = pDepthFrameSource->OpenReader(&m_pDepthFrameReader);
-        }
-
-        if (SUCCEEDED(hr))
-        {
-            hr = m_pNuiSensor->get_CoordinateMapper(&m_pMapper);
-        }
-
-        if (SUCCEEDED(hr))
-        {
-            hr = m_pMapper->SubscribeCoordinateMappingChanged(&m_coordinateMappingChangedEvent);
-        }
-
-        if (SUCCEEDED(hr))
-        {
-            hr = m_pNuiSensor->get_ColorFrameSource(&pColorFrameSource);
-        }
-
-        if (SUCCEEDED(hr))
-        {
-            hr = pColorFrameSource->OpenReader(&m_pColorFrameReader);
-        }
-
-        if (SUCCEEDED(InitializeKinectFusion()))
-        {
-            m_bKinectFusionInitialized = true;
-        }
+        m_pMapper->AddRef();
+        hr = m_pMapper->SubscribeCoordinateMappingChanged(&m_coordinateMappingChangedEvent);
+    }
+    else
+    {
+        hr = E_FAIL;
+    }
 
-        SafeRelease(pDepthFrameSource);
-        SafeRelease(pColorFrameSource);
+    if (SUCCEEDED(InitializeKinectFusion()))
+    {
+        m_bKinectFusionInitialized = true;
     }
 
-    if (!m_pNuiSensor || FAILED(hr))
+    if (!m_pFrameSource || FAILED(hr))
     {
         SetStatusMessage(L"No ready Kinect found!");
         return E_FAIL;
@@ -1087,7 +1050,7 @@ HRESULT KinectFusionProcessor::RecreateVolume()
 /// </summary>
 /// <param name="imageFrame">The color image frame to copy.</param>
 /// <returns>S_OK on success, otherwise failure code</returns>
-HRESULT KinectFusionProcessor::CopyColor(IColorFrame* pColorFrame)
+HRESULT KinectFusionProcessor::CopyColor(const TKinectFramePlane<uint8>& colorFrame)
 {
     HRESULT hr = S_OK;
 
@@ -1099,13 +1062,20 @@ HRESULT KinectFusionProcessor::CopyColor(IColorFrame* pColorFrame)
 
     NUI_FUSION_BUFFER *destColorBuffer = m_pColorImage->pFrameBuffer;
 
-    if (nullptr == pColorFrame || nullptr == destColorBuffer)
+    if (nullptr == destColorBuffer)
     {
         return E_NOINTERFACE;
     }
 
-    // Copy the color pixels so we can return the image frame
-    hr = pColorFrame->CopyConvertedFrameDataToArray(cColorWidth * cColorHeight * sizeof(RGBQUAD), destColorBuffer->pBits, ColorImageFormat_Bgra);
+    // The frame is YUY2, converting it straight into the Fusion image is the only pass over it
+    if (colorFrame.Num() != cColorWidth * cColorHeight * 2)
+    {
+        hr = E_INVALIDARG;
+    }
+    else
+    {
+        FKinectColorConversion::ConvertToBGRA(colorFrame.GetData(), cColorWidth, cColorHeight, destColorBuffer->pBits);
+    }
 
     if (FAILED(hr))
     {
@@ -1299,22 +1269,18 @@ HRESULT KinectFusionProcessor::GetKinectFrames(bool &colorSynchronized)
     ////////////////////////////////////////////////////////
     // Get an extended depth frame from Kinect
 
-    IDepthFrame* pDepthFrame = NULL;
-
-    hr = m_pDepthFrameReader->AcquireLatestFrame(&pDepthFrame);
+    if (!m_pFrameSource->WaitForFrame(m_frameBundle, cFrameWaitTimeoutMilliseconds) || !m_frameBundle.Has(EKinectFrameStream::Depth))
+    {
+        SetStatusMessage(L"Kinect depth stream get frame call failed.");
+        return E_PENDING;
+    }
 
+    hr = CopyDepth(m_frameBundle.Depth);
     if (FAILED(hr))
     {
-        SafeRelease(pDepthFrame);
-        SetStatusMessage(L"Kinect depth stream get frame call failed.");
         return hr;
     }
-
-    hr = CopyDepth(pDepthFrame);
-    pDepthFrame->get_RelativeTime(&currentDepthFrameTime);
-    currentDepthFrameTime /= 10000;
-
-    SafeRelease(pDepthFrame);
+    currentDepthFrameTime = m_frameBundle.DepthTime / 10000;
 
     ////////////////////////////////////////////////////////
     // Get a color frame from Kinect
@@ -1323,35 +1289,20 @@ HRESULT KinectFusionProcessor::GetKinectFrames(bool &colorSynchronized)
     {
         currentColorFrameTime = m_cLastColorFrameTimeStamp;
 
-        IColorFrame* pColorFrame;
-        hr = m_pColorFrameReader->AcquireLatestFrame(&pColorFrame);
-
-        if (FAILED(hr))
+        if (!m_frameBundle.Has(EKinectFrameStream::Color))
         {
             // Here we just do not integrate color rather than reporting an error
             colorSynchronized = false;
         }
         else
         {
-            if (SUCCEEDED(hr))
-            {
-                CopyColor(pColorFrame);
-            }
-
-            if (SUCCEEDED(hr))
-            {
-                hr = pColorFrame->get_RelativeTime(&currentColorFrameTime);
-                currentColorFrameTime /= 10000;
-            }
-
-            SafeRelease(pColorFrame);
+            CopyColor(m_frameBundle.Color);
+            currentColorFrameTime = m_frameBundle.ColorTime / 10000;
         }
 
         // Check color and depth frame timestamps to ensure they were captured at the same time
         // If not, we attempt to re-synchronize by getting a new frame from the stream that is behind.
-        int timestampDiff = static_cast<int>(abs(currentColorFrameTime - currentDepthFrameTime));
-
-        if ((timestampDiff >= cMinTimestampDifferenceForFrameReSync) && m_cSuccessfulFrameCounter > 0 && (m_paramsCurrent.m_bAutoFindCameraPoseWhenLost || m_paramsCurrent.m_bCaptureColor))
+        if (!FKinectFrameSynchronizer::IsSynchronized(currentColorFrameTime, currentDepthFrameTime, cMinTimestampDifferenceForFrameReSync) && m_cSuccessfulFrameCounter > 0 && (m_paramsCurrent.m_bAutoFindCameraPoseWhenLost || m_paramsCurrent.m_bCaptureColor))
         {
             colorSynchronized = false;
         }
@@ -1360,9 +1311,13 @@ HRESULT KinectFusionProcessor::GetKinectFrames(bool &colorSynchronized)
             colorSynchronized = true;
         }
     }
+
+    // Both images are copied by now, let the sensor have its buffers back
+    m_frameBundle.Depth.Reset();
+    m_frameBundle.Color.Reset();
     ////////////////////////////////////////////////////////
-    // To enable playback of a .xef file through Kinect Studio and reset of the reconstruction
-    // if the .xef loops, we test for when the frame timestamp has skipped a large number. 
+    // To enable playback of a .xef file through Kinect Studio, or of a recording replayed by the sensor hub,
+    // and reset of the reconstruction if the recording loops, we test for when the frame timestamp has skipped a large number. 
     // Note: this will potentially continually reset live reconstructions on slow machines which
     // cannot process a live frame in less time than the reset threshold. Increase the number of
     // milliseconds in cResetOnTimeStampSkippedMilliseconds if this is a problem.
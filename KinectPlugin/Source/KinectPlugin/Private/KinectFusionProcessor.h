@@ -12,6 +12,8 @@
 #include "Timer.h"
 #include "KinectFusionParams.h"
 #include "KinectFusionProcessorFrame.h"
+#include "KinectFrameSynchronizer.h"
+#include "KinectSensorHub.h"
 
 #include "KinectFusionHelper.h"
 
@@ -26,7 +28,8 @@ class KinectFusionProcessor
     static const int            cResetOnNumberOfLostFrames = 100;
     static const int            cTimeDisplayInterval = 4;
     static const int            cRenderIntervalMilliseconds = 100; // Render every 100ms
-    static const int            cMinTimestampDifferenceForFrameReSync = 30; // The minimum timestamp difference between depth and color (in ms) at which they are considered un-synchronized.
+    static const int            cFrameWaitTimeoutMilliseconds = 100; // Longest wait for the sensor hub's next frame
+    static const int            cMinTimestampDifferenceForFrameReSync = FKinectFrameSynchronizer::DefaultToleranceMilliseconds; // The minimum timestamp difference between depth and color (in ms) at which they are considered un-synchronized.
     static const int            cColorWidth = 1920;
     static const int            cColorHeight = 1080;
     static const int            cVisibilityTestQuantShift = 2; // shift by 2 == divide by 4
@@ -120,9 +123,9 @@ private:
     HANDLE                      m_hThread;
     DWORD                       m_threadId;
 
-    IKinectSensor*              m_pNuiSensor;
-    IDepthFrameReader*          m_pDepthFrameReader;
-    IColorFrameReader*          m_pColorFrameReader;
+    FKinectSensorHub&           m_sensorHub;
+    IKinectFrameSource*         m_pFrameSource;
+    FKinectFrameBundle          m_frameBundle;
 
     LONGLONG                    m_cLastDepthFrameTimeStamp;
     LONGLONG                    m_cLastColorFrameTimeStamp;
@@ -190,7 +193,7 @@ private:
     /// Copy the color data out of a Kinect image frame
     /// </summary>
     /// <returns>S_OK on success, otherwise failure code</returns>
-	HRESULT                     CopyColor(IColorFrame* pColorFrame);
+	HRESULT                     CopyColor(const TKinectFramePlane<uint8>& colorFrame);
 
     /// <summary>
     /// Get the next frames from Kinect, re-synchronizing depth with color if required.
@@ -288,7 +291,7 @@ private:
     /// </summary>
     /// <returns>S_OK on success, otherwise failure code</returns>
     HRESULT                     CopyDepth(
-                                    IDepthFrame* pDepthFrame);
+                                    const TKinectFramePlane<uint16>& depthFrame);
 
     /// <summary>
     /// Set the status bar message.
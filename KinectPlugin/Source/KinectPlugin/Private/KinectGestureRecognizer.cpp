@@ -0,0 +1,540 @@
+#include "KinectPluginPrivatePCH.h"
+#include "KinectGestureRecognizer.h"
+#include "KinectSimd.h"
+
+DECLARE_CYCLE_STAT(TEXT("Gesture Recognition"), STAT_KinectGestureRecognition, STATGROUP_Kinect);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Gesture Warps"), STAT_KinectGestureWarps, STATGROUP_Kinect);
+
+const float FKinectGestureRecognizer::MinDuration = 0.3f;
+const float FKinectGestureRecognizer::DurationStep = 1.25f;
+const float FKinectGestureRecognizer::MaxSpeedRatio = 1.5f;
+
+/** "KGST" read as a little endian uint32. */
+static const uint32 LibraryMagic = 0x5453474B;
+static const uint32 LibraryVersion = 1;
+
+/** Samples a warping path may stray from the diagonal. */
+static const int32 BandRadius = 3;
+
+/** Joints of a sample, in the order their positions are stored. */
+static const JointType FeatureJoints[FKinectGestureRecognizer::NumFeatureJoints] =
+{
+	JointType_HandLeft,
+	JointType_HandRight,
+	JointType_ElbowLeft,
+	JointType_ElbowRight,
+};
+
+/** Torso lengths shorter than this are tracking errors rather than a small body, in centimeters. */
+static const float MinTorsoLength = 10.0f;
+
+static const int32 BlockStride = FKinectGestureRecognizer::NumSamples * FKinectGestureRecognizer::NumFeatures * FKinectGestureRecognizer::BlockWidth;
+
+static float GetWindowDuration(int32 Index)
+{
+	return FKinectGestureRecognizer::MinDuration * FMath::Pow(FKinectGestureRecognizer::DurationStep, static_cast<float>(Index));
+}
+
+/**
+ * Warps Window against each template of Block within BandRadius of the
+ * diagonal, and stores the path costs divided by the number of samples.
+ * A warp that cannot come in under Limits, per lane in path cost, stops early
+ * and stores BIG_NUMBER: it is skipped if the distance of every window sample
+ * to the band's envelope of the template, Lower to Upper, already adds up to
+ * the limit (Keogh's lower bound), and stopped once every lane's row of path
+ * costs is past it, as path costs only grow from row to row.
+ */
+template<typename TLanes>
+static void WarpBlock(const float *Window, const float *Block, const float *Lower, const float *Upper, const float *Limits, float *OutCosts)
+{
+	const int32 N = FKinectGestureRecognizer::NumSamples;
+	const int32 F = FKinectGestureRecognizer::NumFeatures;
+	const int32 W = FKinectGestureRecognizer::BlockWidth;
+	for (int32 Lane = 0; Lane < W; Lane += TLanes::Width)
+	{
+		const TLanes Limit = TLanes::Load(Limits + Lane);
+		// Every warping path takes a cell of each row, which is no nearer than the envelope of the row's band
+		TLanes Bound(0.0f);
+		for (int32 i = 0; i < N; i++)
+		{
+			TLanes Sum(0.0f);
+			for (int32 f = 0; f < F; f++)
+			{
+				const int32 Offset = (i * F + f) * W + Lane;
+				const TLanes Value(Window[i * F + f]);
+				const TLanes Outside = TLanes::Max(Value - TLanes::Load(Upper + Offset), TLanes::Max(TLanes::Load(Lower + Offset) - Value, TLanes(0.0f)));
+				Sum = Sum + Outside * Outside;
+			}
+			Bound = Bound + TLanes::Sqrt(Sum);
+		}
+		if (!TLanes::Any(Bound < Limit))
+		{
+			TLanes(BIG_NUMBER).Store(OutCosts + Lane);
+			continue;
+		}
+		// Two rows of path costs; a cell outside the band is never written before it is read as infinite
+		float Rows[2][N][W];
+		for (int32 j = 0; j < N; j++)
+		{
+			TLanes(BIG_NUMBER).Store(Rows[0][j] + Lane);
+			TLanes(BIG_NUMBER).Store(Rows[1][j] + Lane);
+		}
+		bool bAbandoned = false;
+		for (int32 i = 0; i < N && !bAbandoned; i++)
+		{
+			float (*Previous)[W] = Rows[(i + 1) & 1];
+			float (*Current)[W] = Rows[i & 1];
+			const int32 First = FMath::Max(0, i - BandRadius);
+			const int32 Last = FMath::Min(N - 1, i + BandRadius);
+			if (First > 0)
+			{
+				// Left of the band, still holding the row before last
+				TLanes(BIG_NUMBER).Store(Current[First - 1] + Lane);
+			}
+			const float *Sample = Window + i * F;
+			TLanes RowMin(BIG_NUMBER);
+			for (int32 j = First; j <= Last; j++)
+			{
+				const float *Template = Block + j * F * W + Lane;
+				TLanes Sum(0.0f);
+				for (int32 f = 0; f < F; f++)
+				{
+					const TLanes Difference = TLanes(Sample[f]) - TLanes::Load(Template + f * W);
+					Sum = Sum + Difference * Difference;
+				}
+				TLanes Best(0.0f);
+				if (i > 0 || j > 0)
+				{
+					Best = TLanes::Load(Previous[j] + Lane);
+					if (j > 0)
+					{
+						Best = TLanes::Min(Best, TLanes::Min(TLanes::Load(Previous[j - 1] + Lane), TLanes::Load(Current[j - 1] + Lane)));
+					}
+				}
+				const TLanes Cost = TLanes::Sqrt(Sum) + Best;
+				Cost.Store(Current[j] + Lane);
+				RowMin = TLanes::Min(RowMin, Cost);
+			}
+			bAbandoned = !TLanes::Any(RowMin < Limit);
+		}
+		if (bAbandoned)
+		{
+			TLanes(BIG_NUMBER).Store(OutCosts + Lane);
+			continue;
+		}
+		(TLanes::Load(Rows[(N - 1) & 1][N - 1] + Lane) * TLanes(1.0f / N)).Store(OutCosts + Lane);
+	}
+}
+
+FKinectGestureRecognizer::FKinectGestureRecognizer()
+{
+	Reset();
+}
+
+void FKinectGestureRecognizer::Reset()
+{
+	FScopeLock ScopeLock(&Lock);
+	for (int32 Body = 0; Body < BODY_COUNT; Body++)
+	{
+		Windows[Body].Head = 0;
+		Windows[Body].Num = 0;
+	}
+	for (int32 i = 0; i < MatchStates.Num(); i++)
+	{
+		MatchStates[i].BestCost = BIG_NUMBER;
+		MatchStates[i].bFired = false;
+	}
+}
+
+void FKinectGestureRecognizer::PushFrame(int32 Body, const FKinectBodyFrame &Frame)
+{
+	FBodyWindow &Window = Windows[Body];
+	if (!Frame.bTracked[Body])
+	{
+		Window.Num = 0;
+		return;
+	}
+	if (Window.Num > 0 && Frame.Time <= Window.Times[(Window.Head + Window.Num - 1) % FBodyWindow::Capacity])
+	{
+		// Time went back, as when a replay loops
+		Window.Num = 0;
+	}
+	if (Window.Num == FBodyWindow::Capacity)
+	{
+		Window.Head = (Window.Head + 1) % FBodyWindow::Capacity;
+		Window.Num--;
+	}
+	const int32 Slot = (Window.Head + Window.Num) % FBodyWindow::Capacity;
+	Window.Num++;
+	Window.Times[Slot] = Frame.Time;
+	const FVector &Shoulders = Frame.Positions[Body][JointType_SpineShoulder];
+	const float TorsoLength = FVector::Dist(Shoulders, Frame.Positions[Body][JointType_SpineBase]);
+	const float Scale = 1.0f / FMath::Max(TorsoLength, MinTorsoLength);
+	float *Features = Window.Features[Slot];
+	for (int32 j = 0; j < NumFeatureJoints; j++)
+	{
+		const FVector Position = (Frame.Positions[Body][FeatureJoints[j]] - Shoulders) * Scale;
+		Features[j * 3 + 0] = Position.X;
+		Features[j * 3 + 1] = Position.Y;
+		Features[j * 3 + 2] = Position.Z;
+	}
+}
+
+bool FKinectGestureRecognizer::Resample(const FBodyWindow &Window, float Duration, float *Out)
+{
+	if (Window.Num < 2)
+	{
+		return false;
+	}
+	const int32 Capacity = FBodyWindow::Capacity;
+	const TIMESPAN Newest = Window.Times[(Window.Head + Window.Num - 1) % Capacity];
+	const double Span = Duration * KinectTicksPerSecond;
+	const double Start = Newest - Span;
+	if (Window.Times[Window.Head] > Start)
+	{
+		return false;
+	}
+	// The last frame at or before the start of the span
+	int32 k = Window.Num - 2;
+	while (k > 0 && Window.Times[(Window.Head + k) % Capacity] > Start)
+	{
+		k--;
+	}
+	for (int32 s = 0; s < NumSamples; s++)
+	{
+		const double Time = Start + Span * s / (NumSamples - 1);
+		while (k < Window.Num - 2 && Window.Times[(Window.Head + k + 1) % Capacity] < Time)
+		{
+			k++;
+		}
+		const int32 Slot0 = (Window.Head + k) % Capacity;
+		const int32 Slot1 = (Window.Head + k + 1) % Capacity;
+		const double Time0 = static_cast<double>(Window.Times[Slot0]);
+		const double Time1 = static_cast<double>(Window.Times[Slot1]);
+		const float Alpha = static_cast<float>(FMath::Clamp((Time - Time0) / (Time1 - Time0), 0.0, 1.0));
+		for (int32 f = 0; f < NumFeatures; f++)
+		{
+			Out[s * NumFeatures + f] = FMath::Lerp(Window.Features[Slot0][f], Window.Features[Slot1][f], Alpha);
+		}
+	}
+	return true;
+}
+
+void FKinectGestureRecognizer::Update(const FKinectBodyFrame &Frame, TArray<FKinectGestureEvent> &OutEvents)
+{
+	SCOPE_CYCLE_COUNTER(STAT_KinectGestureRecognition);
+	FScopeLock ScopeLock(&Lock);
+	const int32 NumBlocks = BlockDurations.Num();
+	uint32 NeededDurations = 0;
+	for (int32 b = 0; b < NumBlocks; b++)
+	{
+		NeededDurations |= BlockDurations[b];
+	}
+	for (int32 Body = 0; Body < BODY_COUNT; Body++)
+	{
+		PushFrame(Body, Frame);
+		FMatchState *States = MatchStates.GetData() + Body * NumBlocks * BlockWidth;
+		FBodyWindow &Window = Windows[Body];
+		uint32 Durations = 0;
+		for (int32 k = 0; k < NumDurations; k++)
+		{
+			if ((NeededDurations & (1u << k)) && Resample(Window, GetWindowDuration(k), Window.Resampled[k]))
+			{
+				Durations |= 1u << k;
+			}
+		}
+		if (!Durations)
+		{
+			// Nothing to compare, which also ends any match in progress
+			for (int32 t = 0; t < NumBlocks * BlockWidth; t++)
+			{
+				States[t].BestCost = BIG_NUMBER;
+				States[t].bFired = false;
+			}
+			continue;
+		}
+		for (int32 b = 0; b < NumBlocks; b++)
+		{
+			float Costs[BlockWidth] = { BIG_NUMBER, BIG_NUMBER, BIG_NUMBER, BIG_NUMBER };
+			const uint32 BlockMask = BlockDurations[b] & Durations;
+			for (int32 k = 0; k < NumDurations; k++)
+			{
+				if (!(BlockMask & (1u << k)))
+				{
+					continue;
+				}
+				// Lanes not compared at this duration need no exact cost
+				float Limits[BlockWidth];
+				for (int32 Lane = 0; Lane < BlockWidth; Lane++)
+				{
+					Limits[Lane] = (LaneDurations[b * BlockWidth + Lane] & (1u << k)) ? LaneLimits[b * BlockWidth + Lane] : -1.0f;
+				}
+				float WarpCosts[BlockWidth];
+				WarpBlock<FKinectLanes>(Window.Resampled[k], BlockSamples.GetData() + b * BlockStride, BlockLower.GetData() + b * BlockStride,
+					BlockUpper.GetData() + b * BlockStride, Limits, WarpCosts);
+				INC_DWORD_STAT(STAT_KinectGestureWarps);
+				for (int32 Lane = 0; Lane < BlockWidth; Lane++)
+				{
+					if (LaneDurations[b * BlockWidth + Lane] & (1u << k))
+					{
+						Costs[Lane] = FMath::Min(Costs[Lane], WarpCosts[Lane]);
+					}
+				}
+			}
+			for (int32 Lane = 0; Lane < BlockWidth; Lane++)
+			{
+				const int32 TemplateIndex = BlockTemplates[b * BlockWidth + Lane];
+				if (TemplateIndex == INDEX_NONE)
+				{
+					continue;
+				}
+				const FKinectGestureTemplate &Template = Templates[TemplateIndex];
+				FMatchState &State = States[b * BlockWidth + Lane];
+				const float Cost = Costs[Lane];
+				// Fire at the best alignment: the first frame the cost stops falling, or leaves the threshold
+				if (!State.bFired && State.BestCost < Template.Threshold && (Cost >= State.BestCost || Cost >= Template.Threshold))
+				{
+					FKinectGestureEvent Event;
+					Event.Body = Body;
+					Event.Name = Template.Name;
+					Event.Cost = State.BestCost;
+					Event.Time = Frame.Time;
+					OutEvents.Add(Event);
+					State.bFired = true;
+				}
+				if (Cost < Template.Threshold)
+				{
+					State.BestCost = FMath::Min(State.BestCost, Cost);
+				}
+				else
+				{
+					State.BestCost = BIG_NUMBER;
+					State.bFired = false;
+				}
+			}
+		}
+	}
+}
+
+bool FKinectGestureRecognizer::CaptureTemplate(FName Name, int32 Body, float Duration, float Threshold)
+{
+	if (Body < 0 || Body >= BODY_COUNT)
+	{
+		return false;
+	}
+	FKinectGestureTemplate Template;
+	Template.Name = Name;
+	Template.Duration = FMath::Clamp(Duration, MinDuration, GetWindowDuration(NumDurations - 1));
+	Template.Threshold = Threshold;
+	Template.Samples.SetNumUninitialized(NumSamples * NumFeatures);
+	{
+		FScopeLock ScopeLock(&Lock);
+		if (!Resample(Windows[Body], Template.Duration, Template.Samples.GetData()))
+		{
+			return false;
+		}
+	}
+	return AddTemplate(Template);
+}
+
+bool FKinectGestureRecognizer::AddTemplate(const FKinectGestureTemplate &Template)
+{
+	if (Template.Samples.Num() != NumSamples * NumFeatures || Template.Duration <= 0.0f)
+	{
+		return false;
+	}
+	FScopeLock ScopeLock(&Lock);
+	const int32 Existing = FindTemplate(Template.Name);
+	if (Existing != INDEX_NONE)
+	{
+		Templates[Existing] = Template;
+	}
+	else
+	{
+		Templates.Add(Template);
+	}
+	RebuildBlocks();
+	return true;
+}
+
+bool FKinectGestureRecognizer::RemoveTemplate(FName Name)
+{
+	FScopeLock ScopeLock(&Lock);
+	const int32 Existing = FindTemplate(Name);
+	if (Existing == INDEX_NONE)
+	{
+		return false;
+	}
+	Templates.RemoveAt(Existing);
+	RebuildBlocks();
+	return true;
+}
+
+void FKinectGestureRecognizer::GetTemplates(TArray<FKinectGestureTemplate> &OutTemplates) const
+{
+	FScopeLock ScopeLock(&Lock);
+	OutTemplates = Templates;
+}
+
+int32 FKinectGestureRecognizer::NumTemplates() const
+{
+	FScopeLock ScopeLock(&Lock);
+	return Templates.Num();
+}
+
+int32 FKinectGestureRecognizer::FindTemplate(FName Name) const
+{
+	for (int32 i = 0; i < Templates.Num(); i++)
+	{
+		if (Templates[i].Name == Name)
+		{
+			return i;
+		}
+	}
+	return INDEX_NONE;
+}
+
+void FKinectGestureRecognizer::RebuildBlocks()
+{
+	// Templates of similar durations share a block, so its warps are mostly needed by all four
+	TArray<int32> Order;
+	for (int32 i = 0; i < Templates.Num(); i++)
+	{
+		Order.Add(i);
+	}
+	const TArray<FKinectGestureTemplate> &Sorted = Templates;
+	Order.Sort([&Sorted](int32 A, int32 B) { return Sorted[A].Duration < Sorted[B].Duration; });
+	const int32 NumBlocks = (Templates.Num() + BlockWidth - 1) / BlockWidth;
+	BlockSamples.Reset();
+	BlockSamples.SetNumZeroed(NumBlocks * BlockStride);
+	BlockLower.Reset();
+	BlockLower.SetNumZeroed(NumBlocks * BlockStride);
+	BlockUpper.Reset();
+	BlockUpper.SetNumZeroed(NumBlocks * BlockStride);
+	BlockTemplates.Init(INDEX_NONE, NumBlocks * BlockWidth);
+	LaneDurations.Init(0, NumBlocks * BlockWidth);
+	LaneLimits.Init(-1.0f, NumBlocks * BlockWidth);
+	BlockDurations.Init(0, NumBlocks);
+	for (int32 o = 0; o < Order.Num(); o++)
+	{
+		const FKinectGestureTemplate &Template = Templates[Order[o]];
+		const int32 Block = o / BlockWidth;
+		const int32 Lane = o % BlockWidth;
+		float *Samples = BlockSamples.GetData() + Block * BlockStride + Lane;
+		for (int32 i = 0; i < NumSamples * NumFeatures; i++)
+		{
+			Samples[i * BlockWidth] = Template.Samples[i];
+		}
+		uint32 Durations = 0;
+		int32 Nearest = 0;
+		for (int32 k = 0; k < NumDurations; k++)
+		{
+			const float Ratio = GetWindowDuration(k) / Template.Duration;
+			if (Ratio >= 1.0f / MaxSpeedRatio && Ratio <= MaxSpeedRatio)
+			{
+				Durations |= 1u << k;
+			}
+			if (FMath::Abs(FMath::Loge(Ratio)) < FMath::Abs(FMath::Loge(GetWindowDuration(Nearest) / Template.Duration)))
+			{
+				Nearest = k;
+			}
+		}
+		float *Lower = BlockLower.GetData() + Block * BlockStride + Lane;
+		float *Upper = BlockUpper.GetData() + Block * BlockStride + Lane;
+		for (int32 i = 0; i < NumSamples; i++)
+		{
+			for (int32 f = 0; f < NumFeatures; f++)
+			{
+				float Min = BIG_NUMBER;
+				float Max = -BIG_NUMBER;
+				for (int32 j = FMath::Max(0, i - BandRadius); j <= FMath::Min(NumSamples - 1, i + BandRadius); j++)
+				{
+					Min = FMath::Min(Min, Template.Samples[j * NumFeatures + f]);
+					Max = FMath::Max(Max, Template.Samples[j * NumFeatures + f]);
+				}
+				Lower[(i * NumFeatures + f) * BlockWidth] = Min;
+				Upper[(i * NumFeatures + f) * BlockWidth] = Max;
+			}
+		}
+		BlockTemplates[o] = Order[o];
+		LaneLimits[o] = Template.Threshold * NumSamples;
+		LaneDurations[o] = Durations ? Durations : 1u << Nearest;
+		BlockDurations[Block] |= LaneDurations[o];
+	}
+	FMatchState Idle;
+	Idle.BestCost = BIG_NUMBER;
+	Idle.bFired = false;
+	MatchStates.Init(Idle, BODY_COUNT * NumBlocks * BlockWidth);
+}
+
+bool FKinectGestureRecognizer::SaveLibrary(const FString &Filename) const
+{
+	TArray<uint8> Bytes;
+	FMemoryWriter Writer(Bytes);
+	uint32 Magic = LibraryMagic;
+	uint32 Version = LibraryVersion;
+	int32 Samples = NumSamples;
+	int32 Features = NumFeatures;
+	Writer << Magic << Version << Samples << Features;
+	{
+		FScopeLock ScopeLock(&Lock);
+		int32 Count = Templates.Num();
+		Writer << Count;
+		for (int32 i = 0; i < Templates.Num(); i++)
+		{
+			FKinectGestureTemplate Template = Templates[i];
+			FString Name = Template.Name.ToString();
+			Writer << Name << Template.Duration << Template.Threshold << Template.Samples;
+		}
+	}
+	if (!FFileHelper::SaveArrayToFile(Bytes, *Filename))
+	{
+		UE_LOG(LogKinect, Error, TEXT("Cannot write gesture library %s"), *Filename);
+		return false;
+	}
+	return true;
+}
+
+bool FKinectGestureRecognizer::LoadLibrary(const FString &Filename)
+{
+	TArray<uint8> Bytes;
+	if (!FFileHelper::LoadFileToArray(Bytes, *Filename))
+	{
+		UE_LOG(LogKinect, Error, TEXT("Cannot open gesture library %s"), *Filename);
+		return false;
+	}
+	FMemoryReader Reader(Bytes);
+	uint32 Magic = 0;
+	uint32 Version = 0;
+	int32 Samples = 0;
+	int32 Features = 0;
+	int32 Count = 0;
+	Reader << Magic << Version << Samples << Features << Count;
+	if (Reader.IsError() || Magic != LibraryMagic || Version != LibraryVersion || Samples != NumSamples || Features != NumFeatures || Count < 0)
+	{
+		UE_LOG(LogKinect, Error, TEXT("%s is not a gesture library of version %d"), *Filename, LibraryVersion);
+		return false;
+	}
+	TArray<FKinectGestureTemplate> Loaded;
+	for (int32 i = 0; i < Count && !Reader.IsError(); i++)
+	{
+		FKinectGestureTemplate Template;
+		FString Name;
+		Reader << Name << Template.Duration << Template.Threshold << Template.Samples;
+		Template.Name = FName(*Name);
+		if (Template.Samples.Num() != NumSamples * NumFeatures || Template.Duration <= 0.0f)
+		{
+			break;
+		}
+		Loaded.Add(Template);
+	}
+	if (Reader.IsError() || Loaded.Num() != Count)
+	{
+		UE_LOG(LogKinect, Error, TEXT("Gesture library %s is damaged"), *Filename);
+		return false;
+	}
+	FScopeLock ScopeLock(&Lock);
+	Templates = Loaded;
+	RebuildBlocks();
+	return true;
+}
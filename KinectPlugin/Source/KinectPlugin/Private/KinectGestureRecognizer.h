@@ -0,0 +1,148 @@
+#pragma once
+
+#include "Engine.h"
+#include "KinectBodyFrame.h"
+
+/** A recorded gesture, the way the recognizer compares it. */
+struct FKinectGestureTemplate
+{
+	FName Name;
+	/** How long the recorded gesture took, in seconds. */
+	float Duration;
+	/** Largest mean distance per sample, in torso lengths, that still counts as the gesture. */
+	float Threshold;
+	/** NumSamples frames of NumFeatures values each. */
+	TArray<float> Samples;
+
+	FKinectGestureTemplate()
+		: Duration(0.0f)
+		, Threshold(0.0f)
+	{
+	}
+};
+
+/** A gesture a body completed. */
+struct FKinectGestureEvent
+{
+	int32 Body;
+	FName Name;
+	/** Mean distance per sample to the template; lower is a closer match. */
+	float Cost;
+	/** RelativeTime of the body frame that completed the gesture. */
+	TIMESPAN Time;
+};
+
+/**
+ * Spots recorded gestures in the motion of every tracked body.
+ *
+ * Each body keeps a sliding window of its recent frames, reduced to the
+ * hand and elbow positions relative to the shoulders and scaled by torso
+ * length, so templates carry over between people and distances from the
+ * sensor. On every frame the recent past is resampled at a fixed set of
+ * durations and each template is compared, by dynamic time warping within a
+ * band around the diagonal, to the durations close to its own. The templates
+ * are stored four to a block, one per SSE lane, so one warp compares four
+ * templates at once, and a warp is cut short as soon as none of the four can
+ * come in under its threshold any more.
+ *
+ * A gesture fires once, on the frame after its cost stopped falling below the
+ * template's threshold, and fires again only after the cost rose above it.
+ * Updates run on one thread; the library can be changed from any other.
+ */
+class FKinectGestureRecognizer
+{
+public:
+	/** Samples every template and window is resampled to. */
+	static const int32 NumSamples = 16;
+	/** Joints whose positions make up a sample. */
+	static const int32 NumFeatureJoints = 4;
+	static const int32 NumFeatures = NumFeatureJoints * 3;
+	/** Templates compared by one warp. */
+	static const int32 BlockWidth = 4;
+	/** Window durations the recent past is resampled at, MinDuration growing by DurationStep. */
+	static const int32 NumDurations = 10;
+	static const float MinDuration;
+	static const float DurationStep;
+	/** How much faster or slower than its template a gesture may be performed. */
+	static const float MaxSpeedRatio;
+
+	FKinectGestureRecognizer();
+
+	/** Feeds the next body frame and appends the gestures it completed to OutEvents. */
+	void Update(const FKinectBodyFrame &Frame, TArray<FKinectGestureEvent> &OutEvents);
+
+	/** Forgets the recent motion of every body; the library stays. */
+	void Reset();
+
+	/**
+	 * Adds the last Duration seconds of body Body's motion as a template,
+	 * replacing any template of the same name.
+	 *
+	 * @return false if the body was not tracked for that long.
+	 */
+	bool CaptureTemplate(FName Name, int32 Body, float Duration, float Threshold);
+
+	/** Adds a template, replacing any template of the same name. */
+	bool AddTemplate(const FKinectGestureTemplate &Template);
+
+	bool RemoveTemplate(FName Name);
+
+	void GetTemplates(TArray<FKinectGestureTemplate> &OutTemplates) const;
+
+	int32 NumTemplates() const;
+
+	bool SaveLibrary(const FString &Filename) const;
+
+	/** Replaces the library with the templates in Filename. */
+	bool LoadLibrary(const FString &Filename);
+
+private:
+	/** Recent frames of one body. */
+	struct FBodyWindow
+	{
+		static const int32 Capacity = 96;
+		TIMESPAN Times[Capacity];
+		float Features[Capacity][NumFeatures];
+		int32 Head;
+		int32 Num;
+		/** The window resampled at each duration, rebuilt on every frame that needs it. */
+		float Resampled[NumDurations][NumSamples * NumFeatures];
+	};
+
+	/** Per body and template: the lowest cost since it fell below the threshold, and whether it fired since. */
+	struct FMatchState
+	{
+		float BestCost;
+		bool bFired;
+	};
+
+	void PushFrame(int32 Body, const FKinectBodyFrame &Frame);
+
+	/** Resamples the last Duration seconds of Window into Out; false if the window is shorter. */
+	static bool Resample(const FBodyWindow &Window, float Duration, float *Out);
+
+	/** Sorts the templates by duration and lays them out in blocks. Called with the lock held. */
+	void RebuildBlocks();
+
+	/** Called with the lock held. */
+	int32 FindTemplate(FName Name) const;
+
+	mutable FCriticalSection Lock;
+	TArray<FKinectGestureTemplate> Templates;
+	/** Per block, sample by sample and feature by feature, the values of its BlockWidth templates side by side. */
+	TArray<float> BlockSamples;
+	/** Laid out as BlockSamples: the least and greatest value within the warping band around each sample. */
+	TArray<float> BlockLower;
+	TArray<float> BlockUpper;
+	/** Per template, in block order: its index in Templates, or INDEX_NONE for padding. */
+	TArray<int32> BlockTemplates;
+	/** Per template in block order, a bit for every window duration it is compared at. */
+	TArray<uint32> LaneDurations;
+	/** Per template in block order, its threshold as a path cost; a warp stops once every lane is past its limit. */
+	TArray<float> LaneLimits;
+	/** Per block, the union of its templates' durations. */
+	TArray<uint32> BlockDurations;
+	FBodyWindow Windows[BODY_COUNT];
+	/** BODY_COUNT rows of one state per template in block order. */
+	TArray<FMatchState> MatchStates;
+};
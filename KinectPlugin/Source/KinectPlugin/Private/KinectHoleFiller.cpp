@@ -0,0 +1,421 @@
+#include "KinectPluginPrivatePCH.h"
+#include "KinectHoleFiller.h"
+#include "AllowWindowsPlatformTypes.h"
+#include "ppl.h"
+#include "HideWindowsPlatformTypes.h"
+
+DECLARE_CYCLE_STAT(TEXT("Fill Holes"), STAT_KinectFillHoles, STATGROUP_Kinect);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Holes Filled"), STAT_KinectHolesFilled, STATGROUP_Kinect);
+
+/** Holes are zero, which would always be the minimum, so they count as the largest depth instead. */
+static FORCEINLINE uint16 MinKey(uint16 Depth)
+{
+	return Depth ? Depth : MAX_uint16;
+}
+
+/** Columns a task of the vertical pass slides at once, a few cache lines of each row. */
+static const int32 BandWidth = 64;
+
+/** Rows a task of the median pass slides its column bins down; each task starts them over. */
+static const int32 StripHeight = 32;
+
+/** Up to this radius a window is a handful of pixels, and gathering it beats building the tables. */
+static const int32 MaxDirectRadius = 2;
+
+/** Most depth bins the median keeps per column; larger ranges gather the window instead. */
+static const int32 MaxBins = 256;
+
+/** Adds Sign to the bin of every valid depth of Row in its column's bins. */
+static FORCEINLINE void CountRow(const uint16 *Row, int32 Width, int32 BinMask, int32 Sign, int32 *ColumnBins)
+{
+	const int32 NumBins = BinMask + 1;
+	for (int32 x = 0; x < Width; x++)
+	{
+		if (Row[x])
+		{
+			ColumnBins[x * NumBins + (Row[x] & BinMask)] += Sign;
+		}
+	}
+}
+
+/** Adds Sign times one column's bins to a window's. */
+static FORCEINLINE void AddBins(const int32 *Column, int32 NumBins, int32 Sign, int32 *Window)
+{
+	for (int32 b = 0; b < NumBins; b++)
+	{
+		Window[b] += Sign * Column[b];
+	}
+}
+
+/** Smallest or largest, with holes neutral to both. */
+template<bool bMin>
+struct TExtreme
+{
+	static FORCEINLINE uint16 Key(uint16 Depth)
+	{
+		return bMin ? MinKey(Depth) : Depth;
+	}
+
+	static FORCEINLINE uint16 Neutral()
+	{
+		return bMin ? MAX_uint16 : 0;
+	}
+
+	static FORCEINLINE uint16 Apply(uint16 A, uint16 B)
+	{
+		return bMin ? FMath::Min(A, B) : FMath::Max(A, B);
+	}
+};
+
+/**
+ * Writes to Out, for every window i - Radius to i + Radius - 1 of a line of
+ * Num elements, the extreme of each of its Span values; elements are Stride
+ * apart and values beyond the line's ends are neutral. Van Herk and
+ * Gil-Werman's algorithm: the padded line is cut into blocks of the window's
+ * length, and every window is one block's suffix and the next one's prefix,
+ * so a line takes three operations per value whatever the radius. Rows of
+ * Span values are processed whole, so a column pass streams through memory.
+ * Forward and Backward hold (Num + 2 * Radius) * Span values.
+ */
+template<bool bMin>
+static void SlidingExtreme(const uint16 *In, int32 Num, int32 Span, int32 Stride, int32 Radius, uint16 *Forward, uint16 *Backward, uint16 *Out)
+{
+	typedef TExtreme<bMin> FOp;
+	const int32 Length = 2 * Radius;
+	const int32 NumPadded = Num + Length;
+	// Element p of the padded line is element p - Radius of In; Phase is p % Length, kept without dividing
+	for (int32 p = 0, Phase = 0; p < NumPadded; p++, Phase = Phase == Length - 1 ? 0 : Phase + 1)
+	{
+		const int32 i = p - Radius;
+		const uint16 *Values = In + i * Stride;
+		uint16 *Prefix = Forward + p * Span;
+		const bool bInside = i >= 0 && i < Num;
+		if (Phase == 0)
+		{
+			for (int32 s = 0; s < Span; s++)
+			{
+				Prefix[s] = bInside ? FOp::Key(Values[s]) : FOp::Neutral();
+			}
+		}
+		else if (bInside)
+		{
+			const uint16 *Previous = Prefix - Span;
+			for (int32 s = 0; s < Span; s++)
+			{
+				Prefix[s] = FOp::Apply(Previous[s], FOp::Key(Values[s]));
+			}
+		}
+		else
+		{
+			FMemory::Memcpy(Prefix, Prefix - Span, Span * sizeof(uint16));
+		}
+	}
+	for (int32 p = NumPadded - 1, Phase = p % Length; p >= 0; p--, Phase = Phase == 0 ? Length - 1 : Phase - 1)
+	{
+		const int32 i = p - Radius;
+		const uint16 *Values = In + i * Stride;
+		uint16 *Suffix = Backward + p * Span;
+		const bool bInside = i >= 0 && i < Num;
+		if (Phase == Length - 1 || p == NumPadded - 1)
+		{
+			for (int32 s = 0; s < Span; s++)
+			{
+				Suffix[s] = bInside ? FOp::Key(Values[s]) : FOp::Neutral();
+			}
+		}
+		else if (bInside)
+		{
+			const uint16 *Next = Suffix + Span;
+			for (int32 s = 0; s < Span; s++)
+			{
+				Suffix[s] = FOp::Apply(Next[s], FOp::Key(Values[s]));
+			}
+		}
+		else
+		{
+			FMemory::Memcpy(Suffix, Suffix + Span, Span * sizeof(uint16));
+		}
+	}
+	// The window of i is padded elements i to i + Length - 1
+	for (int32 i = 0; i < Num; i++)
+	{
+		const uint16 *Suffix = Backward + i * Span;
+		const uint16 *Prefix = Forward + (i + Length - 1) * Span;
+		uint16 *Result = Out + i * Stride;
+		for (int32 s = 0; s < Span; s++)
+		{
+			Result[s] = FOp::Apply(Suffix[s], Prefix[s]);
+		}
+	}
+}
+
+/**
+ * SlidingExtreme for a row, with the minimum and the maximum taken in the same
+ * pass. A row is a single element wide, where the per element loops of the
+ * general version cost more than the comparisons. Scratch holds
+ * 4 * (Width + 2 * Radius) values.
+ */
+static void SlidingRowExtremes(const uint16 *Row, int32 Width, int32 Radius, uint16 *Scratch, uint16 *OutMin, uint16 *OutMax)
+{
+	const int32 Length = 2 * Radius;
+	const int32 NumPadded = Width + Length;
+	uint16 *ForwardMin = Scratch;
+	uint16 *ForwardMax = ForwardMin + NumPadded;
+	uint16 *BackwardMin = ForwardMax + NumPadded;
+	uint16 *BackwardMax = BackwardMin + NumPadded;
+	for (int32 p = 0, Phase = 0; p < NumPadded; p++, Phase = Phase == Length - 1 ? 0 : Phase + 1)
+	{
+		const int32 x = p - Radius;
+		const uint16 Value = x >= 0 && x < Width ? Row[x] : 0;
+		const uint16 Key = MinKey(Value);
+		ForwardMin[p] = Phase == 0 ? Key : FMath::Min(ForwardMin[p - 1], Key);
+		ForwardMax[p] = Phase == 0 ? Value : FMath::Max(ForwardMax[p - 1], Value);
+	}
+	for (int32 p = NumPadded - 1, Phase = p % Length; p >= 0; p--, Phase = Phase == 0 ? Length - 1 : Phase - 1)
+	{
+		const int32 x = p - Radius;
+		const uint16 Value = x >= 0 && x < Width ? Row[x] : 0;
+		const uint16 Key = MinKey(Value);
+		const bool bBlockEnd = Phase == Length - 1 || p == NumPadded - 1;
+		BackwardMin[p] = bBlockEnd ? Key : FMath::Min(BackwardMin[p + 1], Key);
+		BackwardMax[p] = bBlockEnd ? Value : FMath::Max(BackwardMax[p + 1], Value);
+	}
+	for (int32 x = 0; x < Width; x++)
+	{
+		OutMin[x] = FMath::Min(BackwardMin[x], ForwardMin[x + Length - 1]);
+		OutMax[x] = FMath::Max(BackwardMax[x], ForwardMax[x + Length - 1]);
+	}
+}
+
+void FKinectHoleFiller::Fill(const uint16 *Depth, int32 Width, int32 Height, const FKinectHoleFillSettings &Settings, uint16 *Out)
+{
+	SCOPE_CYCLE_COUNTER(STAT_KinectFillHoles);
+	const int32 Radius = Settings.Radius;
+	if (Radius < 1 || Width < 1 || Height < 1)
+	{
+		FMemory::Memcpy(Out, Depth, Width * Height * sizeof(uint16));
+		return;
+	}
+	if (Radius <= MaxDirectRadius || static_cast<int32>(FMath::RoundUpToPowerOfTwo(FMath::Max(Settings.MaxRange, 1))) > MaxBins)
+	{
+		FillDirect(Depth, Width, Height, Settings, Out);
+		return;
+	}
+	const int32 RowPitch = Width + 1;
+	RowCounts.SetNumUninitialized(RowPitch * Height);
+	Counts.SetNumUninitialized(RowPitch * (Height + 1));
+	RowMin.SetNumUninitialized(Width * Height);
+	RowMax.SetNumUninitialized(Width * Height);
+	WindowMin.SetNumUninitialized(Width * Height);
+	WindowMax.SetNumUninitialized(Width * Height);
+
+	Concurrency::combinable<TArray<uint16>> Scratches;
+	Concurrency::parallel_for(0, Height, [&](int y)
+	{
+		TArray<uint16> &Scratch = Scratches.local();
+		Scratch.SetNumUninitialized(4 * (Width + 2 * Radius));
+		const uint16 *Row = Depth + y * Width;
+		int32 *Count = RowCounts.GetData() + y * RowPitch;
+		Count[0] = 0;
+		for (int32 x = 0; x < Width; x++)
+		{
+			Count[x + 1] = Count[x] + (Row[x] != 0);
+		}
+		SlidingRowExtremes(Row, Width, Radius, Scratch.GetData(), RowMin.GetData() + y * Width, RowMax.GetData() + y * Width);
+	});
+	// Bands of columns slide down the rows together
+	const int32 NumBands = FMath::DivideAndRoundUp(Width, BandWidth);
+	Concurrency::parallel_for(0, NumBands, [&](int Band)
+	{
+		const int32 x = Band * BandWidth;
+		const int32 Span = FMath::Min(BandWidth, Width - x);
+		TArray<uint16> &Scratch = Scratches.local();
+		Scratch.SetNumUninitialized(2 * (Height + 2 * Radius) * BandWidth);
+		uint16 *Forward = Scratch.GetData();
+		uint16 *Backward = Forward + (Height + 2 * Radius) * BandWidth;
+		SlidingExtreme<true>(RowMin.GetData() + x, Height, Span, Width, Radius, Forward, Backward, WindowMin.GetData() + x);
+		SlidingExtreme<false>(RowMax.GetData() + x, Height, Span, Width, Radius, Forward, Backward, WindowMax.GetData() + x);
+	});
+	// The summed area table is a running sum down the rows, cheap enough to build on one thread
+	FMemory::Memzero(Counts.GetData(), RowPitch * sizeof(int32));
+	for (int32 y = 0; y < Height; y++)
+	{
+		const int32 *Above = Counts.GetData() + y * RowPitch;
+		const int32 *Row = RowCounts.GetData() + y * RowPitch;
+		int32 *Below = Counts.GetData() + (y + 1) * RowPitch;
+		for (int32 x = 0; x <= Width; x++)
+		{
+			Below[x] = Above[x] + Row[x];
+		}
+	}
+
+	// Depths of a window that passes lie less than MaxRange apart, so binning them by depth modulo
+	// a power of two at least that large still gives every depth a bin of its own
+	const int32 NumBins = static_cast<int32>(FMath::RoundUpToPowerOfTwo(FMath::Max(Settings.MaxRange, 1)));
+	const int32 BinMask = NumBins - 1;
+	const int32 NumStrips = FMath::DivideAndRoundUp(Height, StripHeight);
+	Concurrency::combinable<TArray<int32>> Histograms;
+	Concurrency::combinable<int32> Filled;
+	Concurrency::parallel_for(0, NumStrips, [&](int Strip)
+	{
+		const int32 FirstRow = Strip * StripHeight;
+		const int32 LastRow = FMath::Min(FirstRow + StripHeight, Height);
+		TArray<int32> &Histogram = Histograms.local();
+		Histogram.SetNumUninitialized((Width + 1) * NumBins);
+		// Bins of every column over the window's rows, followed by the bins of one window
+		int32 *ColumnBins = Histogram.GetData();
+		int32 *WindowBins = ColumnBins + Width * NumBins;
+		FMemory::Memzero(ColumnBins, Width * NumBins * sizeof(int32));
+		for (int32 y = FMath::Max(FirstRow - Radius, 0); y < FMath::Min(FirstRow + Radius, Height); y++)
+		{
+			CountRow(Depth + y * Width, Width, BinMask, 1, ColumnBins);
+		}
+		for (int32 y0 = FirstRow; y0 < LastRow; y0++)
+		{
+			// The column bins slide down one row, constant work per pixel whatever the radius
+			if (y0 > FirstRow && y0 - 1 - Radius >= 0)
+			{
+				CountRow(Depth + (y0 - 1 - Radius) * Width, Width, BinMask, -1, ColumnBins);
+			}
+			if (y0 > FirstRow && y0 + Radius - 1 < Height)
+			{
+				CountRow(Depth + (y0 + Radius - 1) * Width, Width, BinMask, 1, ColumnBins);
+			}
+			const int32 Top = FMath::Max(y0 - Radius, 0);
+			const int32 Bottom = FMath::Min(y0 + Radius, Height);
+			// The ring rows exist only where the window is not cut off by the image border
+			const bool bTopRing = y0 - Radius >= 0;
+			const bool bBottomRing = y0 + Radius - 1 < Height;
+			const int32 *CountsTop = Counts.GetData() + Top * RowPitch;
+			const int32 *CountsBottom = Counts.GetData() + Bottom * RowPitch;
+			const int32 *RingTop = Counts.GetData() + (Top + (bTopRing ? 1 : 0)) * RowPitch;
+			const int32 *RingBottom = Counts.GetData() + FMath::Max(Bottom - (bBottomRing ? 1 : 0), Top + (bTopRing ? 1 : 0)) * RowPitch;
+			// Columns the window bins hold, moved along only when a hole needs its median
+			int32 WindowLeft = 0;
+			int32 WindowRight = 0;
+			for (int32 x0 = 0; x0 < Width; x0++)
+			{
+				const int32 i = y0 * Width + x0;
+				Out[i] = Depth[i];
+				if (Depth[i] != 0)
+				{
+					continue;
+				}
+				const int32 Left = FMath::Max(x0 - Radius, 0);
+				const int32 Right = FMath::Min(x0 + Radius, Width);
+				const int32 NumValid = CountsBottom[Right] - CountsTop[Right] - CountsBottom[Left] + CountsTop[Left];
+				const uint16 Min = WindowMin[i];
+				const uint16 Max = WindowMax[i];
+				if (NumValid == 0 || NumValid < Settings.MinNeighbors || Max - Min >= Settings.MaxRange)
+				{
+					continue;
+				}
+				int32 Enclosed = 0;
+				if (bTopRing)
+				{
+					const int32 *Row = RowCounts.GetData() + (y0 - Radius) * RowPitch;
+					Enclosed += Row[Right] - Row[Left];
+				}
+				if (bBottomRing)
+				{
+					const int32 *Row = RowCounts.GetData() + (y0 + Radius - 1) * RowPitch;
+					Enclosed += Row[Right] - Row[Left];
+				}
+				// The columns without the corners the rows already counted, as one pixel wide summed areas
+				if (x0 - Radius >= 0)
+				{
+					const int32 c = x0 - Radius;
+					Enclosed += RingBottom[c + 1] - RingTop[c + 1] - RingBottom[c] + RingTop[c];
+				}
+				if (x0 + Radius - 1 < Width)
+				{
+					const int32 c = x0 + Radius - 1;
+					Enclosed += RingBottom[c + 1] - RingTop[c + 1] - RingBottom[c] + RingTop[c];
+				}
+				if (Enclosed < Settings.MinEnclosed)
+				{
+					continue;
+				}
+				if (Left >= WindowRight)
+				{
+					FMemory::Memzero(WindowBins, NumBins * sizeof(int32));
+					WindowRight = Left;
+				}
+				else
+				{
+					for (int32 c = WindowLeft; c < Left; c++)
+					{
+						AddBins(ColumnBins + c * NumBins, NumBins, -1, WindowBins);
+					}
+				}
+				for (int32 c = WindowRight; c < Right; c++)
+				{
+					AddBins(ColumnBins + c * NumBins, NumBins, 1, WindowBins);
+				}
+				WindowLeft = Left;
+				WindowRight = Right;
+				// The upper median, as the sorted gather picked it
+				int32 Rank = NumValid / 2;
+				int32 Median = Min;
+				while (Rank >= WindowBins[Median & BinMask])
+				{
+					Rank -= WindowBins[Median++ & BinMask];
+				}
+				Out[i] = static_cast<uint16>(Median);
+				Filled.local()++;
+			}
+		}
+	});
+	INC_DWORD_STAT_BY(STAT_KinectHolesFilled, Filled.combine(std::plus<int32>()));
+}
+
+void FKinectHoleFiller::FillDirect(const uint16 *Depth, int32 Width, int32 Height, const FKinectHoleFillSettings &Settings, uint16 *Out)
+{
+	const int32 Radius = Settings.Radius;
+	Concurrency::combinable<TArray<uint16>> Gathers;
+	Concurrency::combinable<int32> Filled;
+	Concurrency::parallel_for(0, Height, [&](int y0)
+	{
+		TArray<uint16> &Values = Gathers.local();
+		const int32 Top = FMath::Max(y0 - Radius, 0);
+		const int32 Bottom = FMath::Min(y0 + Radius, Height);
+		for (int32 x0 = 0; x0 < Width; x0++)
+		{
+			const int32 i = y0 * Width + x0;
+			Out[i] = Depth[i];
+			if (Depth[i] != 0)
+			{
+				continue;
+			}
+			const int32 Left = FMath::Max(x0 - Radius, 0);
+			const int32 Right = FMath::Min(x0 + Radius, Width);
+			uint16 Min = MAX_uint16;
+			uint16 Max = 0;
+			int32 Enclosed = 0;
+			Values.Reset();
+			for (int32 y = Top; y < Bottom; y++)
+			{
+				const uint16 *Row = Depth + y * Width;
+				const bool bRingRow = y == y0 - Radius || y == y0 + Radius - 1;
+				for (int32 x = Left; x < Right; x++)
+				{
+					if (Row[x])
+					{
+						Values.Add(Row[x]);
+						Min = FMath::Min(Min, Row[x]);
+						Max = FMath::Max(Max, Row[x]);
+						Enclosed += bRingRow || x == x0 - Radius || x == x0 + Radius - 1 ? 1 : 0;
+					}
+				}
+			}
+			if (Values.Num() == 0 || Values.Num() < Settings.MinNeighbors || Max - Min >= Settings.MaxRange || Enclosed < Settings.MinEnclosed)
+			{
+				continue;
+			}
+			Values.Sort();
+			Out[i] = Values[Values.Num() / 2];
+			Filled.local()++;
+		}
+	});
+	INC_DWORD_STAT_BY(STAT_KinectHolesFilled, Filled.combine(std::plus<int32>()));
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include "Engine.h"
+
+/** Thresholds of FKinectHoleFiller, named after the paper's Tc, Te and Tr. */
+struct FKinectHoleFillSettings
+{
+	/** Half the edge length of the square window around a hole, in pixels. */
+	int32 Radius;
+	/** Tc: valid pixels the window needs at least. */
+	int32 MinNeighbors;
+	/** Te: valid pixels the outermost ring of the window needs at least, so the hole is enclosed. */
+	int32 MinEnclosed;
+	/** Tr: the valid pixels of the window must span less than this, in millimeters. */
+	int32 MaxRange;
+
+	FKinectHoleFillSettings()
+		: Radius(10)
+		, MinNeighbors(2)
+		, MinEnclosed(2)
+		, MaxRange(10)
+	{
+	}
+};
+
+/**
+ * Fills holes of a depth image with the median of the valid pixels around
+ * them, Algorithm 1 of Maimone and Fuchs, "Reducing interference between
+ * multiple structured light depth sensors using motion" (2012).
+ *
+ * The window of a pixel at x, y spans x - Radius to x + Radius - 1 and the
+ * same rows. Rather than gathering it for every hole, the tests read
+ * precomputed images: the valid pixel counts of the window and of its ring
+ * come from summed area tables, its minimum and maximum from separable
+ * sliding window passes, all in constant time per pixel. The median counts
+ * depths in per column histograms that slide down the image, summed into
+ * the window's as it moves along a row, so it does not depend on the
+ * radius either; a window that passes spans fewer than MaxRange depths, so
+ * a few bins suffice. Windows of small radii are cheaper to gather than
+ * the tables are to build, and are gathered directly, as are windows with
+ * a MaxRange too large to bin.
+ */
+class FKinectHoleFiller
+{
+public:
+	/** Copies Depth to Out, filling the holes that pass the tests. */
+	void Fill(const uint16 *Depth, int32 Width, int32 Height, const FKinectHoleFillSettings &Settings, uint16 *Out);
+
+private:
+	/** Gathers the window of every hole, as the paper does. */
+	void FillDirect(const uint16 *Depth, int32 Width, int32 Height, const FKinectHoleFillSettings &Settings, uint16 *Out);
+
+	/** Valid pixels of each row up to each column, Width + 1 per row. */
+	TArray<int32> RowCounts;
+	/** Valid pixels above and left of each pixel, (Width + 1) * (Height + 1). */
+	TArray<int32> Counts;
+	/** Minimum and maximum of the valid pixels over each row's window span, then over the whole window. */
+	TArray<uint16> RowMin;
+	TArray<uint16> RowMax;
+	TArray<uint16> WindowMin;
+	TArray<uint16> WindowMax;
+};
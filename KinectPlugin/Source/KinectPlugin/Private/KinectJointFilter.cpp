@@ -0,0 +1,253 @@
+#include "KinectPluginPrivatePCH.h"
+#include "KinectJointFilter.h"
+#include "KinectSimd.h"
+
+DECLARE_CYCLE_STAT(TEXT("Joint Filter"), STAT_KinectJointFilter, STATGROUP_Kinect);
+
+/** A frame later than this restarts the filter rather than smoothing across the gap. */
+static const double MaxFrameGapSeconds = 0.5;
+
+/** Smoothing factor of an exponential low pass with cutoff Cutoff Hz at a sample interval Dt. */
+template<typename TLanes>
+static FORCEINLINE TLanes LowPassAlpha(TLanes Cutoff, TLanes Dt)
+{
+	const TLanes Te = Cutoff * Dt * TLanes(2.0f * PI);
+	return Te / (Te + TLanes(1.0f));
+}
+
+template<typename TLanes>
+static void OneEuroLanes(FKinectJointFilter::FChannel &Channel, const float *History, int32 Lane, float Dt)
+{
+	const int32 N = Channel.NumComponents;
+	const TLanes Interval(Dt);
+	const TLanes InverseInterval(1.0f / Dt);
+	const typename TLanes::FMask bStarted = TLanes(0.5f) < TLanes::Load(History + Lane);
+	const TLanes DerivativeAlpha = LowPassAlpha(TLanes::Load(Channel.DerivativeCutoff + Lane), Interval);
+	TLanes Speed2(0.0f);
+	TLanes Derivative[FKinectJointFilter::MaxComponents] = { 0.0f, 0.0f, 0.0f, 0.0f };
+	for (int32 c = 0; c < N; c++)
+	{
+		const TLanes Raw = TLanes::Load(Channel.Raw[c] + Lane);
+		const TLanes Estimate = TLanes::Load(Channel.Estimate[c] + Lane);
+		const TLanes PreviousDerivative = TLanes::Load(Channel.Trend[c] + Lane);
+		const TLanes Rate = (Raw - Estimate) * InverseInterval;
+		Derivative[c] = TLanes::Select(bStarted, PreviousDerivative + DerivativeAlpha * (Rate - PreviousDerivative), TLanes(0.0f));
+		Speed2 = Speed2 + Derivative[c] * Derivative[c];
+	}
+	// One cutoff for all components, from the speed of the joint as a whole
+	const TLanes Cutoff = TLanes::Load(Channel.MinCutoff + Lane) + TLanes::Load(Channel.Beta + Lane) * TLanes::Sqrt(Speed2);
+	const TLanes Alpha = LowPassAlpha(Cutoff, Interval);
+	for (int32 c = 0; c < N; c++)
+	{
+		const TLanes Raw = TLanes::Load(Channel.Raw[c] + Lane);
+		const TLanes Estimate = TLanes::Load(Channel.Estimate[c] + Lane);
+		const TLanes Filtered = TLanes::Select(bStarted, Estimate + Alpha * (Raw - Estimate), Raw);
+		Filtered.Store(Channel.Estimate[c] + Lane);
+		Filtered.Store(Channel.Raw[c] + Lane);
+		Derivative[c].Store(Channel.Trend[c] + Lane);
+	}
+}
+
+template<typename TLanes>
+static void DoubleExponentialLanes(FKinectJointFilter::FChannel &Channel, const float *History, int32 Lane)
+{
+	const int32 N = Channel.NumComponents;
+	const TLanes Count = TLanes::Load(History + Lane);
+	const typename TLanes::FMask bStarted = TLanes(0.5f) < Count;
+	const typename TLanes::FMask bRunning = TLanes(1.5f) < Count;
+	const TLanes Zero(0.0f);
+	const TLanes One(1.0f);
+	const TLanes Smoothing = TLanes::Load(Channel.Smoothing + Lane);
+	const TLanes Correction = TLanes::Load(Channel.Correction + Lane);
+	const TLanes Prediction = TLanes::Load(Channel.Prediction + Lane);
+	const TLanes JitterRadius = TLanes::Load(Channel.JitterRadius + Lane);
+	const TLanes MaxDeviationRadius = TLanes::Load(Channel.MaxDeviationRadius + Lane);
+
+	// Moves within the jitter radius of the last estimate are scaled down by how far inside they are
+	TLanes Distance2(0.0f);
+	for (int32 c = 0; c < N; c++)
+	{
+		const TLanes Delta = TLanes::Load(Channel.Raw[c] + Lane) - TLanes::Load(Channel.Estimate[c] + Lane);
+		Distance2 = Distance2 + Delta * Delta;
+	}
+	const TLanes Distance = TLanes::Sqrt(Distance2);
+	const TLanes JitterWeight = TLanes::Select(TLanes::And(Distance < JitterRadius, Zero < JitterRadius),
+		Distance / TLanes::Max(JitterRadius, TLanes(1e-6f)), One);
+
+	TLanes Predicted[FKinectJointFilter::MaxComponents] = { 0.0f, 0.0f, 0.0f, 0.0f };
+	TLanes Deviation2(0.0f);
+	for (int32 c = 0; c < N; c++)
+	{
+		const TLanes Raw = TLanes::Load(Channel.Raw[c] + Lane);
+		const TLanes Estimate = TLanes::Load(Channel.Estimate[c] + Lane);
+		const TLanes Trend = TLanes::Load(Channel.Trend[c] + Lane);
+		const TLanes PreviousRaw = TLanes::Load(Channel.PreviousRaw[c] + Lane);
+		const TLanes Dejittered = Estimate + JitterWeight * (Raw - Estimate);
+		// The second frame only has a trend to go by once it is averaged with the first
+		TLanes Filtered = TLanes::Select(bRunning, Dejittered * (One - Smoothing) + (Estimate + Trend) * Smoothing, (Raw + PreviousRaw) * TLanes(0.5f));
+		Filtered = TLanes::Select(bStarted, Filtered, Raw);
+		const TLanes NewTrend = TLanes::Select(bStarted, (Filtered - Estimate) * Correction + Trend * (One - Correction), Zero);
+		Filtered.Store(Channel.Estimate[c] + Lane);
+		NewTrend.Store(Channel.Trend[c] + Lane);
+		Raw.Store(Channel.PreviousRaw[c] + Lane);
+		Predicted[c] = Filtered + NewTrend * Prediction;
+		const TLanes Deviation = Predicted[c] - Raw;
+		Deviation2 = Deviation2 + Deviation * Deviation;
+	}
+	// Predictions straying too far are pulled back onto the max deviation radius around the input
+	const TLanes Deviation = TLanes::Sqrt(Deviation2);
+	const TLanes Pull = TLanes::Select(TLanes::And(MaxDeviationRadius < Deviation, Zero < MaxDeviationRadius),
+		MaxDeviationRadius / TLanes::Max(Deviation, TLanes(1e-6f)), One);
+	for (int32 c = 0; c < N; c++)
+	{
+		const TLanes Raw = TLanes::Load(Channel.Raw[c] + Lane);
+		(Raw + Pull * (Predicted[c] - Raw)).Store(Channel.Raw[c] + Lane);
+	}
+}
+
+/** Runs the filter over lanes [0, NumLanes), NumLanes a multiple of four. */
+template<typename TLanes>
+static void FilterChannel(EKinectJointFilter::Type Type, FKinectJointFilter::FChannel &Channel, const float *History, float Dt)
+{
+	for (int32 Lane = 0; Lane < FKinectJointFilter::NumLanes; Lane += TLanes::Width)
+	{
+		if (Type == EKinectJointFilter::OneEuro)
+		{
+			OneEuroLanes<TLanes>(Channel, History, Lane, Dt);
+		}
+		else
+		{
+			DoubleExponentialLanes<TLanes>(Channel, History, Lane);
+		}
+	}
+}
+
+FKinectJointFilter::FKinectJointFilter()
+	: Type(EKinectJointFilter::None)
+	, bScalarLanes(false)
+	, LastTime(0)
+{
+	FMemory::Memzero(Channels, sizeof(Channels));
+	Channels[Position].NumComponents = 3;
+	Channels[Orientation].NumComponents = 4;
+	SetParams(Position, GetDefaultParams(Position));
+	SetParams(Orientation, GetDefaultParams(Orientation));
+	Reset();
+}
+
+FKinectJointFilterParams FKinectJointFilter::GetDefaultParams(EChannel Channel)
+{
+	FKinectJointFilterParams Params;
+	if (Channel == Orientation)
+	{
+		// Quaternion components change by about half an angle in radians, the radii are in those units
+		Params.Beta = 0.5f;
+		Params.JitterRadius = 0.05f;
+		Params.MaxDeviationRadius = 0.04f;
+	}
+	return Params;
+}
+
+void FKinectJointFilter::SetParams(EChannel Channel, int32 Joint, const FKinectJointFilterParams &Params)
+{
+	FChannel &Lanes = Channels[Channel];
+	for (int32 Body = 0; Body < BODY_COUNT; Body++)
+	{
+		const int32 Lane = Body * JointType_Count + Joint;
+		Lanes.MinCutoff[Lane] = Params.MinCutoff;
+		Lanes.Beta[Lane] = Params.Beta;
+		Lanes.DerivativeCutoff[Lane] = Params.DerivativeCutoff;
+		Lanes.Smoothing[Lane] = FMath::Clamp(Params.Smoothing, 0.0f, 1.0f);
+		Lanes.Correction[Lane] = FMath::Clamp(Params.Correction, 0.0f, 1.0f);
+		Lanes.Prediction[Lane] = Params.Prediction;
+		Lanes.JitterRadius[Lane] = Params.JitterRadius;
+		Lanes.MaxDeviationRadius[Lane] = Params.MaxDeviationRadius;
+	}
+}
+
+void FKinectJointFilter::SetParams(EChannel Channel, const FKinectJointFilterParams &Params)
+{
+	for (int32 Joint = 0; Joint < JointType_Count; Joint++)
+	{
+		SetParams(Channel, Joint, Params);
+	}
+}
+
+void FKinectJointFilter::Reset()
+{
+	FMemory::Memzero(History, sizeof(History));
+	LastTime = 0;
+}
+
+void FKinectJointFilter::Apply(FKinectBodyFrame &Frame)
+{
+	if (Type == EKinectJointFilter::None)
+	{
+		return;
+	}
+	SCOPE_CYCLE_COUNTER(STAT_KinectJointFilter);
+	const double Dt = (Frame.Time - LastTime) / KinectTicksPerSecond;
+	if (LastTime == 0 || Dt <= 0.0 || Dt > MaxFrameGapSeconds)
+	{
+		FMemory::Memzero(History, sizeof(History));
+	}
+	LastTime = Frame.Time;
+
+	FChannel &Positions = Channels[Position];
+	FChannel &Orientations = Channels[Orientation];
+	for (int32 Body = 0; Body < BODY_COUNT; Body++)
+	{
+		const int32 FirstLane = Body * JointType_Count;
+		if (!Frame.bTracked[Body])
+		{
+			// Filtered anyway, the lanes are restarted when the body is found again
+			FMemory::Memzero(History + FirstLane, JointType_Count * sizeof(float));
+			continue;
+		}
+		for (int32 j = 0; j < JointType_Count; j++)
+		{
+			const int32 Lane = FirstLane + j;
+			const FVector &P = Frame.Positions[Body][j];
+			Positions.Raw[0][Lane] = P.X;
+			Positions.Raw[1][Lane] = P.Y;
+			Positions.Raw[2][Lane] = P.Z;
+			const FQuat &Q = Frame.Orientations[Body][j];
+			const float Dot = Q.X * Orientations.Estimate[0][Lane] + Q.Y * Orientations.Estimate[1][Lane] +
+				Q.Z * Orientations.Estimate[2][Lane] + Q.W * Orientations.Estimate[3][Lane];
+			const float Sign = History[Lane] > 0.0f && Dot < 0.0f ? -1.0f : 1.0f;
+			Orientations.Raw[0][Lane] = Q.X * Sign;
+			Orientations.Raw[1][Lane] = Q.Y * Sign;
+			Orientations.Raw[2][Lane] = Q.Z * Sign;
+			Orientations.Raw[3][Lane] = Q.W * Sign;
+		}
+	}
+
+	const float FrameInterval = Dt > 0.0 && Dt <= MaxFrameGapSeconds ? static_cast<float>(Dt) : 1.0f / 30.0f;
+	if (bScalarLanes)
+	{
+		FilterChannel<FKinectScalarLanes>(Type, Positions, History, FrameInterval);
+		FilterChannel<FKinectScalarLanes>(Type, Orientations, History, FrameInterval);
+	}
+	else
+	{
+		FilterChannel<FKinectLanes>(Type, Positions, History, FrameInterval);
+		FilterChannel<FKinectLanes>(Type, Orientations, History, FrameInterval);
+	}
+
+	for (int32 Body = 0; Body < BODY_COUNT; Body++)
+	{
+		if (!Frame.bTracked[Body])
+		{
+			continue;
+		}
+		for (int32 j = 0; j < JointType_Count; j++)
+		{
+			const int32 Lane = Body * JointType_Count + j;
+			Frame.Positions[Body][j] = FVector(Positions.Raw[0][Lane], Positions.Raw[1][Lane], Positions.Raw[2][Lane]);
+			FQuat Q(Orientations.Raw[0][Lane], Orientations.Raw[1][Lane], Orientations.Raw[2][Lane], Orientations.Raw[3][Lane]);
+			Q.Normalize();
+			Frame.Orientations[Body][j] = Q;
+			History[Lane] = FMath::Min(History[Lane] + 1.0f, 2.0f);
+		}
+	}
+}
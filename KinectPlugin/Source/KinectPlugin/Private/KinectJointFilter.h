@@ -0,0 +1,139 @@
+#pragma once
+
+#include "Engine.h"
+#include "KinectBodyFrame.h"
+
+/** Smoothing applied to body joints. */
+namespace EKinectJointFilter
+{
+	enum Type
+	{
+		None,
+		/** Casiez et al.'s 1 Euro filter: a low pass whose cutoff rises with speed, little lag on fast moves and little jitter at rest. */
+		OneEuro,
+		/** Holt's double exponential smoothing with jitter removal and prediction, as the Kinect SDK 1.x offered it. */
+		DoubleExponential,
+	};
+}
+
+/** Parameters of one joint, for either filter; each filter only reads its own. */
+struct FKinectJointFilterParams
+{
+	/** 1 Euro: cutoff frequency at rest, in Hz. */
+	float MinCutoff;
+	/** 1 Euro: cutoff increase per unit of speed. */
+	float Beta;
+	/** 1 Euro: cutoff of the speed estimate, in Hz. */
+	float DerivativeCutoff;
+	/** Double exponential: weight of the previous estimate, 0 to 1. */
+	float Smoothing;
+	/** Double exponential: how fast the trend follows, 0 to 1. */
+	float Correction;
+	/** Double exponential: frames the output is extrapolated ahead. */
+	float Prediction;
+	/** Double exponential: moves smaller than this are damped as jitter. */
+	float JitterRadius;
+	/** Double exponential: largest distance the output may stray from the raw input. */
+	float MaxDeviationRadius;
+
+	FKinectJointFilterParams()
+		: MinCutoff(1.0f)
+		, Beta(0.05f)
+		, DerivativeCutoff(1.0f)
+		, Smoothing(0.5f)
+		, Correction(0.5f)
+		, Prediction(0.5f)
+		, JitterRadius(5.0f)
+		, MaxDeviationRadius(4.0f)
+	{
+	}
+};
+
+/**
+ * Smooths the joints of body frames in place, all bodies and joints at once.
+ * State is kept per lane, one lane per body and joint, with each component in
+ * an array of its own, so the filters run four lanes per SSE instruction.
+ * Positions are filtered in centimeters. Orientations are filtered as
+ * quaternions: each is first flipped into the hemisphere of the previous
+ * estimate, so q and -q do not average to nothing, and the result is
+ * normalized again. A body that is lost, or a jump in time, restarts the filter.
+ */
+class FKinectJointFilter
+{
+public:
+	/** What a set of parameters applies to; the two move in different units, so they are set separately. */
+	enum EChannel
+	{
+		Position,
+		Orientation,
+		NumChannels
+	};
+
+	FKinectJointFilter();
+
+	void SetType(EKinectJointFilter::Type InType)
+	{
+		Type = InType;
+		Reset();
+	}
+
+	EKinectJointFilter::Type GetType() const
+	{
+		return Type;
+	}
+
+	/** Runs the filters one lane at a time even where SSE is available, which gives the same result slower; for tests. */
+	void SetScalarLanes(bool bInScalarLanes)
+	{
+		bScalarLanes = bInScalarLanes;
+	}
+
+	/** Parameters every joint of Channel starts with. */
+	static FKinectJointFilterParams GetDefaultParams(EChannel Channel);
+
+	/** Sets the parameters of the sensor joint Joint for Channel. */
+	void SetParams(EChannel Channel, int32 Joint, const FKinectJointFilterParams &Params);
+
+	/** Sets the parameters of every joint for Channel. */
+	void SetParams(EChannel Channel, const FKinectJointFilterParams &Params);
+
+	/** Forgets all history, the next frame passes unfiltered. */
+	void Reset();
+
+	/** Filters the tracked bodies of Frame, which must be the next frame in time. */
+	void Apply(FKinectBodyFrame &Frame);
+
+	/** Lanes rounded up to whole SSE registers. */
+	static const int32 NumLanes = (BODY_COUNT * JointType_Count + 3) & ~3;
+	static const int32 MaxComponents = 4;
+
+	/** Per lane state and parameters of one channel. */
+	struct FChannel
+	{
+		int32 NumComponents;
+		/** Input, and the filtered output once the filter ran. */
+		float Raw[MaxComponents][NumLanes];
+		/** Previous estimate. */
+		float Estimate[MaxComponents][NumLanes];
+		/** 1 Euro: smoothed derivative. Double exponential: trend. */
+		float Trend[MaxComponents][NumLanes];
+		/** Double exponential: previous raw input. */
+		float PreviousRaw[MaxComponents][NumLanes];
+		float MinCutoff[NumLanes];
+		float Beta[NumLanes];
+		float DerivativeCutoff[NumLanes];
+		float Smoothing[NumLanes];
+		float Correction[NumLanes];
+		float Prediction[NumLanes];
+		float JitterRadius[NumLanes];
+		float MaxDeviationRadius[NumLanes];
+	};
+
+private:
+	EKinectJointFilter::Type Type;
+	bool bScalarLanes;
+	/** Frames each lane has seen since it (re)started, up to 2. */
+	float History[NumLanes];
+	FChannel Channels[NumChannels];
+	TIMESPAN LastTime;
+};
@@ -0,0 +1,48 @@
+#pragma once
+
+#include "Engine.h"
+
+/** How the index buffer of a FKinectMeshBuffers relates to its vertices. */
+enum class EKinectMeshIndexPattern : uint8
+{
+	/** Any index buffer. */
+	Explicit,
+	/** Four vertices per quad, indexed 0 1 2, 1 3 2 relative to the quad's first vertex. */
+	Quads,
+	/** Three vertices per triangle, indexed in order. */
+	TriangleList
+};
+
+/** Geometry produced for one procedural mesh section. */
+struct FKinectMeshBuffers
+{
+	TArray<FVector> Vertices;
+	TArray<FColor> Colors;
+	TArray<int32> Triangles;
+
+	/**
+	 * Changes whenever Triangles changes. Consumers that remember the serial
+	 * they uploaded can push vertex attributes only while it stays the same.
+	 */
+	uint32 TopologySerial;
+
+	/**
+	 * Anything but Explicit means Triangles follows from the vertex count, so
+	 * the buffers can be padded with collapsed primitives without touching the
+	 * index pattern.
+	 */
+	EKinectMeshIndexPattern IndexPattern;
+
+	FKinectMeshBuffers()
+		: TopologySerial(0)
+		, IndexPattern(EKinectMeshIndexPattern::Explicit)
+	{
+	}
+
+	void Reset()
+	{
+		Vertices.Reset();
+		Colors.Reset();
+		Triangles.Reset();
+	}
+};
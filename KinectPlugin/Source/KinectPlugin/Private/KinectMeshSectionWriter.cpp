@@ -0,0 +1,165 @@
+#include "KinectPluginPrivatePCH.h"
+#include "KinectMeshSectionWriter.h"
+#include "Runtime/Launch/Resources/Version.h"
+
+/** UProceduralMeshComponent::UpdateMeshSection arrived in 4.9; before it a section can only be created again. */
+#define KINECT_UPDATE_MESH_SECTION (ENGINE_MAJOR_VERSION > 4 || ENGINE_MINOR_VERSION >= 9)
+
+DECLARE_CYCLE_STAT(TEXT("Mesh Section Write"), STAT_KinectMeshSectionWrite, STATGROUP_Kinect);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Mesh Section Creates"), STAT_KinectMeshSectionCreates, STATGROUP_Kinect);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Mesh Section Updates"), STAT_KinectMeshSectionUpdates, STATGROUP_Kinect);
+
+FKinectMeshSectionWriter::FKinectMeshSectionWriter()
+	: bSectionCreated(false)
+	, SectionPrimitiveVertices(0)
+	, PrimitiveCapacity(0)
+	, SectionVertices(0)
+	, UploadedTopologySerial(0)
+{
+}
+
+void FKinectMeshSectionWriter::Reset()
+{
+	bSectionCreated = false;
+	SectionPrimitiveVertices = 0;
+	PrimitiveCapacity = 0;
+	SectionVertices = 0;
+}
+
+void FKinectMeshSectionWriter::UpdateSection(UProceduralMeshComponent *MeshComp, int32 SectionIndex, const TArray<FVector> &Vertices,
+	const TArray<int32> &Triangles, const TArray<FVector> &Normals, const TArray<FColor> &Colors, bool bCreateCollision)
+{
+#if KINECT_UPDATE_MESH_SECTION
+	MeshComp->UpdateMeshSection(SectionIndex, Vertices, Normals, UVs, Colors, Tangents);
+#else
+	MeshComp->CreateMeshSection(SectionIndex, Vertices, Triangles, Normals, UVs, Colors, Tangents, bCreateCollision);
+#endif
+	INC_DWORD_STAT(STAT_KinectMeshSectionUpdates);
+}
+
+int32 FKinectMeshSectionWriter::GetPrimitiveVertices(EKinectMeshIndexPattern Pattern)
+{
+	switch (Pattern)
+	{
+	case EKinectMeshIndexPattern::Quads:
+		return 4;
+	case EKinectMeshIndexPattern::TriangleList:
+		return 3;
+	default:
+		return 0;
+	}
+}
+
+void FKinectMeshSectionWriter::Write(UProceduralMeshComponent *MeshComp, int32 SectionIndex, const FKinectMeshBuffers &Buffers,
+	const TArray<FVector> &Normals, bool bCreateCollision)
+{
+	SCOPE_CYCLE_COUNTER(STAT_KinectMeshSectionWrite);
+	const int32 PrimitiveVertices = GetPrimitiveVertices(Buffers.IndexPattern);
+	const int32 NumVertices = Buffers.Vertices.Num();
+	const bool bHasNormals = Normals.Num() == NumVertices && NumVertices > 0;
+
+	if (PrimitiveVertices == 0)
+	{
+		const bool bCreate = !bSectionCreated || SectionPrimitiveVertices != 0 ||
+			Buffers.TopologySerial != UploadedTopologySerial || NumVertices != SectionVertices;
+		PaddedNormals.Reset();
+		const TArray<FVector> &SectionNormals = bHasNormals ? Normals : PaddedNormals;
+		if (bCreate)
+		{
+			MeshComp->CreateMeshSection(SectionIndex, Buffers.Vertices, Buffers.Triangles, SectionNormals, UVs, Buffers.Colors, Tangents, bCreateCollision);
+			INC_DWORD_STAT(STAT_KinectMeshSectionCreates);
+		}
+		else
+		{
+			UpdateSection(MeshComp, SectionIndex, Buffers.Vertices, Buffers.Triangles, SectionNormals, Buffers.Colors, bCreateCollision);
+		}
+		bSectionCreated = true;
+		SectionPrimitiveVertices = 0;
+		PrimitiveCapacity = 0;
+		SectionVertices = NumVertices;
+		UploadedTopologySerial = Buffers.TopologySerial;
+		return;
+	}
+
+	const int32 NumPrimitives = NumVertices / PrimitiveVertices;
+	const bool bCreate = !bSectionCreated || SectionPrimitiveVertices != PrimitiveVertices || NumPrimitives > PrimitiveCapacity;
+	if (bCreate)
+	{
+		if (NumPrimitives == 0)
+		{
+			// Nothing to draw and no section to keep
+			if (bSectionCreated)
+			{
+				MeshComp->ClearMeshSection(SectionIndex);
+			}
+			Reset();
+			return;
+		}
+		const bool bGrow = bSectionCreated && SectionPrimitiveVertices == PrimitiveVertices;
+		PrimitiveCapacity = FMath::Max(NumPrimitives + NumPrimitives / 4, bGrow ? PrimitiveCapacity * 2 : 0);
+		SectionPrimitiveVertices = PrimitiveVertices;
+
+		// The index pattern depends only on the capacity, so it is built once per section size
+		PaddedTriangles.SetNumUninitialized(PrimitiveCapacity * (PrimitiveVertices == 4 ? 6 : 3));
+		int32 *Indices = PaddedTriangles.GetData();
+		for (int32 p = 0; p < PrimitiveCapacity; p++)
+		{
+			const int32 First = p * PrimitiveVertices;
+			if (PrimitiveVertices == 4)
+			{
+				*Indices++ = First;
+				*Indices++ = First + 1;
+				*Indices++ = First + 2;
+				*Indices++ = First + 1;
+				*Indices++ = First + 3;
+				*Indices++ = First + 2;
+			}
+			else
+			{
+				*Indices++ = First;
+				*Indices++ = First + 1;
+				*Indices++ = First + 2;
+			}
+		}
+	}
+
+	// Unused primitives collapse onto the last real vertex so they neither draw nor grow the bounds
+	const int32 Used = NumPrimitives * PrimitiveVertices;
+	const int32 Capacity = PrimitiveCapacity * PrimitiveVertices;
+	const FVector Collapsed = Used > 0 ? Buffers.Vertices[Used - 1] : FVector::ZeroVector;
+	PaddedVertices.SetNumUninitialized(Capacity);
+	PaddedColors.SetNumUninitialized(Capacity);
+	FMemory::Memcpy(PaddedVertices.GetData(), Buffers.Vertices.GetData(), Used * sizeof(FVector));
+	FMemory::Memcpy(PaddedColors.GetData(), Buffers.Colors.GetData(), Used * sizeof(FColor));
+	for (int32 i = Used; i < Capacity; i++)
+	{
+		PaddedVertices[i] = Collapsed;
+		PaddedColors[i] = FColor(0, 0, 0, 0);
+	}
+	if (bHasNormals)
+	{
+		PaddedNormals.SetNumUninitialized(Capacity);
+		FMemory::Memcpy(PaddedNormals.GetData(), Normals.GetData(), Used * sizeof(FVector));
+		for (int32 i = Used; i < Capacity; i++)
+		{
+			PaddedNormals[i] = FVector::UpVector;
+		}
+	}
+	else
+	{
+		PaddedNormals.Reset();
+	}
+
+	if (bCreate)
+	{
+		MeshComp->CreateMeshSection(SectionIndex, PaddedVertices, PaddedTriangles, PaddedNormals, UVs, PaddedColors, Tangents, bCreateCollision);
+		INC_DWORD_STAT(STAT_KinectMeshSectionCreates);
+	}
+	else
+	{
+		UpdateSection(MeshComp, SectionIndex, PaddedVertices, PaddedTriangles, PaddedNormals, PaddedColors, bCreateCollision);
+	}
+	bSectionCreated = true;
+	SectionVertices = Capacity;
+	UploadedTopologySerial = Buffers.TopologySerial;
+}
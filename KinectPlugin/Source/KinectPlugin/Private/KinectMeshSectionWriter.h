@@ -0,0 +1,50 @@
+#pragma once
+
+#include "Engine.h"
+#include "ProceduralMeshComponent.h"
+#include "KinectMeshBuffers.h"
+
+/**
+ * Uploads FKinectMeshBuffers into one section of a procedural mesh component
+ * without recreating the section every frame.
+ *
+ * Buffers with an implied index pattern are padded with collapsed primitives
+ * up to a capacity that grows geometrically, so the section's index buffer
+ * only changes when the capacity does and every other frame is an in place
+ * UpdateMeshSection. Explicitly indexed buffers are updated in place while
+ * their TopologySerial and vertex count stay the same. Engines before 4.9
+ * have no UpdateMeshSection, so there an update creates the section again,
+ * still without clearing the component.
+ */
+class FKinectMeshSectionWriter
+{
+public:
+	FKinectMeshSectionWriter();
+
+	/** Creates or updates section SectionIndex of MeshComp from Buffers. Normals may be empty. */
+	void Write(UProceduralMeshComponent *MeshComp, int32 SectionIndex, const FKinectMeshBuffers &Buffers,
+		const TArray<FVector> &Normals, bool bCreateCollision);
+
+	/** Forgets the live section, e.g. after the component's sections were cleared. */
+	void Reset();
+
+private:
+	/** Replaces the vertex attributes of the live section, whose index buffer is Triangles. */
+	void UpdateSection(UProceduralMeshComponent *MeshComp, int32 SectionIndex, const TArray<FVector> &Vertices,
+		const TArray<int32> &Triangles, const TArray<FVector> &Normals, const TArray<FColor> &Colors, bool bCreateCollision);
+	static int32 GetPrimitiveVertices(EKinectMeshIndexPattern Pattern);
+
+	bool bSectionCreated;
+	/** Vertices per primitive of the live section, 0 if it is explicitly indexed. */
+	int32 SectionPrimitiveVertices;
+	int32 PrimitiveCapacity;
+	int32 SectionVertices;
+	uint32 UploadedTopologySerial;
+
+	TArray<FVector> PaddedVertices;
+	TArray<FColor> PaddedColors;
+	TArray<FVector> PaddedNormals;
+	TArray<int32> PaddedTriangles;
+	TArray<FVector2D> UVs;
+	TArray<FProcMeshTangent> Tangents;
+};
@@ -1,6 +1,7 @@
 // Copyright 1998-2015 Epic Games, Inc. All Rights Reserved.
 
 #include "KinectPluginPrivatePCH.h"
+#include "KinectSensorHub.h"
 
 
 
@@ -11,6 +12,14 @@ class FKinectPlugin : public IKinectPlugin
 	/** IModuleInterface implementation */
 	virtual void StartupModule() override;
 	virtual void ShutdownModule() override;
+
+	virtual FKinectSensorHub& GetSensorHub() override
+	{
+		return SensorHub;
+	}
+
+private:
+	FKinectSensorHub SensorHub;
 };
 
 IMPLEMENT_MODULE( FKinectPlugin, KinectPlugin )
@@ -27,6 +36,7 @@ void FKinectPlugin::ShutdownModule()
 {
 	// This function may be called during shutdown to clean up your module.  For modules that support dynamic reloading,
 	// we call this function before unloading the module.
+	SensorHub.Shutdown();
 }
 
 
@@ -2,6 +2,9 @@
 #pragma once
 #include "CoreUObject.h"
 #include "IKinectPlugin.h"
+
+DECLARE_STATS_GROUP(TEXT("Kinect"), STATGROUP_Kinect, STATCAT_Advanced);
+
 #include "AllowWindowsPlatformTypes.h"
 #undef DWORD
 #define DWORD HIDE_DWORD
@@ -0,0 +1,820 @@
+#include "KinectPluginPrivatePCH.h"
+#include "KinectRecording.h"
+#include "KinectDepthCodec.h"
+#include "AllowWindowsPlatformTypes.h"
+#include "ppl.h"
+
+DECLARE_DWORD_COUNTER_STAT(TEXT("Recorder Frames Written"), STAT_KinectRecorderFramesWritten, STATGROUP_Kinect);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Recorder Frames Dropped"), STAT_KinectRecorderFramesDropped, STATGROUP_Kinect);
+DECLARE_MEMORY_STAT(TEXT("Recorder Bytes Written"), STAT_KinectRecorderBytesWritten, STATGROUP_Kinect);
+
+#define KINECT_FOURCC(a, b, c, d) (uint32(a) | (uint32(b) << 8) | (uint32(c) << 16) | (uint32(d) << 24))
+
+static const uint32 RecordingMagic = KINECT_FOURCC('K', 'R', 'E', 'C');
+static const uint32 RecordingVersion = 1;
+
+/** Chunk types. */
+static const uint32 ChunkCalibration = KINECT_FOURCC('C', 'A', 'L', 'B');
+static const uint32 ChunkFrame = KINECT_FOURCC('F', 'R', 'A', 'M');
+static const uint32 ChunkIndex = KINECT_FOURCC('I', 'N', 'D', 'X');
+/** Sub chunk types of a frame chunk. */
+static const uint32 ChunkColor = KINECT_FOURCC('C', 'O', 'L', 'R');
+static const uint32 ChunkDepth = KINECT_FOURCC('D', 'P', 'T', 'H');
+/** Depth compressed with FKinectDepthCodec, of the recording's depth size. */
+static const uint32 ChunkCompressedDepth = KINECT_FOURCC('D', 'R', 'V', 'L');
+static const uint32 ChunkBodyIndex = KINECT_FOURCC('B', 'I', 'D', 'X');
+static const uint32 ChunkBodies = KINECT_FOURCC('B', 'O', 'D', 'Y');
+/** Size of a recorded body before the attributes were added to FKinectBodyData. */
+static const SIZE_T LegacyBodySize = STRUCT_OFFSET(FKinectBodyData, Attributes);
+
+/** Payloads start 16 byte aligned, so mapped images can be read like any other buffer. */
+static const uint64 ChunkAlignment = 16;
+
+/** Frames queued for the disk before new ones are dropped; a second of the sensor's output. */
+static const int32 MaxQueuedFrames = 30;
+
+struct FRecordingHeader
+{
+	uint32 Magic;
+	uint32 Version;
+	int32 ColorWidth;
+	int32 ColorHeight;
+	int32 DepthWidth;
+	int32 DepthHeight;
+	/** 0 until the writer is closed. */
+	uint64 IndexOffset;
+	uint32 NumFrames;
+	uint32 Reserved;
+};
+
+struct FChunkHeader
+{
+	uint32 Type;
+	uint32 Reserved;
+	/** Payload size, without the padding that follows it. */
+	uint64 Size;
+};
+
+struct FFrameHeader
+{
+	int32 Streams;
+	int32 Reserved;
+	TIMESPAN ColorTime;
+	TIMESPAN DepthTime;
+	TIMESPAN BodyIndexTime;
+	TIMESPAN BodyTime;
+};
+
+struct FCalibrationHeader
+{
+	CameraIntrinsics Intrinsics;
+	int32 Width;
+	int32 Height;
+	uint16 NearDepth;
+	uint16 FarDepth;
+};
+
+static uint64 Align(uint64 Value)
+{
+	return (Value + ChunkAlignment - 1) & ~(ChunkAlignment - 1);
+}
+
+/** Bytes a chunk with a Size byte payload takes, header and padding included. */
+static uint64 GetChunkSpan(uint64 Size)
+{
+	return Align(sizeof(FChunkHeader) + Size);
+}
+
+FKinectRecordedCalibration::FKinectRecordedCalibration()
+	: Width(0)
+	, Height(0)
+	, NearDepth(1000)
+	, FarDepth(4000)
+{
+	FMemory::Memzero(&Intrinsics, sizeof(Intrinsics));
+}
+
+bool FKinectRecordedCalibration::Capture(IKinectFrameSource &Source)
+{
+	const FIntPoint DepthSize = Source.GetDepthSize();
+	if (!Source.GetDepthIntrinsics().GetDepthRays(DepthSize.X, DepthSize.Y, DepthRays))
+	{
+		return false;
+	}
+	Width = DepthSize.X;
+	Height = DepthSize.Y;
+	const int32 NumPixels = Width * Height;
+	TArray<uint16> Plane;
+	Plane.Init(NearDepth, NumPixels);
+	NearColorPoints.SetNumUninitialized(NumPixels);
+	if (FAILED(Source.MapDepthFrameToColorSpace(Plane.GetData(), NumPixels, NearColorPoints.GetData())))
+	{
+		return false;
+	}
+	Plane.Init(FarDepth, NumPixels);
+	FarColorPoints.SetNumUninitialized(NumPixels);
+	if (FAILED(Source.MapDepthFrameToColorSpace(Plane.GetData(), NumPixels, FarColorPoints.GetData())))
+	{
+		return false;
+	}
+
+	ICoordinateMapper *Mapper = Source.GetCoordinateMapper();
+	if (Mapper == nullptr || FAILED(Mapper->GetDepthCameraIntrinsics(&Intrinsics)) || Intrinsics.FocalLengthX == 0.0f)
+	{
+		// A pinhole fitted to the rays around the image center; rays point up while rows go down
+		const int32 X = Width / 2;
+		const int32 Y = Height / 2;
+		const FVector2D &Center = DepthRays[Y * Width + X];
+		FMemory::Memzero(&Intrinsics, sizeof(Intrinsics));
+		Intrinsics.FocalLengthX = 1.0f / (DepthRays[Y * Width + X + 1].X - Center.X);
+		Intrinsics.FocalLengthY = -1.0f / (DepthRays[(Y + 1) * Width + X].Y - Center.Y);
+		Intrinsics.PrincipalPointX = X - Center.X * Intrinsics.FocalLengthX;
+		Intrinsics.PrincipalPointY = Y + Center.Y * Intrinsics.FocalLengthY;
+	}
+	return true;
+}
+
+HRESULT FKinectRecordedCalibration::MapDepthFrameToColorSpace(const uint16 *Depth, int32 NumPixels, ColorSpacePoint *OutColorPoints) const
+{
+	if (!IsValid() || NumPixels != Width * Height)
+	{
+		return E_INVALIDARG;
+	}
+	const float InverseNear = 1.0f / NearDepth;
+	const float InverseRange = 1.0f / (1.0f / FarDepth - InverseNear);
+	const ColorSpacePoint *Near = NearColorPoints.GetData();
+	const ColorSpacePoint *Far = FarColorPoints.GetData();
+	Concurrency::parallel_for(0, Height, [&](int y)
+	{
+		for (int32 i = y * Width; i < (y + 1) * Width; i++)
+		{
+			if (Depth[i] == 0 || !FMath::IsFinite(Near[i].X) || !FMath::IsFinite(Far[i].X))
+			{
+				OutColorPoints[i].X = -FLT_MAX;
+				OutColorPoints[i].Y = -FLT_MAX;
+				continue;
+			}
+			const float Alpha = (1.0f / Depth[i] - InverseNear) * InverseRange;
+			OutColorPoints[i].X = Near[i].X + (Far[i].X - Near[i].X) * Alpha;
+			OutColorPoints[i].Y = Near[i].Y + (Far[i].Y - Near[i].Y) * Alpha;
+		}
+	});
+	return S_OK;
+}
+
+FKinectRecordingWriter::FKinectRecordingWriter()
+	: File(nullptr)
+	, Offset(0)
+	, CalibrationOffset(0)
+	, ColorSize(0, 0)
+	, DepthSize(0, 0)
+	, bCompressDepth(true)
+	, RawDepthBytes(0)
+	, CompressedDepthBytes(0)
+	, EncodeSeconds(0.0)
+{
+}
+
+FKinectRecordingWriter::~FKinectRecordingWriter()
+{
+	Close();
+}
+
+bool FKinectRecordingWriter::Open(const FString &Filename, const FIntPoint &InColorSize, const FIntPoint &InDepthSize)
+{
+	Close();
+	File = FPlatformFileManager::Get().GetPlatformFile().OpenWrite(*Filename);
+	if (File == nullptr)
+	{
+		UE_LOG(LogKinect, Error, TEXT("Cannot create Kinect recording %s"), *Filename);
+		return false;
+	}
+	Offset = 0;
+	CalibrationOffset = 0;
+	ColorSize = InColorSize;
+	DepthSize = InDepthSize;
+	Index.Reset();
+	RawDepthBytes = 0;
+	CompressedDepthBytes = 0;
+	EncodeSeconds = 0.0;
+	FRecordingHeader Header;
+	FMemory::Memzero(&Header, sizeof(Header));
+	Header.Magic = RecordingMagic;
+	Header.Version = RecordingVersion;
+	Header.ColorWidth = ColorSize.X;
+	Header.ColorHeight = ColorSize.Y;
+	Header.DepthWidth = DepthSize.X;
+	Header.DepthHeight = DepthSize.Y;
+	return Write(&Header, sizeof(Header)) && WritePadding();
+}
+
+bool FKinectRecordingWriter::Close()
+{
+	if (File == nullptr)
+	{
+		return false;
+	}
+	const uint64 IndexOffset = Offset;
+	bool bResult = WriteChunkHeader(ChunkIndex, Index.Num() * sizeof(FKinectRecordingIndexEntry)) &&
+		Write(Index.GetData(), Index.Num() * sizeof(FKinectRecordingIndexEntry)) && WritePadding();
+	if (bResult)
+	{
+		FRecordingHeader Header;
+		FMemory::Memzero(&Header, sizeof(Header));
+		Header.Magic = RecordingMagic;
+		Header.Version = RecordingVersion;
+		Header.ColorWidth = ColorSize.X;
+		Header.ColorHeight = ColorSize.Y;
+		Header.DepthWidth = DepthSize.X;
+		Header.DepthHeight = DepthSize.Y;
+		Header.IndexOffset = IndexOffset;
+		Header.NumFrames = Index.Num();
+		bResult = File->Seek(0) && File->Write(reinterpret_cast<const uint8*>(&Header), sizeof(Header));
+	}
+	delete File;
+	File = nullptr;
+	Index.Reset();
+	if (CompressedDepthBytes > 0)
+	{
+		UE_LOG(LogKinect, Log, TEXT("Recorded depth compressed %.2f:1, encoded at %.1f MB/s"),
+			static_cast<double>(RawDepthBytes) / CompressedDepthBytes, RawDepthBytes / FMath::Max(EncodeSeconds, 1e-6) / (1024.0 * 1024.0));
+	}
+	return bResult;
+}
+
+bool FKinectRecordingWriter::Write(const void *Data, int64 Size)
+{
+	if (Size > 0 && !File->Write(static_cast<const uint8*>(Data), Size))
+	{
+		return false;
+	}
+	Offset += Size;
+	INC_MEMORY_STAT_BY(STAT_KinectRecorderBytesWritten, Size);
+	return true;
+}
+
+bool FKinectRecordingWriter::WriteChunkHeader(uint32 Type, uint64 Size)
+{
+	FChunkHeader Header;
+	Header.Type = Type;
+	Header.Reserved = 0;
+	Header.Size = Size;
+	return Write(&Header, sizeof(Header));
+}
+
+bool FKinectRecordingWriter::WritePadding()
+{
+	static const uint8 Zeros[ChunkAlignment] = { 0 };
+	return Write(Zeros, Align(Offset) - Offset);
+}
+
+bool FKinectRecordingWriter::WriteCalibration(const FKinectRecordedCalibration &Calibration)
+{
+	if (File == nullptr || !Calibration.IsValid())
+	{
+		return false;
+	}
+	const int32 NumPixels = Calibration.Width * Calibration.Height;
+	FCalibrationHeader Header;
+	FMemory::Memzero(&Header, sizeof(Header));
+	Header.Intrinsics = Calibration.Intrinsics;
+	Header.Width = Calibration.Width;
+	Header.Height = Calibration.Height;
+	Header.NearDepth = Calibration.NearDepth;
+	Header.FarDepth = Calibration.FarDepth;
+	const uint64 ChunkOffset = Offset;
+	const uint64 Size = Align(sizeof(Header)) + NumPixels * (sizeof(FVector2D) + 2 * sizeof(ColorSpacePoint));
+	if (!WriteChunkHeader(ChunkCalibration, Size) ||
+		!Write(&Header, sizeof(Header)) || !WritePadding() ||
+		!Write(Calibration.DepthRays.GetData(), NumPixels * sizeof(FVector2D)) ||
+		!Write(Calibration.NearColorPoints.GetData(), NumPixels * sizeof(ColorSpacePoint)) ||
+		!Write(Calibration.FarColorPoints.GetData(), NumPixels * sizeof(ColorSpacePoint)) ||
+		!WritePadding())
+	{
+		return false;
+	}
+	CalibrationOffset = ChunkOffset;
+	return true;
+}
+
+bool FKinectRecordingWriter::WriteFrame(const FKinectFrameBundle &Bundle)
+{
+	if (File == nullptr)
+	{
+		return false;
+	}
+	// The reader rejects images of any other size than the header's, so such frames are not written at all
+	const int32 NumDepthPixels = DepthSize.X * DepthSize.Y;
+	if ((Bundle.Has(EKinectFrameStream::Color) && Bundle.Color.Num() != ColorSize.X * ColorSize.Y * 2) ||
+		(Bundle.Has(EKinectFrameStream::Depth) && Bundle.Depth.Num() != NumDepthPixels) ||
+		(Bundle.Has(EKinectFrameStream::BodyIndex) && Bundle.BodyIndex.Num() != NumDepthPixels))
+	{
+		return false;
+	}
+	struct FStreamPayload
+	{
+		uint32 Type;
+		const void *Data;
+		uint64 Size;
+	};
+	FStreamPayload Payloads[4];
+	int32 NumPayloads = 0;
+	if (Bundle.Has(EKinectFrameStream::Color))
+	{
+		FStreamPayload Payload = { ChunkColor, Bundle.Color.GetData(), static_cast<uint64>(Bundle.Color.Num()) };
+		Payloads[NumPayloads++] = Payload;
+	}
+	if (Bundle.Has(EKinectFrameStream::Depth) && bCompressDepth)
+	{
+		const double StartTime = FPlatformTime::Seconds();
+		const int32 Size = FKinectDepthCodec::Compress(Bundle.Depth.GetData(), Bundle.Depth.Num(), CompressedDepth);
+		EncodeSeconds += FPlatformTime::Seconds() - StartTime;
+		RawDepthBytes += Bundle.Depth.Num() * sizeof(uint16);
+		CompressedDepthBytes += Size;
+		FStreamPayload Payload = { ChunkCompressedDepth, CompressedDepth.GetData(), static_cast<uint64>(Size) };
+		Payloads[NumPayloads++] = Payload;
+	}
+	else if (Bundle.Has(EKinectFrameStream::Depth))
+	{
+		FStreamPayload Payload = { ChunkDepth, Bundle.Depth.GetData(), Bundle.Depth.Num() * sizeof(uint16) };
+		Payloads[NumPayloads++] = Payload;
+	}
+	if (Bundle.Has(EKinectFrameStream::BodyIndex))
+	{
+		FStreamPayload Payload = { ChunkBodyIndex, Bundle.BodyIndex.GetData(), static_cast<uint64>(Bundle.BodyIndex.Num()) };
+		Payloads[NumPayloads++] = Payload;
+	}
+	if (Bundle.Has(EKinectFrameStream::Body))
+	{
+		FStreamPayload Payload = { ChunkBodies, Bundle.Bodies, sizeof(Bundle.Bodies) };
+		Payloads[NumPayloads++] = Payload;
+	}
+
+	FFrameHeader Header;
+	FMemory::Memzero(&Header, sizeof(Header));
+	Header.Streams = Bundle.Streams;
+	Header.ColorTime = Bundle.ColorTime;
+	Header.DepthTime = Bundle.DepthTime;
+	Header.BodyIndexTime = Bundle.BodyIndexTime;
+	Header.BodyTime = Bundle.BodyTime;
+	uint64 Size = Align(sizeof(Header));
+	for (int32 i = 0; i < NumPayloads; i++)
+	{
+		Size += GetChunkSpan(Payloads[i].Size);
+	}
+
+	FKinectRecordingIndexEntry Entry;
+	Entry.FrameOffset = Offset;
+	Entry.CalibrationOffset = CalibrationOffset;
+	Entry.Time = Bundle.Has(EKinectFrameStream::Depth) ? Bundle.DepthTime : FMath::Max(Bundle.ColorTime, Bundle.BodyTime);
+	if (!WriteChunkHeader(ChunkFrame, Size) || !Write(&Header, sizeof(Header)) || !WritePadding())
+	{
+		return false;
+	}
+	for (int32 i = 0; i < NumPayloads; i++)
+	{
+		if (!WriteChunkHeader(Payloads[i].Type, Payloads[i].Size) || !Write(Payloads[i].Data, Payloads[i].Size) || !WritePadding())
+		{
+			return false;
+		}
+	}
+	Index.Add(Entry);
+	return true;
+}
+
+/** Read only view of a whole file; also the hold of the frame planes pointing into it. */
+class FKinectRecordingReader::FMapping : public FKinectFrameHold
+{
+public:
+	FMapping()
+		: File(INVALID_HANDLE_VALUE)
+		, Mapping(nullptr)
+		, View(nullptr)
+		, Size(0)
+	{
+	}
+
+	virtual ~FMapping()
+	{
+		if (View != nullptr)
+		{
+			UnmapViewOfFile(View);
+		}
+		if (Mapping != nullptr)
+		{
+			CloseHandle(Mapping);
+		}
+		if (File != INVALID_HANDLE_VALUE)
+		{
+			CloseHandle(File);
+		}
+	}
+
+	bool Open(const FString &Filename)
+	{
+		const FString FullPath = FPaths::ConvertRelativePathToFull(Filename);
+		// Playback mostly runs forward, but seeks must stay cheap
+		File = CreateFileW(*FullPath, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+		LARGE_INTEGER FileSize;
+		if (File == INVALID_HANDLE_VALUE || !GetFileSizeEx(File, &FileSize) || FileSize.QuadPart == 0)
+		{
+			return false;
+		}
+		Mapping = CreateFileMappingW(File, nullptr, PAGE_READONLY, 0, 0, nullptr);
+		if (Mapping == nullptr)
+		{
+			return false;
+		}
+		View = MapViewOfFile(Mapping, FILE_MAP_READ, 0, 0, 0);
+		Size = FileSize.QuadPart;
+		return View != nullptr;
+	}
+
+	const uint8 *GetData() const
+	{
+		return static_cast<const uint8*>(View);
+	}
+
+	uint64 GetSize() const
+	{
+		return Size;
+	}
+
+private:
+	HANDLE File;
+	HANDLE Mapping;
+	void *View;
+	uint64 Size;
+};
+
+FKinectRecordingReader::FKinectRecordingReader()
+	: Data(nullptr)
+	, Size(0)
+	, ColorSize(0, 0)
+	, DepthSize(0, 0)
+	, NumFrames(0)
+	, Index(nullptr)
+	, DecodedDepthBytes(0)
+	, DecodeSeconds(0.0)
+{
+}
+
+FKinectRecordingReader::~FKinectRecordingReader()
+{
+	Close();
+}
+
+bool FKinectRecordingReader::Open(const FString &Filename)
+{
+	Close();
+	TSharedPtr<FMapping, ESPMode::ThreadSafe> NewMapping = MakeShareable(new FMapping());
+	if (!NewMapping->Open(Filename) || NewMapping->GetSize() < Align(sizeof(FRecordingHeader)))
+	{
+		UE_LOG(LogKinect, Error, TEXT("Cannot open Kinect recording %s"), *Filename);
+		return false;
+	}
+	const FRecordingHeader &Header = *reinterpret_cast<const FRecordingHeader*>(NewMapping->GetData());
+	if (Header.Magic != RecordingMagic || Header.Version != RecordingVersion)
+	{
+		UE_LOG(LogKinect, Error, TEXT("%s is not a Kinect recording of version %d"), *Filename, RecordingVersion);
+		return false;
+	}
+	Mapping = NewMapping;
+	Data = Mapping->GetData();
+	Size = Mapping->GetSize();
+	ColorSize = FIntPoint(Header.ColorWidth, Header.ColorHeight);
+	DepthSize = FIntPoint(Header.DepthWidth, Header.DepthHeight);
+
+	uint32 Type = 0;
+	uint64 ChunkSize = 0;
+	const uint8 *IndexData = Header.IndexOffset != 0 ? GetChunk(Header.IndexOffset, Type, ChunkSize) : nullptr;
+	if (IndexData != nullptr && Type == ChunkIndex && ChunkSize == Header.NumFrames * sizeof(FKinectRecordingIndexEntry))
+	{
+		Index = reinterpret_cast<const FKinectRecordingIndexEntry*>(IndexData);
+		NumFrames = Header.NumFrames;
+		return true;
+	}
+	UE_LOG(LogKinect, Warning, TEXT("Kinect recording %s was not closed, indexing it"), *Filename);
+	return ScanFrames();
+}
+
+void FKinectRecordingReader::Close()
+{
+	if (DecodedDepthBytes > 0)
+	{
+		UE_LOG(LogKinect, Log, TEXT("Replayed depth decoded at %.1f MB/s"), DecodedDepthBytes / FMath::Max(DecodeSeconds, 1e-6) / (1024.0 * 1024.0));
+	}
+	DecodedDepthBytes = 0;
+	DecodeSeconds = 0.0;
+	Mapping.Reset();
+	Data = nullptr;
+	Size = 0;
+	NumFrames = 0;
+	Index = nullptr;
+	ScannedIndex.Reset();
+}
+
+const uint8 *FKinectRecordingReader::GetChunk(uint64 ChunkOffset, uint32 &OutType, uint64 &OutSize) const
+{
+	if (ChunkOffset + sizeof(FChunkHeader) > Size)
+	{
+		return nullptr;
+	}
+	const FChunkHeader &Header = *reinterpret_cast<const FChunkHeader*>(Data + ChunkOffset);
+	if (Header.Size > Size - ChunkOffset - sizeof(FChunkHeader))
+	{
+		// Cut short, e.g. by a crash while writing
+		return nullptr;
+	}
+	OutType = Header.Type;
+	OutSize = Header.Size;
+	return Data + ChunkOffset + sizeof(FChunkHeader);
+}
+
+bool FKinectRecordingReader::ScanFrames()
+{
+	uint64 CalibrationOffset = 0;
+	uint64 ChunkOffset = Align(sizeof(FRecordingHeader));
+	uint32 Type = 0;
+	uint64 ChunkSize = 0;
+	while (const uint8 *Payload = GetChunk(ChunkOffset, Type, ChunkSize))
+	{
+		if (Type == ChunkCalibration)
+		{
+			CalibrationOffset = ChunkOffset;
+		}
+		else if (Type == ChunkFrame && ChunkSize >= sizeof(FFrameHeader))
+		{
+			const FFrameHeader &Header = *reinterpret_cast<const FFrameHeader*>(Payload);
+			FKinectRecordingIndexEntry Entry;
+			Entry.FrameOffset = ChunkOffset;
+			Entry.CalibrationOffset = CalibrationOffset;
+			Entry.Time = (Header.Streams & EKinectFrameStream::Depth) ? Header.DepthTime : FMath::Max(Header.ColorTime, Header.BodyTime);
+			ScannedIndex.Add(Entry);
+		}
+		ChunkOffset += GetChunkSpan(ChunkSize);
+	}
+	Index = ScannedIndex.GetData();
+	NumFrames = ScannedIndex.Num();
+	return NumFrames > 0;
+}
+
+bool FKinectRecordingReader::ReadFrame(int32 FrameIndex, FKinectFrameBundle &OutBundle) const
+{
+	if (FrameIndex < 0 || FrameIndex >= NumFrames)
+	{
+		return false;
+	}
+	uint32 Type = 0;
+	uint64 ChunkSize = 0;
+	const uint8 *Payload = GetChunk(Index[FrameIndex].FrameOffset, Type, ChunkSize);
+	if (Payload == nullptr || Type != ChunkFrame || ChunkSize < sizeof(FFrameHeader))
+	{
+		return false;
+	}
+	const FFrameHeader &Header = *reinterpret_cast<const FFrameHeader*>(Payload);
+	OutBundle.Streams = EKinectFrameStream::None;
+	OutBundle.ColorTime = Header.ColorTime;
+	OutBundle.DepthTime = Header.DepthTime;
+	OutBundle.BodyIndexTime = Header.BodyIndexTime;
+	OutBundle.BodyTime = Header.BodyTime;
+
+	// Images of any other size than the header's would be read past their end downstream
+	const uint64 NumColorBytes = static_cast<uint64>(ColorSize.X) * ColorSize.Y * 2;
+	const uint64 NumDepthPixels = static_cast<uint64>(DepthSize.X) * DepthSize.Y;
+	const FKinectFrameHoldPtr Hold = Mapping;
+	const uint64 FrameOffset = Payload - Data;
+	uint64 StreamOffset = FrameOffset + Align(sizeof(FFrameHeader));
+	uint64 StreamSize = 0;
+	while (StreamOffset < FrameOffset + ChunkSize)
+	{
+		const uint8 *Stream = GetChunk(StreamOffset, Type, StreamSize);
+		if (Stream == nullptr)
+		{
+			return false;
+		}
+		if ((Type == ChunkColor && StreamSize != NumColorBytes) ||
+			(Type == ChunkDepth && StreamSize != NumDepthPixels * sizeof(uint16)) ||
+			(Type == ChunkBodyIndex && StreamSize != NumDepthPixels))
+		{
+			return false;
+		}
+		if (Type == ChunkColor)
+		{
+			OutBundle.Color.SetView(Stream, static_cast<int32>(StreamSize), Hold);
+			OutBundle.Streams |= EKinectFrameStream::Color;
+		}
+		else if (Type == ChunkDepth)
+		{
+			OutBundle.Depth.SetView(reinterpret_cast<const uint16*>(Stream), static_cast<int32>(StreamSize / sizeof(uint16)), Hold);
+			OutBundle.Streams |= EKinectFrameStream::Depth;
+		}
+		else if (Type == ChunkCompressedDepth)
+		{
+			// Decoded into the bundle's own storage, which is reused if the previous frame is done with it
+			const int32 NumPixels = DepthSize.X * DepthSize.Y;
+			const double StartTime = FPlatformTime::Seconds();
+			if (!FKinectDepthCodec::Decompress(Stream, static_cast<int32>(StreamSize), OutBundle.Depth.Allocate(NumPixels), NumPixels))
+			{
+				OutBundle.Depth.Reset();
+				return false;
+			}
+			DecodeSeconds += FPlatformTime::Seconds() - StartTime;
+			DecodedDepthBytes += NumPixels * sizeof(uint16);
+			OutBundle.Streams |= EKinectFrameStream::Depth;
+		}
+		else if (Type == ChunkBodyIndex)
+		{
+			OutBundle.BodyIndex.SetView(Stream, static_cast<int32>(StreamSize), Hold);
+			OutBundle.Streams |= EKinectFrameStream::BodyIndex;
+		}
+		else if (Type == ChunkBodies && StreamSize == sizeof(OutBundle.Bodies))
+		{
+			FMemory::Memcpy(OutBundle.Bodies, Stream, sizeof(OutBundle.Bodies));
+			OutBundle.Streams |= EKinectFrameStream::Body;
+		}
+		else if (Type == ChunkBodies && StreamSize == BODY_COUNT * LegacyBodySize)
+		{
+			// Recorded before bodies carried attributes: joints, orientations and hand states only
+			for (int32 i = 0; i < BODY_COUNT; i++)
+			{
+				FMemory::Memcpy(&OutBundle.Bodies[i], Stream + i * LegacyBodySize, LegacyBodySize);
+				OutBundle.Bodies[i].Attributes = EKinectBodyAttribute::Default;
+			}
+			OutBundle.Streams |= EKinectFrameStream::Body;
+		}
+		StreamOffset += GetChunkSpan(StreamSize);
+	}
+	if (!OutBundle.Has(EKinectFrameStream::Color))
+	{
+		OutBundle.Color.Reset();
+	}
+	if (!OutBundle.Has(EKinectFrameStream::Depth))
+	{
+		OutBundle.Depth.Reset();
+	}
+	if (!OutBundle.Has(EKinectFrameStream::BodyIndex))
+	{
+		OutBundle.BodyIndex.Reset();
+	}
+	return true;
+}
+
+TIMESPAN FKinectRecordingReader::GetFrameTime(int32 FrameIndex) const
+{
+	return FrameIndex >= 0 && FrameIndex < NumFrames ? Index[FrameIndex].Time : 0;
+}
+
+uint64 FKinectRecordingReader::GetCalibrationId(int32 FrameIndex) const
+{
+	return FrameIndex >= 0 && FrameIndex < NumFrames ? Index[FrameIndex].CalibrationOffset : 0;
+}
+
+bool FKinectRecordingReader::ReadCalibration(int32 FrameIndex, FKinectRecordedCalibration &OutCalibration) const
+{
+	const uint64 ChunkOffset = GetCalibrationId(FrameIndex);
+	uint32 Type = 0;
+	uint64 ChunkSize = 0;
+	const uint8 *Payload = ChunkOffset != 0 ? GetChunk(ChunkOffset, Type, ChunkSize) : nullptr;
+	if (Payload == nullptr || Type != ChunkCalibration || ChunkSize < sizeof(FCalibrationHeader))
+	{
+		return false;
+	}
+	const FCalibrationHeader &Header = *reinterpret_cast<const FCalibrationHeader*>(Payload);
+	const int32 NumPixels = Header.Width * Header.Height;
+	if (ChunkSize != Align(sizeof(Header)) + NumPixels * (sizeof(FVector2D) + 2 * sizeof(ColorSpacePoint)))
+	{
+		return false;
+	}
+	OutCalibration.Intrinsics = Header.Intrinsics;
+	OutCalibration.Width = Header.Width;
+	OutCalibration.Height = Header.Height;
+	OutCalibration.NearDepth = Header.NearDepth;
+	OutCalibration.FarDepth = Header.FarDepth;
+	const uint8 *Tables = Payload + Align(sizeof(Header));
+	OutCalibration.DepthRays.SetNumUninitialized(NumPixels);
+	FMemory::Memcpy(OutCalibration.DepthRays.GetData(), Tables, NumPixels * sizeof(FVector2D));
+	Tables += NumPixels * sizeof(FVector2D);
+	OutCalibration.NearColorPoints.SetNumUninitialized(NumPixels);
+	FMemory::Memcpy(OutCalibration.NearColorPoints.GetData(), Tables, NumPixels * sizeof(ColorSpacePoint));
+	Tables += NumPixels * sizeof(ColorSpacePoint);
+	OutCalibration.FarColorPoints.SetNumUninitialized(NumPixels);
+	FMemory::Memcpy(OutCalibration.FarColorPoints.GetData(), Tables, NumPixels * sizeof(ColorSpacePoint));
+	return true;
+}
+
+FKinectFrameRecorder::FKinectFrameRecorder()
+	: Thread(nullptr)
+	, bRunning(false)
+	, bCalibrationPending(true)
+	, QueueEvent(FPlatformProcess::CreateSynchEvent())
+{
+}
+
+FKinectFrameRecorder::~FKinectFrameRecorder()
+{
+	Stop();
+	delete QueueEvent;
+}
+
+bool FKinectFrameRecorder::Start(const FString &Filename, IKinectFrameSource &Source, bool bCompressDepth)
+{
+	Stop();
+	Writer.SetCompressDepth(bCompressDepth);
+	if (!Writer.Open(Filename, Source.GetColorSize(), Source.GetDepthSize()))
+	{
+		return false;
+	}
+	bCalibrationPending = true;
+	bRunning = true;
+	Thread = FRunnableThread::Create(this, TEXT("KinectFrameRecorder"));
+	return true;
+}
+
+void FKinectFrameRecorder::Stop()
+{
+	if (Thread != nullptr)
+	{
+		bRunning = false;
+		QueueEvent->Trigger();
+		Thread->WaitForCompletion();
+		delete Thread;
+		Thread = nullptr;
+	}
+	Writer.Close();
+	FScopeLock Lock(&Crit);
+	Queue.Reset();
+}
+
+void FKinectFrameRecorder::Write(const FKinectFrameBundle &Bundle, IKinectFrameSource &Source)
+{
+	if (Thread == nullptr)
+	{
+		return;
+	}
+	TSharedPtr<FKinectRecordedCalibration, ESPMode::ThreadSafe> Calibration;
+	if (bCalibrationPending)
+	{
+		Calibration = MakeShareable(new FKinectRecordedCalibration());
+		if (Calibration->Capture(Source))
+		{
+			bCalibrationPending = false;
+		}
+		else
+		{
+			Calibration.Reset();
+		}
+	}
+	{
+		FScopeLock Lock(&Crit);
+		if (Queue.Num() >= MaxQueuedFrames && !Calibration.IsValid())
+		{
+			INC_DWORD_STAT(STAT_KinectRecorderFramesDropped);
+			return;
+		}
+		FItem &Item = Queue[Queue.AddDefaulted()];
+		Item.Calibration = Calibration;
+		Item.Bundle = Bundle;
+		// The sensor gets its memory back right away, the disk may take a while
+		Item.Bundle.Color.Retain();
+		Item.Bundle.Depth.Retain();
+		Item.Bundle.BodyIndex.Retain();
+	}
+	QueueEvent->Trigger();
+}
+
+uint32 FKinectFrameRecorder::Run()
+{
+	TArray<FItem> Items;
+	for (;;)
+	{
+		{
+			FScopeLock Lock(&Crit);
+			Exchange(Items, Queue);
+		}
+		for (int32 i = 0; i < Items.Num(); i++)
+		{
+			if (Items[i].Calibration.IsValid())
+			{
+				Writer.WriteCalibration(*Items[i].Calibration);
+			}
+			if (Writer.WriteFrame(Items[i].Bundle))
+			{
+				INC_DWORD_STAT(STAT_KinectRecorderFramesWritten);
+			}
+		}
+		Items.Reset();
+		if (!bRunning)
+		{
+			// Stop waits for everything queued so far
+			FScopeLock Lock(&Crit);
+			if (Queue.Num() == 0)
+			{
+				break;
+			}
+			continue;
+		}
+		QueueEvent->Wait(100);
+	}
+	return 0;
+}
@@ -0,0 +1,224 @@
+#pragma once
+
+#include "KinectFrameSource.h"
+
+/** Where a recorded frame lives; the index of a recording is an array of these. */
+struct FKinectRecordingIndexEntry
+{
+	uint64 FrameOffset;
+	/** Offset of the calibration chunk in effect, 0 if none was recorded yet. */
+	uint64 CalibrationOffset;
+	TIMESPAN Time;
+};
+
+/**
+ * Calibration a recording is replayed with. The depth rays drive the
+ * unprojection; the color mapping is kept as the color coordinates of every
+ * depth pixel at two depths and interpolated in 1/z in between, which is
+ * exact for the translation between the two cameras and close for the rest.
+ */
+struct FKinectRecordedCalibration
+{
+	/** Depth camera intrinsics in pixels, as ICoordinateMapper::GetDepthCameraIntrinsics reports them. */
+	CameraIntrinsics Intrinsics;
+	int32 Width;
+	int32 Height;
+	/** Depth pixel rays at one meter, see IKinectDepthIntrinsics. */
+	TArray<FVector2D> DepthRays;
+	/** Depths in millimeters the two color tables were taken at. */
+	uint16 NearDepth;
+	uint16 FarDepth;
+	TArray<ColorSpacePoint> NearColorPoints;
+	TArray<ColorSpacePoint> FarColorPoints;
+
+	FKinectRecordedCalibration();
+
+	/**
+	 * Samples the calibration of Source. The intrinsics come from its
+	 * coordinate mapper if it has one, otherwise they are estimated from the rays.
+	 *
+	 * @return false while the source has no calibration yet.
+	 */
+	bool Capture(IKinectFrameSource &Source);
+
+	bool IsValid() const
+	{
+		return Width > 0 && DepthRays.Num() == Width * Height;
+	}
+
+	/** Same contract as IKinectFrameSource::MapDepthFrameToColorSpace. */
+	HRESULT MapDepthFrameToColorSpace(const uint16 *Depth, int32 NumPixels, ColorSpacePoint *OutColorPoints) const;
+};
+
+/**
+ * Writes bundles to a recording. The file is a header followed by chunks,
+ * each a type, a size and a payload aligned to 16 bytes: calibration chunks
+ * whenever the calibration changes and one chunk per frame with a sub chunk
+ * per stream. Close appends an index holding the offset of every frame and
+ * its calibration, so readers seek in constant time. Readers skip chunk types
+ * they do not know, so streams can be added without breaking old readers.
+ */
+class FKinectRecordingWriter
+{
+public:
+	FKinectRecordingWriter();
+	~FKinectRecordingWriter();
+
+	bool Open(const FString &Filename, const FIntPoint &ColorSize, const FIntPoint &DepthSize);
+
+	/** Writes the index and finishes the header; a file that was never closed is indexed by a scan when read. */
+	bool Close();
+
+	bool IsOpen() const
+	{
+		return File != nullptr;
+	}
+
+	/** Applies to the frames written after it. */
+	bool WriteCalibration(const FKinectRecordedCalibration &Calibration);
+	/** Writes nothing and fails if an image of Bundle is not of the size the recording was opened with. */
+	bool WriteFrame(const FKinectFrameBundle &Bundle);
+
+	int64 GetBytesWritten() const
+	{
+		return Offset;
+	}
+
+	/** Stores depth frames compressed with FKinectDepthCodec, which is the default. */
+	void SetCompressDepth(bool bInCompressDepth)
+	{
+		bCompressDepth = bInCompressDepth;
+	}
+
+private:
+	bool Write(const void *Data, int64 Size);
+	bool WriteChunkHeader(uint32 Type, uint64 Size);
+	bool WritePadding();
+
+	class IFileHandle *File;
+	int64 Offset;
+	uint64 CalibrationOffset;
+	FIntPoint ColorSize;
+	FIntPoint DepthSize;
+	TArray<FKinectRecordingIndexEntry> Index;
+	bool bCompressDepth;
+	TArray<uint8> CompressedDepth;
+	/** Compression totals, logged on Close. */
+	int64 RawDepthBytes;
+	int64 CompressedDepthBytes;
+	double EncodeSeconds;
+};
+
+/**
+ * Reads a recording through a read only memory mapping of the whole file.
+ * Frame images are views of the mapping, nothing is copied, and they keep the
+ * mapping alive on their own, so they may outlive the reader. Compressed
+ * depth is the exception, it is decoded into the bundle's own storage.
+ */
+class FKinectRecordingReader
+{
+public:
+	FKinectRecordingReader();
+	~FKinectRecordingReader();
+
+	bool Open(const FString &Filename);
+	void Close();
+
+	bool IsOpen() const
+	{
+		return Mapping.IsValid();
+	}
+
+	int32 GetNumFrames() const
+	{
+		return NumFrames;
+	}
+
+	FIntPoint GetColorSize() const
+	{
+		return ColorSize;
+	}
+
+	FIntPoint GetDepthSize() const
+	{
+		return DepthSize;
+	}
+
+	/** Fills OutBundle with frame Index; fails if an image of it is not of the recording's size. */
+	bool ReadFrame(int32 Index, FKinectFrameBundle &OutBundle) const;
+
+	/** RelativeTime of frame Index, of its depth frame if it has one. */
+	TIMESPAN GetFrameTime(int32 Index) const;
+
+	/** Identifies the calibration frame Index was recorded with, 0 if it has none; equal ids mean the same calibration. */
+	uint64 GetCalibrationId(int32 Index) const;
+
+	bool ReadCalibration(int32 Index, FKinectRecordedCalibration &OutCalibration) const;
+
+private:
+	class FMapping;
+
+	/** Rebuilds the index of a file whose writer never got to close it. */
+	bool ScanFrames();
+	const uint8 *GetChunk(uint64 ChunkOffset, uint32 &OutType, uint64 &OutSize) const;
+
+	TSharedPtr<FMapping, ESPMode::ThreadSafe> Mapping;
+	const uint8 *Data;
+	uint64 Size;
+	FIntPoint ColorSize;
+	FIntPoint DepthSize;
+	int32 NumFrames;
+	/** Points into the mapping, or into ScannedIndex for a file that was not closed. */
+	const FKinectRecordingIndexEntry *Index;
+	TArray<FKinectRecordingIndexEntry> ScannedIndex;
+	/** Decoding totals, logged on Close. */
+	mutable int64 DecodedDepthBytes;
+	mutable double DecodeSeconds;
+};
+
+/**
+ * Records the bundles handed to Write on a thread of its own, so the caller
+ * only pays for copying the frames out of sensor memory. Frames the disk
+ * cannot keep up with are dropped and counted.
+ */
+class FKinectFrameRecorder : public FRunnable
+{
+public:
+	FKinectFrameRecorder();
+	virtual ~FKinectFrameRecorder();
+
+	/** Starts recording the frames of Source, whose sizes the recording takes. */
+	bool Start(const FString &Filename, IKinectFrameSource &Source, bool bCompressDepth = true);
+	void Stop();
+
+	bool IsRecording() const
+	{
+		return Thread != nullptr;
+	}
+
+	/** Captures the calibration again with the next frame; call when the source reports a change. */
+	void InvalidateCalibration()
+	{
+		bCalibrationPending = true;
+	}
+
+	/** Queues Bundle. Source is the one it came from, for the calibration. */
+	void Write(const FKinectFrameBundle &Bundle, IKinectFrameSource &Source);
+
+	virtual uint32 Run() override;
+
+private:
+	struct FItem
+	{
+		TSharedPtr<FKinectRecordedCalibration, ESPMode::ThreadSafe> Calibration;
+		FKinectFrameBundle Bundle;
+	};
+
+	FKinectRecordingWriter Writer;
+	FRunnableThread *Thread;
+	volatile bool bRunning;
+	bool bCalibrationPending;
+	FCriticalSection Crit;
+	TArray<FItem> Queue;
+	FEvent *QueueEvent;
+};
@@ -0,0 +1,503 @@
+#include "KinectPluginPrivatePCH.h"
+#include "KinectReplayFrameSource.h"
+#include "AllowWindowsPlatformTypes.h"
+#include "ppl.h"
+
+DECLARE_DWORD_COUNTER_STAT(TEXT("Replay Frames"), STAT_KinectReplayFrames, STATGROUP_Kinect);
+
+/** A paced replay further behind than this starts its schedule over instead of bursting to catch up. */
+static const double MaxReplayLagSeconds = 0.1;
+
+/**
+ * ICoordinateMapper answering from a recorded calibration, for consumers
+ * written against the sensor's mapper. It covers what the plugin uses: the
+ * depth intrinsics, projecting camera points and mapping whole depth frames.
+ * The remaining queries need calibration data a recording does not hold and
+ * return E_NOTIMPL. It keeps its own reference to the calibration, so it may
+ * outlive the frame source.
+ */
+class FKinectReplayFrameSource::FCoordinateMapper : public ICoordinateMapper
+{
+public:
+	FCoordinateMapper()
+		: RefCount(1)
+	{
+	}
+
+	/** Takes effect for all further queries and signals every subscriber. */
+	void SetCalibration(const FCalibrationPtr &InCalibration)
+	{
+		FScopeLock Lock(&Crit);
+		Calibration = InCalibration;
+		for (int32 i = 0; i < ChangedEvents.Num(); i++)
+		{
+			SetEvent(ChangedEvents[i]);
+		}
+	}
+
+	virtual HRESULT STDMETHODCALLTYPE QueryInterface(REFIID Riid, void **OutObject) override
+	{
+		if (OutObject == nullptr)
+		{
+			return E_POINTER;
+		}
+		if (Riid == __uuidof(IUnknown) || Riid == __uuidof(ICoordinateMapper))
+		{
+			*OutObject = static_cast<ICoordinateMapper*>(this);
+			AddRef();
+			return S_OK;
+		}
+		*OutObject = nullptr;
+		return E_NOINTERFACE;
+	}
+
+	virtual ULONG STDMETHODCALLTYPE AddRef() override
+	{
+		return InterlockedIncrement(&RefCount);
+	}
+
+	virtual ULONG STDMETHODCALLTYPE Release() override
+	{
+		const ULONG Count = InterlockedDecrement(&RefCount);
+		if (Count == 0)
+		{
+			delete this;
+		}
+		return Count;
+	}
+
+	virtual HRESULT STDMETHODCALLTYPE SubscribeCoordinateMappingChanged(WAITABLE_HANDLE *WaitableHandle) override
+	{
+		if (WaitableHandle == nullptr)
+		{
+			return E_POINTER;
+		}
+		// Manual reset, like the sensor's; signaled right away if there is a calibration to pick up
+		HANDLE Event = CreateEvent(nullptr, TRUE, FALSE, nullptr);
+		if (Event == nullptr)
+		{
+			return HRESULT_FROM_WIN32(GetLastError());
+		}
+		FScopeLock Lock(&Crit);
+		if (Calibration.IsValid() && Calibration->IsValid())
+		{
+			SetEvent(Event);
+		}
+		ChangedEvents.Add(Event);
+		*WaitableHandle = reinterpret_cast<WAITABLE_HANDLE>(Event);
+		return S_OK;
+	}
+
+	virtual HRESULT STDMETHODCALLTYPE UnsubscribeCoordinateMappingChanged(WAITABLE_HANDLE WaitableHandle) override
+	{
+		HANDLE Event = reinterpret_cast<HANDLE>(WaitableHandle);
+		FScopeLock Lock(&Crit);
+		if (ChangedEvents.Remove(Event) == 0)
+		{
+			return E_INVALIDARG;
+		}
+		CloseHandle(Event);
+		return S_OK;
+	}
+
+	virtual HRESULT STDMETHODCALLTYPE GetCoordinateMappingChangedEventData(WAITABLE_HANDLE WaitableHandle, ICoordinateMappingChangedEventArgs **EventData) override
+	{
+		return E_NOTIMPL;
+	}
+
+	virtual HRESULT STDMETHODCALLTYPE MapCameraPointToDepthSpace(CameraSpacePoint CameraPoint, DepthSpacePoint *DepthPoint) override
+	{
+		return MapCameraPointsToDepthSpace(1, &CameraPoint, 1, DepthPoint);
+	}
+
+	virtual HRESULT STDMETHODCALLTYPE MapCameraPointToColorSpace(CameraSpacePoint CameraPoint, ColorSpacePoint *ColorPoint) override
+	{
+		return E_NOTIMPL;
+	}
+
+	virtual HRESULT STDMETHODCALLTYPE MapDepthPointToCameraSpace(DepthSpacePoint DepthPoint, UINT16 Depth, CameraSpacePoint *CameraPoint) override
+	{
+		const FCalibrationPtr Current = GetCalibration();
+		if (!Current.IsValid() || !Current->IsValid())
+		{
+			return E_PENDING;
+		}
+		// Rays are known per pixel, the nearest one stands in for points in between
+		const int32 X = FMath::Clamp(FMath::RoundToInt(DepthPoint.X), 0, Current->Width - 1);
+		const int32 Y = FMath::Clamp(FMath::RoundToInt(DepthPoint.Y), 0, Current->Height - 1);
+		const FVector2D &Ray = Current->DepthRays[Y * Current->Width + X];
+		const float Z = Depth * 0.001f;
+		CameraPoint->X = Ray.X * Z;
+		CameraPoint->Y = Ray.Y * Z;
+		CameraPoint->Z = Z;
+		return S_OK;
+	}
+
+	virtual HRESULT STDMETHODCALLTYPE MapDepthPointToColorSpace(DepthSpacePoint DepthPoint, UINT16 Depth, ColorSpacePoint *ColorPoint) override
+	{
+		return E_NOTIMPL;
+	}
+
+	virtual HRESULT STDMETHODCALLTYPE MapCameraPointsToDepthSpace(UINT CameraPointCount, const CameraSpacePoint *CameraPoints, UINT DepthPointCount, DepthSpacePoint *DepthPoints) override
+	{
+		if (CameraPointCount != DepthPointCount)
+		{
+			return E_INVALIDARG;
+		}
+		const FCalibrationPtr Current = GetCalibration();
+		if (!Current.IsValid() || !Current->IsValid())
+		{
+			return E_PENDING;
+		}
+		// Pinhole with the depth camera's radial distortion; rows run opposite to camera Y
+		const CameraIntrinsics &K = Current->Intrinsics;
+		for (UINT i = 0; i < CameraPointCount; i++)
+		{
+			const CameraSpacePoint &Point = CameraPoints[i];
+			if (Point.Z <= 0.0f)
+			{
+				DepthPoints[i].X = -FLT_MAX;
+				DepthPoints[i].Y = -FLT_MAX;
+				continue;
+			}
+			const float X = Point.X / Point.Z;
+			const float Y = Point.Y / Point.Z;
+			const float R2 = X * X + Y * Y;
+			const float Distortion = 1.0f + R2 * (K.RadialDistortionSecondOrder + R2 * (K.RadialDistortionFourthOrder + R2 * K.RadialDistortionSixthOrder));
+			DepthPoints[i].X = K.PrincipalPointX + K.FocalLengthX * X * Distortion;
+			DepthPoints[i].Y = K.PrincipalPointY - K.FocalLengthY * Y * Distortion;
+		}
+		return S_OK;
+	}
+
+	virtual HRESULT STDMETHODCALLTYPE MapCameraPointsToColorSpace(UINT CameraPointCount, const CameraSpacePoint *CameraPoints, UINT ColorPointCount, ColorSpacePoint *ColorPoints) override
+	{
+		return E_NOTIMPL;
+	}
+
+	virtual HRESULT STDMETHODCALLTYPE MapDepthPointsToCameraSpace(UINT DepthPointCount, const DepthSpacePoint *DepthPoints, UINT DepthCount, const UINT16 *Depths, UINT CameraPointCount, CameraSpacePoint *CameraPoints) override
+	{
+		if (DepthPointCount != DepthCount || DepthPointCount != CameraPointCount)
+		{
+			return E_INVALIDARG;
+		}
+		for (UINT i = 0; i < DepthPointCount; i++)
+		{
+			HRESULT hResult = MapDepthPointToCameraSpace(DepthPoints[i], Depths[i], &CameraPoints[i]);
+			if (FAILED(hResult))
+			{
+				return hResult;
+			}
+		}
+		return S_OK;
+	}
+
+	virtual HRESULT STDMETHODCALLTYPE MapDepthPointsToColorSpace(UINT DepthPointCount, const DepthSpacePoint *DepthPoints, UINT DepthCount, const UINT16 *Depths, UINT ColorPointCount, ColorSpacePoint *ColorPoints) override
+	{
+		return E_NOTIMPL;
+	}
+
+	virtual HRESULT STDMETHODCALLTYPE MapDepthFrameToCameraSpace(UINT DepthPointCount, const UINT16 *DepthFrameData, UINT CameraPointCount, CameraSpacePoint *CameraSpacePoints) override
+	{
+		const FCalibrationPtr Current = GetCalibration();
+		if (!Current.IsValid() || !Current->IsValid())
+		{
+			return E_PENDING;
+		}
+		if (DepthPointCount != CameraPointCount || static_cast<int32>(DepthPointCount) != Current->DepthRays.Num())
+		{
+			return E_INVALIDARG;
+		}
+		const FVector2D *Rays = Current->DepthRays.GetData();
+		Concurrency::parallel_for(0, Current->Height, [&](int y)
+		{
+			for (int32 i = y * Current->Width; i < (y + 1) * Current->Width; i++)
+			{
+				const float Z = DepthFrameData[i] * 0.001f;
+				CameraSpacePoints[i].X = DepthFrameData[i] ? Rays[i].X * Z : -FLT_MAX;
+				CameraSpacePoints[i].Y = DepthFrameData[i] ? Rays[i].Y * Z : -FLT_MAX;
+				CameraSpacePoints[i].Z = DepthFrameData[i] ? Z : -FLT_MAX;
+			}
+		});
+		return S_OK;
+	}
+
+	virtual HRESULT STDMETHODCALLTYPE MapDepthFrameToColorSpace(UINT DepthPointCount, const UINT16 *DepthFrameData, UINT ColorPointCount, ColorSpacePoint *ColorSpacePoints) override
+	{
+		const FCalibrationPtr Current = GetCalibration();
+		if (!Current.IsValid() || DepthPointCount != ColorPointCount)
+		{
+			return E_INVALIDARG;
+		}
+		return Current->MapDepthFrameToColorSpace(DepthFrameData, DepthPointCount, ColorSpacePoints);
+	}
+
+	virtual HRESULT STDMETHODCALLTYPE MapColorFrameToDepthSpace(UINT DepthDataPointCount, const UINT16 *DepthFrameData, UINT DepthPointCount, DepthSpacePoint *DepthSpacePoints) override
+	{
+		return E_NOTIMPL;
+	}
+
+	virtual HRESULT STDMETHODCALLTYPE MapColorFrameToCameraSpace(UINT DepthDataPointCount, const UINT16 *DepthFrameData, UINT CameraPointCount, CameraSpacePoint *CameraSpacePoints) override
+	{
+		return E_NOTIMPL;
+	}
+
+	virtual HRESULT STDMETHODCALLTYPE GetDepthFrameToCameraSpaceTable(UINT32 *TableEntryCount, PointF **TableEntries) override
+	{
+		const FCalibrationPtr Current = GetCalibration();
+		if (!Current.IsValid() || !Current->IsValid())
+		{
+			return E_PENDING;
+		}
+		// Callers free the table with CoTaskMemFree, as they would the sensor's
+		const int32 NumEntries = Current->DepthRays.Num();
+		PointF *Table = static_cast<PointF*>(CoTaskMemAlloc(NumEntries * sizeof(PointF)));
+		if (Table == nullptr)
+		{
+			return E_OUTOFMEMORY;
+		}
+		for (int32 i = 0; i < NumEntries; i++)
+		{
+			Table[i].X = Current->DepthRays[i].X;
+			Table[i].Y = Current->DepthRays[i].Y;
+		}
+		*TableEntryCount = NumEntries;
+		*TableEntries = Table;
+		return S_OK;
+	}
+
+	virtual HRESULT STDMETHODCALLTYPE GetDepthCameraIntrinsics(CameraIntrinsics *OutIntrinsics) override
+	{
+		const FCalibrationPtr Current = GetCalibration();
+		if (Current.IsValid() && Current->IsValid())
+		{
+			*OutIntrinsics = Current->Intrinsics;
+		}
+		else
+		{
+			// All zero until the calibration is known, as the sensor reports it
+			FMemory::Memzero(OutIntrinsics, sizeof(CameraIntrinsics));
+		}
+		return S_OK;
+	}
+
+private:
+	~FCoordinateMapper()
+	{
+		for (int32 i = 0; i < ChangedEvents.Num(); i++)
+		{
+			CloseHandle(ChangedEvents[i]);
+		}
+	}
+
+	FCalibrationPtr GetCalibration() const
+	{
+		FScopeLock Lock(&Crit);
+		return Calibration;
+	}
+
+	volatile LONG RefCount;
+	mutable FCriticalSection Crit;
+	FCalibrationPtr Calibration;
+	TArray<HANDLE> ChangedEvents;
+};
+
+bool FKinectReplayFrameSource::FIntrinsics::GetDepthRays(int32 Width, int32 Height, TArray<FVector2D> &OutRays)
+{
+	const FCalibrationPtr Current = Owner.GetCalibration();
+	if (!Current.IsValid() || !Current->IsValid() || Current->Width != Width || Current->Height != Height)
+	{
+		return false;
+	}
+	OutRays = Current->DepthRays;
+	return true;
+}
+
+FKinectReplayFrameSource::FKinectReplayFrameSource(const FString &InFilename, const FKinectReplaySettings &InSettings)
+	: Filename(InFilename)
+	, Settings(InSettings)
+	, OpenStreams(EKinectFrameStream::None)
+	, FrameIndex(0)
+	, StartTime(0.0)
+	, FirstPacedFrame(0)
+	, CalibrationId(0)
+	, bMappingChanged(false)
+	, StopEvent(FPlatformProcess::CreateSynchEvent(true))
+	, Intrinsics(*this)
+	, Mapper(new FCoordinateMapper())
+{
+	Settings.FramesPerSecond = FMath::Max(Settings.FramesPerSecond, 1.0f);
+}
+
+FKinectReplayFrameSource::~FKinectReplayFrameSource()
+{
+	Close();
+	Mapper->Release();
+	delete StopEvent;
+}
+
+HRESULT FKinectReplayFrameSource::Open(int32 Streams)
+{
+	Close();
+	if (!Reader.Open(Filename))
+	{
+		return E_FAIL;
+	}
+	StopEvent->Reset();
+	OpenStreams = Streams;
+	FrameIndex = 0;
+	FirstPacedFrame = 0;
+	StartTime = FPlatformTime::Seconds();
+	// Any id but the first frame's, so its calibration is loaded and announced
+	CalibrationId = ~Reader.GetCalibrationId(0);
+	UpdateCalibration(0);
+	return S_OK;
+}
+
+void FKinectReplayFrameSource::Close()
+{
+	OpenStreams = EKinectFrameStream::None;
+	// Planes handed out keep the mapping alive on their own
+	Reader.Close();
+}
+
+void FKinectReplayFrameSource::Stop()
+{
+	StopEvent->Trigger();
+}
+
+double FKinectReplayFrameSource::GetFrameDueTime(int32 Index) const
+{
+	switch (Settings.Pacing)
+	{
+	case EKinectReplayPacing::RealTime:
+		return FMath::Max(static_cast<double>(Reader.GetFrameTime(Index) - Reader.GetFrameTime(FirstPacedFrame)) / KinectTicksPerSecond, 0.0);
+	case EKinectReplayPacing::FixedRate:
+		return (Index - FirstPacedFrame) / Settings.FramesPerSecond;
+	default:
+		return 0.0;
+	}
+}
+
+bool FKinectReplayFrameSource::WaitForFrame(FKinectFrameBundle &OutBundle, uint32 TimeoutMilliseconds)
+{
+	if (OpenStreams == EKinectFrameStream::None)
+	{
+		return false;
+	}
+	if (FrameIndex >= Reader.GetNumFrames())
+	{
+		if (!Settings.bLoop || Reader.GetNumFrames() == 0)
+		{
+			// The stream has ended, like a sensor that was unplugged
+			StopEvent->Wait(TimeoutMilliseconds);
+			return false;
+		}
+		FrameIndex = 0;
+		FirstPacedFrame = 0;
+		StartTime = FPlatformTime::Seconds();
+	}
+	const double DueTime = StartTime + GetFrameDueTime(FrameIndex);
+	const double Now = FPlatformTime::Seconds();
+	const double WaitSeconds = FMath::Max(DueTime - Now, 0.0);
+	if (WaitSeconds * 1000.0 > TimeoutMilliseconds)
+	{
+		StopEvent->Wait(TimeoutMilliseconds);
+		return false;
+	}
+	if (StopEvent->Wait(static_cast<uint32>(WaitSeconds * 1000.0)))
+	{
+		return false;
+	}
+	if (Now - DueTime > MaxReplayLagSeconds)
+	{
+		// Every frame is delivered; a consumer that stalled gets the rest on the recorded schedule
+		FirstPacedFrame = FrameIndex;
+		StartTime = Now;
+	}
+	const int32 Index = FrameIndex++;
+	if (!Reader.ReadFrame(Index, OutBundle))
+	{
+		return false;
+	}
+	OutBundle.Streams &= OpenStreams;
+	if (!OutBundle.Has(EKinectFrameStream::Color))
+	{
+		OutBundle.Color.Reset();
+	}
+	if (!OutBundle.Has(EKinectFrameStream::Depth))
+	{
+		OutBundle.Depth.Reset();
+	}
+	if (!OutBundle.Has(EKinectFrameStream::BodyIndex))
+	{
+		OutBundle.BodyIndex.Reset();
+	}
+	UpdateCalibration(Index);
+	INC_DWORD_STAT(STAT_KinectReplayFrames);
+	return true;
+}
+
+void FKinectReplayFrameSource::UpdateCalibration(int32 Index)
+{
+	const uint64 Id = Reader.GetCalibrationId(Index);
+	if (Id == CalibrationId)
+	{
+		return;
+	}
+	CalibrationId = Id;
+	TSharedPtr<FKinectRecordedCalibration, ESPMode::ThreadSafe> NewCalibration = MakeShareable(new FKinectRecordedCalibration());
+	if (!Reader.ReadCalibration(Index, *NewCalibration))
+	{
+		UE_LOG(LogKinect, Warning, TEXT("Frame %d of Kinect recording %s has no calibration"), Index, *Filename);
+	}
+	{
+		FScopeLock Lock(&CalibrationCrit);
+		Calibration = NewCalibration;
+	}
+	Mapper->SetCalibration(NewCalibration);
+	bMappingChanged = true;
+}
+
+FKinectReplayFrameSource::FCalibrationPtr FKinectReplayFrameSource::GetCalibration() const
+{
+	FScopeLock Lock(&CalibrationCrit);
+	return Calibration;
+}
+
+FIntPoint FKinectReplayFrameSource::GetColorSize() const
+{
+	return Reader.GetColorSize();
+}
+
+FIntPoint FKinectReplayFrameSource::GetDepthSize() const
+{
+	return Reader.GetDepthSize();
+}
+
+IKinectDepthIntrinsics &FKinectReplayFrameSource::GetDepthIntrinsics()
+{
+	return Intrinsics;
+}
+
+bool FKinectReplayFrameSource::PollCoordinateMappingChanged()
+{
+	const bool bChanged = bMappingChanged;
+	bMappingChanged = false;
+	return bChanged;
+}
+
+HRESULT FKinectReplayFrameSource::MapDepthFrameToColorSpace(const uint16 *Depth, int32 NumPixels, ColorSpacePoint *OutColorPoints)
+{
+	const FCalibrationPtr Current = GetCalibration();
+	if (!Current.IsValid())
+	{
+		return E_PENDING;
+	}
+	return Current->MapDepthFrameToColorSpace(Depth, NumPixels, OutColorPoints);
+}
+
+ICoordinateMapper *FKinectReplayFrameSource::GetCoordinateMapper() const
+{
+	return Mapper;
+}
@@ -0,0 +1,107 @@
+#pragma once
+
+#include "KinectFrameSource.h"
+#include "KinectRecording.h"
+
+/** How a replay paces its frames. */
+namespace EKinectReplayPacing
+{
+	enum Type
+	{
+		/** Frames are spaced as they were recorded. */
+		RealTime,
+		/** Frames are spaced evenly at FKinectReplaySettings::FramesPerSecond. */
+		FixedRate,
+		/** Each frame is delivered as soon as the consumer asks for it, for throughput measurements. */
+		AsFastAsPossible,
+	};
+}
+
+struct FKinectReplaySettings
+{
+	EKinectReplayPacing::Type Pacing;
+	float FramesPerSecond;
+	/** Starts over after the last frame rather than ending the stream. */
+	bool bLoop;
+
+	FKinectReplaySettings()
+		: Pacing(EKinectReplayPacing::RealTime)
+		, FramesPerSecond(30.0f)
+		, bLoop(true)
+	{
+	}
+};
+
+/**
+ * Frame source replaying a recording made with FKinectFrameRecorder. Frame
+ * images are views of the memory mapped file, so a replay costs no more than
+ * the page faults of reading it. The recorded calibration stands in for the
+ * sensor's, including a coordinate mapper for consumers that talk to one
+ * directly, so everything downstream runs as it would on the capture rig.
+ *
+ * Frames keep their recorded RelativeTime; a loop starts over at the first
+ * one, which consumers treat like the sensor's clock jumping back.
+ */
+class FKinectReplayFrameSource : public IKinectFrameSource
+{
+public:
+	FKinectReplayFrameSource(const FString &InFilename, const FKinectReplaySettings &InSettings);
+	virtual ~FKinectReplayFrameSource();
+
+	/** Delivers the recorded streams among Streams; streams that were not recorded never arrive. */
+	virtual HRESULT Open(int32 Streams) override;
+	virtual void Close() override;
+	virtual bool WaitForFrame(FKinectFrameBundle &OutBundle, uint32 TimeoutMilliseconds) override;
+	virtual void Stop() override;
+	virtual FIntPoint GetColorSize() const override;
+	virtual FIntPoint GetDepthSize() const override;
+	virtual IKinectDepthIntrinsics &GetDepthIntrinsics() override;
+	virtual bool PollCoordinateMappingChanged() override;
+	virtual HRESULT MapDepthFrameToColorSpace(const uint16 *Depth, int32 NumPixels, ColorSpacePoint *OutColorPoints) override;
+	virtual ICoordinateMapper *GetCoordinateMapper() const override;
+
+	typedef TSharedPtr<const FKinectRecordedCalibration, ESPMode::ThreadSafe> FCalibrationPtr;
+
+	/** Calibration of the frame delivered last, or of the first frame before that. */
+	FCalibrationPtr GetCalibration() const;
+
+private:
+	class FIntrinsics : public IKinectDepthIntrinsics
+	{
+	public:
+		explicit FIntrinsics(FKinectReplayFrameSource &InOwner)
+			: Owner(InOwner)
+		{
+		}
+
+		virtual bool GetDepthRays(int32 Width, int32 Height, TArray<FVector2D> &OutRays) override;
+
+	private:
+		FKinectReplayFrameSource &Owner;
+	};
+
+	class FCoordinateMapper;
+
+	/** Switches to the calibration of frame Index if it differs from the current one. */
+	void UpdateCalibration(int32 Index);
+
+	/** Seconds from the replay's start to when frame Index is due. */
+	double GetFrameDueTime(int32 Index) const;
+
+	FString Filename;
+	FKinectReplaySettings Settings;
+	FKinectRecordingReader Reader;
+	int32 OpenStreams;
+	int32 FrameIndex;
+	/** Wall clock time frame FirstPacedFrame was due at. */
+	double StartTime;
+	int32 FirstPacedFrame;
+	uint64 CalibrationId;
+	bool bMappingChanged;
+	FEvent *StopEvent;
+	FIntrinsics Intrinsics;
+	FCoordinateMapper *Mapper;
+	/** Guards Calibration, which consumers may query from other threads. */
+	mutable FCriticalSection CalibrationCrit;
+	FCalibrationPtr Calibration;
+};
@@ -2,6 +2,7 @@
 
 #include "KinectPluginPrivatePCH.h"
 #include "KinectSensor.h"
+#include "KinectSensorHub.h"
 #include "AllowWindowsPlatformTypes.h"
 #include <kinect.h>
 #include <comdef.h>
@@ -17,13 +18,29 @@ static void LogError(const FString &context, int hr) {
 
 UKinectSensor::UKinectSensor(const FObjectInitializer& ObjectInitializer)
   : Super( ObjectInitializer )
+  , FrameSource(nullptr)
 {
-  HRESULT hr = GetDefaultKinectSensor(&KinectSensor);
-  if (SUCCEEDED(hr)) {
-    hr = KinectSensor->Open();
-    if (SUCCEEDED(hr)) {
-    }
-  } else {
-    LogError(TEXT("GetDefaultKinectSensor"), hr);
+}
+
+void UKinectSensor::PostInitProperties()
+{
+  Super::PostInitProperties();
+  // The class default object must not hold the sensor open
+  if (HasAnyFlags(RF_ClassDefaultObject)) {
+    return;
+  }
+  FrameSource = new FKinectHubFrameSource(IKinectPlugin::Get().GetSensorHub());
+  HRESULT hr = FrameSource->Open(EKinectFrameStream::None);
+  if (FAILED(hr)) {
+    LogError(TEXT("Open shared Kinect sensor"), hr);
+    delete FrameSource;
+    FrameSource = nullptr;
   }
 }
+
+void UKinectSensor::BeginDestroy()
+{
+  delete FrameSource;
+  FrameSource = nullptr;
+  Super::BeginDestroy();
+}
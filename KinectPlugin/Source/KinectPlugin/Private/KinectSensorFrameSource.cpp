@@ -0,0 +1,515 @@
+#include "KinectPluginPrivatePCH.h"
+#include "KinectSensorFrameSource.h"
+#include "AllowWindowsPlatformTypes.h"
+#include "comdef.h"
+
+DECLARE_CYCLE_STAT(TEXT("Frame Acquisition"), STAT_KinectFrameAcquisition, STATGROUP_Kinect);
+DECLARE_CYCLE_STAT(TEXT("Body Attribute Queries"), STAT_KinectBodyAttributeQueries, STATGROUP_Kinect);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Body Attribute Queries Skipped"), STAT_KinectBodyAttributeQueriesSkipped, STATGROUP_Kinect);
+DECLARE_FLOAT_COUNTER_STAT(TEXT("Body Attribute Query Ms Saved"), STAT_KinectBodyAttributeQueryMsSaved, STATGROUP_Kinect);
+
+/** Runtime calls each EKinectBodyAttribute bit takes per body, in bit order. */
+static const int32 BodyAttributeCalls[] = { 2, 1, 2, 1, 1, 1 };
+static_assert(EKinectBodyAttribute::All == (1 << ARRAY_COUNT(BodyAttributeCalls)) - 1, "Every body attribute needs its call count");
+
+/** Times each attribute's query is repeated when measured; the fastest is kept, the first may pay for a cold runtime. */
+static const int32 BodyAttributeTimings = 4;
+
+static void LogKinectError(const FString &context, int hr) {
+	_com_error err(hr);
+	LPCTSTR errMsg = err.ErrorMessage();
+	UE_LOG(LogKinect, Error, TEXT("%s: %d: %s"), *context, hr, errMsg);
+}
+
+/** Keeps a sensor frame acquired while planes view its underlying buffer. */
+class FKinectSensorFrameHold : public FKinectFrameHold
+{
+public:
+	/** Takes over the caller's reference to Frame. */
+	explicit FKinectSensorFrameHold(IUnknown *InFrame)
+		: Frame(InFrame)
+	{
+	}
+
+	virtual ~FKinectSensorFrameHold()
+	{
+		SafeRelease(Frame);
+	}
+
+private:
+	IUnknown *Frame;
+};
+
+FKinectSensorFrameSource::FKinectSensorFrameSource()
+	: OpenStreams(EKinectFrameStream::None)
+	, BodyAttributes(EKinectBodyAttribute::Default)
+	, Sensor(nullptr)
+	, CoordinateMapper(nullptr)
+	, Reader(nullptr)
+	, FrameArrivedEvent(0)
+	, CoordinateMappingChangedEvent(0)
+	, StopEvent(CreateEvent(nullptr, TRUE, FALSE, nullptr))
+	, Intrinsics(nullptr)
+	, ColorSize(0, 0)
+	, DepthSize(0, 0)
+	, bBodyAttributesTimed(false)
+{
+	FMemory::Memzero(BodyAttributeSeconds, sizeof(BodyAttributeSeconds));
+}
+
+FKinectSensorFrameSource::~FKinectSensorFrameSource()
+{
+	Close();
+	CloseHandle(StopEvent);
+}
+
+HRESULT FKinectSensorFrameSource::Open(int32 Streams)
+{
+	Close();
+	ResetEvent(StopEvent);
+	HRESULT hResult = GetDefaultKinectSensor(&Sensor);
+	if (FAILED(hResult))
+	{
+		LogKinectError("Get Default Kinect Sensor", hResult);
+		return hResult;
+	}
+	hResult = Sensor->Open();
+	if (FAILED(hResult))
+	{
+		LogKinectError("Sensor Open", hResult);
+		return hResult;
+	}
+	hResult = Sensor->get_CoordinateMapper(&CoordinateMapper);
+	if (FAILED(hResult))
+	{
+		LogKinectError("Get Coordinate Mapper", hResult);
+		return hResult;
+	}
+	Intrinsics = FKinectCoordinateMapperIntrinsics(CoordinateMapper);
+	hResult = CoordinateMapper->SubscribeCoordinateMappingChanged(&CoordinateMappingChangedEvent);
+	if (FAILED(hResult))
+	{
+		LogKinectError("Subscribe Coordinate Mapping Changed", hResult);
+	}
+
+	// Frame sizes come from the individual sources, the multi source reader does not report them
+	IColorFrameSource *ColorSource = nullptr;
+	IFrameDescription *Description = nullptr;
+	hResult = Sensor->get_ColorFrameSource(&ColorSource);
+	if (SUCCEEDED(hResult))
+	{
+		hResult = ColorSource->get_FrameDescription(&Description);
+	}
+	if (SUCCEEDED(hResult))
+	{
+		Description->get_Width(&ColorSize.X); // 1920
+		Description->get_Height(&ColorSize.Y); // 1080
+	}
+	SafeRelease(Description);
+	SafeRelease(ColorSource);
+	if (FAILED(hResult))
+	{
+		LogKinectError("Color Source Frame Description", hResult);
+		return hResult;
+	}
+	IDepthFrameSource *DepthSource = nullptr;
+	hResult = Sensor->get_DepthFrameSource(&DepthSource);
+	if (SUCCEEDED(hResult))
+	{
+		hResult = DepthSource->get_FrameDescription(&Description);
+	}
+	if (SUCCEEDED(hResult))
+	{
+		Description->get_Width(&DepthSize.X); // 512
+		Description->get_Height(&DepthSize.Y); // 424
+	}
+	SafeRelease(Description);
+	SafeRelease(DepthSource);
+	if (FAILED(hResult))
+	{
+		LogKinectError("Depth Source Frame Description", hResult);
+		return hResult;
+	}
+
+	DWORD Types = 0;
+	Types |= (Streams & EKinectFrameStream::Color) ? FrameSourceTypes_Color : 0;
+	Types |= (Streams & EKinectFrameStream::Depth) ? FrameSourceTypes_Depth : 0;
+	Types |= (Streams & EKinectFrameStream::BodyIndex) ? FrameSourceTypes_BodyIndex : 0;
+	Types |= (Streams & EKinectFrameStream::Body) ? FrameSourceTypes_Body : 0;
+	hResult = Sensor->OpenMultiSourceFrameReader(Types, &Reader);
+	if (FAILED(hResult))
+	{
+		LogKinectError("Open Multi Source Frame Reader", hResult);
+		return hResult;
+	}
+	hResult = Reader->SubscribeMultiSourceFrameArrived(&FrameArrivedEvent);
+	if (FAILED(hResult))
+	{
+		LogKinectError("Subscribe Multi Source Frame Arrived", hResult);
+		return hResult;
+	}
+	OpenStreams = Streams;
+	return S_OK;
+}
+
+void FKinectSensorFrameSource::Close()
+{
+	if (Reader && FrameArrivedEvent)
+	{
+		Reader->UnsubscribeMultiSourceFrameArrived(FrameArrivedEvent);
+	}
+	FrameArrivedEvent = 0;
+	SafeRelease(Reader);
+	if (CoordinateMapper && CoordinateMappingChangedEvent)
+	{
+		CoordinateMapper->UnsubscribeCoordinateMappingChanged(CoordinateMappingChangedEvent);
+	}
+	CoordinateMappingChangedEvent = 0;
+	Intrinsics = FKinectCoordinateMapperIntrinsics(nullptr);
+	SafeRelease(CoordinateMapper);
+	if (Sensor)
+	{
+		Sensor->Close();
+	}
+	SafeRelease(Sensor);
+	OpenStreams = EKinectFrameStream::None;
+}
+
+void FKinectSensorFrameSource::Stop()
+{
+	SetEvent(StopEvent);
+}
+
+bool FKinectSensorFrameSource::WaitForFrame(FKinectFrameBundle &OutBundle, uint32 TimeoutMilliseconds)
+{
+	if (Reader == nullptr)
+	{
+		return false;
+	}
+	HANDLE Events[] = { reinterpret_cast<HANDLE>(FrameArrivedEvent), StopEvent };
+	if (WaitForMultipleObjects(2, Events, FALSE, TimeoutMilliseconds) != WAIT_OBJECT_0)
+	{
+		return false;
+	}
+	SCOPE_CYCLE_COUNTER(STAT_KinectFrameAcquisition);
+	IMultiSourceFrameArrivedEventArgs *Args = nullptr;
+	IMultiSourceFrameReference *Reference = nullptr;
+	IMultiSourceFrame *Frame = nullptr;
+	HRESULT hResult = Reader->GetMultiSourceFrameArrivedEventData(FrameArrivedEvent, &Args);
+	if (SUCCEEDED(hResult))
+	{
+		hResult = Args->get_FrameReference(&Reference);
+	}
+	if (SUCCEEDED(hResult))
+	{
+		hResult = Reference->AcquireFrame(&Frame);
+	}
+	if (SUCCEEDED(hResult))
+	{
+		hResult = AcquireBundle(Frame, OutBundle);
+	}
+	SafeRelease(Frame);
+	SafeRelease(Reference);
+	SafeRelease(Args);
+	return SUCCEEDED(hResult) && OutBundle.Streams != EKinectFrameStream::None;
+}
+
+HRESULT FKinectSensorFrameSource::AcquireBundle(IMultiSourceFrame *Frame, FKinectFrameBundle &OutBundle)
+{
+	// A stream whose frame already expired is left out of the bundle rather than failing it
+	OutBundle.Streams = EKinectFrameStream::None;
+	if ((OpenStreams & EKinectFrameStream::Color) && SUCCEEDED(AcquireColor(Frame, OutBundle)))
+	{
+		OutBundle.Streams |= EKinectFrameStream::Color;
+	}
+	if ((OpenStreams & EKinectFrameStream::Depth) && SUCCEEDED(AcquireDepth(Frame, OutBundle)))
+	{
+		OutBundle.Streams |= EKinectFrameStream::Depth;
+	}
+	if ((OpenStreams & EKinectFrameStream::BodyIndex) && SUCCEEDED(AcquireBodyIndex(Frame, OutBundle)))
+	{
+		OutBundle.Streams |= EKinectFrameStream::BodyIndex;
+	}
+	if ((OpenStreams & EKinectFrameStream::Body) && SUCCEEDED(AcquireBodies(Frame, OutBundle)))
+	{
+		OutBundle.Streams |= EKinectFrameStream::Body;
+	}
+	return S_OK;
+}
+
+HRESULT FKinectSensorFrameSource::AcquireColor(IMultiSourceFrame *Frame, FKinectFrameBundle &OutBundle)
+{
+	IColorFrameReference *Reference = nullptr;
+	IColorFrame *ColorFrame = nullptr;
+	OutBundle.Color.Reset();
+	HRESULT hResult = Frame->get_ColorFrameReference(&Reference);
+	if (SUCCEEDED(hResult))
+	{
+		hResult = Reference->AcquireFrame(&ColorFrame);
+	}
+	if (SUCCEEDED(hResult))
+	{
+		hResult = ColorFrame->get_RelativeTime(&OutBundle.ColorTime);
+	}
+	if (SUCCEEDED(hResult))
+	{
+		ColorImageFormat Format = ColorImageFormat_None;
+		hResult = ColorFrame->get_RawColorImageFormat(&Format);
+		if (SUCCEEDED(hResult) && Format == ColorImageFormat_Yuy2)
+		{
+			// Handed on as is, consumers convert only what they use
+			UINT Size = 0;
+			BYTE *Buffer = nullptr;
+			hResult = ColorFrame->AccessRawUnderlyingBuffer(&Size, &Buffer);
+			if (SUCCEEDED(hResult))
+			{
+				OutBundle.Color.SetView(Buffer, Size, MakeShareable(new FKinectSensorFrameHold(ColorFrame)));
+				ColorFrame = nullptr;
+			}
+			else
+			{
+				LogKinectError("Error : IColorFrame::AccessRawUnderlyingBuffer()", hResult);
+			}
+		}
+		else if (SUCCEEDED(hResult))
+		{
+			const int32 Size = ColorSize.X * ColorSize.Y * 2;
+			hResult = ColorFrame->CopyConvertedFrameDataToArray(Size, OutBundle.Color.Allocate(Size), ColorImageFormat_Yuy2);
+			if (FAILED(hResult))
+			{
+				LogKinectError("Error : IColorFrame::CopyConvertedFrameDataToArray()", hResult);
+			}
+		}
+		else
+		{
+			LogKinectError("Error : IColorFrame::get_RawColorImageFormat()", hResult);
+		}
+	}
+	SafeRelease(ColorFrame);
+	SafeRelease(Reference);
+	return hResult;
+}
+
+HRESULT FKinectSensorFrameSource::AcquireDepth(IMultiSourceFrame *Frame, FKinectFrameBundle &OutBundle)
+{
+	IDepthFrameReference *Reference = nullptr;
+	IDepthFrame *DepthFrame = nullptr;
+	// A frame still held from last time would keep the new one from being acquired
+	OutBundle.Depth.Reset();
+	HRESULT hResult = Frame->get_DepthFrameReference(&Reference);
+	if (SUCCEEDED(hResult))
+	{
+		hResult = Reference->AcquireFrame(&DepthFrame);
+	}
+	if (SUCCEEDED(hResult))
+	{
+		hResult = DepthFrame->get_RelativeTime(&OutBundle.DepthTime);
+	}
+	if (SUCCEEDED(hResult))
+	{
+		UINT Size = 0;
+		UINT16 *Buffer = nullptr;
+		hResult = DepthFrame->AccessUnderlyingBuffer(&Size, &Buffer);
+		if (SUCCEEDED(hResult))
+		{
+			// No copy, the bundle holds on to the frame for as long as someone views the buffer
+			OutBundle.Depth.SetView(Buffer, Size, MakeShareable(new FKinectSensorFrameHold(DepthFrame)));
+			DepthFrame = nullptr;
+		}
+		else
+		{
+			LogKinectError("Error : IDepthFrame::AccessUnderlyingBuffer()", hResult);
+		}
+	}
+	SafeRelease(DepthFrame);
+	SafeRelease(Reference);
+	return hResult;
+}
+
+HRESULT FKinectSensorFrameSource::AcquireBodyIndex(IMultiSourceFrame *Frame, FKinectFrameBundle &OutBundle)
+{
+	IBodyIndexFrameReference *Reference = nullptr;
+	IBodyIndexFrame *BodyIndexFrame = nullptr;
+	OutBundle.BodyIndex.Reset();
+	HRESULT hResult = Frame->get_BodyIndexFrameReference(&Reference);
+	if (SUCCEEDED(hResult))
+	{
+		hResult = Reference->AcquireFrame(&BodyIndexFrame);
+	}
+	if (SUCCEEDED(hResult))
+	{
+		hResult = BodyIndexFrame->get_RelativeTime(&OutBundle.BodyIndexTime);
+	}
+	if (SUCCEEDED(hResult))
+	{
+		UINT Size = 0;
+		BYTE *Buffer = nullptr;
+		hResult = BodyIndexFrame->AccessUnderlyingBuffer(&Size, &Buffer);
+		if (SUCCEEDED(hResult))
+		{
+			OutBundle.BodyIndex.SetView(Buffer, Size, MakeShareable(new FKinectSensorFrameHold(BodyIndexFrame)));
+			BodyIndexFrame = nullptr;
+		}
+	}
+	SafeRelease(BodyIndexFrame);
+	SafeRelease(Reference);
+	return hResult;
+}
+
+void FKinectSensorFrameSource::QueryBodyAttributes(IBody *Body, int32 Attributes, FKinectBodyData &OutBody)
+{
+	OutBody.Attributes = Attributes;
+	if (Attributes & EKinectBodyAttribute::JointOrientations)
+	{
+		HRESULT hOrientation = Body->GetJointOrientations(JointType_Count, OutBody.JointOrientations);
+		if (FAILED(hOrientation))
+		{
+			LogKinectError("GetJointOrientations", hOrientation);
+			OutBody.Attributes &= ~EKinectBodyAttribute::JointOrientations;
+		}
+	}
+	if (Attributes & EKinectBodyAttribute::HandStates)
+	{
+		OutBody.LeftHandState = HandState_Unknown;
+		Body->get_HandLeftState(&OutBody.LeftHandState);
+		OutBody.RightHandState = HandState_Unknown;
+		Body->get_HandRightState(&OutBody.RightHandState);
+	}
+	if (Attributes & EKinectBodyAttribute::Lean)
+	{
+		OutBody.LeanTrackingState = TrackingState_NotTracked;
+		if (FAILED(Body->get_Lean(&OutBody.Lean)) ||
+			FAILED(Body->get_LeanTrackingState(&OutBody.LeanTrackingState)))
+		{
+			OutBody.Attributes &= ~EKinectBodyAttribute::Lean;
+		}
+	}
+	// The detection results are reported Unknown by runtimes that do not detect them
+	if ((Attributes & EKinectBodyAttribute::Activities) &&
+		FAILED(Body->GetActivityDetectionResults(Activity_Count, OutBody.Activities)))
+	{
+		OutBody.Attributes &= ~EKinectBodyAttribute::Activities;
+	}
+	if ((Attributes & EKinectBodyAttribute::Appearance) &&
+		FAILED(Body->GetAppearanceDetectionResults(Appearance_Count, OutBody.Appearance)))
+	{
+		OutBody.Attributes &= ~EKinectBodyAttribute::Appearance;
+	}
+	if ((Attributes & EKinectBodyAttribute::Expressions) &&
+		FAILED(Body->GetExpressionDetectionResults(Expression_Count, OutBody.Expressions)))
+	{
+		OutBody.Attributes &= ~EKinectBodyAttribute::Expressions;
+	}
+}
+
+void FKinectSensorFrameSource::TimeBodyAttributes(IBody *Body)
+{
+	static_assert(ARRAY_COUNT(BodyAttributeSeconds) == ARRAY_COUNT(BodyAttributeCalls), "Every body attribute needs its time");
+	FKinectBodyData Scratch;
+	for (int32 Bit = 0; Bit < static_cast<int32>(ARRAY_COUNT(BodyAttributeSeconds)); Bit++)
+	{
+		BodyAttributeSeconds[Bit] = MAX_dbl;
+		for (int32 i = 0; i < BodyAttributeTimings; i++)
+		{
+			const double StartTime = FPlatformTime::Seconds();
+			QueryBodyAttributes(Body, 1 << Bit, Scratch);
+			BodyAttributeSeconds[Bit] = FMath::Min(BodyAttributeSeconds[Bit], FPlatformTime::Seconds() - StartTime);
+		}
+	}
+	bBodyAttributesTimed = true;
+}
+
+HRESULT FKinectSensorFrameSource::AcquireBodies(IMultiSourceFrame *Frame, FKinectFrameBundle &OutBundle)
+{
+	IBodyFrameReference *Reference = nullptr;
+	IBodyFrame *BodyFrame = nullptr;
+	IBody *Bodies[BODY_COUNT] = { 0 };
+	HRESULT hResult = Frame->get_BodyFrameReference(&Reference);
+	if (SUCCEEDED(hResult))
+	{
+		hResult = Reference->AcquireFrame(&BodyFrame);
+	}
+	if (SUCCEEDED(hResult))
+	{
+		hResult = BodyFrame->get_RelativeTime(&OutBundle.BodyTime);
+	}
+	if (SUCCEEDED(hResult))
+	{
+		hResult = BodyFrame->GetAndRefreshBodyData(BODY_COUNT, Bodies);
+	}
+	if (SUCCEEDED(hResult))
+	{
+		// Read once, so every body of the frame holds the same attributes
+		const int32 Attributes = BodyAttributes;
+		int32 SkippedCalls = 0;
+		double SkippedSeconds = 0.0;
+		for (int32 Bit = 0; Bit < static_cast<int32>(ARRAY_COUNT(BodyAttributeCalls)); Bit++)
+		{
+			SkippedCalls += (Attributes & (1 << Bit)) ? 0 : BodyAttributeCalls[Bit];
+			SkippedSeconds += (Attributes & (1 << Bit)) ? 0.0 : BodyAttributeSeconds[Bit];
+		}
+		for (int32 count = 0; count < BODY_COUNT; count++)
+		{
+			FKinectBodyData &Body = OutBundle.Bodies[count];
+			BOOLEAN bTracked = false;
+			Body.bTracked = SUCCEEDED(Bodies[count]->get_IsTracked(&bTracked)) && bTracked &&
+				SUCCEEDED(Bodies[count]->GetJoints(JointType_Count, Body.Joints));
+			if (!Body.bTracked)
+			{
+				continue;
+			}
+#if STATS
+			if (!bBodyAttributesTimed)
+			{
+				TimeBodyAttributes(Bodies[count]);
+			}
+#endif
+			SCOPE_CYCLE_COUNTER(STAT_KinectBodyAttributeQueries);
+			INC_DWORD_STAT_BY(STAT_KinectBodyAttributeQueriesSkipped, SkippedCalls);
+			INC_FLOAT_STAT_BY(STAT_KinectBodyAttributeQueryMsSaved, static_cast<float>(SkippedSeconds * 1000.0));
+			QueryBodyAttributes(Bodies[count], Attributes, Body);
+		}
+	}
+	for (int32 count = 0; count < BODY_COUNT; count++)
+	{
+		SafeRelease(Bodies[count]);
+	}
+	SafeRelease(BodyFrame);
+	SafeRelease(Reference);
+	return hResult;
+}
+
+FIntPoint FKinectSensorFrameSource::GetColorSize() const
+{
+	return ColorSize;
+}
+
+FIntPoint FKinectSensorFrameSource::GetDepthSize() const
+{
+	return DepthSize;
+}
+
+IKinectDepthIntrinsics &FKinectSensorFrameSource::GetDepthIntrinsics()
+{
+	return Intrinsics;
+}
+
+bool FKinectSensorFrameSource::PollCoordinateMappingChanged()
+{
+	if (CoordinateMappingChangedEvent != 0 &&
+		WAIT_OBJECT_0 == WaitForSingleObject(reinterpret_cast<HANDLE>(CoordinateMappingChangedEvent), 0))
+	{
+		ResetEvent(reinterpret_cast<HANDLE>(CoordinateMappingChangedEvent));
+		return true;
+	}
+	return false;
+}
+
+HRESULT FKinectSensorFrameSource::MapDepthFrameToColorSpace(const uint16 *Depth, int32 NumPixels, ColorSpacePoint *OutColorPoints)
+{
+	if (CoordinateMapper == nullptr)
+	{
+		return E_NOT_VALID_STATE;
+	}
+	return CoordinateMapper->MapDepthFrameToColorSpace(NumPixels, Depth, NumPixels, OutColorPoints);
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include "KinectFrameSource.h"
+
+/**
+ * Frame source backed by the default Kinect sensor. All streams come from a
+ * single multi source reader; WaitForFrame sleeps on its frame arrived event,
+ * so a bundle is delivered as soon as the sensor has one.
+ */
+class FKinectSensorFrameSource : public IKinectFrameSource
+{
+public:
+	FKinectSensorFrameSource();
+	virtual ~FKinectSensorFrameSource();
+
+	virtual HRESULT Open(int32 Streams) override;
+	virtual void Close() override;
+	virtual bool WaitForFrame(FKinectFrameBundle &OutBundle, uint32 TimeoutMilliseconds) override;
+	virtual void Stop() override;
+	virtual FIntPoint GetColorSize() const override;
+	virtual FIntPoint GetDepthSize() const override;
+	virtual IKinectDepthIntrinsics &GetDepthIntrinsics() override;
+	virtual bool PollCoordinateMappingChanged() override;
+	virtual HRESULT MapDepthFrameToColorSpace(const uint16 *Depth, int32 NumPixels, ColorSpacePoint *OutColorPoints) override;
+
+	virtual ICoordinateMapper *GetCoordinateMapper() const override
+	{
+		return CoordinateMapper;
+	}
+
+	/** Safe to call from any thread while bodies are acquired. */
+	virtual void SetBodyAttributes(int32 Attributes) override
+	{
+		BodyAttributes = Attributes;
+	}
+
+private:
+	HRESULT AcquireBundle(IMultiSourceFrame *Frame, FKinectFrameBundle &OutBundle);
+	HRESULT AcquireColor(IMultiSourceFrame *Frame, FKinectFrameBundle &OutBundle);
+	HRESULT AcquireDepth(IMultiSourceFrame *Frame, FKinectFrameBundle &OutBundle);
+	HRESULT AcquireBodyIndex(IMultiSourceFrame *Frame, FKinectFrameBundle &OutBundle);
+	HRESULT AcquireBodies(IMultiSourceFrame *Frame, FKinectFrameBundle &OutBundle);
+	/** Queries the attributes of Body in the Attributes mask, clearing the bits of those that fail from OutBody. */
+	static void QueryBodyAttributes(IBody *Body, int32 Attributes, FKinectBodyData &OutBody);
+	/** Times each attribute's query on Body, for the stat of the time the unqueried attributes save. */
+	void TimeBodyAttributes(IBody *Body);
+
+	int32 OpenStreams;
+	volatile int32 BodyAttributes;
+	IKinectSensor *Sensor;
+	ICoordinateMapper *CoordinateMapper;
+	IMultiSourceFrameReader *Reader;
+	WAITABLE_HANDLE FrameArrivedEvent;
+	WAITABLE_HANDLE CoordinateMappingChangedEvent;
+	HANDLE StopEvent;
+	FKinectCoordinateMapperIntrinsics Intrinsics;
+	FIntPoint ColorSize;
+	FIntPoint DepthSize;
+	/** Seconds one body's query of each EKinectBodyAttribute bit takes, in bit order; measured on the first tracked body. */
+	double BodyAttributeSeconds[6];
+	bool bBodyAttributesTimed;
+};
@@ -0,0 +1,408 @@
+#include "KinectPluginPrivatePCH.h"
+#include "KinectSensorHub.h"
+
+DECLARE_DWORD_COUNTER_STAT(TEXT("Hub Bundles Delivered"), STAT_KinectHubBundlesDelivered, STATGROUP_Kinect);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Hub Bundles Skipped"), STAT_KinectHubBundlesSkipped, STATGROUP_Kinect);
+
+FKinectSensorHub::FKinectSensorHub()
+	: Source(&SensorSource)
+	, bOpen(false)
+	, bRunning(false)
+	, Thread(nullptr)
+{
+}
+
+FKinectSensorHub::~FKinectSensorHub()
+{
+	Shutdown();
+	if (Source != &SensorSource)
+	{
+		delete Source;
+	}
+}
+
+HRESULT FKinectSensorHub::AddSubscriber(IKinectFrameSubscriber *Subscriber, int32 Streams, int32 BodyAttributes)
+{
+	FScopeLock OpenLock(&OpenCrit);
+	if (!bOpen)
+	{
+		Source = CreateSource();
+		// Every stream is opened so subscribers can come and go without reopening the sensor
+		HRESULT hResult = Source->Open(EKinectFrameStream::Color | EKinectFrameStream::Depth |
+			EKinectFrameStream::BodyIndex | EKinectFrameStream::Body);
+		if (FAILED(hResult))
+		{
+			Source->Close();
+			return hResult;
+		}
+		bOpen = true;
+		bRunning = true;
+		Thread = FRunnableThread::Create(this, TEXT("KinectSensorHub"));
+	}
+	FSubscription Subscription = { Subscriber, Streams, BodyAttributes };
+	{
+		FScopeLock Lock(&SubscriberCrit);
+		Subscriptions.Add(Subscription);
+	}
+	UpdateBodyAttributes();
+	return S_OK;
+}
+
+void FKinectSensorHub::SetBodyAttributes(IKinectFrameSubscriber *Subscriber, int32 BodyAttributes)
+{
+	FScopeLock OpenLock(&OpenCrit);
+	{
+		FScopeLock Lock(&SubscriberCrit);
+		for (int32 i = 0; i < Subscriptions.Num(); i++)
+		{
+			if (Subscriptions[i].Subscriber == Subscriber)
+			{
+				Subscriptions[i].BodyAttributes = BodyAttributes;
+			}
+		}
+	}
+	UpdateBodyAttributes();
+}
+
+void FKinectSensorHub::UpdateBodyAttributes()
+{
+	int32 BodyAttributes = EKinectBodyAttribute::None;
+	{
+		FScopeLock Lock(&SubscriberCrit);
+		for (int32 i = 0; i < Subscriptions.Num(); i++)
+		{
+			BodyAttributes |= Subscriptions[i].BodyAttributes;
+		}
+	}
+	if (bOpen)
+	{
+		Source->SetBodyAttributes(BodyAttributes);
+	}
+}
+
+void FKinectSensorHub::RemoveSubscriber(IKinectFrameSubscriber *Subscriber)
+{
+	FScopeLock OpenLock(&OpenCrit);
+	bool bLast = false;
+	{
+		FScopeLock Lock(&SubscriberCrit);
+		for (int32 i = Subscriptions.Num() - 1; i >= 0; i--)
+		{
+			if (Subscriptions[i].Subscriber == Subscriber)
+			{
+				Subscriptions.RemoveAt(i);
+			}
+		}
+		bLast = Subscriptions.Num() == 0;
+	}
+	if (bLast && bOpen)
+	{
+		CloseSensor();
+	}
+	else
+	{
+		UpdateBodyAttributes();
+	}
+}
+
+void FKinectSensorHub::Shutdown()
+{
+	FScopeLock OpenLock(&OpenCrit);
+	{
+		FScopeLock Lock(&SubscriberCrit);
+		Subscriptions.Reset();
+	}
+	if (bOpen)
+	{
+		CloseSensor();
+	}
+}
+
+void FKinectSensorHub::CloseSensor()
+{
+	// The delivery lock must not be held here, the thread may be waiting for it
+	bRunning = false;
+	Source->Stop();
+	if (Thread)
+	{
+		Thread->WaitForCompletion();
+		delete Thread;
+		Thread = nullptr;
+	}
+	Source->Close();
+	bOpen = false;
+}
+
+void FKinectSensorHub::SetReplay(const FString &Filename, const FKinectReplaySettings &Settings)
+{
+	FScopeLock OpenLock(&OpenCrit);
+	ReplayFilename = Filename;
+	ReplaySettings = Settings;
+}
+
+IKinectFrameSource *FKinectSensorHub::CreateSource()
+{
+	if (Source != &SensorSource)
+	{
+		delete Source;
+		Source = &SensorSource;
+	}
+	FString Filename = ReplayFilename;
+	FKinectReplaySettings Settings = ReplaySettings;
+	if (Filename.IsEmpty() && FParse::Value(FCommandLine::Get(), TEXT("KinectReplay="), Filename))
+	{
+		Settings = FKinectReplaySettings();
+		if (FParse::Value(FCommandLine::Get(), TEXT("KinectReplayRate="), Settings.FramesPerSecond))
+		{
+			Settings.Pacing = EKinectReplayPacing::FixedRate;
+		}
+		if (FParse::Param(FCommandLine::Get(), TEXT("KinectReplayFast")))
+		{
+			Settings.Pacing = EKinectReplayPacing::AsFastAsPossible;
+		}
+	}
+	if (Filename.IsEmpty())
+	{
+		return &SensorSource;
+	}
+	UE_LOG(LogKinect, Log, TEXT("Kinect sensor hub replays %s"), *Filename);
+	return new FKinectReplayFrameSource(Filename, Settings);
+}
+
+uint32 FKinectSensorHub::Run()
+{
+	while (bRunning)
+	{
+		if (!Source->WaitForFrame(Bundle, 100))
+		{
+			continue;
+		}
+		if (Source->PollCoordinateMappingChanged())
+		{
+			MappingGeneration.Increment();
+		}
+		{
+			FScopeLock Lock(&SubscriberCrit);
+			for (int32 i = 0; i < Subscriptions.Num(); i++)
+			{
+				if (Subscriptions[i].Streams & Bundle.Streams)
+				{
+					Subscriptions[i].Subscriber->OnFrameBundle(Bundle);
+					INC_DWORD_STAT(STAT_KinectHubBundlesDelivered);
+				}
+			}
+		}
+		// Only the subscribers keep the sensor frames now, so the last one done releases them
+		Bundle.Color.Reset();
+		Bundle.Depth.Reset();
+		Bundle.BodyIndex.Reset();
+	}
+	Bundle.Color.Reset();
+	Bundle.Depth.Reset();
+	Bundle.BodyIndex.Reset();
+	return 0;
+}
+
+FIntPoint FKinectSensorHub::GetColorSize() const
+{
+	return Source->GetColorSize();
+}
+
+FIntPoint FKinectSensorHub::GetDepthSize() const
+{
+	return Source->GetDepthSize();
+}
+
+IKinectDepthIntrinsics &FKinectSensorHub::GetDepthIntrinsics()
+{
+	return Source->GetDepthIntrinsics();
+}
+
+HRESULT FKinectSensorHub::MapDepthFrameToColorSpace(const uint16 *Depth, int32 NumPixels, ColorSpacePoint *OutColorPoints)
+{
+	return Source->MapDepthFrameToColorSpace(Depth, NumPixels, OutColorPoints);
+}
+
+ICoordinateMapper *FKinectSensorHub::GetCoordinateMapper() const
+{
+	return Source->GetCoordinateMapper();
+}
+
+FKinectHubFrameSource::FKinectHubFrameSource(FKinectSensorHub &InHub)
+	: Hub(InHub)
+	, bOpen(false)
+	, bStopped(false)
+	, Streams(EKinectFrameStream::None)
+	, BodyAttributes(EKinectBodyAttribute::Default)
+	, MappingGeneration(INDEX_NONE)
+	, bPending(false)
+	, FrameEvent(FPlatformProcess::CreateSynchEvent())
+{
+}
+
+FKinectHubFrameSource::~FKinectHubFrameSource()
+{
+	Close();
+	delete FrameEvent;
+}
+
+HRESULT FKinectHubFrameSource::Open(int32 InStreams)
+{
+	Close();
+	bStopped = false;
+	Streams = InStreams;
+	MappingGeneration = INDEX_NONE;
+	HRESULT hResult = Hub.AddSubscriber(this, Streams, BodyAttributes);
+	bOpen = SUCCEEDED(hResult);
+	return hResult;
+}
+
+void FKinectHubFrameSource::Close()
+{
+	if (bOpen)
+	{
+		Hub.RemoveSubscriber(this);
+		bOpen = false;
+	}
+	FScopeLock Lock(&Crit);
+	ReleasePending();
+}
+
+void FKinectHubFrameSource::ReleasePending()
+{
+	Pending.Color.Reset();
+	Pending.Depth.Reset();
+	Pending.BodyIndex.Reset();
+	bPending = false;
+}
+
+void FKinectHubFrameSource::OnFrameBundle(const FKinectFrameBundle &Bundle)
+{
+	{
+		FScopeLock Lock(&Crit);
+		if (bPending)
+		{
+			INC_DWORD_STAT(STAT_KinectHubBundlesSkipped);
+		}
+		// Only references are taken, the images stay where the sensor put them
+		Pending.Streams = Bundle.Streams & Streams;
+		Pending.ColorTime = Bundle.ColorTime;
+		Pending.DepthTime = Bundle.DepthTime;
+		Pending.BodyIndexTime = Bundle.BodyIndexTime;
+		Pending.BodyTime = Bundle.BodyTime;
+		Pending.Color.Reset();
+		if (Pending.Has(EKinectFrameStream::Color))
+		{
+			Pending.Color = Bundle.Color;
+		}
+		Pending.Depth.Reset();
+		if (Pending.Has(EKinectFrameStream::Depth))
+		{
+			Pending.Depth = Bundle.Depth;
+		}
+		Pending.BodyIndex.Reset();
+		if (Pending.Has(EKinectFrameStream::BodyIndex))
+		{
+			Pending.BodyIndex = Bundle.BodyIndex;
+		}
+		if (Pending.Has(EKinectFrameStream::Body))
+		{
+			for (int32 i = 0; i < BODY_COUNT; i++)
+			{
+				Pending.Bodies[i] = Bundle.Bodies[i];
+			}
+		}
+		bPending = true;
+	}
+	FrameEvent->Trigger();
+}
+
+bool FKinectHubFrameSource::WaitForFrame(FKinectFrameBundle &OutBundle, uint32 TimeoutMilliseconds)
+{
+	if (!bStopped)
+	{
+		bool bReady = false;
+		{
+			FScopeLock Lock(&Crit);
+			bReady = bPending;
+		}
+		if (!bReady)
+		{
+			FrameEvent->Wait(TimeoutMilliseconds);
+		}
+	}
+	FScopeLock Lock(&Crit);
+	if (bStopped || !bPending)
+	{
+		return false;
+	}
+	OutBundle.Streams = Pending.Streams;
+	OutBundle.ColorTime = Pending.ColorTime;
+	OutBundle.DepthTime = Pending.DepthTime;
+	OutBundle.BodyIndexTime = Pending.BodyIndexTime;
+	OutBundle.BodyTime = Pending.BodyTime;
+	Exchange(OutBundle.Color, Pending.Color);
+	Exchange(OutBundle.Depth, Pending.Depth);
+	Exchange(OutBundle.BodyIndex, Pending.BodyIndex);
+	if (OutBundle.Has(EKinectFrameStream::Body))
+	{
+		for (int32 i = 0; i < BODY_COUNT; i++)
+		{
+			OutBundle.Bodies[i] = Pending.Bodies[i];
+		}
+	}
+	// Whatever OutBundle held before is released here rather than kept until the next bundle
+	ReleasePending();
+	return true;
+}
+
+void FKinectHubFrameSource::Stop()
+{
+	bStopped = true;
+	FrameEvent->Trigger();
+}
+
+FIntPoint FKinectHubFrameSource::GetColorSize() const
+{
+	return Hub.GetColorSize();
+}
+
+FIntPoint FKinectHubFrameSource::GetDepthSize() const
+{
+	return Hub.GetDepthSize();
+}
+
+IKinectDepthIntrinsics &FKinectHubFrameSource::GetDepthIntrinsics()
+{
+	return Hub.GetDepthIntrinsics();
+}
+
+bool FKinectHubFrameSource::PollCoordinateMappingChanged()
+{
+	const int32 Generation = Hub.GetCoordinateMappingGeneration();
+	if (Generation != MappingGeneration)
+	{
+		MappingGeneration = Generation;
+		return true;
+	}
+	return false;
+}
+
+HRESULT FKinectHubFrameSource::MapDepthFrameToColorSpace(const uint16 *Depth, int32 NumPixels, ColorSpacePoint *OutColorPoints)
+{
+	return Hub.MapDepthFrameToColorSpace(Depth, NumPixels, OutColorPoints);
+}
+
+ICoordinateMapper *FKinectHubFrameSource::GetCoordinateMapper() const
+{
+	return Hub.GetCoordinateMapper();
+}
+
+void FKinectHubFrameSource::SetBodyAttributes(int32 Attributes)
+{
+	BodyAttributes = Attributes;
+	if (bOpen)
+	{
+		Hub.SetBodyAttributes(this, BodyAttributes);
+	}
+}
@@ -0,0 +1,152 @@
+#pragma once
+
+#include "KinectSensorFrameSource.h"
+#include "KinectReplayFrameSource.h"
+
+/** Receives the bundles the sensor hub acquires. */
+class IKinectFrameSubscriber
+{
+public:
+	virtual ~IKinectFrameSubscriber() {}
+
+	/**
+	 * Called on the hub's acquisition thread for every bundle holding one of
+	 * the subscribed streams. Keep it short, every other subscriber waits;
+	 * copying the bundle is cheap, its images are reference counted views of
+	 * sensor memory. Those keep the sensor frames acquired, see
+	 * TKinectFramePlane, so release them as soon as the frame is processed.
+	 */
+	virtual void OnFrameBundle(const FKinectFrameBundle &Bundle) = 0;
+};
+
+/**
+ * The one place the process talks to the sensor. The hub opens the sensor
+ * for its first subscriber and closes it after the last one is gone; in
+ * between a single thread acquires every stream once and hands
+ * the same bundle to all subscribers, so any number of actors costs a single
+ * acquisition. Owned by the plugin module, see IKinectPlugin::GetSensorHub.
+ *
+ * Instead of the sensor the hub can replay a recording, set with SetReplay or
+ * on the command line as -KinectReplay=<file>, with -KinectReplayRate=<fps>
+ * for a fixed rate or -KinectReplayFast to go as fast as the consumers do.
+ */
+class FKinectSensorHub : public FRunnable
+{
+public:
+	FKinectSensorHub();
+	virtual ~FKinectSensorHub();
+
+	/**
+	 * Registers Subscriber for the streams in Streams, a mask of
+	 * EKinectFrameStream bits, opening the sensor if this is the first one.
+	 * A mask of None just keeps the sensor open. BodyAttributes are the
+	 * EKinectBodyAttribute bits the subscriber needs of every body.
+	 */
+	HRESULT AddSubscriber(IKinectFrameSubscriber *Subscriber, int32 Streams, int32 BodyAttributes = EKinectBodyAttribute::Default);
+
+	/** Changes the body attributes Subscriber needs; the sensor queries what any subscriber needs. */
+	void SetBodyAttributes(IKinectFrameSubscriber *Subscriber, int32 BodyAttributes);
+
+	/** Returns once Subscriber gets no more calls; closes the sensor with the last one. */
+	void RemoveSubscriber(IKinectFrameSubscriber *Subscriber);
+
+	/** Drops all subscribers and closes the sensor, for module shutdown. */
+	void Shutdown();
+
+	/**
+	 * Replays Filename instead of reading the sensor, from the next time the
+	 * hub opens; an empty name goes back to the sensor. Overrides the command line.
+	 */
+	void SetReplay(const FString &Filename, const FKinectReplaySettings &Settings);
+
+	/** The queries below describe the open sensor; only call them while subscribed. */
+	FIntPoint GetColorSize() const;
+	FIntPoint GetDepthSize() const;
+	IKinectDepthIntrinsics &GetDepthIntrinsics();
+	HRESULT MapDepthFrameToColorSpace(const uint16 *Depth, int32 NumPixels, ColorSpacePoint *OutColorPoints);
+	ICoordinateMapper *GetCoordinateMapper() const;
+
+	/** Incremented on every change of the depth camera calibration. */
+	int32 GetCoordinateMappingGeneration() const
+	{
+		return MappingGeneration.GetValue();
+	}
+
+	virtual uint32 Run() override;
+
+private:
+	struct FSubscription
+	{
+		IKinectFrameSubscriber *Subscriber;
+		int32 Streams;
+		int32 BodyAttributes;
+	};
+
+	void CloseSensor();
+	/** Hands the source the union of the subscribers' body attributes; call with OpenCrit held. */
+	void UpdateBodyAttributes();
+	/** Picks the source to open: the replay set, or given on the command line, or else the sensor. */
+	IKinectFrameSource *CreateSource();
+
+	/** Guards opening and closing the sensor. */
+	FCriticalSection OpenCrit;
+	/** Guards Subscriptions; held while delivering, so removal waits for delivery to finish. */
+	FCriticalSection SubscriberCrit;
+	TArray<FSubscription> Subscriptions;
+	FKinectSensorFrameSource SensorSource;
+	/** The open source, SensorSource or a replay owned by the hub. */
+	IKinectFrameSource *Source;
+	FString ReplayFilename;
+	FKinectReplaySettings ReplaySettings;
+	bool bOpen;
+	volatile bool bRunning;
+	FRunnableThread *Thread;
+	FThreadSafeCounter MappingGeneration;
+	/** Only used by the acquisition thread; its images are released after delivery. */
+	FKinectFrameBundle Bundle;
+};
+
+/**
+ * Frame source view of the sensor hub: subscribes on Open and hands the
+ * newest bundle to WaitForFrame, so a consumer written against a frame source
+ * shares the sensor without knowing it. Bundles the consumer was too slow
+ * for are skipped.
+ */
+class FKinectHubFrameSource : public IKinectFrameSource, public IKinectFrameSubscriber
+{
+public:
+	explicit FKinectHubFrameSource(FKinectSensorHub &InHub);
+	virtual ~FKinectHubFrameSource();
+
+	virtual HRESULT Open(int32 Streams) override;
+	virtual void Close() override;
+	virtual bool WaitForFrame(FKinectFrameBundle &OutBundle, uint32 TimeoutMilliseconds) override;
+	virtual void Stop() override;
+	virtual FIntPoint GetColorSize() const override;
+	virtual FIntPoint GetDepthSize() const override;
+	virtual IKinectDepthIntrinsics &GetDepthIntrinsics() override;
+	virtual bool PollCoordinateMappingChanged() override;
+	virtual HRESULT MapDepthFrameToColorSpace(const uint16 *Depth, int32 NumPixels, ColorSpacePoint *OutColorPoints) override;
+	virtual ICoordinateMapper *GetCoordinateMapper() const override;
+	virtual void SetBodyAttributes(int32 Attributes) override;
+
+	virtual void OnFrameBundle(const FKinectFrameBundle &Bundle) override;
+
+private:
+	/** Drops the images of Pending; call with Crit held. */
+	void ReleasePending();
+
+	FKinectSensorHub &Hub;
+	bool bOpen;
+	volatile bool bStopped;
+	/** EKinectFrameStream bits subscribed to. */
+	int32 Streams;
+	/** EKinectBodyAttribute bits subscribed to. */
+	int32 BodyAttributes;
+	int32 MappingGeneration;
+	FCriticalSection Crit;
+	/** Newest bundle not yet handed out, valid if bPending. */
+	FKinectFrameBundle Pending;
+	bool bPending;
+	FEvent *FrameEvent;
+};
@@ -0,0 +1,70 @@
+#pragma once
+
+#include "Core.h"
+
+/**
+ * SSE is used by the depth and color kernels whenever the engine itself is
+ * built with vector intrinsics. Every kernel keeps a scalar path for the rest.
+ */
+#if PLATFORM_ENABLE_VECTORINTRINSICS && !PLATFORM_ENABLE_VECTORINTRINSICS_NEON
+#define KINECT_SIMD_SSE 1
+#include <emmintrin.h>
+#else
+#define KINECT_SIMD_SSE 0
+#endif
+
+/**
+ * Lanes of floats for kernels that run on independent lanes, such as the
+ * joint filter's joints: FKinectLanes is four lanes per SSE register, or one
+ * lane at a time for builds without SSE.
+ */
+struct FKinectScalarLanes
+{
+	enum { Width = 1 };
+	typedef bool FMask;
+	float V;
+
+	FKinectScalarLanes(float InV) : V(InV) {}
+	static FKinectScalarLanes Load(const float *P) { return FKinectScalarLanes(*P); }
+	void Store(float *P) const { *P = V; }
+	friend FKinectScalarLanes operator+(FKinectScalarLanes A, FKinectScalarLanes B) { return A.V + B.V; }
+	friend FKinectScalarLanes operator-(FKinectScalarLanes A, FKinectScalarLanes B) { return A.V - B.V; }
+	friend FKinectScalarLanes operator*(FKinectScalarLanes A, FKinectScalarLanes B) { return A.V * B.V; }
+	friend FKinectScalarLanes operator/(FKinectScalarLanes A, FKinectScalarLanes B) { return A.V / B.V; }
+	friend FMask operator<(FKinectScalarLanes A, FKinectScalarLanes B) { return A.V < B.V; }
+	static FKinectScalarLanes Sqrt(FKinectScalarLanes A) { return FMath::Sqrt(A.V); }
+	static FKinectScalarLanes Min(FKinectScalarLanes A, FKinectScalarLanes B) { return FMath::Min(A.V, B.V); }
+	static FKinectScalarLanes Max(FKinectScalarLanes A, FKinectScalarLanes B) { return FMath::Max(A.V, B.V); }
+	static FKinectScalarLanes Select(FMask Mask, FKinectScalarLanes A, FKinectScalarLanes B) { return Mask ? A : B; }
+	static FMask And(FMask A, FMask B) { return A && B; }
+	/** Whether the mask is set in any lane. */
+	static bool Any(FMask Mask) { return Mask; }
+};
+
+#if KINECT_SIMD_SSE
+struct FKinectSseLanes
+{
+	enum { Width = 4 };
+	typedef __m128 FMask;
+	__m128 V;
+
+	FKinectSseLanes(__m128 InV) : V(InV) {}
+	FKinectSseLanes(float InV) : V(_mm_set1_ps(InV)) {}
+	static FKinectSseLanes Load(const float *P) { return _mm_loadu_ps(P); }
+	void Store(float *P) const { _mm_storeu_ps(P, V); }
+	friend FKinectSseLanes operator+(FKinectSseLanes A, FKinectSseLanes B) { return _mm_add_ps(A.V, B.V); }
+	friend FKinectSseLanes operator-(FKinectSseLanes A, FKinectSseLanes B) { return _mm_sub_ps(A.V, B.V); }
+	friend FKinectSseLanes operator*(FKinectSseLanes A, FKinectSseLanes B) { return _mm_mul_ps(A.V, B.V); }
+	friend FKinectSseLanes operator/(FKinectSseLanes A, FKinectSseLanes B) { return _mm_div_ps(A.V, B.V); }
+	friend FMask operator<(FKinectSseLanes A, FKinectSseLanes B) { return _mm_cmplt_ps(A.V, B.V); }
+	static FKinectSseLanes Sqrt(FKinectSseLanes A) { return _mm_sqrt_ps(A.V); }
+	static FKinectSseLanes Min(FKinectSseLanes A, FKinectSseLanes B) { return _mm_min_ps(A.V, B.V); }
+	static FKinectSseLanes Max(FKinectSseLanes A, FKinectSseLanes B) { return _mm_max_ps(A.V, B.V); }
+	static FKinectSseLanes Select(FMask Mask, FKinectSseLanes A, FKinectSseLanes B) { return _mm_or_ps(_mm_and_ps(Mask, A.V), _mm_andnot_ps(Mask, B.V)); }
+	static FMask And(FMask A, FMask B) { return _mm_and_ps(A, B); }
+	static bool Any(FMask Mask) { return _mm_movemask_ps(Mask) != 0; }
+};
+typedef FKinectSseLanes FKinectLanes;
+#else
+typedef FKinectScalarLanes FKinectLanes;
+#endif
@@ -0,0 +1,228 @@
+#include "KinectPluginPrivatePCH.h"
+#include "KinectSyntheticFrameSource.h"
+#include "AllowWindowsPlatformTypes.h"
+#include "ppl.h"
+
+/** Scene layout, in meters. */
+static const float WallDistance = 2.5f;
+static const float SphereDistance = 1.5f;
+static const float SphereRadius = 0.3f;
+static const float SphereSweep = 0.6f;
+/** Seconds per sweep from one side to the other and back. */
+static const float SpherePeriod = 4.0f;
+
+FKinectSyntheticFrameSource::FKinectSyntheticFrameSource(float InFramesPerSecond)
+	: FramesPerSecond(FMath::Max(InFramesPerSecond, 1.0f))
+	, OpenStreams(EKinectFrameStream::None)
+	, FrameIndex(0)
+	, NextFrameTime(0.0)
+	, bMappingChanged(false)
+	, StopEvent(FPlatformProcess::CreateSynchEvent(true))
+	, ColorSize(1920, 1080)
+	, DepthSize(512, 424)
+{
+}
+
+FKinectSyntheticFrameSource::~FKinectSyntheticFrameSource()
+{
+	Close();
+	delete StopEvent;
+}
+
+HRESULT FKinectSyntheticFrameSource::Open(int32 Streams)
+{
+	if (!Intrinsics.GetDepthRays(DepthSize.X, DepthSize.Y, Rays))
+	{
+		return E_FAIL;
+	}
+	StopEvent->Reset();
+	OpenStreams = Streams;
+	FrameIndex = 0;
+	NextFrameTime = FPlatformTime::Seconds();
+	// Lets the consumer build its unprojection table the same way it would for a sensor
+	bMappingChanged = true;
+	return S_OK;
+}
+
+void FKinectSyntheticFrameSource::Close()
+{
+	OpenStreams = EKinectFrameStream::None;
+}
+
+void FKinectSyntheticFrameSource::Stop()
+{
+	StopEvent->Trigger();
+}
+
+bool FKinectSyntheticFrameSource::WaitForFrame(FKinectFrameBundle &OutBundle, uint32 TimeoutMilliseconds)
+{
+	if (OpenStreams == EKinectFrameStream::None)
+	{
+		return false;
+	}
+	const double Now = FPlatformTime::Seconds();
+	const double WaitSeconds = FMath::Max(NextFrameTime - Now, 0.0);
+	if (WaitSeconds * 1000.0 > TimeoutMilliseconds)
+	{
+		StopEvent->Wait(TimeoutMilliseconds);
+		return false;
+	}
+	if (StopEvent->Wait(static_cast<uint32>(WaitSeconds * 1000.0)))
+	{
+		return false;
+	}
+	const double Period = 1.0 / FramesPerSecond;
+	// Resynchronize instead of bursting frames after a consumer stall
+	NextFrameTime = FMath::Max(NextFrameTime + Period, FPlatformTime::Seconds());
+	RenderFrame(OutBundle);
+	FrameIndex++;
+	return true;
+}
+
+void FKinectSyntheticFrameSource::RenderFrame(FKinectFrameBundle &OutBundle)
+{
+	const TIMESPAN Time = static_cast<TIMESPAN>(FrameIndex * KinectTicksPerSecond / FramesPerSecond);
+	const float Seconds = FrameIndex / FramesPerSecond;
+	const FVector Center(SphereSweep * FMath::Sin(2.0f * PI * Seconds / SpherePeriod), 0.0f, SphereDistance);
+	const int32 DepthPixels = DepthSize.X * DepthSize.Y;
+
+	// Depth and body index are ray cast together; the body index marks the sphere
+	uint16 *Depth = OutBundle.Depth.Allocate(DepthPixels);
+	uint8 *BodyIndex = OutBundle.BodyIndex.Allocate(DepthPixels);
+	const FVector2D *RayData = Rays.GetData();
+	Concurrency::parallel_for(0, DepthSize.Y, [&](int y)
+	{
+		for (int32 i = y * DepthSize.X; i < (y + 1) * DepthSize.X; i++)
+		{
+			const FVector Ray(RayData[i].X, RayData[i].Y, 1.0f);
+			// Ray/sphere intersection, t is the depth (Z) of the hit
+			const float A = Ray.SizeSquared();
+			const float B = FVector::DotProduct(Ray, Center);
+			const float C = Center.SizeSquared() - SphereRadius * SphereRadius;
+			const float Discriminant = B * B - A * C;
+			if (Discriminant >= 0.0f)
+			{
+				Depth[i] = static_cast<uint16>((B - FMath::Sqrt(Discriminant)) / A * 1000.0f);
+				BodyIndex[i] = 0;
+			}
+			else
+			{
+				Depth[i] = static_cast<uint16>(WallDistance * 1000.0f);
+				BodyIndex[i] = 0xff;
+			}
+		}
+	});
+	OutBundle.Streams = EKinectFrameStream::None;
+	if (OpenStreams & EKinectFrameStream::Depth)
+	{
+		OutBundle.Streams |= EKinectFrameStream::Depth;
+		OutBundle.DepthTime = Time;
+	}
+	if (OpenStreams & EKinectFrameStream::BodyIndex)
+	{
+		OutBundle.Streams |= EKinectFrameStream::BodyIndex;
+		OutBundle.BodyIndexTime = Time;
+	}
+
+	if (OpenStreams & EKinectFrameStream::Color)
+	{
+		// Gradient background, the sphere is painted where the body index has it; YUY2 like the camera
+		uint8 *Color = OutBundle.Color.Allocate(ColorSize.X * ColorSize.Y * 2);
+		Concurrency::parallel_for(0, ColorSize.Y, [&](int y)
+		{
+			const int32 DepthRow = (y * DepthSize.Y / ColorSize.Y) * DepthSize.X;
+			uint8 *Row = Color + y * ColorSize.X * 2;
+			for (int32 x = 0; x < ColorSize.X; x += 2)
+			{
+				const int32 DepthX = x * DepthSize.X / ColorSize.X;
+				const FColor Pixel = BodyIndex[DepthRow + DepthX] == 0 ?
+					FColor(220, 60, 40, 255) :
+					FColor(x * 255 / ColorSize.X, y * 255 / ColorSize.Y, 128, 255);
+				// BT.601 video range, the inverse of FKinectColorConversion
+				const uint8 Luma = static_cast<uint8>(((66 * Pixel.R + 129 * Pixel.G + 25 * Pixel.B + 128) >> 8) + 16);
+				Row[x * 2] = Luma;
+				Row[x * 2 + 1] = static_cast<uint8>(((-38 * Pixel.R - 74 * Pixel.G + 112 * Pixel.B + 128) >> 8) + 128);
+				Row[x * 2 + 2] = Luma;
+				Row[x * 2 + 3] = static_cast<uint8>(((112 * Pixel.R - 94 * Pixel.G - 18 * Pixel.B + 128) >> 8) + 128);
+			}
+		});
+		OutBundle.ColorTime = Time;
+		OutBundle.Streams |= EKinectFrameStream::Color;
+	}
+
+	if (OpenStreams & EKinectFrameStream::Body)
+	{
+		for (int32 count = 0; count < BODY_COUNT; count++)
+		{
+			OutBundle.Bodies[count].bTracked = false;
+		}
+		FKinectBodyData &Body = OutBundle.Bodies[0];
+		Body.bTracked = true;
+		for (int32 j = 0; j < JointType_Count; j++)
+		{
+			Body.Joints[j].JointType = static_cast<JointType>(j);
+			Body.Joints[j].Position.X = Center.X;
+			Body.Joints[j].Position.Y = Center.Y;
+			Body.Joints[j].Position.Z = Center.Z;
+			Body.Joints[j].TrackingState = TrackingState_Tracked;
+			Body.JointOrientations[j].JointType = static_cast<JointType>(j);
+			Body.JointOrientations[j].Orientation.x = 0.0f;
+			Body.JointOrientations[j].Orientation.y = 0.0f;
+			Body.JointOrientations[j].Orientation.z = 0.0f;
+			Body.JointOrientations[j].Orientation.w = 1.0f;
+		}
+		Body.LeftHandState = HandState_Open;
+		Body.RightHandState = HandState_Open;
+		Body.Attributes = EKinectBodyAttribute::HandStates | EKinectBodyAttribute::JointOrientations;
+		OutBundle.BodyTime = Time;
+		OutBundle.Streams |= EKinectFrameStream::Body;
+	}
+}
+
+FIntPoint FKinectSyntheticFrameSource::GetColorSize() const
+{
+	return ColorSize;
+}
+
+FIntPoint FKinectSyntheticFrameSource::GetDepthSize() const
+{
+	return DepthSize;
+}
+
+IKinectDepthIntrinsics &FKinectSyntheticFrameSource::GetDepthIntrinsics()
+{
+	return Intrinsics;
+}
+
+bool FKinectSyntheticFrameSource::PollCoordinateMappingChanged()
+{
+	const bool bChanged = bMappingChanged;
+	bMappingChanged = false;
+	return bChanged;
+}
+
+HRESULT FKinectSyntheticFrameSource::MapDepthFrameToColorSpace(const uint16 *Depth, int32 NumPixels, ColorSpacePoint *OutColorPoints)
+{
+	if (NumPixels != DepthSize.X * DepthSize.Y)
+	{
+		return E_INVALIDARG;
+	}
+	// The synthetic cameras share one viewpoint, so the mapping is a plain rescale
+	const float ScaleX = static_cast<float>(ColorSize.X) / DepthSize.X;
+	const float ScaleY = static_cast<float>(ColorSize.Y) / DepthSize.Y;
+	for (int32 y = 0; y < DepthSize.Y; y++)
+	{
+		for (int32 x = 0; x < DepthSize.X; x++)
+		{
+			ColorSpacePoint &Point = OutColorPoints[y * DepthSize.X + x];
+			Point.X = x * ScaleX;
+			Point.Y = y * ScaleY;
+		}
+	}
+	return S_OK;
+}
+
+ICoordinateMapper *FKinectSyntheticFrameSource::GetCoordinateMapper() const
+{
+	return nullptr;
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include "KinectFrameSource.h"
+
+/**
+ * Frame source that renders a simple scene instead of reading a sensor: a
+ * wall with a sphere sweeping across in front of it, tracked as body 0. It
+ * paces itself to the requested frame rate, so the acquisition thread and
+ * everything downstream of it can be timed without a Kinect attached.
+ */
+class FKinectSyntheticFrameSource : public IKinectFrameSource
+{
+public:
+	explicit FKinectSyntheticFrameSource(float InFramesPerSecond = 30.0f);
+	virtual ~FKinectSyntheticFrameSource();
+
+	virtual HRESULT Open(int32 Streams) override;
+	virtual void Close() override;
+	virtual bool WaitForFrame(FKinectFrameBundle &OutBundle, uint32 TimeoutMilliseconds) override;
+	virtual void Stop() override;
+	virtual FIntPoint GetColorSize() const override;
+	virtual FIntPoint GetDepthSize() const override;
+	virtual IKinectDepthIntrinsics &GetDepthIntrinsics() override;
+	virtual bool PollCoordinateMappingChanged() override;
+	virtual HRESULT MapDepthFrameToColorSpace(const uint16 *Depth, int32 NumPixels, ColorSpacePoint *OutColorPoints) override;
+	virtual ICoordinateMapper *GetCoordinateMapper() const override;
+
+private:
+	void RenderFrame(FKinectFrameBundle &OutBundle);
+
+	float FramesPerSecond;
+	int32 OpenStreams;
+	int64 FrameIndex;
+	double NextFrameTime;
+	bool bMappingChanged;
+	FEvent *StopEvent;
+	FKinectSyntheticDepthIntrinsics Intrinsics;
+	/** Depth pixel rays at one meter, the scene is ray cast through them. */
+	TArray<FVector2D> Rays;
+	FIntPoint ColorSize;
+	FIntPoint DepthSize;
+};
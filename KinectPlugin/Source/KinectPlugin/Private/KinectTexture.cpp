@@ -2,6 +2,12 @@
 #include "KinectTexture.h"
 #include "Engine/EngineTypes.h"
 #include "DeviceProfiles/DeviceProfile.h"
+#include "AllowWindowsPlatformTypes.h"
+#include "ppl.h"
+#include "HideWindowsPlatformTypes.h"
+
+DECLARE_CYCLE_STAT(TEXT("Texture Upload"), STAT_KinectTextureUpload, STATGROUP_Kinect);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Texture Uploads Skipped"), STAT_KinectTextureUploadsSkipped, STATGROUP_Kinect);
 
 
 /**
@@ -48,8 +54,8 @@ private:
 	/** The color that the resource was cleared with. */
 	FLinearColor LastClearColor;
 
-	/** The playback time of the last drawn video frame. */
-	FTimespan LastFrameTime;
+	/** Sequence number of the last uploaded frame. */
+	uint64 LastFrameSequence;
 
 	/** The UTextureRenderTarget2D which this resource represents. */
 	const UKinectTexture *Owner;
@@ -64,7 +70,7 @@ private:
 
 FKinectTextureResource::FKinectTextureResource(const class UKinectTexture* InOwner)
 	: Cleared(false)
-	, LastFrameTime(FTimespan::MinValue())
+	, LastFrameSequence(0)
 	, Owner(InOwner)
 {
 }
@@ -144,17 +150,47 @@ FIntPoint FKinectTextureResource::GetSizeXY() const
 
 void FKinectTextureResource::UpdateDeferredResource(FRHICommandListImmediate& RHICmdList, bool bClearRenderTarget/*=true*/)
 {
-	TSharedPtr<TArray<uint8>, ESPMode::ThreadSafe> CurrentFrame = Owner->GetCurrentFrame();
+	FKinectFrameBufferPtr CurrentFrame = Owner->GetCurrentFrame();
 	if (CurrentFrame.IsValid())
 	{
+		// The sensor delivers 30 frames per second, most render frames have nothing new
+		if (CurrentFrame->GetSequence() == LastFrameSequence)
+		{
+			INC_DWORD_STAT(STAT_KinectTextureUploadsSkipped);
+			return;
+		}
+		SCOPE_CYCLE_COUNTER(STAT_KinectTextureUpload);
 		uint32 Stride = 0;
 		FRHITexture2D* Texture2D = TextureRHI->GetTexture2D();
 		uint8* TextureBuffer = (uint8*)RHILockTexture2D(Texture2D, 0, RLM_WriteOnly, Stride, false);
 
-		FMemory::Memcpy(TextureBuffer, CurrentFrame->GetData(), CurrentFrame->Num());
+		// Rows are Stride apart in the locked texture, which may be padded past the frame width
+		const FIntPoint Dimensions = CurrentFrame->GetDimensions();
+		const int32 Width = FMath::Min<int32>(Dimensions.X, Texture2D->GetSizeX());
+		const int32 Height = FMath::Min<int32>(Dimensions.Y, Texture2D->GetSizeY());
+		const uint32 SourceStride = Dimensions.X * 4;
+		const uint32 RowBytes = Width * 4;
+		const uint8 *Source = CurrentFrame->GetData();
+		if (Stride == SourceStride && RowBytes == SourceStride)
+		{
+			FMemory::Memcpy(TextureBuffer, Source, Height * RowBytes);
+		}
+		else
+		{
+			const int32 RowsPerBand = 64;
+			const int32 NumBands = Height * RowBytes >= 1024 * 1024 ? (Height + RowsPerBand - 1) / RowsPerBand : 1;
+			Concurrency::parallel_for(0, NumBands, [&](int Band)
+			{
+				const int32 EndRow = NumBands > 1 ? FMath::Min(Height, (Band + 1) * RowsPerBand) : Height;
+				for (int32 y = NumBands > 1 ? Band * RowsPerBand : 0; y < EndRow; y++)
+				{
+					FMemory::Memcpy(TextureBuffer + y * Stride, Source + y * SourceStride, RowBytes);
+				}
+			});
+		}
 		RHIUnlockTexture2D(Texture2D, 0, false);
 
-		//      LastFrameTime = CurrentFrameTime;
+		LastFrameSequence = CurrentFrame->GetSequence();
 		Cleared = false;
 	}
 	else if (!Cleared || (LastClearColor != Owner->ClearColor))
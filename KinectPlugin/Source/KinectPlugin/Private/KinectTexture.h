@@ -1,12 +1,13 @@
 #pragma once
 #include "Engine.h"
 #include "Engine/Texture.h"
+#include "KinectFrameBuffer.h"
 #include "KinectTexture.generated.h"
 
 struct FSampleInfo
 {
 	FIntPoint Dimensions;
-	TSharedPtr<TArray<uint8>, ESPMode::ThreadSafe> CurrentFrame;
+	FKinectFrameBufferPtr CurrentFrame;
 };
 
 UCLASS()
@@ -50,12 +51,12 @@ public:
 		return SampleInfo->Dimensions;
 	}
 
-	TSharedPtr<TArray<uint8>, ESPMode::ThreadSafe> GetCurrentFrame() const
+	FKinectFrameBufferPtr GetCurrentFrame() const
 	{
 		return SampleInfo->CurrentFrame;
 	}
 
-	void SetCurrentFrame(const TSharedPtr<TArray<uint8>, ESPMode::ThreadSafe> &InCurrentFrame)
+	void SetCurrentFrame(const FKinectFrameBufferPtr &InCurrentFrame)
 	{
 		SampleInfo->CurrentFrame = InCurrentFrame;
 	}
@@ -0,0 +1,86 @@
+#pragma once
+
+#include "Engine.h"
+
+/**
+ * Lock free handoff of the newest item from one producer thread to one
+ * consumer thread.
+ *
+ * The producer fills the back slot and publishes it, the consumer acquires
+ * whatever was published last into the front slot. Neither side ever waits on
+ * the other: a publish that replaces an item the consumer has not acquired
+ * drops that item, and an acquire with nothing new keeps the current front.
+ */
+template <typename T>
+class TKinectTripleBuffer
+{
+public:
+	TKinectTripleBuffer()
+		: Back(0)
+		, Ready(1)
+		, Front(2)
+	{
+	}
+
+	/** Slot the producer fills before calling Publish. */
+	T &GetBack()
+	{
+		return Slots[Back];
+	}
+
+	/**
+	 * Makes the back slot the newest item and hands the producer a new back slot.
+	 *
+	 * @return true if the replaced item was never acquired. The new back slot
+	 *         then still holds that dropped item, so the producer can carry
+	 *         over anything the consumer must not miss.
+	 */
+	bool Publish()
+	{
+		const int32 Previous = FPlatformAtomics::InterlockedExchange(&Ready, Back | FreshFlag);
+		Back = Previous & IndexMask;
+		return (Previous & FreshFlag) != 0;
+	}
+
+	/**
+	 * Moves the newest published item to the front slot.
+	 *
+	 * @return false if nothing was published since the last acquire.
+	 */
+	bool Acquire()
+	{
+		if ((Ready & FreshFlag) == 0)
+		{
+			return false;
+		}
+		const int32 Previous = FPlatformAtomics::InterlockedExchange(&Ready, Front);
+		Front = Previous & IndexMask;
+		return true;
+	}
+
+	/** Slot the consumer reads after a successful Acquire. */
+	T &GetFront()
+	{
+		return Slots[Front];
+	}
+
+	/** Direct slot access, only while neither thread is using the buffer. */
+	T &GetSlot(int32 Index)
+	{
+		return Slots[Index];
+	}
+
+	static const int32 NumSlots = 3;
+
+private:
+	static const int32 IndexMask = 3;
+	static const int32 FreshFlag = 4;
+
+	T Slots[NumSlots];
+	/** Owned by the producer. */
+	int32 Back;
+	/** Shared: index of the newest item, plus FreshFlag until it is acquired. */
+	volatile int32 Ready;
+	/** Owned by the consumer. */
+	int32 Front;
+};
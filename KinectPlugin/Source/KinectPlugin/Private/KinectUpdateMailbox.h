@@ -0,0 +1,65 @@
+#pragma once
+
+#include "Engine.h"
+
+/** Kinds of update the mesh generator thread posts to the game thread. */
+namespace EKinectUpdate
+{
+	enum Type
+	{
+		None = 0,
+		Mesh = 1 << 0,
+		Camera = 1 << 1,
+		Bodies = 1 << 2,
+	};
+}
+
+/**
+ * Latest wins mailbox between the mesh generator thread and the game thread.
+ *
+ * Each kind of update is a single pending bit, so however many times the
+ * producer posts a kind before the game thread gets to it, the game thread
+ * applies it once, from the newest data.
+ */
+class FKinectUpdateMailbox
+{
+public:
+	FKinectUpdateMailbox()
+		: Pending(EKinectUpdate::None)
+	{
+	}
+
+	/**
+	 * Marks Kinds pending.
+	 *
+	 * @return the kinds that were still pending, i.e. coalesced into this post.
+	 */
+	int32 Post(int32 Kinds)
+	{
+		int32 Previous;
+		do
+		{
+			Previous = Pending;
+		} while (FPlatformAtomics::InterlockedCompareExchange(&Pending, Previous | Kinds, Previous) != Previous);
+		return Previous & Kinds;
+	}
+
+	/** Takes every pending kind, leaving the mailbox empty. */
+	int32 Take()
+	{
+		return FPlatformAtomics::InterlockedExchange(&Pending, EKinectUpdate::None);
+	}
+
+	static int32 CountKinds(int32 Kinds)
+	{
+		int32 Count = 0;
+		for (; Kinds != 0; Kinds &= Kinds - 1)
+		{
+			Count++;
+		}
+		return Count;
+	}
+
+private:
+	volatile int32 Pending;
+};
@@ -0,0 +1,265 @@
+#include "KinectPluginPrivatePCH.h"
+#include "KinectBilateralFilter.h"
+#include "KinectTestHelpers.h"
+#include "AllowWindowsPlatformTypes.h"
+#include "ppl.h"
+#include "HideWindowsPlatformTypes.h"
+
+static const int32 DepthWidth = 512;
+static const int32 DepthHeight = 424;
+
+/** Holes in the reference's images of doubles. */
+static const double ReferenceHole = -1.0;
+
+/** Range weight as the filter has it: (1 - x / 16)^16 for x = d^2 / (2 sigma^2), and zero where the base turns negative. */
+static double ReferenceRangeWeight(double Difference, float RangeSigma)
+{
+	const double Base = 1.0 - Difference * Difference / (32.0 * RangeSigma * RangeSigma);
+	return Base > 0.0 ? pow(Base, 16) : 0.0;
+}
+
+/**
+ * A direct bilateral filter in doubles, with an exp for every tap of every
+ * pixel. The taps are the square of Radius, or only its row or its column
+ * for the passes of the separable filter. Holes neither take part nor get
+ * filled.
+ */
+static void ReferencePass(const double *In, int32 Width, int32 Height, const FKinectBilateralFilterSettings &Settings, bool bRows, bool bColumns, double *Out)
+{
+	const int32 Radius = Settings.Radius;
+	const double SpatialScale = -0.5 / (Settings.SpatialSigma * Settings.SpatialSigma);
+	Concurrency::parallel_for(0, Height, [&](int y)
+	{
+		for (int32 x = 0; x < Width; x++)
+		{
+			const double Center = In[y * Width + x];
+			if (Center == ReferenceHole)
+			{
+				Out[y * Width + x] = ReferenceHole;
+				continue;
+			}
+			double Sum = 0.0;
+			double Weight = 0.0;
+			for (int32 dy = bColumns ? -Radius : 0; dy <= (bColumns ? Radius : 0); dy++)
+			{
+				for (int32 dx = bRows ? -Radius : 0; dx <= (bRows ? Radius : 0); dx++)
+				{
+					if (x + dx < 0 || x + dx >= Width || y + dy < 0 || y + dy >= Height)
+					{
+						continue;
+					}
+					const double Neighbor = In[(y + dy) * Width + x + dx];
+					if (Neighbor == ReferenceHole)
+					{
+						continue;
+					}
+					const double TapWeight = exp((dx * dx + dy * dy) * SpatialScale) * ReferenceRangeWeight(Neighbor - Center, Settings.RangeSigma);
+					Sum += TapWeight * Neighbor;
+					Weight += TapWeight;
+				}
+			}
+			Out[y * Width + x] = Sum / Weight;
+		}
+	});
+}
+
+/** The reference filter of Depth into Out, separable or not as Settings asks. */
+static void ReferenceFilter(const uint16 *Depth, int32 Width, int32 Height, const FKinectBilateralFilterSettings &Settings, uint16 *Out)
+{
+	const int32 NumPixels = Width * Height;
+	TArray<double> In;
+	TArray<double> Result;
+	In.SetNumUninitialized(NumPixels);
+	Result.SetNumUninitialized(NumPixels);
+	for (int32 i = 0; i < NumPixels; i++)
+	{
+		In[i] = Depth[i] ? Depth[i] : ReferenceHole;
+	}
+	if (Settings.bSeparable)
+	{
+		TArray<double> Rows;
+		Rows.SetNumUninitialized(NumPixels);
+		ReferencePass(In.GetData(), Width, Height, Settings, true, false, Rows.GetData());
+		ReferencePass(Rows.GetData(), Width, Height, Settings, false, true, Result.GetData());
+	}
+	else
+	{
+		ReferencePass(In.GetData(), Width, Height, Settings, true, true, Result.GetData());
+	}
+	for (int32 i = 0; i < NumPixels; i++)
+	{
+		Out[i] = Result[i] > 0.0 ? static_cast<uint16>(Result[i] + 0.5) : 0;
+	}
+}
+
+/** Largest and mean difference of valid pixels, and pixels whose validity changed. */
+struct FDepthDifference
+{
+	int32 Max;
+	double Mean;
+	int32 Holes;
+
+	FDepthDifference(const TArray<uint16> &A, const TArray<uint16> &B)
+		: Max(0)
+		, Mean(0.0)
+		, Holes(0)
+	{
+		int32 NumValid = 0;
+		for (int32 i = 0; i < A.Num(); i++)
+		{
+			if ((A[i] == 0) != (B[i] == 0))
+			{
+				Holes++;
+			}
+			else if (A[i] != 0)
+			{
+				const int32 Difference = FMath::Abs(A[i] - B[i]);
+				Max = FMath::Max(Max, Difference);
+				Mean += Difference;
+				NumValid++;
+			}
+		}
+		Mean /= FMath::Max(NumValid, 1);
+	}
+};
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FKinectBilateralFilterTest, "Kinect.BilateralFilter.MatchesDirect", KINECT_TEST_FLAGS)
+
+bool FKinectBilateralFilterTest::RunTest(const FString &Parameters)
+{
+	// Float sums rounded to the nearest millimeter may land on the other side of a half
+	const int32 Tolerance = 1;
+	const double MaxMeanApproximation = 1.0;
+	// The sensor's size, and one whose rows end in part of a lane
+	const int32 Sizes[][2] = { { DepthWidth, DepthHeight }, { 301, 203 } };
+	FKinectBilateralFilterSettings Kernels[4];
+	Kernels[1].Radius = 4;
+	Kernels[1].SpatialSigma = 3.0f;
+	Kernels[1].RangeSigma = 10.0f;
+	// A range table of three millimeters, narrower than the frame's noise
+	Kernels[2].Radius = 1;
+	Kernels[2].RangeSigma = 0.5f;
+	Kernels[3].Radius = 7;
+	Kernels[3].SpatialSigma = 4.0f;
+	Kernels[3].RangeSigma = 40.0f;
+	FKinectBilateralFilter Filter;
+	TArray<uint16> Depth;
+	TArray<uint16> Filtered;
+	TArray<uint16> Reference;
+	TArray<uint16> Full;
+	for (const auto &Size : Sizes)
+	{
+		const int32 Width = Size[0];
+		const int32 Height = Size[1];
+		KinectTest::MakeDepthFrame(Width, Height, 5, Width, Depth);
+		Filtered.SetNumUninitialized(Width * Height);
+		Reference.SetNumUninitialized(Width * Height);
+		Full.SetNumUninitialized(Width * Height);
+		for (FKinectBilateralFilterSettings Settings : Kernels)
+		{
+			for (const bool bSeparable : { false, true })
+			{
+				Settings.bSeparable = bSeparable;
+				Filter.Filter(Depth.GetData(), Width, Height, Settings, Filtered.GetData());
+				ReferenceFilter(Depth.GetData(), Width, Height, Settings, Reference.GetData());
+				const FDepthDifference Difference(Filtered, Reference);
+				const FString Case = FString::Printf(TEXT("%s, %dx%d, radius %d, sigmas %.1f and %.1f"), bSeparable ? TEXT("separable") : TEXT("square"),
+					Width, Height, Settings.Radius, Settings.SpatialSigma, Settings.RangeSigma);
+				TestEqual(FString::Printf(TEXT("Holes filled or made, %s"), *Case), Difference.Holes, 0);
+				TestTrue(FString::Printf(TEXT("Largest difference from the direct filter, %d mm, is at most %d mm, %s"), Difference.Max, Tolerance, *Case),
+					Difference.Max <= Tolerance);
+				if (bSeparable)
+				{
+					// The approximation strays most at depth edges, but on average stays within the sensor's noise of the square kernel
+					Settings.bSeparable = false;
+					ReferenceFilter(Depth.GetData(), Width, Height, Settings, Full.GetData());
+					const FDepthDifference Approximation(Filtered, Full);
+					TestTrue(FString::Printf(TEXT("Mean difference from the square kernel, %.3f mm, is under %.1f mm, %s"), Approximation.Mean, MaxMeanApproximation, *Case),
+						Approximation.Mean < MaxMeanApproximation);
+					AddLogItem(FString::Printf(TEXT("%s: %d mm largest and %.3f mm mean difference from the square kernel"), *Case, Approximation.Max, Approximation.Mean));
+				}
+			}
+		}
+	}
+	return true;
+}
+
+/** The actor's BilateralFilter before FKinectBilateralFilter: two exp and two sqrt per tap, sigmas of 1, in place. */
+static void OldBilateralFilter(uint16 *Depth, int32 Width, int32 Height, int32 KernelSize)
+{
+	const int32 HalfKernelSize = FMath::RoundToInt(KernelSize / 2.0f);
+	Concurrency::parallel_for(0, Height, [&](int y)
+	{
+		for (int32 x = 0; x < Width; x++)
+		{
+			const float Center = Depth[y * Width + x];
+			float Sum = 0.0f;
+			float SumWeight = 0.0f;
+			for (int32 j = y - HalfKernelSize; j <= y + HalfKernelSize; j++)
+			{
+				for (int32 i = x - HalfKernelSize; i <= x + HalfKernelSize; i++)
+				{
+					const float Neighbor = Depth[FMath::Clamp(j, 0, Height - 1) * Width + FMath::Clamp(i, 0, Width - 1)];
+					const float ImageDistance = FMath::Sqrt(static_cast<float>((i - x) * (i - x) + (j - y) * (j - y)));
+					// Depth stood in for three identical color channels
+					const float ColorDistance = FMath::Sqrt(3.0f * (Neighbor - Center) * (Neighbor - Center));
+					const float Weight = 1.0f / (FMath::Exp(ImageDistance * ImageDistance * 0.5f) * FMath::Exp(ColorDistance * ColorDistance * 0.5f));
+					SumWeight += Weight;
+					Sum += Weight * Neighbor;
+				}
+			}
+			Depth[y * Width + x] = static_cast<uint16>(FMath::FloorToInt(Sum / SumWeight));
+		}
+	});
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FKinectBilateralFilterBenchmark, "Kinect.Benchmark.BilateralFilter", KINECT_TEST_FLAGS)
+
+bool FKinectBilateralFilterBenchmark::RunTest(const FString &Parameters)
+{
+	// What a frame may take on one core, alongside the rest of the depth processing
+	const double BudgetMs = 2.0;
+	TArray<uint16> Depth;
+	TArray<uint16> Scratch;
+	TArray<uint16> Out;
+	KinectTest::MakeDepthFrame(DepthWidth, DepthHeight, 5, 1, Depth);
+	Out.SetNumUninitialized(DepthWidth * DepthHeight);
+	FKinectBilateralFilter Filter;
+	// Every parallel_for of this thread runs on one core until the scheduler is detached
+	Concurrency::CurrentScheduler::Create(Concurrency::SchedulerPolicy(2, Concurrency::MinConcurrency, 1, Concurrency::MaxConcurrency, 1));
+	// The actor's default kernel size, as it reads BilateralFilterKernelSize
+	const int32 DefaultKernelSize = 4;
+	const double OldMs = KinectTest::TimeMilliseconds(1, [&]()
+	{
+		Scratch = Depth;
+		OldBilateralFilter(Scratch.GetData(), DepthWidth, DepthHeight, DefaultKernelSize);
+	});
+	AddLogItem(FString::Printf(TEXT("%dx%d on one core, kernel size %d: direct in place %.2f ms"), DepthWidth, DepthHeight, DefaultKernelSize, OldMs));
+	const int32 KernelSizes[] = { 3, 5, 7, 9 };
+	for (const int32 KernelSize : KernelSizes)
+	{
+		FKinectBilateralFilterSettings Settings;
+		Settings.Radius = KernelSize / 2;
+		const double SquareMs = KinectTest::TimeMilliseconds(20, [&]()
+		{
+			Filter.Filter(Depth.GetData(), DepthWidth, DepthHeight, Settings, Out.GetData());
+		});
+		Settings.bSeparable = true;
+		const double SeparableMs = KinectTest::TimeMilliseconds(20, [&]()
+		{
+			Filter.Filter(Depth.GetData(), DepthWidth, DepthHeight, Settings, Out.GetData());
+		});
+		// What the actor runs with bApproximateBilateralFilter, which it is by default
+		const bool bActorSeparable = Settings.Radius > 1;
+		const double ActorMs = bActorSeparable ? SeparableMs : SquareMs;
+		AddLogItem(FString::Printf(TEXT("%dx%d on one core, kernel size %d: square %.2f ms, separable %.2f ms, budget %.1f ms"),
+			DepthWidth, DepthHeight, KernelSize, SquareMs, SeparableMs, BudgetMs));
+		if (ActorMs > BudgetMs)
+		{
+			AddWarning(FString::Printf(TEXT("The %s bilateral filter of kernel size %d takes %.2f ms on one core, over the budget of %.1f ms"),
+				bActorSeparable ? TEXT("separable") : TEXT("square"), KernelSize, ActorMs, BudgetMs));
+		}
+	}
+	Concurrency::CurrentScheduler::Detach();
+	return true;
+}
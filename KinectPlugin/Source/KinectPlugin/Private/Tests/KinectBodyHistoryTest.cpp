@@ -0,0 +1,103 @@
+#include "KinectPluginPrivatePCH.h"
+#include "KinectBodyHistory.h"
+#include "KinectTestHelpers.h"
+
+/** The sensor's body frame period, in 100 ns units. */
+static const TIMESPAN FrameTicks = 333333;
+/** Host time of sensor time 0; every frame arrives at least this much later. */
+static const double HostBase = 100.0;
+/** How far the hand moves per frame, in centimeters. */
+static const float Speed = 3.0f;
+/** Tracked in every frame but the last pushed. */
+static const int32 LostBody = 1;
+
+/** Frame Index of a body moving along X at Speed, started at sensor time Start. Frames with odd indices waited a few ms longer to arrive. */
+static FKinectBodyFramePtr PushFrame(FKinectBodyHistory &History, TIMESPAN Start, int32 Index, bool bLostBodyTracked)
+{
+	FKinectBodyFrameRef Frame = MakeShareable(new FKinectBodyFrame());
+	Frame->Time = Start + Index * FrameTicks;
+	Frame->bTracked[0] = true;
+	Frame->bTracked[LostBody] = bLostBodyTracked;
+	for (int32 Body = 0; Body <= LostBody; Body++)
+	{
+		for (int32 j = 0; j < JointType_Count; j++)
+		{
+			Frame->Positions[Body][j] = FVector(Index * Speed, Body * 50.0f, j * 10.0f);
+			Frame->TrackingStates[Body][j] = TrackingState_Tracked;
+		}
+	}
+	History.Push(Frame, HostBase + Frame->Time / KinectTicksPerSecond + (Index % 2 ? 0.004 : 0.0));
+	return Frame;
+}
+
+/** Host time of a point Frames frame periods after sensor time Start. */
+static double HostSeconds(TIMESPAN Start, double Frames)
+{
+	return HostBase + (Start + Frames * FrameTicks) / KinectTicksPerSecond;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FKinectBodyHistorySampleTest, "Kinect.BodyHistory.Sample", KINECT_TEST_FLAGS)
+
+bool FKinectBodyHistorySampleTest::RunTest(const FString &Parameters)
+{
+	const float Tolerance = 0.01f;
+	const float MaxExtrapolationSeconds = 0.05f;
+	const int32 NumFrames = 6;
+	FKinectBodyHistory History;
+	FKinectBodyFrame Out;
+	TestFalse(TEXT("An empty history samples"), History.Sample(HostBase, MaxExtrapolationSeconds, Out));
+
+	const TIMESPAN Start = 1000 * FrameTicks;
+	for (int32 i = 0; i < NumFrames; i++)
+	{
+		PushFrame(History, Start, i, i < NumFrames - 1);
+	}
+	const float Newest = (NumFrames - 1) * Speed;
+
+	// Between two frames, the one that arrived late must not pull the clock offset along
+	TestTrue(TEXT("Samples between frames"), History.Sample(HostSeconds(Start, 2.25), MaxExtrapolationSeconds, Out));
+	TestEqual(TEXT("Interpolated position"), Out.Positions[0][0].X, 2.25f * Speed, Tolerance);
+	TestEqual(TEXT("Interpolated joint keeps its offset"), Out.Positions[0][JointType_Count - 1].Z, (JointType_Count - 1) * 10.0f, Tolerance);
+	TestTrue(TEXT("Interpolated time"), FMath::Abs(Out.Time - (Start + 2 * FrameTicks + FrameTicks / 4)) <= 1);
+	TestTrue(TEXT("Body tracked in both frames is tracked"), Out.bTracked[0] && Out.bTracked[LostBody]);
+
+	// Nearer the older of two frames a body is lost in, it is still tracked, and still where the older frame has it
+	TestTrue(TEXT("Samples before the body is lost"), History.Sample(HostSeconds(Start, NumFrames - 1.75), MaxExtrapolationSeconds, Out));
+	TestTrue(TEXT("Body lost in the newer frame is tracked nearer the older one"), Out.bTracked[LostBody]);
+	TestEqual(TEXT("Body tracked in the older frame only is not interpolated"), Out.Positions[LostBody][0].X, Newest - Speed, Tolerance);
+	TestTrue(TEXT("Samples after the body is lost"), History.Sample(HostSeconds(Start, NumFrames - 1.25), MaxExtrapolationSeconds, Out));
+	TestFalse(TEXT("Body lost in the newer frame is tracked nearer the newer one"), Out.bTracked[LostBody]);
+
+	// Past the newest frame the last frame's motion carries on, the body lost there stays lost
+	TestTrue(TEXT("Samples past the newest frame"), History.Sample(HostSeconds(Start, NumFrames - 0.5), MaxExtrapolationSeconds, Out));
+	TestEqual(TEXT("Extrapolated position"), Out.Positions[0][0].X, Newest + 0.5f * Speed, Tolerance);
+	TestTrue(TEXT("Body tracked in the newest frame is tracked"), Out.bTracked[0]);
+	TestFalse(TEXT("Body lost in the newest frame is tracked past it"), Out.bTracked[LostBody]);
+
+	// Far past the newest frame extrapolation stops MaxExtrapolationSeconds out
+	TestTrue(TEXT("Samples far past the newest frame"), History.Sample(HostSeconds(Start, NumFrames + 10.0), MaxExtrapolationSeconds, Out));
+	const float ClampedFrames = MaxExtrapolationSeconds * KinectTicksPerSecond / FrameTicks;
+	TestEqual(TEXT("Extrapolation is clamped"), Out.Positions[0][0].X, Newest + ClampedFrames * Speed, Tolerance);
+	TestTrue(TEXT("Clamped time"), FMath::Abs(Out.Time - (Start + (NumFrames - 1) * FrameTicks + static_cast<TIMESPAN>(MaxExtrapolationSeconds * KinectTicksPerSecond))) <= 1);
+	TestTrue(TEXT("Samples with extrapolation off"), History.Sample(HostSeconds(Start, NumFrames + 10.0), 0.0f, Out));
+	TestEqual(TEXT("Without extrapolation the newest frame is held"), Out.Positions[0][0].X, Newest, Tolerance);
+
+	// Before the oldest frame the oldest is held
+	TestTrue(TEXT("Samples before the oldest frame"), History.Sample(HostSeconds(Start, -3.0), MaxExtrapolationSeconds, Out));
+	TestEqual(TEXT("Oldest frame is held"), Out.Positions[0][0].X, 0.0f, Tolerance);
+
+	// A replay that loops starts its times over; what came before must not be blended with it
+	const TIMESPAN LoopStart = 10 * FrameTicks;
+	const FKinectBodyFramePtr Looped = PushFrame(History, LoopStart, 0, true);
+	TestTrue(TEXT("Newest frame after the loop"), History.GetNewest() == Looped);
+	TestTrue(TEXT("Samples after the loop"), History.Sample(HostSeconds(LoopStart, 0.5), MaxExtrapolationSeconds, Out));
+	TestEqual(TEXT("Only the looped frame is sampled"), Out.Positions[0][0].X, 0.0f, Tolerance);
+	TestTrue(TEXT("Looped frame's bodies"), Out.bTracked[0] && Out.bTracked[LostBody]);
+	PushFrame(History, LoopStart, 1, true);
+	TestTrue(TEXT("Samples between looped frames"), History.Sample(HostSeconds(LoopStart, 0.5), MaxExtrapolationSeconds, Out));
+	TestEqual(TEXT("Interpolated after the loop"), Out.Positions[0][0].X, 0.5f * Speed, Tolerance);
+
+	History.Reset();
+	TestFalse(TEXT("A reset history samples"), History.Sample(HostBase, MaxExtrapolationSeconds, Out));
+	return true;
+}
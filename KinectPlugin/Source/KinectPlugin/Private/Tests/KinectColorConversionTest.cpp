@@ -0,0 +1,124 @@
+#include "KinectPluginPrivatePCH.h"
+#include "KinectColorConversion.h"
+#include "KinectTestHelpers.h"
+#include "AllowWindowsPlatformTypes.h"
+#include "ppl.h"
+#include "HideWindowsPlatformTypes.h"
+
+static uint8 AverageReference(uint8 A, uint8 B)
+{
+	return static_cast<uint8>((A + B + 1) >> 1);
+}
+
+/** Random YUY2 bytes over the whole byte range, so the clamps are hit as often as the plain formula. */
+static void MakeYuy2Frame(int32 Width, int32 Height, int32 Seed, TArray<uint8> &Out)
+{
+	FRandomStream Random(Seed);
+	Out.SetNumUninitialized(Width * Height * 2);
+	for (int32 i = 0; i < Out.Num(); i++)
+	{
+		Out[i] = static_cast<uint8>(Random.RandHelper(256));
+	}
+}
+
+/** Converts every pixel on its own through Sample, never the SSE kernels. */
+static void ReferenceConvert(const uint8 *Yuy2, int32 Width, int32 Height, TArray<FColor> &Out)
+{
+	Out.SetNumUninitialized(Width * Height);
+	Concurrency::parallel_for(0, Height, [&](int y)
+	{
+		for (int32 x = 0; x < Width; x++)
+		{
+			Out[y * Width + x] = FKinectColorConversion::Sample(Yuy2, Width, x, y);
+		}
+	});
+}
+
+/** Averages each 2x2 block in YUV the way the scalar path does, then converts it through ToColor. */
+static void ReferenceConvertHalf(const uint8 *Yuy2, int32 Width, int32 Height, TArray<FColor> &Out)
+{
+	const int32 HalfWidth = Width / 2;
+	const int32 HalfHeight = Height / 2;
+	Out.SetNumUninitialized(HalfWidth * HalfHeight);
+	Concurrency::parallel_for(0, HalfHeight, [&](int y)
+	{
+		for (int32 x = 0; x < HalfWidth; x++)
+		{
+			const uint8 *Top = Yuy2 + (2 * y * Width + 2 * x) * 2;
+			const uint8 *Bottom = Top + Width * 2;
+			const uint8 Y = AverageReference(AverageReference(Top[0], Bottom[0]), AverageReference(Top[2], Bottom[2]));
+			Out[y * HalfWidth + x] = FKinectColorConversion::ToColor(Y, AverageReference(Top[1], Bottom[1]), AverageReference(Top[3], Bottom[3]));
+		}
+	});
+}
+
+static int32 CountMismatches(const TArray<uint8> &Bgra, const TArray<FColor> &Reference)
+{
+	const FColor *Colors = reinterpret_cast<const FColor*>(Bgra.GetData());
+	int32 Mismatches = 0;
+	for (int32 i = 0; i < Reference.Num(); i++)
+	{
+		Mismatches += Colors[i] == Reference[i] ? 0 : 1;
+	}
+	return Mismatches;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FKinectColorConversionTest, "Kinect.ColorConversion.MatchesScalar", KINECT_TEST_FLAGS)
+
+bool FKinectColorConversionTest::RunTest(const FString &Parameters)
+{
+	// The sensor's width, and one whose rows end in a scalar tail of 6 pixels and, halved, of 3
+	const int32 Widths[] = { 1920, 1926 };
+	const int32 Height = 1080;
+	TArray<uint8> Yuy2;
+	TArray<uint8> Bgra;
+	TArray<FColor> Reference;
+	for (const int32 Width : Widths)
+	{
+		MakeYuy2Frame(Width, Height, Width, Yuy2);
+
+		Bgra.SetNumUninitialized(Width * Height * 4);
+		FKinectColorConversion::ConvertToBGRA(Yuy2.GetData(), Width, Height, Bgra.GetData());
+		ReferenceConvert(Yuy2.GetData(), Width, Height, Reference);
+		TestEqual(FString::Printf(TEXT("Full resolution pixels differing from scalar, width %d"), Width), CountMismatches(Bgra, Reference), 0);
+
+		Bgra.SetNumUninitialized(Width / 2 * (Height / 2) * 4);
+		FKinectColorConversion::ConvertToBGRAHalf(Yuy2.GetData(), Width, Height, Bgra.GetData());
+		ReferenceConvertHalf(Yuy2.GetData(), Width, Height, Reference);
+		TestEqual(FString::Printf(TEXT("Half resolution pixels differing from scalar, width %d"), Width), CountMismatches(Bgra, Reference), 0);
+	}
+	return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FKinectColorConversionBenchmark, "Kinect.Benchmark.ColorConversion", KINECT_TEST_FLAGS)
+
+bool FKinectColorConversionBenchmark::RunTest(const FString &Parameters)
+{
+	const int32 Width = 1920;
+	const int32 Height = 1080;
+	TArray<uint8> Yuy2;
+	TArray<uint8> Bgra;
+	TArray<FColor> Reference;
+	MakeYuy2Frame(Width, Height, 1, Yuy2);
+	Bgra.SetNumUninitialized(Width * Height * 4);
+	// The references split rows across cores the same way, so the ratio is the kernels' own
+	const double ReferenceMs = KinectTest::TimeMilliseconds(5, [&]()
+	{
+		ReferenceConvert(Yuy2.GetData(), Width, Height, Reference);
+	});
+	const double ConvertMs = KinectTest::TimeMilliseconds(20, [&]()
+	{
+		FKinectColorConversion::ConvertToBGRA(Yuy2.GetData(), Width, Height, Bgra.GetData());
+	});
+	const double ReferenceHalfMs = KinectTest::TimeMilliseconds(5, [&]()
+	{
+		ReferenceConvertHalf(Yuy2.GetData(), Width, Height, Reference);
+	});
+	const double ConvertHalfMs = KinectTest::TimeMilliseconds(20, [&]()
+	{
+		FKinectColorConversion::ConvertToBGRAHalf(Yuy2.GetData(), Width, Height, Bgra.GetData());
+	});
+	AddLogItem(FString::Printf(TEXT("%dx%d full resolution: per pixel ToColor %.2f ms, ConvertToBGRA %.2f ms"), Width, Height, ReferenceMs, ConvertMs));
+	AddLogItem(FString::Printf(TEXT("%dx%d half resolution: per pixel ToColor %.2f ms, ConvertToBGRAHalf %.2f ms"), Width, Height, ReferenceHalfMs, ConvertHalfMs));
+	return true;
+}
@@ -0,0 +1,180 @@
+#include "KinectPluginPrivatePCH.h"
+#include "KinectDepthCodec.h"
+#include "KinectTestHelpers.h"
+
+static const int32 DepthWidth = 512;
+static const int32 DepthHeight = 424;
+
+/** Pixels past the end of a decode, which no input may touch. */
+static const int32 GuardPixels = 64;
+static const uint16 GuardDepth = 0xBEEF;
+
+/** Hand packs variable length integers into words the way the codec does, so tests can forge streams. */
+static void AppendVarInts(const uint32 *Values, int32 NumValues, TArray<uint8> &OutData)
+{
+	TArray<uint32> Nibbles;
+	for (int32 i = 0; i < NumValues; i++)
+	{
+		uint32 Value = Values[i];
+		do
+		{
+			const uint32 Rest = Value >> 3;
+			Nibbles.Add((Value & 0x7) | (Rest ? 0x8 : 0));
+			Value = Rest;
+		} while (Value);
+	}
+	for (int32 First = 0; First < Nibbles.Num(); First += 8)
+	{
+		uint32 Word = 0;
+		for (int32 i = First; i < First + 8; i++)
+		{
+			Word = (Word << 4) | (i < Nibbles.Num() ? Nibbles[i] : 0);
+		}
+		const int32 Offset = OutData.Num();
+		OutData.AddUninitialized(sizeof(uint32));
+		FMemory::Memcpy(OutData.GetData() + Offset, &Word, sizeof(uint32));
+	}
+}
+
+/** Decodes into a buffer followed by guard pixels; returns Decompress, failing the test if the guard was written. */
+static bool DecompressGuarded(FAutomationTestBase &Test, const FString &What, const uint8 *Data, int32 Size, int32 NumPixels, TArray<uint16> &OutDepth)
+{
+	OutDepth.SetNumUninitialized(NumPixels + GuardPixels);
+	for (int32 i = NumPixels; i < OutDepth.Num(); i++)
+	{
+		OutDepth[i] = GuardDepth;
+	}
+	const bool bDecoded = FKinectDepthCodec::Decompress(Data, Size, OutDepth.GetData(), NumPixels);
+	int32 GuardWrites = 0;
+	for (int32 i = NumPixels; i < OutDepth.Num(); i++)
+	{
+		GuardWrites += OutDepth[i] != GuardDepth ? 1 : 0;
+	}
+	Test.TestEqual(FString::Printf(TEXT("Pixels written past the end, %s"), *What), GuardWrites, 0);
+	return bDecoded;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FKinectDepthCodecRoundTripTest, "Kinect.DepthCodec.RoundTrip", KINECT_TEST_FLAGS)
+
+bool FKinectDepthCodecRoundTripTest::RunTest(const FString &Parameters)
+{
+	const int32 NumPixels = DepthWidth * DepthHeight;
+	TArray<TArray<uint16>> Frames;
+	const FString Names[] = { TEXT("recorded like"), TEXT("all holes"), TEXT("no holes"), TEXT("alternating extremes"), TEXT("single pixel") };
+	Frames.AddDefaulted(ARRAY_COUNT(Names));
+	KinectTest::MakeDepthFrame(DepthWidth, DepthHeight, 5, 1, Frames[0]);
+	Frames[1].AddZeroed(NumPixels);
+	KinectTest::MakeDepthFrame(DepthWidth, DepthHeight, 0, 2, Frames[2]);
+	for (int32 i = 0; i < Frames[2].Num(); i++)
+	{
+		Frames[2][i] = FMath::Max<uint16>(Frames[2][i], 1);
+	}
+	// The widest differences, and runs of one pixel
+	Frames[3].SetNumUninitialized(NumPixels);
+	const uint16 Extremes[] = { 1, MAX_uint16, 0, MAX_uint16, 1 };
+	for (int32 i = 0; i < NumPixels; i++)
+	{
+		Frames[3][i] = Extremes[i % ARRAY_COUNT(Extremes)];
+	}
+	Frames[4].Add(1234);
+
+	TArray<uint8> Compressed;
+	TArray<uint16> Decoded;
+	for (int32 f = 0; f < Frames.Num(); f++)
+	{
+		const TArray<uint16> &Frame = Frames[f];
+		const int32 Size = FKinectDepthCodec::Compress(Frame.GetData(), Frame.Num(), Compressed);
+		TestTrue(FString::Printf(TEXT("Compressed size within the bound, %s frame"), *Names[f]), Size <= FKinectDepthCodec::GetMaxCompressedSize(Frame.Num()));
+		const bool bDecoded = DecompressGuarded(*this, Names[f], Compressed.GetData(), Size, Frame.Num(), Decoded);
+		TestTrue(FString::Printf(TEXT("Decoded, %s frame"), *Names[f]), bDecoded);
+		TestTrue(FString::Printf(TEXT("Round trip is lossless, %s frame"), *Names[f]),
+			bDecoded && FMemory::Memcmp(Decoded.GetData(), Frame.GetData(), Frame.Num() * sizeof(uint16)) == 0);
+	}
+	return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FKinectDepthCodecCorruptInputTest, "Kinect.DepthCodec.CorruptInput", KINECT_TEST_FLAGS)
+
+bool FKinectDepthCodecCorruptInputTest::RunTest(const FString &Parameters)
+{
+	const int32 NumPixels = DepthWidth * DepthHeight;
+	TArray<uint16> Frame;
+	KinectTest::MakeDepthFrame(DepthWidth, DepthHeight, 5, 3, Frame);
+	TArray<uint8> Compressed;
+	const int32 Size = FKinectDepthCodec::Compress(Frame.GetData(), NumPixels, Compressed);
+	TArray<uint16> Decoded;
+
+	// Every word of the stream carries data, so any shorter stream is missing pixels
+	int32 TruncatedAccepted = 0;
+	const int32 CutStep = FMath::Max(Size / 100 / 4, 1) * 4;
+	for (int32 Cut = 0; Cut < Size; Cut += CutStep)
+	{
+		TruncatedAccepted += DecompressGuarded(*this, FString::Printf(TEXT("cut to %d bytes"), Cut), Compressed.GetData(), Cut, NumPixels, Decoded) ? 1 : 0;
+	}
+	TruncatedAccepted += DecompressGuarded(*this, TEXT("last word cut off"), Compressed.GetData(), Size - sizeof(uint32), NumPixels, Decoded) ? 1 : 0;
+	TestEqual(TEXT("Truncated streams accepted"), TruncatedAccepted, 0);
+	TestFalse(TEXT("Decoded a stream of partial words"), DecompressGuarded(*this, TEXT("partial word"), Compressed.GetData(), Size - 1, NumPixels, Decoded));
+	TestFalse(TEXT("Decoded a stream too long for the image"), DecompressGuarded(*this, TEXT("image too small"), Compressed.GetData(), Size, NumPixels - 1, Decoded));
+
+	// Runs whose lengths wrap around uint32 when added, and runs longer than the image
+	const uint32 Wrapping[] = { 0xFFFFFFF0u, 0x20, 1, 1 };
+	const uint32 TooLong[] = { 0, static_cast<uint32>(NumPixels) + 1 };
+	const uint32 Empty[] = { 0, 0, 0, 0 };
+	struct FForged
+	{
+		const TCHAR *Name;
+		const uint32 *Values;
+		int32 NumValues;
+	};
+	const FForged Forged[] = { { TEXT("wrapping runs"), Wrapping, ARRAY_COUNT(Wrapping) }, { TEXT("run past the end"), TooLong, ARRAY_COUNT(TooLong) },
+		{ TEXT("empty runs"), Empty, ARRAY_COUNT(Empty) } };
+	TArray<uint8> Stream;
+	for (const FForged &Forgery : Forged)
+	{
+		Stream.Reset();
+		AppendVarInts(Forgery.Values, Forgery.NumValues, Stream);
+		TestFalse(FString::Printf(TEXT("Decoded forged %s"), Forgery.Name), DecompressGuarded(*this, Forgery.Name, Stream.GetData(), Stream.Num(), NumPixels, Decoded));
+	}
+
+	// Flipped bits may still decode to some image, but never outside the buffer
+	FRandomStream Random(4);
+	for (int32 Trial = 0; Trial < 200; Trial++)
+	{
+		Stream = Compressed;
+		for (int32 Flip = 0; Flip < 4; Flip++)
+		{
+			Stream[Random.RandHelper(Size)] ^= static_cast<uint8>(1 << Random.RandHelper(8));
+		}
+		DecompressGuarded(*this, FString::Printf(TEXT("flipped bits, trial %d"), Trial), Stream.GetData(), Size, NumPixels, Decoded);
+	}
+	return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FKinectDepthCodecBenchmark, "Kinect.Benchmark.DepthCodec", KINECT_TEST_FLAGS)
+
+bool FKinectDepthCodecBenchmark::RunTest(const FString &Parameters)
+{
+	const int32 NumPixels = DepthWidth * DepthHeight;
+	const double RawMegabytes = NumPixels * sizeof(uint16) / (1024.0 * 1024.0);
+	TArray<uint16> Frame;
+	TArray<uint8> Compressed;
+	TArray<uint16> Decoded;
+	Decoded.SetNumUninitialized(NumPixels);
+	const int32 HolePercents[] = { 0, 5, 20 };
+	for (const int32 HolePercent : HolePercents)
+	{
+		KinectTest::MakeDepthFrame(DepthWidth, DepthHeight, HolePercent, 5, Frame);
+		const double EncodeMs = KinectTest::TimeMilliseconds(50, [&]()
+		{
+			FKinectDepthCodec::Compress(Frame.GetData(), NumPixels, Compressed);
+		});
+		const double DecodeMs = KinectTest::TimeMilliseconds(50, [&]()
+		{
+			FKinectDepthCodec::Decompress(Compressed.GetData(), Compressed.Num(), Decoded.GetData(), NumPixels);
+		});
+		AddLogItem(FString::Printf(TEXT("%dx%d, %d%% holes: ratio %.2f:1, encode %.2f ms (%.0f MB/s), decode %.2f ms (%.0f MB/s)"),
+			DepthWidth, DepthHeight, HolePercent, NumPixels * sizeof(uint16) / static_cast<double>(Compressed.Num()),
+			EncodeMs, RawMegabytes * 1000.0 / EncodeMs, DecodeMs, RawMegabytes * 1000.0 / DecodeMs));
+	}
+	return true;
+}
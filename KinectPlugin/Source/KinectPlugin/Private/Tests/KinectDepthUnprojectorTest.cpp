@@ -0,0 +1,114 @@
+#include "KinectPluginPrivatePCH.h"
+#include "KinectDepthUnprojector.h"
+#include "KinectTestHelpers.h"
+
+static const int32 DepthWidth = 512;
+static const int32 DepthHeight = 424;
+
+/** Unprojects Count pixels one call each, which always takes the scalar path of UnprojectRow. */
+static void UnprojectPixels(const FKinectDepthUnprojector &Unprojector, const uint16 *DepthRow, int32 Y, int32 X0, int32 Step, int32 Count, FVector *OutPositions, float *OutDistances)
+{
+	for (int32 i = 0; i < Count; i++)
+	{
+		Unprojector.UnprojectRow(DepthRow, Y, X0 + i * Step, Step, 1, OutPositions + i, OutDistances + i);
+	}
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FKinectDepthUnprojectorTest, "Kinect.DepthUnprojector.RowsMatchScalar", KINECT_TEST_FLAGS)
+
+bool FKinectDepthUnprojectorTest::RunTest(const FString &Parameters)
+{
+	FKinectSyntheticDepthIntrinsics Intrinsics;
+	FKinectDepthUnprojector Unprojector;
+	if (!Unprojector.Rebuild(Intrinsics, DepthWidth, DepthHeight))
+	{
+		AddError(TEXT("The unprojector did not build from synthetic intrinsics"));
+		return false;
+	}
+	TArray<uint16> Depth;
+	KinectTest::MakeDepthFrame(DepthWidth, DepthHeight, 5, 1, Depth);
+
+	// Odd starts and steps leave the SSE loop a scalar tail and take its gather path
+	const int32 Layouts[][2] = { { 0, 1 }, { 1, 1 }, { 0, 2 }, { 1, 3 } };
+	TArray<FVector> RowPositions;
+	TArray<float> RowDistances;
+	TArray<FVector> PixelPositions;
+	TArray<float> PixelDistances;
+	for (const auto &Layout : Layouts)
+	{
+		const int32 X0 = Layout[0];
+		const int32 Step = Layout[1];
+		const int32 Count = (DepthWidth - 1 - X0) / Step + 1;
+		RowPositions.SetNumUninitialized(Count);
+		RowDistances.SetNumUninitialized(Count);
+		PixelPositions.SetNumUninitialized(Count);
+		PixelDistances.SetNumUninitialized(Count);
+		int32 Mismatches = 0;
+		for (int32 y = 0; y < DepthHeight; y++)
+		{
+			const uint16 *Row = Depth.GetData() + y * DepthWidth;
+			Unprojector.UnprojectRow(Row, y, X0, Step, Count, RowPositions.GetData(), RowDistances.GetData());
+			UnprojectPixels(Unprojector, Row, y, X0, Step, Count, PixelPositions.GetData(), PixelDistances.GetData());
+			for (int32 i = 0; i < Count; i++)
+			{
+				if (!RowPositions[i].Equals(PixelPositions[i], 1e-3f) || FMath::Abs(RowDistances[i] - PixelDistances[i]) > 1e-6f)
+				{
+					Mismatches++;
+				}
+			}
+		}
+		TestEqual(FString::Printf(TEXT("Pixels differing from scalar, start %d step %d"), X0, Step), Mismatches, 0);
+	}
+
+	// The principal point looks straight ahead
+	const uint16 Center[1] = { 2000 };
+	FVector Position;
+	float Distance;
+	FKinectSyntheticDepthIntrinsics CenteredIntrinsics(365.0f, 365.0f, 0.0f, 0.0f);
+	FKinectDepthUnprojector Centered;
+	Centered.Rebuild(CenteredIntrinsics, 1, 1);
+	Centered.UnprojectRow(Center, 0, 0, 1, 1, &Position, &Distance);
+	TestTrue(TEXT("Principal point position"), Position.Equals(FVector(200.0f, 0.0f, 0.0f), 1e-3f));
+	TestTrue(TEXT("Principal point distance"), FMath::IsNearlyEqual(Distance, 2.0f, 1e-5f));
+	return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FKinectDepthUnprojectorBenchmark, "Kinect.Benchmark.DepthUnprojector", KINECT_TEST_FLAGS)
+
+bool FKinectDepthUnprojectorBenchmark::RunTest(const FString &Parameters)
+{
+	FKinectSyntheticDepthIntrinsics Intrinsics;
+	FKinectDepthUnprojector Unprojector;
+	if (!Unprojector.Rebuild(Intrinsics, DepthWidth, DepthHeight))
+	{
+		AddError(TEXT("The unprojector did not build from synthetic intrinsics"));
+		return false;
+	}
+	TArray<uint16> Depth;
+	KinectTest::MakeDepthFrame(DepthWidth, DepthHeight, 5, 1, Depth);
+	TArray<FVector> Positions;
+	TArray<float> Distances;
+	Positions.SetNumUninitialized(DepthWidth);
+	Distances.SetNumUninitialized(DepthWidth);
+	for (int32 Step = 1; Step <= 2; Step++)
+	{
+		const int32 Count = (DepthWidth - 1) / Step + 1;
+		const double RowMilliseconds = KinectTest::TimeMilliseconds(50, [&]()
+		{
+			for (int32 y = 0; y < DepthHeight; y += Step)
+			{
+				Unprojector.UnprojectRow(Depth.GetData() + y * DepthWidth, y, 0, Step, Count, Positions.GetData(), Distances.GetData());
+			}
+		});
+		const double PixelMilliseconds = KinectTest::TimeMilliseconds(50, [&]()
+		{
+			for (int32 y = 0; y < DepthHeight; y += Step)
+			{
+				UnprojectPixels(Unprojector, Depth.GetData() + y * DepthWidth, y, 0, Step, Count, Positions.GetData(), Distances.GetData());
+			}
+		});
+		AddLogItem(FString::Printf(TEXT("Resolution %d: %.3f ms per frame by rows, %.3f ms pixel by pixel (%.1fx)"),
+			Step, RowMilliseconds, PixelMilliseconds, PixelMilliseconds / FMath::Max(RowMilliseconds, 1e-6)));
+	}
+	return true;
+}
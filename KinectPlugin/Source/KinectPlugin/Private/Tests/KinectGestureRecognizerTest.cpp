@@ -0,0 +1,220 @@
+#include "KinectPluginPrivatePCH.h"
+#include "KinectGestureRecognizer.h"
+#include "KinectTestHelpers.h"
+
+static const TIMESPAN FrameTicks = 333333;
+static const float FramesPerSecond = 30.0f;
+
+/**
+ * Where the arms end up, in engine space centimeters relative to the spine
+ * base of a person with a torso of 50 cm: X forward, Y right, Z up. A motion
+ * goes there from the rest pose, arms hanging, and back.
+ */
+struct FArmMotion
+{
+	FVector HandLeft;
+	FVector ElbowLeft;
+	FVector HandRight;
+	FVector ElbowRight;
+};
+
+static const FArmMotion RestPose = { FVector(5.0f, -25.0f, 5.0f), FVector(0.0f, -25.0f, 30.0f), FVector(5.0f, 25.0f, 5.0f), FVector(0.0f, 25.0f, 30.0f) };
+/** The right hand rises out to the side and up above the head. */
+static const FArmMotion RaiseRight = { RestPose.HandLeft, RestPose.ElbowLeft, FVector(10.0f, 45.0f, 85.0f), FVector(5.0f, 40.0f, 55.0f) };
+/** The left hand punches forward. */
+static const FArmMotion PunchLeft = { FVector(60.0f, -20.0f, 45.0f), FVector(30.0f, -22.0f, 45.0f), RestPose.HandRight, RestPose.ElbowRight };
+
+/** A motion of both arms to somewhere within reach. */
+static FArmMotion MakeRandomMotion(FRandomStream &Random)
+{
+	FArmMotion Motion;
+	Motion.HandLeft = FVector(Random.FRandRange(0.0f, 60.0f), Random.FRandRange(-60.0f, 10.0f), Random.FRandRange(0.0f, 90.0f));
+	Motion.HandRight = FVector(Random.FRandRange(0.0f, 60.0f), Random.FRandRange(-10.0f, 60.0f), Random.FRandRange(0.0f, 90.0f));
+	Motion.ElbowLeft = FMath::Lerp(RestPose.ElbowLeft, Motion.HandLeft, 0.4f);
+	Motion.ElbowRight = FMath::Lerp(RestPose.ElbowRight, Motion.HandRight, 0.4f);
+	return Motion;
+}
+
+/** Poses body Body of Frame at Alpha along Motion, for a person Scale times the size of the rest pose's standing at Offset. */
+static void SetPose(FKinectBodyFrame &Frame, int32 Body, const FArmMotion &Motion, float Alpha, float Scale, const FVector &Offset)
+{
+	// Eased in and out, as people move
+	const float Ease = Alpha * Alpha * (3.0f - 2.0f * Alpha);
+	for (int32 j = 0; j < JointType_Count; j++)
+	{
+		Frame.Positions[Body][j] = Offset + FVector(0.0f, 0.0f, 25.0f) * Scale;
+	}
+	Frame.Positions[Body][JointType_SpineBase] = Offset;
+	Frame.Positions[Body][JointType_SpineShoulder] = Offset + FVector(0.0f, 0.0f, 50.0f) * Scale;
+	Frame.Positions[Body][JointType_HandLeft] = Offset + FMath::Lerp(RestPose.HandLeft, Motion.HandLeft, Ease) * Scale;
+	Frame.Positions[Body][JointType_ElbowLeft] = Offset + FMath::Lerp(RestPose.ElbowLeft, Motion.ElbowLeft, Ease) * Scale;
+	Frame.Positions[Body][JointType_HandRight] = Offset + FMath::Lerp(RestPose.HandRight, Motion.HandRight, Ease) * Scale;
+	Frame.Positions[Body][JointType_ElbowRight] = Offset + FMath::Lerp(RestPose.ElbowRight, Motion.ElbowRight, Ease) * Scale;
+}
+
+/** Drives one tracked body through a sequence of motions at the sensor's frame rate, collecting the events. */
+struct FGesturePlayer
+{
+	FKinectGestureRecognizer &Recognizer;
+	FKinectBodyFrame &Frame;
+	int32 Body;
+	float Scale;
+	FVector Offset;
+	TArray<FKinectGestureEvent> Events;
+
+	FGesturePlayer(FKinectGestureRecognizer &InRecognizer, FKinectBodyFrame &InFrame, int32 InBody, float InScale, const FVector &InOffset)
+		: Recognizer(InRecognizer)
+		, Frame(InFrame)
+		, Body(InBody)
+		, Scale(InScale)
+		, Offset(InOffset)
+	{
+		for (int32 i = 0; i < BODY_COUNT; i++)
+		{
+			Frame.bTracked[i] = i == Body;
+		}
+	}
+
+	/** Moves along Motion for Seconds, or back to the rest pose along it if bReverse. */
+	void Play(const FArmMotion &Motion, float Seconds, bool bReverse = false)
+	{
+		const int32 NumFrames = FMath::RoundToInt(Seconds * FramesPerSecond);
+		for (int32 i = 1; i <= NumFrames; i++)
+		{
+			const float Alpha = static_cast<float>(i) / NumFrames;
+			SetPose(Frame, Body, Motion, bReverse ? 1.0f - Alpha : Alpha, Scale, Offset);
+			Frame.Time += FrameTicks;
+			Recognizer.Update(Frame, Events);
+		}
+	}
+
+	/** Rest, then Motion and back, then rest again. */
+	void Perform(const FArmMotion &Motion, float Seconds)
+	{
+		Play(RestPose, 1.0f);
+		Play(Motion, Seconds);
+		Play(Motion, Seconds, true);
+		Play(RestPose, 1.0f);
+	}
+
+	int32 Count(FName Name) const
+	{
+		int32 Result = 0;
+		for (const FKinectGestureEvent &Event : Events)
+		{
+			Result += Event.Name == Name ? 1 : 0;
+		}
+		return Result;
+	}
+};
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FKinectGestureRecognizerCaptureTest, "Kinect.GestureRecognizer.CaptureAndPlayBack", KINECT_TEST_FLAGS)
+
+bool FKinectGestureRecognizerCaptureTest::RunTest(const FString &Parameters)
+{
+	const FName Raise(TEXT("Raise"));
+	const float Threshold = 0.2f;
+	TSharedRef<FKinectGestureRecognizer> Recognizer = MakeShareable(new FKinectGestureRecognizer());
+	TSharedRef<FKinectBodyFrame> Frame = MakeShareable(new FKinectBodyFrame());
+	Frame->Time = 1000 * FrameTicks;
+
+	// Recorded by one person, in front of the sensor
+	{
+		FGesturePlayer Recording(*Recognizer, *Frame, 0, 1.0f, FVector(200.0f, 0.0f, 0.0f));
+		Recording.Play(RestPose, 1.0f);
+		Recording.Play(RaiseRight, 1.0f);
+		TestTrue(TEXT("Captures the last second of motion"), Recognizer->CaptureTemplate(Raise, 0, 1.0f, Threshold));
+		TestEqual(TEXT("Templates"), Recognizer->NumTemplates(), 1);
+	}
+
+	// Played back by someone taller, off to the side, as another body, and at other speeds
+	const float Speeds[] = { 1.0f, 0.8f, 1.25f };
+	for (const float Seconds : Speeds)
+	{
+		Recognizer->Reset();
+		FGesturePlayer Playback(*Recognizer, *Frame, 3, 1.2f, FVector(300.0f, -80.0f, 10.0f));
+		Playback.Perform(RaiseRight, Seconds);
+		TestEqual(FString::Printf(TEXT("Times the gesture fired when performed in %.2f s"), Seconds), Playback.Count(Raise), 1);
+		for (const FKinectGestureEvent &Event : Playback.Events)
+		{
+			TestEqual(FString::Printf(TEXT("Body that fired, %.2f s"), Seconds), Event.Body, 3);
+			AddLogItem(FString::Printf(TEXT("Performed in %.2f s: fired at cost %.3f"), Seconds, Event.Cost));
+		}
+	}
+
+	// Another motion, or resting, does not fire it
+	Recognizer->Reset();
+	FGesturePlayer Other(*Recognizer, *Frame, 3, 1.2f, FVector(300.0f, -80.0f, 10.0f));
+	Other.Perform(PunchLeft, 1.0f);
+	Other.Play(RestPose, 3.0f);
+	TestEqual(TEXT("Times a different motion fired the gesture"), Other.Count(Raise), 0);
+	return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FKinectGestureRecognizerBenchmark, "Kinect.Benchmark.GestureRecognizer", KINECT_TEST_FLAGS)
+
+bool FKinectGestureRecognizerBenchmark::RunTest(const FString &Parameters)
+{
+	// What a frame may take on the mesh generator thread, which also meshes the depth frame
+	const double BudgetMicroseconds = 300.0;
+	const int32 NumTemplates = 50;
+	const int32 NumFrames = 300;
+	const float Threshold = 0.2f;
+	TSharedRef<FKinectGestureRecognizer> Recognizer = MakeShareable(new FKinectGestureRecognizer());
+	TSharedRef<FKinectBodyFrame> Frame = MakeShareable(new FKinectBodyFrame());
+	FRandomStream Random(NumTemplates);
+	// A library recorded the way users record one, of motions of every duration the recognizer compares
+	{
+		FGesturePlayer Recording(*Recognizer, *Frame, 0, 1.0f, FVector(200.0f, 0.0f, 0.0f));
+		for (int32 t = 0; t < NumTemplates; t++)
+		{
+			const float Duration = Random.FRandRange(FKinectGestureRecognizer::MinDuration, 2.0f);
+			Recording.Play(RestPose, 0.5f);
+			Recording.Play(MakeRandomMotion(Random), Duration);
+			Recognizer->CaptureTemplate(FName(*FString::Printf(TEXT("Gesture%d"), t)), 0, Duration, Threshold);
+		}
+	}
+	TestEqual(TEXT("Templates"), Recognizer->NumTemplates(), NumTemplates);
+
+	// Six people moving all the time, each to somewhere new on every cycle: the most work a frame can be
+	FArmMotion Motions[BODY_COUNT];
+	TArray<FKinectGestureEvent> Events;
+	int32 Index = 0;
+	auto NextFrame = [&]()
+	{
+		Frame->Time += FrameTicks;
+		for (int32 Body = 0; Body < BODY_COUNT; Body++)
+		{
+			const int32 CycleFrames = 40 + 8 * Body;
+			const int32 Phase = Index % CycleFrames;
+			if (Phase == 0)
+			{
+				Motions[Body] = MakeRandomMotion(Random);
+			}
+			const float Alpha = 1.0f - FMath::Abs(2.0f * Phase / CycleFrames - 1.0f);
+			Frame->bTracked[Body] = true;
+			SetPose(*Frame, Body, Motions[Body], Alpha, 1.0f, FVector(250.0f, Body * 60.0f - 150.0f, 0.0f));
+		}
+		Events.Reset();
+		Recognizer->Update(*Frame, Events);
+		Index++;
+	};
+	// Fill every body's window, so each compares at every duration
+	for (int32 i = 0; i < FKinectGestureRecognizer::NumDurations * 10; i++)
+	{
+		NextFrame();
+	}
+	const double Microseconds = KinectTest::TimeMilliseconds(1, [&]()
+	{
+		for (int32 i = 0; i < NumFrames; i++)
+		{
+			NextFrame();
+		}
+	}) * 1000.0 / NumFrames;
+	AddLogItem(FString::Printf(TEXT("%d templates, %d tracked bodies: %.1f us per frame, budget %.0f us"), NumTemplates, BODY_COUNT, Microseconds, BudgetMicroseconds));
+	if (Microseconds > BudgetMicroseconds)
+	{
+		AddWarning(FString::Printf(TEXT("Gesture recognition takes %.1f us per frame, over the budget of %.0f us"), Microseconds, BudgetMicroseconds));
+	}
+	return true;
+}
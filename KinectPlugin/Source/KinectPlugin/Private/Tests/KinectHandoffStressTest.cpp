@@ -0,0 +1,199 @@
+#include "KinectPluginPrivatePCH.h"
+#include "KinectTripleBuffer.h"
+#include "KinectUpdateMailbox.h"
+#include "KinectTestHelpers.h"
+
+/** Item large enough that a slot written while it is read shows up as a torn payload. */
+struct FStressItem
+{
+	static const int32 PayloadSize = 256;
+
+	int32 Sequence;
+	int32 Payload[PayloadSize];
+};
+
+/** Runs Body on its own thread, standing in for the mesh generator thread. */
+class FStressProducer : public FRunnable
+{
+public:
+	explicit FStressProducer(TFunction<void()> InBody)
+		: Body(InBody)
+	{
+		Thread = FRunnableThread::Create(this, TEXT("KinectStressProducer"));
+	}
+
+	~FStressProducer()
+	{
+		delete Thread;
+	}
+
+	virtual uint32 Run() override
+	{
+		Body();
+		return 0;
+	}
+
+	void Join()
+	{
+		Thread->WaitForCompletion();
+	}
+
+private:
+	TFunction<void()> Body;
+	FRunnableThread *Thread;
+};
+
+/** Items, producer period and consumer period of each run: a fast producer, a slow producer and both flat out. */
+static const int32 StressRuns[][3] = { { 20000, 20000, 1 }, { 2000, 1, 2000 }, { 200000, 200000, 200000 } };
+
+/** Sleeps a millisecond every Period calls and only yields otherwise, so a side with Period 1 runs far slower than the other. */
+static void Throttle(int32 Iteration, int32 Period)
+{
+	if (Iteration % Period == Period - 1)
+	{
+		FPlatformProcess::Sleep(0.001f);
+	}
+	else
+	{
+		FPlatformProcess::Sleep(0.0f);
+	}
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FKinectTripleBufferStressTest, "Kinect.TripleBuffer.MismatchedRates", KINECT_TEST_FLAGS)
+
+bool FKinectTripleBufferStressTest::RunTest(const FString &Parameters)
+{
+	for (const auto &Run : StressRuns)
+	{
+		const int32 NumItems = Run[0];
+		const int32 ProducerPeriod = Run[1];
+		const int32 ConsumerPeriod = Run[2];
+		TKinectTripleBuffer<FStressItem> Buffer;
+		for (int32 Slot = 0; Slot < Buffer.NumSlots; Slot++)
+		{
+			Buffer.GetSlot(Slot).Sequence = INDEX_NONE;
+		}
+		int32 Dropped = 0;
+		int32 LostCarryOvers = 0;
+		FStressProducer Producer([&]()
+		{
+			for (int32 Sequence = 0; Sequence < NumItems; Sequence++)
+			{
+				FStressItem &Item = Buffer.GetBack();
+				Item.Sequence = Sequence;
+				for (int32 i = 0; i < FStressItem::PayloadSize; i++)
+				{
+					Item.Payload[i] = Sequence + i;
+				}
+				if (Buffer.Publish())
+				{
+					Dropped++;
+					// The dropped item comes back as the new back slot
+					if (Buffer.GetBack().Sequence != Sequence - 1)
+					{
+						LostCarryOvers++;
+					}
+				}
+				Throttle(Sequence, ProducerPeriod);
+			}
+		});
+
+		int32 Acquired = 0;
+		int32 OutOfOrder = 0;
+		int32 Torn = 0;
+		int32 LastSequence = INDEX_NONE;
+		for (int32 Iteration = 0; LastSequence < NumItems - 1; Iteration++)
+		{
+			if (Buffer.Acquire())
+			{
+				const FStressItem &Item = Buffer.GetFront();
+				Acquired++;
+				OutOfOrder += Item.Sequence <= LastSequence ? 1 : 0;
+				for (int32 i = 0; i < FStressItem::PayloadSize; i++)
+				{
+					if (Item.Payload[i] != Item.Sequence + i)
+					{
+						Torn++;
+						break;
+					}
+				}
+				LastSequence = Item.Sequence;
+			}
+			Throttle(Iteration, ConsumerPeriod);
+		}
+		Producer.Join();
+
+		const FString Case = FString::Printf(TEXT("producer period %d, consumer period %d"), ProducerPeriod, ConsumerPeriod);
+		TestEqual(FString::Printf(TEXT("Items read while being written, %s"), *Case), Torn, 0);
+		TestEqual(FString::Printf(TEXT("Items acquired out of order, %s"), *Case), OutOfOrder, 0);
+		TestEqual(FString::Printf(TEXT("Dropped items not handed back, %s"), *Case), LostCarryOvers, 0);
+		TestEqual(FString::Printf(TEXT("Acquired plus dropped items, %s"), *Case), Acquired + Dropped, NumItems);
+		TestFalse(FString::Printf(TEXT("Acquire with nothing new, %s"), *Case), Buffer.Acquire());
+		AddLogItem(FString::Printf(TEXT("%s: %d acquired, %d dropped"), *Case, Acquired, Dropped));
+	}
+	return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FKinectUpdateMailboxStressTest, "Kinect.UpdateMailbox.MismatchedRates", KINECT_TEST_FLAGS)
+
+bool FKinectUpdateMailboxStressTest::RunTest(const FString &Parameters)
+{
+	static const int32 NumKinds = 3;
+	for (const auto &Run : StressRuns)
+	{
+		const int32 NumPosts = Run[0];
+		const int32 ProducerPeriod = Run[1];
+		const int32 ConsumerPeriod = Run[2];
+		FKinectUpdateMailbox Mailbox;
+		int32 Posted[NumKinds] = { 0 };
+		int32 Coalesced[NumKinds] = { 0 };
+		volatile int32 bDone = 0;
+		FStressProducer Producer([&]()
+		{
+			FRandomStream Random(7);
+			for (int32 Post = 0; Post < NumPosts; Post++)
+			{
+				const int32 Kinds = 1 + Random.RandHelper((1 << NumKinds) - 1);
+				const int32 Previous = Mailbox.Post(Kinds);
+				for (int32 Kind = 0; Kind < NumKinds; Kind++)
+				{
+					Posted[Kind] += (Kinds >> Kind) & 1;
+					Coalesced[Kind] += (Previous >> Kind) & 1;
+				}
+				Throttle(Post, ProducerPeriod);
+			}
+			FPlatformAtomics::InterlockedExchange(&bDone, 1);
+		});
+
+		int32 Taken[NumKinds] = { 0 };
+		int32 Takes = 0;
+		for (int32 Iteration = 0; ; Iteration++)
+		{
+			// Read before taking, so the last take after it sees every post
+			const bool bProducerDone = bDone != 0;
+			const int32 Kinds = Mailbox.Take();
+			for (int32 Kind = 0; Kind < NumKinds; Kind++)
+			{
+				Taken[Kind] += (Kinds >> Kind) & 1;
+			}
+			Takes += Kinds != EKinectUpdate::None ? 1 : 0;
+			if (bProducerDone)
+			{
+				break;
+			}
+			Throttle(Iteration, ConsumerPeriod);
+		}
+		Producer.Join();
+
+		// Every post either raised a kind's pending bit, which exactly one take clears, or coalesced into a raised one
+		const FString Case = FString::Printf(TEXT("producer period %d, consumer period %d"), ProducerPeriod, ConsumerPeriod);
+		for (int32 Kind = 0; Kind < NumKinds; Kind++)
+		{
+			TestEqual(FString::Printf(TEXT("Kind %d posts less coalesced posts minus takes, %s"), Kind, *Case),
+				Posted[Kind] - Coalesced[Kind] - Taken[Kind], 0);
+		}
+		TestEqual(FString::Printf(TEXT("Kinds pending after the last take, %s"), *Case), Mailbox.Take(), static_cast<int32>(EKinectUpdate::None));
+		AddLogItem(FString::Printf(TEXT("%s: %d posts applied in %d takes"), *Case, NumPosts, Takes));
+	}
+	return true;
+}
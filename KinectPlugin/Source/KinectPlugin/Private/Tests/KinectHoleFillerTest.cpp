@@ -0,0 +1,145 @@
+#include "KinectPluginPrivatePCH.h"
+#include "KinectHoleFiller.h"
+#include "KinectTestHelpers.h"
+#include "AllowWindowsPlatformTypes.h"
+#include "ppl.h"
+#include "HideWindowsPlatformTypes.h"
+
+static const int32 DepthWidth = 512;
+static const int32 DepthHeight = 424;
+
+/** The actor's findNeighbors before FKinectHoleFiller, with its row and column taken from the width as intended. */
+static void ReferenceFindNeighbors(const uint16 *Source, int32 w, int32 h, int32 i, TArray<uint16> &Result, int32 Radius, uint16 &Min, uint16 &Max, int32 &Enclosed)
+{
+	const int32 y0 = i / w;
+	const int32 x0 = i % w;
+	Min = MAX_uint16;
+	Max = 0;
+	Enclosed = 0;
+	Result.Reset();
+	for (int32 y = FMath::Max(0, y0 - Radius); y < FMath::Min(y0 + Radius, h); y++)
+	{
+		for (int32 x = FMath::Max(x0 - Radius, 0); x < FMath::Min(x0 + Radius, w); x++)
+		{
+			const int32 j = y * w + x;
+			if (j != i && Source[j] > 0)
+			{
+				const uint16 d = Source[j];
+				Min = FMath::Min(Min, d);
+				Max = FMath::Max(Max, d);
+				if (y == y0 - Radius || y + 1 == y0 + Radius || x == x0 - Radius || x + 1 == x0 + Radius)
+				{
+					Enclosed++;
+				}
+				Result.Add(d);
+			}
+		}
+	}
+	if (Max < Min)
+	{
+		Max = Min;
+	}
+}
+
+/** The actor's FillHoles before FKinectHoleFiller: a gather and a sort for every hole, in parallel over the pixels. */
+static void ReferenceFill(const uint16 *Depth, int32 Width, int32 Height, const FKinectHoleFillSettings &Settings, uint16 *Out)
+{
+	Concurrency::combinable<TArray<uint16>> Gathers;
+	Concurrency::parallel_for(0, Width * Height, [&](int i)
+	{
+		Out[i] = Depth[i];
+		if (Depth[i] != 0)
+		{
+			return;
+		}
+		TArray<uint16> &Neighbors = Gathers.local();
+		uint16 Min = 0;
+		uint16 Max = 0;
+		int32 Enclosed = 0;
+		ReferenceFindNeighbors(Depth, Width, Height, i, Neighbors, Settings.Radius, Min, Max, Enclosed);
+		// The original indexed an empty gather when MinNeighbors allowed one
+		if (Neighbors.Num() > 0 && Max - Min < Settings.MaxRange && Neighbors.Num() >= Settings.MinNeighbors && Enclosed >= Settings.MinEnclosed)
+		{
+			Neighbors.Sort();
+			Out[i] = Neighbors[Neighbors.Num() / 2];
+		}
+	});
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FKinectHoleFillerTest, "Kinect.HoleFiller.MatchesReference", KINECT_TEST_FLAGS)
+
+bool FKinectHoleFillerTest::RunTest(const FString &Parameters)
+{
+	// The sensor's size, and one that is not a whole number of column bands or row strips
+	const int32 Sizes[][2] = { { DepthWidth, DepthHeight }, { 301, 203 } };
+	// Gathered radii, radii on the tables, and a range too wide to bin
+	const int32 Radii[] = { 1, 2, 3, 5, 10, 40 };
+	const int32 Ranges[] = { 10, 60, 1000 };
+	FKinectHoleFiller Filler;
+	TArray<uint16> Depth;
+	TArray<uint16> Filled;
+	TArray<uint16> Reference;
+	for (const auto &Size : Sizes)
+	{
+		const int32 Width = Size[0];
+		const int32 Height = Size[1];
+		KinectTest::MakeDepthFrame(Width, Height, 20, Width, Depth);
+		Filled.SetNumUninitialized(Width * Height);
+		Reference.SetNumUninitialized(Width * Height);
+		for (const int32 Radius : Radii)
+		{
+			for (const int32 Range : Ranges)
+			{
+				FKinectHoleFillSettings Settings;
+				Settings.Radius = Radius;
+				Settings.MaxRange = Range;
+				Settings.MinNeighbors = Radius;
+				Settings.MinEnclosed = Radius / 2;
+				Filler.Fill(Depth.GetData(), Width, Height, Settings, Filled.GetData());
+				ReferenceFill(Depth.GetData(), Width, Height, Settings, Reference.GetData());
+				int32 Mismatches = 0;
+				int32 NumFilled = 0;
+				for (int32 i = 0; i < Width * Height; i++)
+				{
+					Mismatches += Filled[i] != Reference[i] ? 1 : 0;
+					NumFilled += Depth[i] == 0 && Reference[i] != 0 ? 1 : 0;
+				}
+				TestEqual(FString::Printf(TEXT("Pixels differing from the reference, %dx%d, radius %d, range %d, %d holes filled"),
+					Width, Height, Radius, Range, NumFilled), Mismatches, 0);
+			}
+		}
+	}
+	return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FKinectHoleFillerBenchmark, "Kinect.Benchmark.HoleFiller", KINECT_TEST_FLAGS)
+
+bool FKinectHoleFillerBenchmark::RunTest(const FString &Parameters)
+{
+	TArray<uint16> Depth;
+	TArray<uint16> Out;
+	Out.SetNumUninitialized(DepthWidth * DepthHeight);
+	FKinectHoleFiller Filler;
+	const int32 HolePercents[] = { 5, 20 };
+	const int32 Radii[] = { 1, 2, 5, 10 };
+	for (const int32 HolePercent : HolePercents)
+	{
+		KinectTest::MakeDepthFrame(DepthWidth, DepthHeight, HolePercent, 1, Depth);
+		for (const int32 Radius : Radii)
+		{
+			FKinectHoleFillSettings Settings;
+			Settings.Radius = Radius;
+			const double ReferenceMs = KinectTest::TimeMilliseconds(3, [&]()
+			{
+				ReferenceFill(Depth.GetData(), DepthWidth, DepthHeight, Settings, Out.GetData());
+			});
+			const double FillerMs = KinectTest::TimeMilliseconds(20, [&]()
+			{
+				Filler.Fill(Depth.GetData(), DepthWidth, DepthHeight, Settings, Out.GetData());
+			});
+			AddLogItem(FString::Printf(TEXT("%dx%d, %d%% holes, radius %d: gather and sort %.2f ms, hole filler %.2f ms"),
+				DepthWidth, DepthHeight, HolePercent, Radius, ReferenceMs, FillerMs));
+		}
+	}
+	return true;
+}
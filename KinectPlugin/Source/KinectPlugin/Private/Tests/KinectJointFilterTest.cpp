@@ -0,0 +1,331 @@
+#include "KinectPluginPrivatePCH.h"
+#include "KinectJointFilter.h"
+#include "KinectTestHelpers.h"
+
+static const int32 NumFrames = 240;
+static const TIMESPAN FrameTicks = 333333;
+
+/** State of one joint channel in the reference filters. */
+struct FReferenceState
+{
+	int32 History;
+	float Estimate[4];
+	float Trend[4];
+	float PreviousRaw[4];
+};
+
+/** 1 Euro filter of one joint as Casiez et al. give it, with the cutoff driven by the joint's speed. */
+static void ReferenceOneEuro(const FKinectJointFilterParams &Params, FReferenceState &State, float *Value, int32 NumComponents, float Dt)
+{
+	if (State.History == 0)
+	{
+		for (int32 c = 0; c < NumComponents; c++)
+		{
+			State.Estimate[c] = Value[c];
+			State.Trend[c] = 0.0f;
+		}
+		return;
+	}
+	const float DerivativeTe = 2.0f * PI * Params.DerivativeCutoff * Dt;
+	const float DerivativeAlpha = DerivativeTe / (DerivativeTe + 1.0f);
+	float Speed2 = 0.0f;
+	for (int32 c = 0; c < NumComponents; c++)
+	{
+		const float Rate = (Value[c] - State.Estimate[c]) / Dt;
+		State.Trend[c] += DerivativeAlpha * (Rate - State.Trend[c]);
+		Speed2 += State.Trend[c] * State.Trend[c];
+	}
+	const float Te = 2.0f * PI * (Params.MinCutoff + Params.Beta * FMath::Sqrt(Speed2)) * Dt;
+	const float Alpha = Te / (Te + 1.0f);
+	for (int32 c = 0; c < NumComponents; c++)
+	{
+		State.Estimate[c] += Alpha * (Value[c] - State.Estimate[c]);
+		Value[c] = State.Estimate[c];
+	}
+}
+
+/** Holt's double exponential smoothing of one joint, with the Kinect SDK's jitter removal and clamped prediction. */
+static void ReferenceDoubleExponential(const FKinectJointFilterParams &Params, FReferenceState &State, float *Value, int32 NumComponents)
+{
+	float Raw[4];
+	FMemory::Memcpy(Raw, Value, sizeof(float) * NumComponents);
+	if (State.History == 0)
+	{
+		for (int32 c = 0; c < NumComponents; c++)
+		{
+			State.Estimate[c] = Raw[c];
+			State.Trend[c] = 0.0f;
+			State.PreviousRaw[c] = Raw[c];
+		}
+		return;
+	}
+	float Filtered[4];
+	if (State.History == 1)
+	{
+		for (int32 c = 0; c < NumComponents; c++)
+		{
+			Filtered[c] = (Raw[c] + State.PreviousRaw[c]) * 0.5f;
+		}
+	}
+	else
+	{
+		float Distance2 = 0.0f;
+		for (int32 c = 0; c < NumComponents; c++)
+		{
+			Distance2 += FMath::Square(Raw[c] - State.Estimate[c]);
+		}
+		const float Distance = FMath::Sqrt(Distance2);
+		const float JitterWeight = Params.JitterRadius > 0.0f && Distance < Params.JitterRadius ? Distance / Params.JitterRadius : 1.0f;
+		for (int32 c = 0; c < NumComponents; c++)
+		{
+			const float Dejittered = State.Estimate[c] + JitterWeight * (Raw[c] - State.Estimate[c]);
+			Filtered[c] = Dejittered * (1.0f - Params.Smoothing) + (State.Estimate[c] + State.Trend[c]) * Params.Smoothing;
+		}
+	}
+	float Predicted[4];
+	float Deviation2 = 0.0f;
+	for (int32 c = 0; c < NumComponents; c++)
+	{
+		State.Trend[c] = (Filtered[c] - State.Estimate[c]) * Params.Correction + State.Trend[c] * (1.0f - Params.Correction);
+		State.Estimate[c] = Filtered[c];
+		State.PreviousRaw[c] = Raw[c];
+		Predicted[c] = Filtered[c] + State.Trend[c] * Params.Prediction;
+		Deviation2 += FMath::Square(Predicted[c] - Raw[c]);
+	}
+	const float Deviation = FMath::Sqrt(Deviation2);
+	const float Pull = Params.MaxDeviationRadius > 0.0f && Deviation > Params.MaxDeviationRadius ? Params.MaxDeviationRadius / Deviation : 1.0f;
+	for (int32 c = 0; c < NumComponents; c++)
+	{
+		Value[c] = Raw[c] + Pull * (Predicted[c] - Raw[c]);
+	}
+}
+
+/** FKinectJointFilter written one joint at a time, as plainly as the filters read on paper. */
+class FReferenceJointFilter
+{
+public:
+	FReferenceJointFilter(EKinectJointFilter::Type InType)
+		: Type(InType)
+		, LastTime(0)
+	{
+		FMemory::Memzero(States, sizeof(States));
+		for (int32 j = 0; j < JointType_Count; j++)
+		{
+			Params[FKinectJointFilter::Position][j] = FKinectJointFilter::GetDefaultParams(FKinectJointFilter::Position);
+			Params[FKinectJointFilter::Orientation][j] = FKinectJointFilter::GetDefaultParams(FKinectJointFilter::Orientation);
+		}
+	}
+
+	FKinectJointFilterParams Params[FKinectJointFilter::NumChannels][JointType_Count];
+
+	void Apply(FKinectBodyFrame &Frame)
+	{
+		const double Dt = (Frame.Time - LastTime) / KinectTicksPerSecond;
+		const bool bGap = LastTime == 0 || Dt <= 0.0 || Dt > 0.5;
+		LastTime = Frame.Time;
+		const float Interval = bGap ? 1.0f / 30.0f : static_cast<float>(Dt);
+		for (int32 Body = 0; Body < BODY_COUNT; Body++)
+		{
+			for (int32 j = 0; j < JointType_Count; j++)
+			{
+				FReferenceState (&Joint)[FKinectJointFilter::NumChannels] = States[Body][j];
+				if (bGap || !Frame.bTracked[Body])
+				{
+					Joint[FKinectJointFilter::Position].History = 0;
+					Joint[FKinectJointFilter::Orientation].History = 0;
+				}
+				if (!Frame.bTracked[Body])
+				{
+					continue;
+				}
+				FVector &P = Frame.Positions[Body][j];
+				float Position[3] = { P.X, P.Y, P.Z };
+				FQuat &Q = Frame.Orientations[Body][j];
+				float Orientation[4] = { Q.X, Q.Y, Q.Z, Q.W };
+				FReferenceState &OrientationState = Joint[FKinectJointFilter::Orientation];
+				float Dot = 0.0f;
+				for (int32 c = 0; c < 4; c++)
+				{
+					Dot += Orientation[c] * OrientationState.Estimate[c];
+				}
+				if (OrientationState.History > 0 && Dot < 0.0f)
+				{
+					for (int32 c = 0; c < 4; c++)
+					{
+						Orientation[c] = -Orientation[c];
+					}
+				}
+				Filter(FKinectJointFilter::Position, j, Joint[FKinectJointFilter::Position], Position, 3, Interval);
+				Filter(FKinectJointFilter::Orientation, j, OrientationState, Orientation, 4, Interval);
+				P = FVector(Position[0], Position[1], Position[2]);
+				Q = FQuat(Orientation[0], Orientation[1], Orientation[2], Orientation[3]);
+				Q.Normalize();
+				Joint[FKinectJointFilter::Position].History = FMath::Min(Joint[FKinectJointFilter::Position].History + 1, 2);
+				OrientationState.History = FMath::Min(OrientationState.History + 1, 2);
+			}
+		}
+	}
+
+private:
+	void Filter(int32 Channel, int32 Joint, FReferenceState &State, float *Value, int32 NumComponents, float Dt)
+	{
+		if (Type == EKinectJointFilter::OneEuro)
+		{
+			ReferenceOneEuro(Params[Channel][Joint], State, Value, NumComponents, Dt);
+		}
+		else
+		{
+			ReferenceDoubleExponential(Params[Channel][Joint], State, Value, NumComponents);
+		}
+	}
+
+	EKinectJointFilter::Type Type;
+	FReferenceState States[BODY_COUNT][JointType_Count][FKinectJointFilter::NumChannels];
+	TIMESPAN LastTime;
+};
+
+/**
+ * Frame Index of a synthetic recording: every joint sways at its own rate
+ * and some swing fast, with sensor like noise and quaternions that come with
+ * either sign. Body 0 stays tracked, body 2 is lost for a while and body 5
+ * comes in late; frame 150 arrives after a second's gap.
+ */
+static void MakeBodyFrame(int32 Index, FRandomStream &Random, FKinectBodyFrame &Frame)
+{
+	Frame.Time = FrameTicks * (Index + 1) + (Index >= 150 ? static_cast<TIMESPAN>(KinectTicksPerSecond) : 0);
+	const float Seconds = static_cast<float>(Frame.Time / KinectTicksPerSecond);
+	for (int32 Body = 0; Body < BODY_COUNT; Body++)
+	{
+		Frame.bTracked[Body] = Body == 0 || (Body == 2 && (Index < 80 || Index >= 100)) || (Body == 5 && Index >= 50);
+		for (int32 j = 0; j < JointType_Count; j++)
+		{
+			const float Rate = 0.3f + 0.2f * j + (j % 5 == 0 ? 3.0f : 0.0f);
+			const float Phase = Rate * Seconds + Body;
+			Frame.Positions[Body][j] = FVector(100.0f * Body + 20.0f * FMath::Sin(Phase), 5.0f * j + 10.0f * FMath::Cos(1.3f * Phase), 200.0f + 15.0f * FMath::Sin(0.7f * Phase)) +
+				FVector(Random.FRandRange(-0.5f, 0.5f), Random.FRandRange(-0.5f, 0.5f), Random.FRandRange(-0.5f, 0.5f));
+			const float HalfAngle = 0.5f * (Phase + Random.FRandRange(-0.02f, 0.02f));
+			const FVector Axis = FVector(FMath::Sin(0.1f * j), FMath::Cos(0.1f * j), 0.5f) * (1.0f / FMath::Sqrt(1.25f));
+			const float Sign = Random.FRand() < 0.2f ? -1.0f : 1.0f;
+			Frame.Orientations[Body][j] = FQuat(Axis.X * FMath::Sin(HalfAngle) * Sign, Axis.Y * FMath::Sin(HalfAngle) * Sign,
+				Axis.Z * FMath::Sin(HalfAngle) * Sign, FMath::Cos(HalfAngle) * Sign);
+		}
+	}
+}
+
+/** Largest difference of any tracked joint's position, in centimeters, and of its orientation's components. */
+static void MeasureDifference(const FKinectBodyFrame &A, const FKinectBodyFrame &B, float &InOutPosition, float &InOutOrientation)
+{
+	for (int32 Body = 0; Body < BODY_COUNT; Body++)
+	{
+		if (!A.bTracked[Body])
+		{
+			continue;
+		}
+		for (int32 j = 0; j < JointType_Count; j++)
+		{
+			const FVector Delta = A.Positions[Body][j] - B.Positions[Body][j];
+			InOutPosition = FMath::Max(InOutPosition, FMath::Max(FMath::Abs(Delta.X), FMath::Max(FMath::Abs(Delta.Y), FMath::Abs(Delta.Z))));
+			const FQuat &P = A.Orientations[Body][j];
+			const FQuat &Q = B.Orientations[Body][j];
+			InOutOrientation = FMath::Max(InOutOrientation, FMath::Max(FMath::Max(FMath::Abs(P.X - Q.X), FMath::Abs(P.Y - Q.Y)),
+				FMath::Max(FMath::Abs(P.Z - Q.Z), FMath::Abs(P.W - Q.W))));
+		}
+	}
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FKinectJointFilterTest, "Kinect.JointFilter.MatchesReference", KINECT_TEST_FLAGS)
+
+bool FKinectJointFilterTest::RunTest(const FString &Parameters)
+{
+	// Float rounding drifts apart a little over hundreds of frames, far below the sensor's noise
+	const float PositionTolerance = 1e-3f;
+	const float OrientationTolerance = 1e-4f;
+	const EKinectJointFilter::Type Types[] = { EKinectJointFilter::OneEuro, EKinectJointFilter::DoubleExponential };
+	// One joint with parameters of its own, as an override would set them
+	FKinectJointFilterParams HandParams;
+	HandParams.MinCutoff = 3.0f;
+	HandParams.Beta = 0.2f;
+	HandParams.Smoothing = 0.25f;
+	HandParams.JitterRadius = 1.0f;
+	HandParams.MaxDeviationRadius = 1.0f;
+	for (const EKinectJointFilter::Type Type : Types)
+	{
+		TSharedRef<FKinectJointFilter> Lanes = MakeShareable(new FKinectJointFilter());
+		TSharedRef<FKinectJointFilter> Scalar = MakeShareable(new FKinectJointFilter());
+		TSharedRef<FReferenceJointFilter> Reference = MakeShareable(new FReferenceJointFilter(Type));
+		Lanes->SetType(Type);
+		Scalar->SetType(Type);
+		Scalar->SetScalarLanes(true);
+		Lanes->SetParams(FKinectJointFilter::Position, JointType_HandLeft, HandParams);
+		Scalar->SetParams(FKinectJointFilter::Position, JointType_HandLeft, HandParams);
+		Reference->Params[FKinectJointFilter::Position][JointType_HandLeft] = HandParams;
+
+		FRandomStream Random(static_cast<int32>(Type));
+		TSharedRef<FKinectBodyFrame> LanesFrame = MakeShareable(new FKinectBodyFrame());
+		TSharedRef<FKinectBodyFrame> ScalarFrame = MakeShareable(new FKinectBodyFrame());
+		TSharedRef<FKinectBodyFrame> ReferenceFrame = MakeShareable(new FKinectBodyFrame());
+		float LanesPosition = 0.0f;
+		float LanesOrientation = 0.0f;
+		float ScalarPosition = 0.0f;
+		float ScalarOrientation = 0.0f;
+		for (int32 Index = 0; Index < NumFrames; Index++)
+		{
+			MakeBodyFrame(Index, Random, *ReferenceFrame);
+			*LanesFrame = *ReferenceFrame;
+			*ScalarFrame = *ReferenceFrame;
+			Lanes->Apply(*LanesFrame);
+			Scalar->Apply(*ScalarFrame);
+			Reference->Apply(*ReferenceFrame);
+			MeasureDifference(*ReferenceFrame, *LanesFrame, LanesPosition, LanesOrientation);
+			MeasureDifference(*ReferenceFrame, *ScalarFrame, ScalarPosition, ScalarOrientation);
+		}
+		const TCHAR *Name = Type == EKinectJointFilter::OneEuro ? TEXT("1 Euro") : TEXT("double exponential");
+		TestTrue(FString::Printf(TEXT("%s SSE lane positions within %g cm of the reference, off by %g"), Name, PositionTolerance, LanesPosition), LanesPosition <= PositionTolerance);
+		TestTrue(FString::Printf(TEXT("%s SSE lane orientations within %g of the reference, off by %g"), Name, OrientationTolerance, LanesOrientation), LanesOrientation <= OrientationTolerance);
+		TestTrue(FString::Printf(TEXT("%s scalar lane positions within %g cm of the reference, off by %g"), Name, PositionTolerance, ScalarPosition), ScalarPosition <= PositionTolerance);
+		TestTrue(FString::Printf(TEXT("%s scalar lane orientations within %g of the reference, off by %g"), Name, OrientationTolerance, ScalarOrientation), ScalarOrientation <= OrientationTolerance);
+	}
+	return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FKinectJointFilterBenchmark, "Kinect.Benchmark.JointFilter", KINECT_TEST_FLAGS)
+
+bool FKinectJointFilterBenchmark::RunTest(const FString &Parameters)
+{
+	// Every body tracked, the most work a frame can be
+	TArray<TSharedRef<FKinectBodyFrame>> Frames;
+	FRandomStream Random(1);
+	for (int32 Index = 0; Index < 64; Index++)
+	{
+		Frames.Add(MakeShareable(new FKinectBodyFrame()));
+		MakeBodyFrame(Index, Random, *Frames.Last());
+		for (int32 Body = 0; Body < BODY_COUNT; Body++)
+		{
+			Frames.Last()->bTracked[Body] = true;
+		}
+	}
+	TSharedRef<FKinectBodyFrame> Frame = MakeShareable(new FKinectBodyFrame());
+	const EKinectJointFilter::Type Types[] = { EKinectJointFilter::OneEuro, EKinectJointFilter::DoubleExponential };
+	for (const EKinectJointFilter::Type Type : Types)
+	{
+		double Milliseconds[2];
+		for (int32 Path = 0; Path < 2; Path++)
+		{
+			TSharedRef<FKinectJointFilter> Filter = MakeShareable(new FKinectJointFilter());
+			Filter->SetType(Type);
+			Filter->SetScalarLanes(Path == 1);
+			int32 Index = 0;
+			Milliseconds[Path] = KinectTest::TimeMilliseconds(2000, [&]()
+			{
+				*Frame = *Frames[Index % Frames.Num()];
+				// Times keep going up across passes over the frames, so the filter never restarts
+				Frame->Time = FrameTicks * (Index + 1);
+				Filter->Apply(*Frame);
+				Index++;
+			});
+		}
+		AddLogItem(FString::Printf(TEXT("%s, %d bodies: SSE lanes %.4f ms, scalar lanes %.4f ms per frame"),
+			Type == EKinectJointFilter::OneEuro ? TEXT("1 Euro") : TEXT("double exponential"), BODY_COUNT, Milliseconds[0], Milliseconds[1]));
+	}
+	return true;
+}
@@ -0,0 +1,187 @@
+#include "KinectPluginPrivatePCH.h"
+#include "KinectMeshSectionWriter.h"
+#include "KinectTestHelpers.h"
+
+/**
+ * Passes every call on to the allocator it replaces, counting the calls made
+ * from the thread that began counting, so work of the engine's other threads
+ * does not show up in the counts. Other threads may still be inside it after
+ * End, so it must outlive the test.
+ */
+class FKinectCountingMalloc : public FMalloc
+{
+public:
+	FKinectCountingMalloc()
+		: Inner(nullptr)
+		, ThreadId(0)
+		, Allocations(0)
+		, Bytes(0)
+	{
+	}
+
+	void Begin()
+	{
+		Inner = GMalloc;
+		ThreadId = FPlatformTLS::GetCurrentThreadId();
+		Allocations = 0;
+		Bytes = 0;
+		GMalloc = this;
+	}
+
+	void End()
+	{
+		GMalloc = Inner;
+	}
+
+	virtual void* Malloc(SIZE_T Count, uint32 Alignment) override
+	{
+		CountAllocation(Count);
+		return Inner->Malloc(Count, Alignment);
+	}
+
+	virtual void* Realloc(void *Original, SIZE_T Count, uint32 Alignment) override
+	{
+		CountAllocation(Count);
+		return Inner->Realloc(Original, Count, Alignment);
+	}
+
+	virtual void Free(void *Original) override
+	{
+		Inner->Free(Original);
+	}
+
+	virtual bool GetAllocationSize(void *Original, SIZE_T &SizeOut) override
+	{
+		return Inner->GetAllocationSize(Original, SizeOut);
+	}
+
+	virtual bool IsInternallyThreadSafe() const override
+	{
+		return Inner->IsInternallyThreadSafe();
+	}
+
+	virtual const TCHAR* GetDescriptiveName() override
+	{
+		return TEXT("KinectCountingMalloc");
+	}
+
+	int32 GetAllocations() const
+	{
+		return Allocations;
+	}
+
+	int64 GetBytes() const
+	{
+		return Bytes;
+	}
+
+private:
+	void CountAllocation(SIZE_T Size)
+	{
+		if (FPlatformTLS::GetCurrentThreadId() == ThreadId && Size > 0)
+		{
+			Allocations++;
+			Bytes += Size;
+		}
+	}
+
+	FMalloc *Inner;
+	uint32 ThreadId;
+	int32 Allocations;
+	int64 Bytes;
+};
+
+/** Quads of a depth mesh at step 2, a few percent of them cut from one frame to the next as the mesher's quads come and go. */
+static void MakeQuadFrame(FRandomStream &Random, int32 MaxQuads, FKinectMeshBuffers &Out)
+{
+	const int32 NumQuads = MaxQuads - Random.RandHelper(MaxQuads / 20);
+	Out.Reset();
+	Out.IndexPattern = EKinectMeshIndexPattern::Quads;
+	Out.Vertices.SetNumUninitialized(NumQuads * 4);
+	Out.Colors.SetNumUninitialized(NumQuads * 4);
+	Out.Triangles.SetNumUninitialized(NumQuads * 6);
+	for (int32 q = 0; q < NumQuads; q++)
+	{
+		const float X = (q % 256) * 2.0f;
+		const float Z = (q / 256) * 2.0f;
+		const float Depth = 150.0f + Random.FRand();
+		Out.Vertices[q * 4] = FVector(Depth, X, Z);
+		Out.Vertices[q * 4 + 1] = FVector(Depth, X + 2.0f, Z);
+		Out.Vertices[q * 4 + 2] = FVector(Depth, X, Z + 2.0f);
+		Out.Vertices[q * 4 + 3] = FVector(Depth, X + 2.0f, Z + 2.0f);
+		const int32 Corners[] = { 0, 1, 2, 1, 3, 2 };
+		for (int32 c = 0; c < 6; c++)
+		{
+			Out.Triangles[q * 6 + c] = q * 4 + Corners[c];
+		}
+	}
+	for (int32 i = 0; i < Out.Colors.Num(); i++)
+	{
+		Out.Colors[i] = FColor(128, 128, 128, 255);
+	}
+	Out.TopologySerial++;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FKinectMeshSectionWriterBenchmark, "Kinect.Benchmark.MeshSectionWriter", KINECT_TEST_FLAGS)
+
+bool FKinectMeshSectionWriterBenchmark::RunTest(const FString &Parameters)
+{
+	static const int32 NumFrames = 30;
+	static FKinectCountingMalloc Counter;
+	// A 512x424 image meshed at step 2 is at most 256 by 212 quads; the viewport usually keeps about two thirds
+	const int32 QuadCounts[] = { 36000, 54000 };
+	// The component is never registered, so no render proxy is made and only the game thread's work is timed
+	UProceduralMeshComponent *MeshComp = NewObject<UProceduralMeshComponent>();
+	const TArray<FVector> NoNormals;
+	const TArray<FVector2D> NoUVs;
+	const TArray<FProcMeshTangent> NoTangents;
+	TArray<FKinectMeshBuffers> Frames;
+	Frames.AddDefaulted(NumFrames);
+	for (const int32 MaxQuads : QuadCounts)
+	{
+		FRandomStream Random(MaxQuads);
+		for (FKinectMeshBuffers &Frame : Frames)
+		{
+			MakeQuadFrame(Random, MaxQuads, Frame);
+		}
+
+		// What both actors did every frame before FKinectMeshSectionWriter
+		int32 RecreateAllocations = 0;
+		int64 RecreateBytes = 0;
+		const double RecreateMs = KinectTest::TimeMilliseconds(1, [&]()
+		{
+			Counter.Begin();
+			for (const FKinectMeshBuffers &Frame : Frames)
+			{
+				MeshComp->ClearAllMeshSections();
+				MeshComp->CreateMeshSection(0, Frame.Vertices, Frame.Triangles, NoNormals, NoUVs, Frame.Colors, NoTangents, false);
+			}
+			Counter.End();
+			RecreateAllocations = Counter.GetAllocations();
+			RecreateBytes = Counter.GetBytes();
+		}) / NumFrames;
+
+		MeshComp->ClearAllMeshSections();
+		FKinectMeshSectionWriter Writer;
+		int32 WriteAllocations = 0;
+		int64 WriteBytes = 0;
+		// The warm up call creates the section, so the timed frames are the steady state
+		const double WriteMs = KinectTest::TimeMilliseconds(1, [&]()
+		{
+			Counter.Begin();
+			for (const FKinectMeshBuffers &Frame : Frames)
+			{
+				Writer.Write(MeshComp, 0, Frame, NoNormals, false);
+			}
+			Counter.End();
+			WriteAllocations = Counter.GetAllocations();
+			WriteBytes = Counter.GetBytes();
+		}) / NumFrames;
+		MeshComp->ClearAllMeshSections();
+
+		AddLogItem(FString::Printf(TEXT("%d quads: clear and create %.2f ms, %.1f allocations, %.1f MB per frame; section writer %.2f ms, %.1f allocations, %.1f MB per frame"),
+			MaxQuads, RecreateMs, static_cast<float>(RecreateAllocations) / NumFrames, RecreateBytes / (1024.0 * 1024.0 * NumFrames),
+			WriteMs, static_cast<float>(WriteAllocations) / NumFrames, WriteBytes / (1024.0 * 1024.0 * NumFrames)));
+	}
+	return true;
+}
@@ -0,0 +1,236 @@
+#include "KinectPluginPrivatePCH.h"
+#include "KinectRecording.h"
+#include "KinectTestHelpers.h"
+
+/** Small images keep the files small; nothing in the format depends on the sensor's sizes. */
+static const FIntPoint ColorSize(96, 54);
+static const FIntPoint DepthSize(64, 53);
+static const int32 NumFrames = 8;
+/** Frame the second calibration is written before. */
+static const int32 RecalibratedFrame = 5;
+
+/** Bundles as the sources hand them out: color at half the depth rate, and a frame of bodies alone. */
+static void MakeBundles(TArray<FKinectFrameBundle> &OutBundles)
+{
+	FRandomStream Random(NumFrames);
+	OutBundles.SetNum(NumFrames);
+	for (int32 Frame = 0; Frame < NumFrames; Frame++)
+	{
+		FKinectFrameBundle &Bundle = OutBundles[Frame];
+		const TIMESPAN Time = 1000000 + Frame * 333333;
+		Bundle.Streams = Frame == 3 ? EKinectFrameStream::Body : EKinectFrameStream::Depth | EKinectFrameStream::BodyIndex | EKinectFrameStream::Body;
+		if (Frame % 2 == 0)
+		{
+			Bundle.Streams |= EKinectFrameStream::Color;
+		}
+		Bundle.ColorTime = Bundle.Has(EKinectFrameStream::Color) ? Time + 1234 : 0;
+		Bundle.DepthTime = Bundle.Has(EKinectFrameStream::Depth) ? Time : 0;
+		Bundle.BodyIndexTime = Bundle.DepthTime;
+		Bundle.BodyTime = Time;
+		if (Bundle.Has(EKinectFrameStream::Color))
+		{
+			uint8 *Color = Bundle.Color.Allocate(ColorSize.X * ColorSize.Y * 2);
+			for (int32 i = 0; i < Bundle.Color.Num(); i++)
+			{
+				Color[i] = static_cast<uint8>(Random.RandHelper(256));
+			}
+		}
+		if (Bundle.Has(EKinectFrameStream::Depth))
+		{
+			TArray<uint16> Depth;
+			KinectTest::MakeDepthFrame(DepthSize.X, DepthSize.Y, 5, Frame, Depth);
+			FMemory::Memcpy(Bundle.Depth.Allocate(Depth.Num()), Depth.GetData(), Depth.Num() * sizeof(uint16));
+			uint8 *BodyIndex = Bundle.BodyIndex.Allocate(Depth.Num());
+			for (int32 i = 0; i < Depth.Num(); i++)
+			{
+				BodyIndex[i] = Depth[i] != 0 && Depth[i] < 1000 ? static_cast<uint8>(Frame % BODY_COUNT) : 0xff;
+			}
+		}
+		// Any bytes will do, the reader hands bodies back as they were written
+		FMemory::Memset(Bundle.Bodies, static_cast<uint8>(Frame + 1), sizeof(Bundle.Bodies));
+		for (int32 Body = 0; Body < BODY_COUNT; Body++)
+		{
+			Bundle.Bodies[Body].bTracked = Body == Frame % BODY_COUNT;
+			Bundle.Bodies[Body].Attributes = EKinectBodyAttribute::Default;
+		}
+	}
+}
+
+/** A calibration whose tables differ from pixel to pixel and from one Seed to another. */
+static void MakeCalibration(int32 Seed, FKinectRecordedCalibration &Out)
+{
+	const int32 NumPixels = DepthSize.X * DepthSize.Y;
+	Out.Width = DepthSize.X;
+	Out.Height = DepthSize.Y;
+	Out.Intrinsics.FocalLengthX = 365.0f + Seed;
+	Out.Intrinsics.FocalLengthY = 364.0f + Seed;
+	Out.Intrinsics.PrincipalPointX = DepthSize.X * 0.5f;
+	Out.Intrinsics.PrincipalPointY = DepthSize.Y * 0.5f;
+	Out.DepthRays.SetNumUninitialized(NumPixels);
+	Out.NearColorPoints.SetNumUninitialized(NumPixels);
+	Out.FarColorPoints.SetNumUninitialized(NumPixels);
+	for (int32 i = 0; i < NumPixels; i++)
+	{
+		const float X = static_cast<float>(i % DepthSize.X);
+		const float Y = static_cast<float>(i / DepthSize.X);
+		Out.DepthRays[i] = FVector2D((X - Out.Intrinsics.PrincipalPointX) / Out.Intrinsics.FocalLengthX, (Y - Out.Intrinsics.PrincipalPointY) / Out.Intrinsics.FocalLengthY);
+		Out.NearColorPoints[i].X = X * 1.5f + Seed;
+		Out.NearColorPoints[i].Y = Y * 1.5f;
+		Out.FarColorPoints[i].X = X * 1.5f - Seed;
+		Out.FarColorPoints[i].Y = Y * 1.5f + 0.25f;
+	}
+}
+
+/** Writes Bundles, with a calibration before the first and a second one before RecalibratedFrame; returns the offset the index starts at. */
+static int64 WriteRecording(const FString &Filename, bool bCompressDepth, const TArray<FKinectFrameBundle> &Bundles, const FKinectRecordedCalibration *Calibrations)
+{
+	FKinectRecordingWriter Writer;
+	Writer.SetCompressDepth(bCompressDepth);
+	if (!Writer.Open(Filename, ColorSize, DepthSize))
+	{
+		return 0;
+	}
+	for (int32 Frame = 0; Frame < Bundles.Num(); Frame++)
+	{
+		if ((Frame == 0 && !Writer.WriteCalibration(Calibrations[0])) ||
+			(Frame == RecalibratedFrame && !Writer.WriteCalibration(Calibrations[1])) ||
+			!Writer.WriteFrame(Bundles[Frame]))
+		{
+			return 0;
+		}
+	}
+	const int64 IndexOffset = Writer.GetBytesWritten();
+	return Writer.Close() ? IndexOffset : 0;
+}
+
+template<typename T>
+static bool PlanesEqual(const TKinectFramePlane<T> &A, const TKinectFramePlane<T> &B)
+{
+	return A.Num() == B.Num() && FMemory::Memcmp(A.GetData(), B.GetData(), A.Num() * sizeof(T)) == 0;
+}
+
+static bool CalibrationsEqual(const FKinectRecordedCalibration &A, const FKinectRecordedCalibration &B)
+{
+	const int32 NumPixels = A.Width * A.Height;
+	return A.Width == B.Width && A.Height == B.Height && A.NearDepth == B.NearDepth && A.FarDepth == B.FarDepth &&
+		FMemory::Memcmp(&A.Intrinsics, &B.Intrinsics, sizeof(A.Intrinsics)) == 0 &&
+		B.DepthRays.Num() == NumPixels && FMemory::Memcmp(A.DepthRays.GetData(), B.DepthRays.GetData(), NumPixels * sizeof(FVector2D)) == 0 &&
+		B.NearColorPoints.Num() == NumPixels && FMemory::Memcmp(A.NearColorPoints.GetData(), B.NearColorPoints.GetData(), NumPixels * sizeof(ColorSpacePoint)) == 0 &&
+		B.FarColorPoints.Num() == NumPixels && FMemory::Memcmp(A.FarColorPoints.GetData(), B.FarColorPoints.GetData(), NumPixels * sizeof(ColorSpacePoint)) == 0;
+}
+
+/** Reads every frame of Filename back and compares it, its time and its calibration with what was written. */
+static void TestRecording(FAutomationTestBase &Test, const FString &Case, const FString &Filename, int32 ExpectedFrames,
+	const TArray<FKinectFrameBundle> &Bundles, const FKinectRecordedCalibration *Calibrations)
+{
+	FKinectRecordingReader Reader;
+	if (!Reader.Open(Filename))
+	{
+		Test.AddError(FString::Printf(TEXT("Cannot open the recording, %s"), *Case));
+		return;
+	}
+	Test.TestEqual(FString::Printf(TEXT("Frames, %s"), *Case), Reader.GetNumFrames(), ExpectedFrames);
+	Test.TestTrue(FString::Printf(TEXT("Sizes, %s"), *Case), Reader.GetColorSize() == ColorSize && Reader.GetDepthSize() == DepthSize);
+	FKinectFrameBundle Bundle;
+	FKinectRecordedCalibration Calibration;
+	for (int32 Frame = 0; Frame < FMath::Min(Reader.GetNumFrames(), ExpectedFrames); Frame++)
+	{
+		const FKinectFrameBundle &Written = Bundles[Frame];
+		const FString FrameCase = FString::Printf(TEXT("frame %d, %s"), Frame, *Case);
+		const TIMESPAN ExpectedTime = Written.Has(EKinectFrameStream::Depth) ? Written.DepthTime : FMath::Max(Written.ColorTime, Written.BodyTime);
+		Test.TestTrue(FString::Printf(TEXT("Index time, %s"), *FrameCase), Reader.GetFrameTime(Frame) == ExpectedTime);
+		if (!Reader.ReadFrame(Frame, Bundle))
+		{
+			Test.AddError(FString::Printf(TEXT("Cannot read %s"), *FrameCase));
+			continue;
+		}
+		Test.TestEqual(FString::Printf(TEXT("Streams, %s"), *FrameCase), Bundle.Streams, Written.Streams);
+		Test.TestTrue(FString::Printf(TEXT("Stream times, %s"), *FrameCase), Bundle.ColorTime == Written.ColorTime && Bundle.DepthTime == Written.DepthTime &&
+			Bundle.BodyIndexTime == Written.BodyIndexTime && Bundle.BodyTime == Written.BodyTime);
+		Test.TestTrue(FString::Printf(TEXT("Color, %s"), *FrameCase), PlanesEqual(Bundle.Color, Written.Color));
+		Test.TestTrue(FString::Printf(TEXT("Depth, %s"), *FrameCase), PlanesEqual(Bundle.Depth, Written.Depth));
+		Test.TestTrue(FString::Printf(TEXT("Body index, %s"), *FrameCase), PlanesEqual(Bundle.BodyIndex, Written.BodyIndex));
+		Test.TestTrue(FString::Printf(TEXT("Bodies, %s"), *FrameCase), FMemory::Memcmp(Bundle.Bodies, Written.Bodies, sizeof(Bundle.Bodies)) == 0);
+
+		const int32 ExpectedCalibration = Frame < RecalibratedFrame ? 0 : 1;
+		Test.TestTrue(FString::Printf(TEXT("Calibration id changes with the calibration only, %s"), *FrameCase),
+			(Reader.GetCalibrationId(Frame) == Reader.GetCalibrationId(0)) == (ExpectedCalibration == 0));
+		Test.TestTrue(FString::Printf(TEXT("Calibration, %s"), *FrameCase),
+			Reader.ReadCalibration(Frame, Calibration) && CalibrationsEqual(Calibrations[ExpectedCalibration], Calibration));
+	}
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FKinectRecordingRoundTripTest, "Kinect.Recording.RoundTrip", KINECT_TEST_FLAGS)
+
+bool FKinectRecordingRoundTripTest::RunTest(const FString &Parameters)
+{
+	TArray<FKinectFrameBundle> Bundles;
+	MakeBundles(Bundles);
+	FKinectRecordedCalibration Calibrations[2];
+	MakeCalibration(0, Calibrations[0]);
+	MakeCalibration(1, Calibrations[1]);
+	IFileManager::Get().MakeDirectory(*FPaths::AutomationTransientDir(), true);
+	const FString Filename = FPaths::CreateTempFilename(*FPaths::AutomationTransientDir(), TEXT("KinectRecording"));
+	const FString CutFilename = FPaths::CreateTempFilename(*FPaths::AutomationTransientDir(), TEXT("KinectRecordingCut"));
+	for (const bool bCompressDepth : { true, false })
+	{
+		const FString Depth = bCompressDepth ? TEXT("compressed depth") : TEXT("raw depth");
+		const int64 IndexOffset = WriteRecording(Filename, bCompressDepth, Bundles, Calibrations);
+		if (IndexOffset == 0)
+		{
+			AddError(FString::Printf(TEXT("Cannot write the recording, %s"), *Depth));
+			continue;
+		}
+		TestRecording(*this, FString::Printf(TEXT("closed, %s"), *Depth), Filename, NumFrames, Bundles, Calibrations);
+
+		// What a crash leaves: everything up to the index, then the same cut inside the last frame
+		TArray<uint8> Contents;
+		if (!FFileHelper::LoadFileToArray(Contents, *Filename))
+		{
+			AddError(FString::Printf(TEXT("Cannot load the recording, %s"), *Depth));
+			continue;
+		}
+		Contents.SetNum(IndexOffset);
+		if (FFileHelper::SaveArrayToFile(Contents, *CutFilename))
+		{
+			TestRecording(*this, FString::Printf(TEXT("not closed, %s"), *Depth), CutFilename, NumFrames, Bundles, Calibrations);
+		}
+		Contents.SetNum(IndexOffset - 100);
+		if (FFileHelper::SaveArrayToFile(Contents, *CutFilename))
+		{
+			TestRecording(*this, FString::Printf(TEXT("cut inside the last frame, %s"), *Depth), CutFilename, NumFrames - 1, Bundles, Calibrations);
+		}
+	}
+
+	// The header starts with magic, version, color size and depth size; one whose depth width disagrees with the raw depth frames fails them
+	TArray<uint8> Contents;
+	if (FFileHelper::LoadFileToArray(Contents, *Filename))
+	{
+		const int32 WrongDepthWidth = DepthSize.X + 1;
+		FMemory::Memcpy(Contents.GetData() + 4 * sizeof(int32), &WrongDepthWidth, sizeof(int32));
+		FKinectRecordingReader Reader;
+		FKinectFrameBundle Bundle;
+		TestTrue(TEXT("Frames of another depth size than the header's are read"),
+			FFileHelper::SaveArrayToFile(Contents, *CutFilename) && Reader.Open(CutFilename) && !Reader.ReadFrame(0, Bundle));
+	}
+
+	// Frames the recording's header cannot describe are not written either
+	FKinectRecordingWriter Writer;
+	if (Writer.Open(Filename, ColorSize, DepthSize))
+	{
+		FKinectFrameBundle Bundle = Bundles[0];
+		Bundle.Depth.Allocate(DepthSize.X * (DepthSize.Y + 1));
+		TestFalse(TEXT("Depth of another size is written"), Writer.WriteFrame(Bundle));
+		Bundle = Bundles[0];
+		Bundle.Color.Allocate(ColorSize.X * ColorSize.Y * 4);
+		TestFalse(TEXT("Color of another size is written"), Writer.WriteFrame(Bundle));
+		TestTrue(TEXT("A frame after refused ones is written"), Writer.WriteFrame(Bundles[1]));
+		Writer.Close();
+		FKinectRecordingReader Reader;
+		TestTrue(TEXT("Only the frame of the right size is recorded"), Reader.Open(Filename) && Reader.GetNumFrames() == 1);
+	}
+
+	IFileManager::Get().Delete(*Filename);
+	IFileManager::Get().Delete(*CutFilename);
+	return true;
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include "Core.h"
+#include "AutomationTest.h"
+
+/** The plugin's tests need no sensor, world or viewport, so they run in the editor and in games alike. */
+#define KINECT_TEST_FLAGS (EAutomationTestFlags::ATF_Editor | EAutomationTestFlags::ATF_Game)
+
+namespace KinectTest
+{
+	/**
+	 * Fills Out with a depth image in millimeters standing in for a recorded
+	 * one: a wall slanting away from 1.5 to 2.5 m, a sphere in front of it,
+	 * a few millimeters of noise, HolePercent percent of scattered holes and
+	 * a round hole in the wall.
+	 */
+	inline void MakeDepthFrame(int32 Width, int32 Height, int32 HolePercent, int32 Seed, TArray<uint16> &Out)
+	{
+		FRandomStream Random(Seed);
+		Out.SetNumUninitialized(Width * Height);
+		const float SphereX = Width * 0.6f;
+		const float SphereY = Height * 0.5f;
+		const float SphereRadius = Height * 0.25f;
+		const float HoleX = Width * 0.25f;
+		const float HoleY = Height * 0.3f;
+		const float HoleRadius = Height * 0.05f;
+		for (int32 y = 0; y < Height; y++)
+		{
+			for (int32 x = 0; x < Width; x++)
+			{
+				float Depth = 1500.0f + 1000.0f * x / Width;
+				const float SphereDistance2 = FMath::Square(x - SphereX) + FMath::Square(y - SphereY);
+				if (SphereDistance2 < FMath::Square(SphereRadius))
+				{
+					Depth = 1000.0f - 300.0f * FMath::Sqrt(1.0f - SphereDistance2 / FMath::Square(SphereRadius));
+				}
+				else if (FMath::Square(x - HoleX) + FMath::Square(y - HoleY) < FMath::Square(HoleRadius))
+				{
+					Depth = 0.0f;
+				}
+				if (Random.RandHelper(100) < HolePercent)
+				{
+					Depth = 0.0f;
+				}
+				Out[y * Width + x] = Depth > 0.0f ? static_cast<uint16>(Depth + Random.RandRange(-3, 3)) : 0;
+			}
+		}
+	}
+
+	/** Milliseconds per call of Func, averaged over Iterations calls after one to warm the caches up. */
+	template<typename TFunc>
+	double TimeMilliseconds(int32 Iterations, TFunc Func)
+	{
+		Func();
+		const double StartTime = FPlatformTime::Seconds();
+		for (int32 i = 0; i < Iterations; i++)
+		{
+			Func();
+		}
+		return (FPlatformTime::Seconds() - StartTime) * 1000.0 / FMath::Max(Iterations, 1);
+	}
+}
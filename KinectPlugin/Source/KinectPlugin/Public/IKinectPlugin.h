@@ -6,6 +6,8 @@
 
 KINECTPLUGIN_API DECLARE_LOG_CATEGORY_EXTERN(LogKinect, Warning, All);
 
+class FKinectSensorHub;
+
 /**
  * The public interface to this module
  */
@@ -34,5 +36,11 @@ public:
 	{
 		return FModuleManager::Get().IsModuleLoaded( "KinectPlugin" );
 	}
+
+	/**
+	 * The process wide sensor hub. Everything reading the sensor subscribes to it,
+	 * so the sensor is opened once and each frame is acquired once.
+	 */
+	virtual FKinectSensorHub& GetSensorHub() = 0;
 };
 